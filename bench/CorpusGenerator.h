@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Детерминированный синтетический корпус для бенчмарков.
+// Частоты слов подчиняются закону Ципфа: слово ранга r встречается
+// пропорционально 1 / (r + 1)^zipfExponent. Генератор не зависит от
+// реализации <random> в стандартной библиотеке, поэтому при одинаковых
+// параметрах корпус одинаков на всех платформах и между релизами.
+struct CorpusOptions {
+    size_t vocabulary = 50000;          // число различных слов
+    size_t documents = 10000;
+    size_t wordsPerDocument = 200;      // средняя длина документа (разброс +-50%)
+    double zipfExponent = 1.0;
+    uint64_t seed = 42;
+};
+
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(const CorpusOptions& options) : options(options), state(options.seed) {
+        cumulative.resize(std::max<size_t>(1, options.vocabulary));
+        double total = 0;
+        for (size_t rank = 0; rank < cumulative.size(); ++rank) {
+            total += 1.0 / std::pow(static_cast<double>(rank + 1), options.zipfExponent);
+            cumulative[rank] = total;
+        }
+        for (double& value : cumulative) {
+            value /= total;
+        }
+    }
+
+    // Слово ранга rank: 0 - самое частое. Только латинские буквы, чтобы
+    // токенизатор видел ровно одно слово
+    static std::string Word(size_t rank) {
+        std::string word;
+        do {
+            word.push_back(static_cast<char>('a' + rank % 26));
+            rank /= 26;
+        } while (rank > 0);
+        return word;
+    }
+
+    std::vector<std::string> Documents() {
+        std::vector<std::string> documents;
+        documents.reserve(options.documents);
+        size_t minWords = std::max<size_t>(1, options.wordsPerDocument / 2);
+        for (size_t doc = 0; doc < options.documents; ++doc) {
+            size_t words = minWords + next() % (options.wordsPerDocument + 1);
+            std::string text;
+            for (size_t i = 0; i < words; ++i) {
+                if (i > 0) {
+                    text.push_back(' ');
+                }
+                text += Word(sampleRank());
+            }
+            documents.push_back(std::move(text));
+        }
+        return documents;
+    }
+
+    // Запросы из termsPerQuery слов. Доля rareShare слов берется из редкого
+    // хвоста словаря (нижняя половина по частоте), остальные - по закону
+    // Ципфа, то есть в основном частые
+    std::vector<std::string> Queries(size_t count, size_t termsPerQuery, double rareShare = 0.3) {
+        std::vector<std::string> queries;
+        queries.reserve(count);
+        size_t tailBegin = cumulative.size() / 2;
+        for (size_t q = 0; q < count; ++q) {
+            std::string query;
+            for (size_t i = 0; i < termsPerQuery; ++i) {
+                if (i > 0) {
+                    query.push_back(' ');
+                }
+                bool rare = uniform() < rareShare;
+                size_t rank = rare ? tailBegin + next() % (cumulative.size() - tailBegin) : sampleRank();
+                query += Word(rank);
+            }
+            queries.push_back(std::move(query));
+        }
+        return queries;
+    }
+
+private:
+    CorpusOptions options;
+    uint64_t state;
+    std::vector<double> cumulative;     // нормированная функция распределения рангов
+
+    // SplitMix64
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    double uniform() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    size_t sampleRank() {
+        auto found = std::upper_bound(cumulative.begin(), cumulative.end(), uniform());
+        return std::min(static_cast<size_t>(found - cumulative.begin()), cumulative.size() - 1);
+    }
+};
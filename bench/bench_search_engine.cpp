@@ -0,0 +1,502 @@
+// Бенчмарки движка на синтетическом корпусе (Google Benchmark).
+//
+//   bench_search_engine [--corpus_documents=N] [--corpus_vocabulary=N]
+//                       [--corpus_words=N] [--corpus_zipf=S] [--corpus_seed=N]
+//                       [флаги Google Benchmark]
+//
+// Результаты печатаются в консоль и сохраняются в JSON
+// (bench_search_engine.json, если не задан свой --benchmark_out), чтобы
+// сравнивать релизы: compare.py из Google Benchmark или любой разбор JSON.
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "CorpusGenerator.h"
+#include "../src/ConverterJSON.h"
+#include "../src/DocumentStore.h"
+#include "../src/InvertedIndex.h"
+#include "../src/SearchServer.h"
+#include "../src/TermDictionary.h"
+
+namespace {
+
+CorpusOptions corpusOptions;
+
+// Корпус и индекс по нему строятся один раз на весь запуск
+const std::vector<std::string>& corpus() {
+    static const std::vector<std::string> documents = CorpusGenerator(corpusOptions).Documents();
+    return documents;
+}
+
+std::shared_ptr<InvertedIndex> buildCorpusIndex(bool positional, uint32_t fuzzyDistance = 0) {
+    auto built = std::make_shared<InvertedIndex>();
+    built->SetPositional(positional);
+    built->SetFuzzyDistance(fuzzyDistance);
+    built->UpdateDocumentBase(corpus());
+    built->WaitForMerges();
+    return built;
+}
+
+const std::shared_ptr<InvertedIndex>& corpusIndex() {
+    static const std::shared_ptr<InvertedIndex> index = buildCorpusIndex(false);
+    return index;
+}
+
+// Тот же корпус с позициями слов - для фразовых запросов
+const std::shared_ptr<InvertedIndex>& positionalCorpusIndex() {
+    static const std::shared_ptr<InvertedIndex> index = buildCorpusIndex(true);
+    return index;
+}
+
+// Тот же корпус с индексом удалений для нечеткого поиска на расстоянии distance
+const std::shared_ptr<InvertedIndex>& fuzzyCorpusIndex(uint32_t distance) {
+    static std::shared_ptr<InvertedIndex> indexes[FuzzyIndex::MAX_DISTANCE + 1];
+    if (!indexes[distance]) {
+        indexes[distance] = buildCorpusIndex(false, distance);
+    }
+    return indexes[distance];
+}
+
+size_t corpusBytes(const std::vector<std::string>& documents) {
+    size_t bytes = 0;
+    for (const auto& text : documents) {
+        bytes += text.size();
+    }
+    return bytes;
+}
+
+// Полная индексация: range(0) - число документов (префикс корпуса),
+// range(1) - потоки индексации (0 - по числу ядер), range(2) - с позициями слов
+void BM_UpdateDocumentBase(benchmark::State& state) {
+    const auto& documents = corpus();
+    size_t count = std::min(static_cast<size_t>(state.range(0)), documents.size());
+    std::vector<std::string> prefix(documents.begin(), documents.begin() + static_cast<std::ptrdiff_t>(count));
+
+    InvertedIndex index(static_cast<size_t>(state.range(1)));
+    index.SetPositional(state.range(2) != 0);
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<std::string> input = prefix;
+        state.ResumeTiming();
+        index.UpdateDocumentBase(std::move(input));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * corpusBytes(prefix)));
+}
+BENCHMARK(BM_UpdateDocumentBase)
+    ->ArgsProduct({{1000, 10000}, {1, 0}, {0, 1}})
+    ->ArgNames({"docs", "threads", "positional"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Постинги одного слова: range(0) - ранг слова по частоте (0 - самое частое)
+void BM_GetWordCount(benchmark::State& state) {
+    auto& index = *corpusIndex();
+    size_t rank = std::min(static_cast<size_t>(state.range(0)), corpusOptions.vocabulary - 1);
+    const std::string word = CorpusGenerator::Word(rank);
+    size_t postings = 0;
+    for (auto _ : state) {
+        auto entries = index.GetWordCount(word);
+        postings = entries.size();
+        benchmark::DoNotOptimize(entries.data());
+    }
+    state.counters["postings"] = static_cast<double>(postings);
+}
+BENCHMARK(BM_GetWordCount)->ArgName("rank")->Arg(0)->Arg(10)->Arg(1000)->Arg(40000);
+
+// Один запрос из range(0) слов, смесь частых и редких, через SearchServer::Search
+// с переиспользуемым буфером ответа: после прогрева без выделений памяти.
+// Кэш выключен - каждый запрос считается заново
+void runQueries(benchmark::State& state, Ranking ranking) {
+    SearchServer server(corpusIndex(), 5);
+    server.SetRanking(ranking);
+    CorpusGenerator generator(CorpusOptions{corpusOptions.vocabulary, 0, 0, corpusOptions.zipfExponent,
+                                            corpusOptions.seed + 1});
+    std::vector<std::string> queries = generator.Queries(1024, static_cast<size_t>(state.range(0)));
+
+    std::vector<RelativeIndex> result;
+    size_t next = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        server.Search(queries[next], result);
+        found += result.size();
+        benchmark::DoNotOptimize(result.data());
+        next = (next + 1) % queries.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.counters["results"] = benchmark::Counter(static_cast<double>(found), benchmark::Counter::kAvgIterations);
+}
+
+// Ранжирование по ТЗ: пересечение всех слов запроса
+void BM_ProcessQuery(benchmark::State& state) {
+    runQueries(state, Ranking::Absolute);
+}
+BENCHMARK(BM_ProcessQuery)->ArgName("terms")->DenseRange(1, 5);
+
+// BM25 по любому из слов, 5 лучших через block-max WAND
+void BM_ProcessQueryBm25(benchmark::State& state) {
+    runQueries(state, Ranking::BM25);
+}
+BENCHMARK(BM_ProcessQueryBm25)->ArgName("terms")->DenseRange(1, 5);
+
+// Фраза в кавычках из range(0) слов подряд, взятых из документов корпуса
+// (у каждой фразы есть хотя бы один ответ), по позиционному индексу.
+// Счетчики: размер индекса и доля позиций в нем
+void BM_PhraseQuery(benchmark::State& state) {
+    auto index = positionalCorpusIndex();
+    SearchServer server(index, 5);
+    size_t length = static_cast<size_t>(state.range(0));
+
+    std::vector<std::string> queries;
+    const auto& documents = corpus();
+    for (size_t i = 0; i < 1024 && !documents.empty(); ++i) {
+        std::istringstream words(documents[(i * 7919) % documents.size()]);
+        std::vector<std::string> text{std::istream_iterator<std::string>(words), std::istream_iterator<std::string>()};
+        if (text.size() < length) {
+            continue;
+        }
+        size_t start = (i * 31) % (text.size() - length + 1);
+        std::string query = "\"";
+        for (size_t k = 0; k < length; ++k) {
+            query += (k == 0 ? "" : " ") + text[start + k];
+        }
+        queries.push_back(query + "\"");
+    }
+    if (queries.empty()) {
+        state.SkipWithError("corpus documents are shorter than the phrase");
+        return;
+    }
+
+    std::vector<RelativeIndex> result;
+    size_t next = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        server.Search(queries[next], result);
+        found += result.size();
+        benchmark::DoNotOptimize(result.data());
+        next = (next + 1) % queries.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.counters["results"] = benchmark::Counter(static_cast<double>(found), benchmark::Counter::kAvgIterations);
+
+    IndexMemoryUsage usage = index->GetMemoryUsage();
+    size_t withoutPositions = usage.TotalBytes() - usage.positionsBytes;
+    state.counters["index_bytes"] = static_cast<double>(usage.TotalBytes());
+    state.counters["positions_bytes"] = static_cast<double>(usage.positionsBytes);
+    state.counters["positions_overhead_pct"] = withoutPositions == 0 ? 0.0 :
+            100.0 * static_cast<double>(usage.positionsBytes) / static_cast<double>(withoutPositions);
+}
+BENCHMARK(BM_PhraseQuery)->ArgName("words")->DenseRange(2, 4);
+
+// Шаблон "<префикс>*": range(0) - длина префикса, взятого из слов корпуса,
+// range(1) - ранжирование (0 - Absolute с объединением списков раскрытия,
+// 1 - BM25). Счетчики: слов в раскрытии на запрос и память словаря
+// с front coding против хэш-таблицы по тем же словам
+void BM_PrefixQuery(benchmark::State& state) {
+    auto index = corpusIndex();
+    SearchServer server(index, 5);
+    server.SetRanking(state.range(1) != 0 ? Ranking::BM25 : Ranking::Absolute);
+    size_t length = static_cast<size_t>(state.range(0));
+    CorpusGenerator generator(CorpusOptions{corpusOptions.vocabulary, 0, 0, corpusOptions.zipfExponent,
+                                            corpusOptions.seed + 2});
+    std::vector<std::string> queries;
+    for (const auto& word : generator.Queries(1024, 1, 1.0)) {
+        if (word.size() >= length) {
+            queries.push_back(word.substr(0, length) + "*");
+        }
+    }
+    if (queries.empty()) {
+        state.SkipWithError("corpus words are shorter than the prefix");
+        return;
+    }
+
+    std::vector<RelativeIndex> result;
+    size_t next = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        server.Search(queries[next], result);
+        found += result.size();
+        benchmark::DoNotOptimize(result.data());
+        next = (next + 1) % queries.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.counters["results"] = benchmark::Counter(static_cast<double>(found), benchmark::Counter::kAvgIterations);
+
+    auto snapshot = index->GetSnapshot();
+    PatternExpansion expansion;
+    size_t expanded = 0;
+    for (const auto& query : queries) {
+        snapshot->ExpandPattern(query, server.GetMaxExpansions(), expansion);
+        expanded += expansion.Size();
+    }
+    state.counters["expanded_terms"] = static_cast<double>(expanded) / static_cast<double>(queries.size());
+
+    TermDictionary hashed;
+    for (const auto& ref : index->GetSnapshot()->Segments()) {
+        for (FrontCodedDictionary::Iterator term(ref.segment->Terms(), 0); term.Valid(); term.Next()) {
+            hashed.Insert(term.Term());
+        }
+    }
+    state.counters["dictionary_bytes"] = static_cast<double>(index->GetMemoryUsage().dictionaryBytes);
+    state.counters["hash_dictionary_bytes"] = static_cast<double>(hashed.UsedBytes());
+}
+BENCHMARK(BM_PrefixQuery)
+    ->ArgsProduct({{1, 2, 3}, {0, 1}})
+    ->ArgNames({"prefix", "bm25"});
+
+// Слово с опечаткой при нечетком поиске: range(0) - расстояние, для которого
+// построен индекс удалений, range(1) - ранжирование (1 - BM25). Опечатка -
+// лишняя буква в слове корпуса, такого слова в индексе нет. Счетчики: слов
+// в исправлении, время подбора слов по индексу удалений и просмотром всего
+// словаря (на слово), время построения и память индекса удалений
+void BM_FuzzyQuery(benchmark::State& state) {
+    uint32_t distance = static_cast<uint32_t>(state.range(0));
+    const auto& index = fuzzyCorpusIndex(distance);
+    SearchServer server(index, 5);
+    server.SetRanking(state.range(1) != 0 ? Ranking::BM25 : Ranking::Absolute);
+    server.SetFuzzyDistance(distance);
+
+    auto snapshot = index->GetSnapshot();
+    auto known = [&](const std::string& word) {
+        for (const auto& ref : snapshot->Segments()) {
+            if (ref.segment->Terms().Find(word) != FrontCodedDictionary::npos) {
+                return true;
+            }
+        }
+        return false;
+    };
+    CorpusGenerator generator(CorpusOptions{corpusOptions.vocabulary, 0, 0, corpusOptions.zipfExponent,
+                                            corpusOptions.seed + 3});
+    std::vector<std::string> queries;
+    size_t position = 0;
+    for (auto word : generator.Queries(1024, 1, 0.3)) {
+        if (word.size() < 3) {
+            continue;
+        }
+        position = (position * 7 + 3) % (word.size() + 1);
+        word.insert(position, 1, static_cast<char>('a' + (position * 11 + word.size()) % 26));
+        if (!known(word)) {
+            queries.push_back(std::move(word));
+        }
+    }
+    if (queries.empty()) {
+        state.SkipWithError("no misspelled words outside of the dictionary");
+        return;
+    }
+
+    std::vector<RelativeIndex> result;
+    size_t next = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        server.Search(queries[next], result);
+        found += result.size();
+        benchmark::DoNotOptimize(result.data());
+        next = (next + 1) % queries.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.counters["results"] = benchmark::Counter(static_cast<double>(found), benchmark::Counter::kAvgIterations);
+
+    using Clock = std::chrono::steady_clock;
+    auto micros = [](Clock::duration elapsed) {
+        return std::chrono::duration<double, std::micro>(elapsed).count();
+    };
+    PatternExpansion expansion;
+    size_t expanded = 0;
+    auto start = Clock::now();
+    for (const auto& query : queries) {
+        snapshot->ExpandFuzzy(query, 1, server.GetMaxFuzzyTerms(), expansion);
+        expanded += expansion.Size();
+    }
+    state.counters["fuzzy_terms"] = static_cast<double>(expanded) / static_cast<double>(queries.size());
+    state.counters["expand_us"] = micros(Clock::now() - start) / static_cast<double>(queries.size());
+
+    // Для сравнения - проверка расстояния до каждого слова словаря
+    size_t scanned = std::min<size_t>(queries.size(), 32);
+    size_t close = 0;
+    start = Clock::now();
+    for (size_t q = 0; q < scanned; ++q) {
+        for (const auto& ref : snapshot->Segments()) {
+            for (FrontCodedDictionary::Iterator term(ref.segment->Terms(), 0); term.Valid(); term.Next()) {
+                close += FuzzyIndex::Distance(queries[q], term.Term(), 1) <= 1;
+            }
+        }
+    }
+    benchmark::DoNotOptimize(close);
+    state.counters["scan_us"] = micros(Clock::now() - start) / static_cast<double>(scanned);
+
+    start = Clock::now();
+    for (const auto& ref : snapshot->Segments()) {
+        benchmark::DoNotOptimize(FuzzyIndex::Build(ref.segment->Terms(), distance).Size());
+    }
+    state.counters["build_ms"] = micros(Clock::now() - start) / 1000.0;
+    state.counters["fuzzy_bytes"] = static_cast<double>(index->GetMemoryUsage().fuzzyBytes);
+    state.counters["dictionary_bytes"] = static_cast<double>(index->GetMemoryUsage().dictionaryBytes);
+}
+BENCHMARK(BM_FuzzyQuery)
+    ->ArgsProduct({{1, 2}, {0, 1}})
+    ->ArgNames({"distance", "bm25"});
+
+// Чтение текстов документов из хранилища: range(0) - блоков в кэше,
+// range(1) - строить ли еще и сниппет. Документы берутся из ответов на
+// запросы (по 5 лучших), как при выдаче сниппетов к результатам поиска
+void BM_DocumentFetch(benchmark::State& state) {
+    using Clock = std::chrono::steady_clock;
+    static const std::string path =
+        (std::filesystem::temp_directory_path() / "bench_search_engine.docs").string();
+    static double writeMs = 0;
+    if (writeMs == 0) {
+        const auto& documents = corpus();
+        auto start = Clock::now();
+        DocumentStore::Writer writer(path);
+        for (const auto& document : documents) {
+            writer.Add(document);
+        }
+        writer.Finish(0);
+        writeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+    auto store = std::make_shared<DocumentStore>(path, static_cast<size_t>(state.range(0)));
+    bool snippets = state.range(1) != 0;
+
+    // Сниппеты берут тексты из хранилища при индексе, сам индекс им не нужен
+    auto index = std::make_shared<InvertedIndex>();
+    index->SetDocumentStore(store);
+    SearchServer server(corpusIndex(), 5);
+    SearchServer snippetServer(index);
+    CorpusGenerator generator(CorpusOptions{corpusOptions.vocabulary, 0, 0, corpusOptions.zipfExponent,
+                                            corpusOptions.seed + 4});
+    std::vector<std::pair<size_t, std::string>> fetches;
+    for (const auto& query : generator.Queries(256, 2)) {
+        std::vector<RelativeIndex> result;
+        server.Search(query, result);
+        for (const auto& entry : result) {
+            fetches.emplace_back(entry.doc_id, query);
+        }
+    }
+    if (fetches.empty()) {
+        state.SkipWithError("queries found no documents");
+        return;
+    }
+
+    std::string text;
+    size_t next = 0;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        const auto& fetch = fetches[next];
+        if (snippets) {
+            text = snippetServer.GetSnippet(fetch.first, fetch.second);
+        } else {
+            store->Get(fetch.first, text);
+        }
+        bytes += text.size();
+        benchmark::DoNotOptimize(text.data());
+        next = (next + 1) % fetches.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+
+    auto cache = store->GetCacheStats();
+    state.counters["hit_rate"] = cache.hits + cache.misses == 0 ? 0.0 :
+        static_cast<double>(cache.hits) / static_cast<double>(cache.hits + cache.misses);
+    state.counters["text_mb"] = static_cast<double>(store->RawBytes()) / (1 << 20);
+    state.counters["file_mb"] = static_cast<double>(store->FileBytes()) / (1 << 20);
+    state.counters["write_ms"] = writeMs;
+}
+BENCHMARK(BM_DocumentFetch)
+    ->ArgsProduct({{0, 16}, {0, 1}})
+    ->ArgNames({"cache", "snippet"});
+
+// Запись answers.json: range(0) - число запросов, по 5 документов в ответе.
+// Пишется в память, чтобы измерять форматирование, а не диск
+void BM_PutAnswers(benchmark::State& state) {
+    std::vector<std::vector<std::pair<int, float>>> answers(static_cast<size_t>(state.range(0)));
+    for (size_t i = 0; i < answers.size(); ++i) {
+        if (i % 4 != 3) {
+            for (int j = 0; j < 5; ++j) {
+                answers[i].emplace_back(static_cast<int>(i) + j, 1.0f - 0.15f * static_cast<float>(j));
+            }
+        }
+    }
+
+    size_t bytes = 0;
+    for (auto _ : state) {
+        std::ostringstream out;
+        ConverterJSON::WriteAnswers(out, answers);
+        bytes = static_cast<size_t>(out.tellp());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * answers.size()));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+BENCHMARK(BM_PutAnswers)->ArgName("requests")->Arg(100)->Arg(1000);
+
+// Разбор собственных флагов --corpus_*; остальные аргументы остаются для Google Benchmark
+bool parseCorpusFlag(const std::string& arg) {
+    auto value = [&arg](const std::string& name, std::string& out) {
+        std::string prefix = "--" + name + "=";
+        if (arg.compare(0, prefix.size(), prefix) != 0) {
+            return false;
+        }
+        out = arg.substr(prefix.size());
+        return true;
+    };
+    std::string text;
+    if (value("corpus_documents", text)) {
+        corpusOptions.documents = std::stoul(text);
+    } else if (value("corpus_vocabulary", text)) {
+        corpusOptions.vocabulary = std::max<size_t>(1, std::stoul(text));
+    } else if (value("corpus_words", text)) {
+        corpusOptions.wordsPerDocument = std::stoul(text);
+    } else if (value("corpus_zipf", text)) {
+        corpusOptions.zipfExponent = std::stod(text);
+    } else if (value("corpus_seed", text)) {
+        corpusOptions.seed = std::stoull(text);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> storage;
+    bool hasOutput = false;
+    for (int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i > 0 && parseCorpusFlag(arg)) {
+            continue;
+        }
+        hasOutput = hasOutput || arg.rfind("--benchmark_out=", 0) == 0;
+        storage.push_back(arg);
+    }
+    if (!hasOutput) {
+        storage.push_back("--benchmark_out=bench_search_engine.json");
+        storage.push_back("--benchmark_out_format=json");
+    }
+
+    std::vector<char*> args;
+    for (auto& arg : storage) {
+        args.push_back(arg.data());
+    }
+    int count = static_cast<int>(args.size());
+
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+        return 1;
+    }
+
+    // Параметры корпуса попадают в context JSON-отчета: сравнивать имеет
+    // смысл только запуски на одинаковом корпусе
+    benchmark::AddCustomContext("corpus_documents", std::to_string(corpusOptions.documents));
+    benchmark::AddCustomContext("corpus_vocabulary", std::to_string(corpusOptions.vocabulary));
+    benchmark::AddCustomContext("corpus_words", std::to_string(corpusOptions.wordsPerDocument));
+    benchmark::AddCustomContext("corpus_zipf", std::to_string(corpusOptions.zipfExponent));
+    benchmark::AddCustomContext("corpus_seed", std::to_string(corpusOptions.seed));
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
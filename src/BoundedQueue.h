@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// Очередь между стадиями конвейера с ограничением по суммарной "стоимости"
+// элементов (например, по байтам текста). Писатель ждет, пока очередь полна,
+// читатель - пока она пуста. Элемент дороже всей емкости пропускается в
+// пустую очередь, иначе он никогда бы не прошел.
+template<class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) { };
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // false - очередь закрыта, элемент не принят
+    bool Push(T item, size_t cost) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [&]() { return closed || items.empty() || used + cost <= capacity; });
+        if (closed) {
+            return false;
+        }
+        used += cost;
+        items.emplace_back(std::move(item), cost);
+        not_empty.notify_one();
+        return true;
+    }
+
+    // false - очередь закрыта и пуста
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [&]() { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front().first);
+        used -= items.front().second;
+        items.pop_front();
+        not_full.notify_all();
+        return true;
+    }
+
+    // Писатели больше не принимаются; читатели дочитывают остаток
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    size_t used = 0;
+    bool closed = false;
+    std::deque<std::pair<T, size_t>> items;
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+};
@@ -1,4 +1,5 @@
 #include "ConverterJSON.h"
+#include "Metrics.h"
 #include <sstream>
 #include <algorithm>
 #include <filesystem>
@@ -88,6 +89,204 @@ void ConverterJSON::readConfig() {
         maxResponses = 5;
     }
 
+    // Чтение поля "indexing_threads" (необязательное поле, 0 - по числу ядер)
+    if (configSection.contains("indexing_threads") && configSection["indexing_threads"].is_number_integer()) {
+        int threads = configSection["indexing_threads"].get<int>();
+        if (threads < 0) {
+            std::cout << "⚠️  Warning: indexing_threads must not be negative, using hardware concurrency" << std::endl;
+            threads = 0;
+        }
+        indexingThreads = static_cast<size_t>(threads);
+    }
+
+    // Чтение поля "search_threads" (необязательное поле, 0 - по числу ядер)
+    if (configSection.contains("search_threads") && configSection["search_threads"].is_number_integer()) {
+        int threads = configSection["search_threads"].get<int>();
+        if (threads < 0) {
+            std::cout << "⚠️  Warning: search_threads must not be negative, using hardware concurrency" << std::endl;
+            threads = 0;
+        }
+        searchThreads = static_cast<size_t>(threads);
+    }
+
+    // Чтение поля "query_cache_mb" (необязательное поле, 0 - без кэша)
+    if (configSection.contains("query_cache_mb") && configSection["query_cache_mb"].is_number_integer()) {
+        int megabytes = configSection["query_cache_mb"].get<int>();
+        if (megabytes < 0) {
+            std::cout << "⚠️  Warning: query_cache_mb must not be negative, cache disabled" << std::endl;
+            megabytes = 0;
+        }
+        queryCacheMb = static_cast<size_t>(megabytes);
+    }
+
+    // Чтение поля "ingest_memory_mb" (необязательное поле, 0 - по умолчанию)
+    if (configSection.contains("ingest_memory_mb") && configSection["ingest_memory_mb"].is_number_integer()) {
+        int megabytes = configSection["ingest_memory_mb"].get<int>();
+        if (megabytes < 0) {
+            std::cout << "⚠️  Warning: ingest_memory_mb must not be negative, using default" << std::endl;
+            megabytes = 0;
+        }
+        ingestMemoryMb = static_cast<size_t>(megabytes);
+    }
+
+    // Чтение поля "build_memory_mb" (необязательное поле, 0 - индекс строится в памяти)
+    if (configSection.contains("build_memory_mb") && configSection["build_memory_mb"].is_number_integer()) {
+        int megabytes = configSection["build_memory_mb"].get<int>();
+        if (megabytes < 0) {
+            std::cout << "⚠️  Warning: build_memory_mb must not be negative, building in memory" << std::endl;
+            megabytes = 0;
+        }
+        buildMemoryMb = static_cast<size_t>(megabytes);
+    }
+
+    // Чтение поля "index_memory_mb" (необязательное поле, 0 - без ограничения)
+    if (configSection.contains("index_memory_mb") && configSection["index_memory_mb"].is_number_integer()) {
+        int megabytes = configSection["index_memory_mb"].get<int>();
+        if (megabytes < 0) {
+            std::cout << "⚠️  Warning: index_memory_mb must not be negative, memory is not limited" << std::endl;
+            megabytes = 0;
+        }
+        indexMemoryMb = static_cast<size_t>(megabytes);
+    }
+
+    // Чтение поля "index_memory_policy" (необязательное поле: "fail" или "compact")
+    if (configSection.contains("index_memory_policy") && configSection["index_memory_policy"].is_string()) {
+        std::string policy = configSection["index_memory_policy"].get<std::string>();
+        if (policy == "compact") {
+            indexMemoryPolicy = MemoryPolicy::Compact;
+        } else if (policy == "fail") {
+            indexMemoryPolicy = MemoryPolicy::Fail;
+        } else {
+            std::cout << "⚠️  Warning: unknown index_memory_policy '" << policy << "', using 'fail'" << std::endl;
+        }
+    }
+
+    // Чтение поля "ranking" (необязательное поле: "absolute" или "bm25")
+    if (configSection.contains("ranking") && configSection["ranking"].is_string()) {
+        std::string mode = configSection["ranking"].get<std::string>();
+        if (mode == "bm25") {
+            ranking = Ranking::BM25;
+        } else if (mode == "absolute") {
+            ranking = Ranking::Absolute;
+        } else {
+            std::cout << "⚠️  Warning: unknown ranking '" << mode << "', using 'absolute'" << std::endl;
+        }
+    }
+
+    // Чтение поля "positional_index" (необязательное поле, по умолчанию false)
+    if (configSection.contains("positional_index") && configSection["positional_index"].is_boolean()) {
+        positionalIndex = configSection["positional_index"].get<bool>();
+    }
+
+    // Чтение поля "max_expansions" (необязательное поле, 0 - без ограничения)
+    if (configSection.contains("max_expansions") && configSection["max_expansions"].is_number_integer()) {
+        int expansions = configSection["max_expansions"].get<int>();
+        if (expansions < 0) {
+            std::cout << "⚠️  Warning: max_expansions must not be negative, using "
+                      << SearchServer::DEFAULT_MAX_EXPANSIONS << std::endl;
+            expansions = static_cast<int>(SearchServer::DEFAULT_MAX_EXPANSIONS);
+        }
+        maxExpansions = static_cast<size_t>(expansions);
+    }
+
+    // Чтение поля "fuzzy_distance" (необязательное поле, 0 - нечеткий поиск выключен)
+    if (configSection.contains("fuzzy_distance") && configSection["fuzzy_distance"].is_number_integer()) {
+        int distance = configSection["fuzzy_distance"].get<int>();
+        if (distance < 0 || distance > static_cast<int>(FuzzyIndex::MAX_DISTANCE)) {
+            std::cout << "⚠️  Warning: fuzzy_distance must be between 0 and " << FuzzyIndex::MAX_DISTANCE
+                      << ", fuzzy search disabled" << std::endl;
+            distance = 0;
+        }
+        fuzzyDistance = static_cast<uint32_t>(distance);
+    }
+
+    // Чтение поля "fuzzy_penalty" (необязательное поле, число в (0, 1])
+    if (configSection.contains("fuzzy_penalty") && configSection["fuzzy_penalty"].is_number()) {
+        float penalty = configSection["fuzzy_penalty"].get<float>();
+        if (!(penalty > 0.0f && penalty <= 1.0f)) {
+            std::cout << "⚠️  Warning: fuzzy_penalty must be in (0, 1], using "
+                      << SearchServer::DEFAULT_FUZZY_PENALTY << std::endl;
+            penalty = SearchServer::DEFAULT_FUZZY_PENALTY;
+        }
+        fuzzyPenalty = penalty;
+    }
+
+    // Чтение поля "max_fuzzy_terms" (необязательное поле, 0 - без ограничения)
+    if (configSection.contains("max_fuzzy_terms") && configSection["max_fuzzy_terms"].is_number_integer()) {
+        int terms = configSection["max_fuzzy_terms"].get<int>();
+        if (terms < 0) {
+            std::cout << "⚠️  Warning: max_fuzzy_terms must not be negative, using "
+                      << SearchServer::DEFAULT_MAX_FUZZY_TERMS << std::endl;
+            terms = static_cast<int>(SearchServer::DEFAULT_MAX_FUZZY_TERMS);
+        }
+        maxFuzzyTerms = static_cast<size_t>(terms);
+    }
+
+    // Чтение поля "index_path" (необязательное поле)
+    if (configSection.contains("index_path") && configSection["index_path"].is_string()) {
+        indexPath = configSection["index_path"].get<std::string>();
+    }
+
+    // Чтение поля "verify_index" (необязательное поле, по умолчанию false)
+    if (configSection.contains("verify_index") && configSection["verify_index"].is_boolean()) {
+        verifyIndex = configSection["verify_index"].get<bool>();
+    }
+
+    // Чтение поля "document_store_path" (необязательное поле)
+    if (configSection.contains("document_store_path") && configSection["document_store_path"].is_string()) {
+        documentStorePath = configSection["document_store_path"].get<std::string>();
+    }
+
+    // Чтение поля "snippet_length" (необязательное поле, 0 - без сниппетов)
+    if (configSection.contains("snippet_length") && configSection["snippet_length"].is_number_integer()) {
+        int length = configSection["snippet_length"].get<int>();
+        if (length < 0) {
+            std::cout << "⚠️  Warning: snippet_length must not be negative, using "
+                      << Snippet::DEFAULT_LENGTH << std::endl;
+            length = static_cast<int>(Snippet::DEFAULT_LENGTH);
+        }
+        snippetLength = static_cast<size_t>(length);
+    }
+
+    // Чтение поля "shards" (необязательное поле, 1 - без шардов)
+    if (configSection.contains("shards") && configSection["shards"].is_number_integer()) {
+        int shards = configSection["shards"].get<int>();
+        if (shards < 1) {
+            std::cout << "⚠️  Warning: shards must be positive, using 1" << std::endl;
+            shards = 1;
+        }
+        shardCount = static_cast<size_t>(shards);
+    }
+
+    // Чтение поля "shard_sockets" (необязательное поле: сокеты шардов по порядку)
+    shardSockets.clear();
+    if (configSection.contains("shard_sockets") && configSection["shard_sockets"].is_array()) {
+        for (const auto& socket : configSection["shard_sockets"]) {
+            if (socket.is_string()) {
+                shardSockets.push_back(socket.get<std::string>());
+            } else {
+                // Номер шарда - позиция в списке, пропуск сдвинул бы документы
+                throw std::runtime_error("shard_sockets must contain only socket paths");
+            }
+        }
+    }
+
+    // Чтение поля "shard_timeout_ms" (необязательное поле, больше 0)
+    if (configSection.contains("shard_timeout_ms") && configSection["shard_timeout_ms"].is_number_integer()) {
+        int timeout = configSection["shard_timeout_ms"].get<int>();
+        if (timeout <= 0) {
+            std::cout << "⚠️  Warning: shard_timeout_ms must be positive, using "
+                      << RemoteShard::DEFAULT_TIMEOUT_MS << std::endl;
+            timeout = static_cast<int>(RemoteShard::DEFAULT_TIMEOUT_MS);
+        }
+        shardTimeoutMs = static_cast<size_t>(timeout);
+    }
+
+    // Чтение поля "metrics_path" (необязательное поле)
+    if (configSection.contains("metrics_path") && configSection["metrics_path"].is_string()) {
+        metricsPath = configSection["metrics_path"].get<std::string>();
+    }
+
     // Проверка и чтение секции "files"
     if (!configJson.contains("files") || !configJson["files"].is_array()) {
         throw std::runtime_error("config file is empty: missing 'files' section");
@@ -122,34 +321,41 @@ void ConverterJSON::readConfig() {
     std::cout << "Found " << files.size() << " files to index" << std::endl;
 }
 
+std::string ConverterJSON::resolveFilePath(const std::string& file) {
+    std::vector<std::string> possibleFilePaths = {
+        file,
+        "../" + file,
+        "../../" + file,
+        "resources/" + file.substr(file.find_last_of("/") + 1)
+    };
+
+    for (const auto& path : possibleFilePaths) {
+        if (std::filesystem::is_regular_file(path)) {
+            return path;
+        }
+    }
+    return "";
+}
+
 std::vector<std::string> ConverterJSON::GetTextDocuments() {
+    SE_METRICS_TIMER(ReadDocuments);
     std::vector<std::string> documents;
 
     for (size_t i = 0; i < files.size(); ++i) {
-        std::vector<std::string> possibleFilePaths = {
-            files[i],
-            "../" + files[i],
-            "../../" + files[i],
-            "resources/" + files[i].substr(files[i].find_last_of("/") + 1)
-        };
-
+        std::string path = resolveFilePath(files[i]);
         std::ifstream file;
-        bool fileOpened = false;
-
-        for (const auto& path : possibleFilePaths) {
+        if (!path.empty()) {
             file.open(path);
-            if (file.is_open()) {
-                std::string content((std::istreambuf_iterator<char>(file)),
-                                    std::istreambuf_iterator<char>());
-                documents.push_back(content);
-                file.close();
-                std::cout << "✓ Loaded: " << path << std::endl;
-                fileOpened = true;
-                break;
-            }
         }
 
-        if (!fileOpened) {
+        if (file.is_open()) {
+            std::string content((std::istreambuf_iterator<char>(file)),
+                                std::istreambuf_iterator<char>());
+            SE_METRICS_ADD(BytesRead, content.size());
+            documents.push_back(content);
+            file.close();
+            std::cout << "✓ Loaded: " << path << std::endl;
+        } else {
             std::cerr << "⚠️  Warning: Cannot open file (tried: " << files[i] << " and variations)" << std::endl;
             documents.push_back("");
         }
@@ -158,10 +364,130 @@ std::vector<std::string> ConverterJSON::GetTextDocuments() {
     return documents;
 }
 
+std::vector<std::string> ConverterJSON::GetDocumentPaths() {
+    std::vector<std::string> paths;
+    for (const auto& file : files) {
+        paths.push_back(resolveFilePath(file));
+    }
+    return paths;
+}
+
+size_t ConverterJSON::GetIngestMemoryBytes() {
+    return ingestMemoryMb * 1024 * 1024;
+}
+
+size_t ConverterJSON::GetBuildMemoryBytes() {
+    return buildMemoryMb * 1024 * 1024;
+}
+
+size_t ConverterJSON::GetIndexMemoryBytes() {
+    return indexMemoryMb * 1024 * 1024;
+}
+
+MemoryPolicy ConverterJSON::GetIndexMemoryPolicy() {
+    return indexMemoryPolicy;
+}
+
+Ranking ConverterJSON::GetRanking() {
+    return ranking;
+}
+
+bool ConverterJSON::GetPositionalIndex() {
+    return positionalIndex;
+}
+
+size_t ConverterJSON::GetMaxExpansions() {
+    return maxExpansions;
+}
+
+uint32_t ConverterJSON::GetFuzzyDistance() {
+    return fuzzyDistance;
+}
+
+float ConverterJSON::GetFuzzyPenalty() {
+    return fuzzyPenalty;
+}
+
+size_t ConverterJSON::GetMaxFuzzyTerms() {
+    return maxFuzzyTerms;
+}
+
+std::string ConverterJSON::GetIndexPath() {
+    return indexPath;
+}
+
+bool ConverterJSON::GetVerifyIndex() {
+    return verifyIndex;
+}
+
+std::string ConverterJSON::GetDocumentStorePath() {
+    return documentStorePath;
+}
+
+size_t ConverterJSON::GetSnippetLength() {
+    return snippetLength;
+}
+
+size_t ConverterJSON::GetShardCount() {
+    return shardCount;
+}
+
+std::vector<std::string> ConverterJSON::GetShardSockets() {
+    return shardSockets;
+}
+
+size_t ConverterJSON::GetShardTimeoutMs() {
+    return shardTimeoutMs;
+}
+
+std::string ConverterJSON::GetMetricsPath() {
+    return metricsPath;
+}
+
+uint64_t ConverterJSON::GetFilesFingerprint() {
+    // FNV-1a по списку файлов в порядке конфигурации: порядок задает doc_id
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    for (const auto& file : files) {
+        mix(file.data(), file.size() + 1);
+
+        std::string path = resolveFilePath(file);
+        std::error_code error;
+        uint64_t size = path.empty() ? 0 : std::filesystem::file_size(path, error);
+        int64_t modified = path.empty() ? 0 :
+            std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        bool found = !path.empty() && !error;
+
+        mix(&found, sizeof(found));
+        mix(&size, sizeof(size));
+        mix(&modified, sizeof(modified));
+    }
+    return hash;
+}
+
 int ConverterJSON::GetResponsesLimit() {
     return maxResponses;
 }
 
+size_t ConverterJSON::GetIndexingThreads() {
+    return indexingThreads;
+}
+
+size_t ConverterJSON::GetSearchThreads() {
+    return searchThreads;
+}
+
+size_t ConverterJSON::GetQueryCacheBytes() {
+    return queryCacheMb * 1024 * 1024;
+}
+
 std::vector<std::string> ConverterJSON::GetRequests() {
     std::vector<std::string> possibleRequestPaths = {
         "../resources/requests.json",
@@ -211,75 +537,80 @@ std::vector<std::string> ConverterJSON::GetRequests() {
 
     return requests;
 }
-void ConverterJSON::putAnswers(std::vector<std::vector<std::pair<int, float>>> answers) {
-    std::vector<std::string> possibleAnswerPaths = {
-        "../resources/answers.json",
-        "../../resources/answers.json",
-        "resources/answers.json"
-    };
-
-    std::ofstream answersFile;
-    std::string savedPath;
-
-    // Создаем или перезаписываем файл answers.json
-    for (const auto& path : possibleAnswerPaths) {
-        answersFile.open(path);
-        if (answersFile.is_open()) {
-            savedPath = path;
-            break;
-        }
-    }
-
-    if (!answersFile.is_open()) {
-        answersFile.open("answers.json");
-        savedPath = "answers.json";
-    }
-
+void ConverterJSON::WriteAnswers(std::ostream& out, const std::vector<std::vector<std::pair<int, float>>>& answers) {
     // Создаем JSON вручную для точного контроля формата
-    answersFile << "{\n";
-    answersFile << "  \"answers\": {\n";
+    out << "{\n";
+    out << "  \"answers\": {\n";
 
     for (size_t i = 0; i < answers.size(); ++i) {
-        std::string requestId = "request" + 
-                               std::string(3 - std::to_string(i + 1).length(), '0') + 
-                               std::to_string(i + 1);
+        // request001..request999, дальше номер без дополнения нулями
+        std::string number = std::to_string(i + 1);
+        std::string requestId = "request" + std::string(number.size() < 3 ? 3 - number.size() : 0, '0') + number;
 
-        answersFile << "    \"" << requestId << "\": {\n";
-        answersFile << "      \"result\": \"" << (answers[i].empty() ? "false" : "true") << "\"";
+        out << "    \"" << requestId << "\": {\n";
+        out << "      \"result\": \"" << (answers[i].empty() ? "false" : "true") << "\"";
 
         if (!answers[i].empty()) {
             if (answers[i].size() == 1) {
                 // Для одного документа
-                answersFile << ",\n      \"docid\": " << answers[i][0].first;
-                answersFile << ",\n      \"rank\": " << answers[i][0].second;
+                out << ",\n      \"docid\": " << answers[i][0].first;
+                out << ",\n      \"rank\": " << answers[i][0].second;
             } else {
                 // Для нескольких документов - массив relevance
-                answersFile << ",\n      \"relevance\": [\n";
+                out << ",\n      \"relevance\": [\n";
                 
                 for (size_t j = 0; j < answers[i].size(); ++j) {
-                    answersFile << "        { \"docid\": " << answers[i][j].first 
-                               << ", \"rank\": " << answers[i][j].second << " }";
+                    out << "        { \"docid\": " << answers[i][j].first
+                        << ", \"rank\": " << answers[i][j].second << " }";
                     
                     if (j < answers[i].size() - 1) {
-                        answersFile << ",";
+                        out << ",";
                     }
-                    answersFile << "\n";
+                    out << "\n";
                 }
                 
-                answersFile << "      ]";
+                out << "      ]";
             }
         }
 
-        answersFile << "\n    }";
+        out << "\n    }";
 
         if (i < answers.size() - 1) {
-            answersFile << ",";
+            out << ",";
         }
-        answersFile << "\n";
+        out << "\n";
+    }
+
+    out << "  }\n";
+    out << "}\n";
+}
+
+void ConverterJSON::putAnswers(std::vector<std::vector<std::pair<int, float>>> answers) {
+    SE_METRICS_TIMER(PutAnswers);
+    std::vector<std::string> possibleAnswerPaths = {
+        "../resources/answers.json",
+        "../../resources/answers.json",
+        "resources/answers.json"
+    };
+
+    std::ofstream answersFile;
+    std::string savedPath;
+
+    // Создаем или перезаписываем файл answers.json
+    for (const auto& path : possibleAnswerPaths) {
+        answersFile.open(path);
+        if (answersFile.is_open()) {
+            savedPath = path;
+            break;
+        }
+    }
+
+    if (!answersFile.is_open()) {
+        answersFile.open("answers.json");
+        savedPath = "answers.json";
     }
 
-    answersFile << "  }\n";
-    answersFile << "}\n";
+    WriteAnswers(answersFile, answers);
     answersFile.close();
 
     std::cout << "✓ Results saved to: " << savedPath << std::endl;
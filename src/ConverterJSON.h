@@ -3,10 +3,15 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include "nlohmann/json.hpp"
+#include "MemoryUsage.h"
+#include "Ranking.h"
+#include "SearchServer.h"
+#include "SearchShard.h"
 
 using json = nlohmann::json;
 
@@ -15,9 +20,55 @@ public:
     ConverterJSON();
 
     std::vector<std::string> GetTextDocuments();
+    // Найденные пути файлов из config в порядке doc_id (пустая строка - файл не найден)
+    std::vector<std::string> GetDocumentPaths();
+    // Бюджет памяти под тексты при потоковой индексации (0 - по умолчанию)
+    size_t GetIngestMemoryBytes();
+    // Бюджет словаря при построении индекса вне памяти (0 - строить в памяти)
+    size_t GetBuildMemoryBytes();
+    // Бюджет памяти индекса (0 - без ограничения) и что делать при превышении
+    size_t GetIndexMemoryBytes();
+    MemoryPolicy GetIndexMemoryPolicy();
     int GetResponsesLimit();
+    // Ранжирование результатов: "absolute" (по умолчанию) или "bm25"
+    Ranking GetRanking();
+    // Хранить ли позиции слов для фразовых запросов (по умолчанию нет)
+    bool GetPositionalIndex();
+    // Наибольшее число слов в раскрытии шаблона запроса (0 - без ограничения)
+    size_t GetMaxExpansions();
+    // Нечеткий поиск: наибольшее расстояние правки (0 - выключен), штраф за
+    // правку и сколько слов индекса может заменить слово запроса
+    uint32_t GetFuzzyDistance();
+    float GetFuzzyPenalty();
+    size_t GetMaxFuzzyTerms();
+    size_t GetIndexingThreads();
+    size_t GetSearchThreads();
+    // Бюджет кэша результатов запросов в байтах (0 - кэш выключен)
+    size_t GetQueryCacheBytes();
+
+    // Путь к файлу сохраненного индекса (пустая строка - индекс не сохраняется)
+    std::string GetIndexPath();
+    // Проверять ли при открытии сохраненного индекса контрольную сумму всех
+    // его данных (по умолчанию нет - открытие не читает файл целиком)
+    bool GetVerifyIndex();
+    // Файл хранилища текстов документов для сниппетов (пустая строка - не хранить)
+    std::string GetDocumentStorePath();
+    // Длина сниппета в байтах (0 - без сниппетов)
+    size_t GetSnippetLength();
+    // Распределенный поиск: число шардов в этом процессе (1 - без шардов)
+    // и Unix-сокеты шардов в отдельных процессах (если заданы - шарды там)
+    size_t GetShardCount();
+    std::vector<std::string> GetShardSockets();
+    // Сколько ждать ответа шарда в отдельном процессе, в миллисекундах
+    size_t GetShardTimeoutMs();
+    // Файл отчета телеметрии (пустая строка - телеметрия выключена)
+    std::string GetMetricsPath();
+    // Отпечаток набора файлов: пути, размеры и время изменения
+    uint64_t GetFilesFingerprint();
     std::vector<std::string> GetRequests();
     void putAnswers(std::vector<std::vector<std::pair<int, float>>> answers);
+    // Формат answers.json без работы с файлом (используется putAnswers и бенчмарками)
+    static void WriteAnswers(std::ostream& out, const std::vector<std::vector<std::pair<int, float>>>& answers);
 
 private:
     std::string configPath = "../resources/config.json";
@@ -25,9 +76,31 @@ private:
     std::string answersPath = "../resources/answers.json";
 
     void readConfig();
+    std::string resolveFilePath(const std::string& file);
     std::string engineName;
     std::string version;
     int maxResponses;
+    Ranking ranking = Ranking::Absolute;
+    bool positionalIndex = false;
+    size_t maxExpansions = SearchServer::DEFAULT_MAX_EXPANSIONS;
+    uint32_t fuzzyDistance = 0;
+    float fuzzyPenalty = SearchServer::DEFAULT_FUZZY_PENALTY;
+    size_t maxFuzzyTerms = SearchServer::DEFAULT_MAX_FUZZY_TERMS;
+    size_t indexingThreads = 0;
+    size_t searchThreads = 0;
+    size_t queryCacheMb = 0;
+    size_t ingestMemoryMb = 0;
+    size_t buildMemoryMb = 0;
+    size_t indexMemoryMb = 0;
+    MemoryPolicy indexMemoryPolicy = MemoryPolicy::Fail;
+    std::string indexPath;
+    bool verifyIndex = false;
+    std::string documentStorePath;
+    size_t snippetLength = Snippet::DEFAULT_LENGTH;
+    size_t shardCount = 1;
+    std::vector<std::string> shardSockets;
+    size_t shardTimeoutMs = RemoteShard::DEFAULT_TIMEOUT_MS;
+    std::string metricsPath;
     std::vector<std::string> files;
     
     // Константы для проверки версии
@@ -0,0 +1,314 @@
+#include "DocumentStore.h"
+#include "IndexFile.h"
+#include "LzCodec.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+const char MAGIC[8] = {'S', 'E', 'D', 'O', 'C', 'S', '\0', '\0'};
+
+// Файл: заголовок, сжатые блоки, таблицы (каждая выровнена на 8 байт):
+// смещения блоков (uint64), сжатые и исходные размеры блоков (uint32),
+// первые doc_id блоков (blockCount + 1) и начала документов в блоках (uint32)
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fingerprint;
+    uint64_t documentCount;
+    uint64_t blockCount;
+    uint64_t rawBytes;
+    uint64_t tableOffset;
+    uint64_t fileSize;
+    uint64_t headerChecksum;   // по всем предыдущим байтам заголовка
+};
+
+static_assert(std::is_trivially_copyable<Header>::value, "header is written as raw bytes");
+static_assert(sizeof(Header) % 8 == 0, "header must keep tables aligned");
+
+size_t alignUp(size_t value) {
+    return (value + 7) & ~size_t(7);
+}
+
+uint64_t headerChecksum(const Header& header) {
+    return IndexFile::Checksum(&header, offsetof(Header, headerChecksum));
+}
+
+// Размеры таблиц по порядку; их сумма с выравниванием - размер хвоста файла
+size_t tableBytes(uint64_t blockCount, uint64_t documentCount) {
+    return alignUp(blockCount * sizeof(uint64_t)) + 2 * alignUp(blockCount * sizeof(uint32_t)) +
+           alignUp((blockCount + 1) * sizeof(uint32_t)) + alignUp(documentCount * sizeof(uint32_t));
+}
+
+}
+
+DocumentStore::Writer::Writer(const std::string& path, size_t blockSize)
+    : path(path), tmpPath(path + ".tmp"), blockSize(std::max<size_t>(1, blockSize)) {
+    out.open(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("cannot create document store: " + tmpPath);
+    }
+    // Место под заголовок: он пишется в Finish
+    Header header{};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    offset = sizeof(header);
+}
+
+DocumentStore::Writer::~Writer() {
+    if (!finished) {
+        out.close();
+        std::error_code error;
+        std::filesystem::remove(tmpPath, error);
+    }
+}
+
+void DocumentStore::Writer::Add(std::string_view text) {
+    if (text.size() > UINT32_MAX || docStarts.size() == UINT32_MAX) {
+        throw std::length_error("document store: document or document count exceeds 32 bits");
+    }
+    // Документ не делится между блоками: не влезает в текущий - блок закрывается
+    if (!block.empty() && block.size() + text.size() > blockSize) {
+        flushBlock();
+    }
+    docStarts.push_back(static_cast<uint32_t>(block.size()));
+    block.append(text.data(), text.size());
+    rawBytes += text.size();
+    if (block.size() >= blockSize) {
+        flushBlock();
+    }
+}
+
+void DocumentStore::Writer::flushBlock() {
+    if (docStarts.size() == blockFirst) {
+        return;
+    }
+    compressed.clear();
+    LzCodec::Compress(block.data(), block.size(), compressed);
+    // Несжимаемый блок хранится как есть: сжатый размер равен исходному
+    const std::string& stored = compressed.size() < block.size() ? compressed : block;
+    out.write(stored.data(), static_cast<std::streamsize>(stored.size()));
+
+    blockOffsets.push_back(offset);
+    blockCompressed.push_back(static_cast<uint32_t>(stored.size()));
+    blockRaw.push_back(static_cast<uint32_t>(block.size()));
+    firstDocs.push_back(blockFirst);
+    offset += stored.size();
+    blockFirst = static_cast<uint32_t>(docStarts.size());
+    block.clear();
+    // Буфер может вырасти под большой документ - не держим его дальше
+    if (block.capacity() > blockSize * 2) {
+        block.shrink_to_fit();
+    }
+}
+
+void DocumentStore::Writer::Finish(uint64_t fingerprint) {
+    flushBlock();
+    firstDocs.push_back(static_cast<uint32_t>(docStarts.size()));
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.headerSize = sizeof(Header);
+    header.fingerprint = fingerprint;
+    header.documentCount = docStarts.size();
+    header.blockCount = blockOffsets.size();
+    header.rawBytes = rawBytes;
+    header.tableOffset = alignUp(offset);
+    header.fileSize = header.tableOffset + tableBytes(header.blockCount, header.documentCount);
+
+    const char padding[8] = {};
+    auto table = [&](const void* data, size_t size) {
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        out.write(padding, static_cast<std::streamsize>(alignUp(size) - size));
+    };
+    out.write(padding, static_cast<std::streamsize>(header.tableOffset - offset));
+    table(blockOffsets.data(), blockOffsets.size() * sizeof(uint64_t));
+    table(blockCompressed.data(), blockCompressed.size() * sizeof(uint32_t));
+    table(blockRaw.data(), blockRaw.size() * sizeof(uint32_t));
+    table(firstDocs.data(), firstDocs.size() * sizeof(uint32_t));
+    table(docStarts.data(), docStarts.size() * sizeof(uint32_t));
+
+    header.headerChecksum = headerChecksum(header);
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (!out) {
+        throw std::runtime_error("cannot write document store: " + tmpPath);
+    }
+    std::filesystem::rename(tmpPath, path);
+    finished = true;
+}
+
+DocumentStore::DocumentStore(const std::string& path, size_t cacheBlocks)
+    : file(std::make_unique<MappedFile>(path)), path(path), cacheBlocks(cacheBlocks) {
+    if (file->Size() < sizeof(Header)) {
+        fail("file is too small");
+    }
+    Header header;
+    std::memcpy(&header, file->Data(), sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        fail("bad magic");
+    }
+    if (header.version != VERSION) {
+        fail("unsupported version " + std::to_string(header.version));
+    }
+    if (header.headerSize != sizeof(Header) || header.headerChecksum != headerChecksum(header)) {
+        fail("header checksum mismatch");
+    }
+    if (header.fileSize != file->Size() || header.documentCount >= UINT32_MAX ||
+        header.blockCount > header.documentCount || header.tableOffset % 8 != 0 ||
+        header.tableOffset < sizeof(Header) || header.tableOffset > header.fileSize ||
+        tableBytes(header.blockCount, header.documentCount) != header.fileSize - header.tableOffset) {
+        fail("inconsistent table sizes");
+    }
+
+    fingerprint = header.fingerprint;
+    documentCount = header.documentCount;
+    blockCount = header.blockCount;
+    rawBytes = header.rawBytes;
+    const char* at = file->Data() + header.tableOffset;
+    blockOffsets = reinterpret_cast<const uint64_t*>(at);
+    at += alignUp(blockCount * sizeof(uint64_t));
+    blockCompressed = reinterpret_cast<const uint32_t*>(at);
+    at += alignUp(blockCount * sizeof(uint32_t));
+    blockRaw = reinterpret_cast<const uint32_t*>(at);
+    at += alignUp(blockCount * sizeof(uint32_t));
+    firstDocs = reinterpret_cast<const uint32_t*>(at);
+    at += alignUp((blockCount + 1) * sizeof(uint32_t));
+    docStarts = reinterpret_cast<const uint32_t*>(at);
+
+    // Таблицы проверяются целиком один раз, чтобы чтение документа
+    // не могло выйти за границы файла или блока
+    if (firstDocs[0] != 0 || firstDocs[blockCount] != documentCount) {
+        fail("bad block document ranges");
+    }
+    uint64_t total = 0;
+    for (size_t b = 0; b < blockCount; ++b) {
+        if (firstDocs[b] >= firstDocs[b + 1] || blockCompressed[b] > blockRaw[b] ||
+            blockOffsets[b] < sizeof(Header) || blockOffsets[b] > header.tableOffset ||
+            blockCompressed[b] > header.tableOffset - blockOffsets[b]) {
+            fail("block out of bounds");
+        }
+        for (uint32_t doc = firstDocs[b]; doc < firstDocs[b + 1]; ++doc) {
+            uint32_t end = doc + 1 < firstDocs[b + 1] ? docStarts[doc + 1] : blockRaw[b];
+            if (docStarts[doc] > end || (doc == firstDocs[b] && docStarts[doc] != 0)) {
+                fail("document out of bounds");
+            }
+        }
+        total += blockRaw[b];
+    }
+    if (total != rawBytes) {
+        fail("unexpected text size");
+    }
+}
+
+std::shared_ptr<DocumentStore> DocumentStore::Open(const std::string& path, uint64_t fingerprint,
+                                                   size_t cacheBlocks) {
+    if (!std::filesystem::exists(path)) {
+        return nullptr;
+    }
+    // Заголовок другой версии или по другим файлам - хранилище просто перестраивается
+    {
+        std::ifstream in(path, std::ios::binary);
+        Header header{};
+        if (in.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+            std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+            (header.version != VERSION || header.fingerprint != fingerprint)) {
+            return nullptr;
+        }
+    }
+    return std::make_shared<DocumentStore>(path, cacheBlocks);
+}
+
+void DocumentStore::fail(const std::string& reason) const {
+    throw std::runtime_error("document store " + path + " is corrupted: " + reason);
+}
+
+std::shared_ptr<const std::string> DocumentStore::loadBlock(uint32_t block) const {
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        for (auto& cached : cache) {
+            if (cached.block == block) {
+                cached.lastUse = ++useClock;
+                ++hits;
+                return cached.text;
+            }
+        }
+        ++misses;
+    }
+
+    // Распаковка вне блокировки: другие потоки читают кэш в это время
+    SE_METRICS_ADD(StoreBlocksRead, 1);
+    auto text = std::make_shared<std::string>(blockRaw[block], '\0');
+    if (!LzCodec::Decompress(file->Data() + blockOffsets[block], blockCompressed[block],
+                             text->data(), text->size())) {
+        fail("cannot decompress block " + std::to_string(block));
+    }
+    if (cacheBlocks == 0) {
+        return text;
+    }
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    for (const auto& cached : cache) {
+        if (cached.block == block) {
+            return cached.text;
+        }
+    }
+    CachedBlock entry{block, ++useClock, std::move(text)};
+    if (cache.size() < cacheBlocks) {
+        cache.push_back(entry);
+    } else {
+        // Вытесняется давно не нужный блок; блоков в кэше немного, хватает перебора
+        auto oldest = std::min_element(cache.begin(), cache.end(),
+                                       [](const CachedBlock& a, const CachedBlock& b) {
+                                           return a.lastUse < b.lastUse;
+                                       });
+        *oldest = entry;
+    }
+    return entry.text;
+}
+
+bool DocumentStore::Get(size_t doc_id, std::string& out) const {
+    if (doc_id >= documentCount) {
+        return false;
+    }
+    uint32_t doc = static_cast<uint32_t>(doc_id);
+    uint32_t block = static_cast<uint32_t>(
+        std::upper_bound(firstDocs, firstDocs + blockCount + 1, doc) - firstDocs - 1);
+    uint32_t start = docStarts[doc];
+    uint32_t end = doc + 1 < firstDocs[block + 1] ? docStarts[doc + 1] : blockRaw[block];
+
+    if (blockCompressed[block] == blockRaw[block]) {
+        // Блок записан без сжатия: текст берется прямо из отображенного файла
+        out.assign(file->Data() + blockOffsets[block] + start, end - start);
+        return true;
+    }
+    auto text = loadBlock(block);
+    out.assign(text->data() + start, end - start);
+    return true;
+}
+
+std::string DocumentStore::Get(size_t doc_id) const {
+    std::string text;
+    if (!Get(doc_id, text)) {
+        throw std::out_of_range("document store has no document " + std::to_string(doc_id));
+    }
+    return text;
+}
+
+DocumentStore::CacheStats DocumentStore::GetCacheStats() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    CacheStats stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.blocks = cache.size();
+    for (const auto& cached : cache) {
+        stats.bytes += cached.text->size();
+    }
+    return stats;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+#include "MappedFile.h"
+
+// Хранилище текстов документов для сниппетов и подсветки: индексу тексты
+// не нужны, поэтому они лежат не в памяти, а в файле, и читаются по одному.
+//
+// Тексты идут подряд в порядке doc_id и режутся на блоки примерно по
+// blockSize байт (документ не делится между блоками). Каждый блок сжат
+// LzCodec отдельно, а если сжатие не помогло - записан как есть. Чтение
+// документа распаковывает весь его блок, поэтому блоки небольшие: 16 КиБ
+// распаковываются за десятки микросекунд, а сжимаются хуже блоков по 64 КиБ
+// лишь на несколько процентов. В конце файла - таблица блоков (смещение
+// и размеры), первый doc_id каждого блока и начало каждого документа внутри
+// распакованного блока.
+//
+// Файл открывается через mmap: чтение документа - поиск блока по таблице
+// и распаковка одного блока. Несколько последних распакованных блоков
+// держатся в небольшом кэше (LRU), несжатые блоки читаются прямо из файла.
+class DocumentStore {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t DEFAULT_BLOCK_SIZE = size_t(16) << 10;
+    static constexpr size_t DEFAULT_CACHE_BLOCKS = 16;
+
+    // Запись хранилища по одному документу; файл появляется атомарно в Finish
+    // (через временный файл и переименование), без Finish временный файл удаляется
+    class Writer {
+    public:
+        explicit Writer(const std::string& path, size_t blockSize = DEFAULT_BLOCK_SIZE);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        // Следующий документ получает doc_id, равный числу уже добавленных
+        void Add(std::string_view text);
+        size_t Size() const { return docStarts.size(); }
+
+        // fingerprint - отпечаток исходных файлов, как у файла индекса
+        void Finish(uint64_t fingerprint);
+
+    private:
+        std::string path;
+        std::string tmpPath;
+        size_t blockSize;
+        std::ofstream out;
+        std::string block;              // тексты текущего блока подряд
+        std::string compressed;
+        uint32_t blockFirst = 0;        // doc_id первого документа текущего блока
+        uint64_t offset = 0;            // позиция записи в файле
+        uint64_t rawBytes = 0;
+        bool finished = false;
+
+        std::vector<uint64_t> blockOffsets;
+        std::vector<uint32_t> blockCompressed;
+        std::vector<uint32_t> blockRaw;
+        std::vector<uint32_t> firstDocs;
+        std::vector<uint32_t> docStarts;
+
+        void flushBlock();
+    };
+
+    // Открывает файл хранилища; бросает std::runtime_error, если файл
+    // поврежден или другого формата
+    explicit DocumentStore(const std::string& path, size_t cacheBlocks = DEFAULT_CACHE_BLOCKS);
+
+    // Хранилище, построенное по тем же исходным файлам; nullptr, если файла
+    // нет, он старой версии или отпечаток не совпал
+    static std::shared_ptr<DocumentStore> Open(const std::string& path, uint64_t fingerprint,
+                                               size_t cacheBlocks = DEFAULT_CACHE_BLOCKS);
+
+    // Текст документа в буфер вызывающего; false - такого doc_id в хранилище нет
+    bool Get(size_t doc_id, std::string& out) const;
+    std::string Get(size_t doc_id) const;
+
+    size_t Size() const { return documentCount; }
+    uint64_t Fingerprint() const { return fingerprint; }
+    size_t BlockCount() const { return blockCount; }
+    // Размер текстов без сжатия и размер файла
+    uint64_t RawBytes() const { return rawBytes; }
+    size_t FileBytes() const { return file->Size(); }
+
+    struct CacheStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;            // распакованные блоки
+        size_t blocks = 0;
+        size_t bytes = 0;               // распакованные тексты в кэше
+    };
+    CacheStats GetCacheStats() const;
+
+private:
+    struct CachedBlock {
+        uint32_t block;
+        uint64_t lastUse;
+        std::shared_ptr<const std::string> text;
+    };
+
+    std::unique_ptr<MappedFile> file;
+    std::string path;
+    uint64_t fingerprint = 0;
+    size_t documentCount = 0;
+    size_t blockCount = 0;
+    uint64_t rawBytes = 0;
+    // Таблицы в отображенном файле
+    const uint64_t* blockOffsets = nullptr;
+    const uint32_t* blockCompressed = nullptr;
+    const uint32_t* blockRaw = nullptr;
+    const uint32_t* firstDocs = nullptr;     // blockCount + 1 значений
+    const uint32_t* docStarts = nullptr;
+
+    size_t cacheBlocks;
+    mutable std::mutex cache_mutex;
+    mutable std::vector<CachedBlock> cache;
+    mutable uint64_t useClock = 0;
+    mutable uint64_t hits = 0;
+    mutable uint64_t misses = 0;
+
+    // Распакованный блок из кэша или из файла
+    std::shared_ptr<const std::string> loadBlock(uint32_t block) const;
+    [[noreturn]] void fail(const std::string& reason) const;
+};
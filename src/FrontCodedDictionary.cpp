@@ -0,0 +1,251 @@
+#include "FrontCodedDictionary.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+void putVByte(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+const uint8_t* getVByte(const uint8_t* in, uint32_t& value) {
+    value = 0;
+    for (uint32_t shift = 0; ; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return in;
+        }
+    }
+}
+
+}
+
+void FrontCodedDictionary::Builder::Add(std::string_view term) {
+    if (count > 0 && term <= std::string_view(previous)) {
+        throw std::logic_error("FrontCodedDictionary: terms must be added in strictly increasing order");
+    }
+    if (data.size() > UINT32_MAX) {
+        throw std::length_error("term dictionary exceeds 4 GiB per segment");
+    }
+
+    if (count % BLOCK_SIZE == 0) {
+        blockOffsets.push_back(static_cast<uint32_t>(data.size()));
+        blockKeys.push_back(BlockKey(term));
+        putVByte(data, static_cast<uint32_t>(term.size()));
+        previous.clear();
+    } else {
+        size_t shared = 0;
+        size_t limit = std::min(previous.size(), term.size());
+        while (shared < limit && previous[shared] == term[shared]) {
+            ++shared;
+        }
+        putVByte(data, static_cast<uint32_t>(shared));
+        putVByte(data, static_cast<uint32_t>(term.size() - shared));
+        term.remove_prefix(shared);
+        previous.resize(shared);
+    }
+    data.insert(data.end(), term.begin(), term.end());
+    previous.append(term.data(), term.size());
+    ++count;
+}
+
+FrontCodedDictionary FrontCodedDictionary::Builder::Finish() {
+    blockOffsets.shrink_to_fit();
+    blockKeys.shrink_to_fit();
+    data.shrink_to_fit();
+    FrontCodedDictionary result(std::move(blockOffsets), std::move(blockKeys), std::move(data), count);
+    *this = Builder();
+    return result;
+}
+
+FrontCodedDictionary::Iterator::Iterator(const FrontCodedDictionary& dictionary, uint32_t id)
+    : dictionary(&dictionary), id(id) {
+    if (!Valid()) {
+        return;
+    }
+    // Слово восстанавливается от начала его блока
+    uint32_t block = id / BLOCK_SIZE;
+    at = dictionary.data.data() + dictionary.blockOffsets[block];
+    this->id = block * BLOCK_SIZE;
+    decode();
+    while (this->id < id) {
+        Next();
+    }
+}
+
+void FrontCodedDictionary::Iterator::decode() {
+    uint32_t length;
+    if (id % BLOCK_SIZE == 0) {
+        at = dictionary->data.data() + dictionary->blockOffsets[id / BLOCK_SIZE];
+        at = getVByte(at, length);
+        term.assign(reinterpret_cast<const char*>(at), length);
+    } else {
+        uint32_t shared;
+        at = getVByte(at, shared);
+        at = getVByte(at, length);
+        term.resize(shared);
+        term.append(reinterpret_cast<const char*>(at), length);
+    }
+    at += length;
+}
+
+void FrontCodedDictionary::Iterator::Next() {
+    ++id;
+    if (Valid()) {
+        decode();
+    }
+}
+
+uint64_t FrontCodedDictionary::BlockKey(std::string_view term) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        key = (key << 8) | (i < term.size() ? static_cast<unsigned char>(term[i]) : 0u);
+    }
+    return key;
+}
+
+std::string_view FrontCodedDictionary::blockHead(uint32_t block) const {
+    uint32_t length;
+    const uint8_t* at = getVByte(data.data() + blockOffsets[block], length);
+    return std::string_view(reinterpret_cast<const char*>(at), length);
+}
+
+uint32_t FrontCodedDictionary::findBlock(std::string_view term) const {
+    uint32_t blocks = static_cast<uint32_t>(blockKeys.size());
+    uint64_t key = BlockKey(term);
+    if (blocks == 0 || blockKeys[0] > key) {
+        return npos;
+    }
+
+    // Последний блок с ключом не больше key - двоичный поиск без ветвлений:
+    // исход сравнения не предсказуем, а выбор через условную пересылку дешевле промаха
+    uint32_t last = 0;
+    for (uint32_t count = blocks; count > 1; ) {
+        uint32_t half = count / 2;
+        last = blockKeys[last + half] <= key ? last + half : last;
+        count -= half;
+    }
+    if (blockKeys[last] != key) {
+        return last;
+    }
+
+    // Равные ключи - у слов общие первые 8 байт: среди блоков с тем же
+    // ключом нужен последний, первое слово которого не больше term.
+    // Блок перед ними (если есть) начинается с меньшего слова
+    uint32_t low = static_cast<uint32_t>(std::lower_bound(blockKeys.begin(), blockKeys.begin() + last, key) -
+                                         blockKeys.begin());
+    uint32_t high = last + 1;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (blockHead(middle) <= term) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low == 0 ? npos : low - 1;
+}
+
+uint32_t FrontCodedDictionary::seek(std::string_view term, bool& found) const {
+    found = false;
+    uint32_t block = findBlock(term);
+    if (block == npos) {
+        return 0;
+    }
+
+    // Слова блока сравниваются с term без восстановления: matched - длина
+    // общего префикса term и предыдущего слова, которое меньше term.
+    // Слово с общим префиксом короче matched больше term, длиннее - меньше,
+    // и только при равенстве нужно сравнить его окончание
+    const char* target = term.data();
+    uint32_t id = block * BLOCK_SIZE;
+    uint32_t end = std::min<uint32_t>(static_cast<uint32_t>(termCount), id + BLOCK_SIZE);
+    uint32_t shared = 0;
+    size_t matched = 0;
+    const uint8_t* at = data.data() + blockOffsets[block];
+    for (; id < end; ++id) {
+        uint32_t length;
+        if (id % BLOCK_SIZE != 0) {
+            at = getVByte(at, shared);
+        }
+        at = getVByte(at, length);
+        if (shared < matched) {
+            return id;
+        }
+        if (shared == matched) {
+            const char* suffix = reinterpret_cast<const char*>(at);
+            size_t extra = 0;
+            while (extra < length && matched + extra < term.size() && suffix[extra] == target[matched + extra]) {
+                ++extra;
+            }
+            matched += extra;
+            if (extra < length) {
+                // Слово длиннее общего префикса: больше term, если term кончился
+                // или следующий байт слова больше
+                if (matched == term.size() ||
+                    static_cast<unsigned char>(suffix[extra]) > static_cast<unsigned char>(target[matched])) {
+                    return id;
+                }
+            } else if (matched == term.size()) {
+                found = true;
+                return id;
+            }
+        }
+        at += length;
+    }
+    return end;
+}
+
+uint32_t FrontCodedDictionary::Find(std::string_view term) const {
+    bool found;
+    uint32_t id = seek(term, found);
+    return found ? id : npos;
+}
+
+uint32_t FrontCodedDictionary::LowerBound(std::string_view term) const {
+    bool found;
+    return seek(term, found);
+}
+
+std::pair<uint32_t, uint32_t> FrontCodedDictionary::PrefixRange(std::string_view prefix) const {
+    uint32_t first = LowerBound(prefix);
+
+    // Конец диапазона - первое слово не меньше наименьшей строки, большей
+    // всех строк с префиксом: префикс без хвостовых 0xFF с увеличенным последним байтом
+    std::string next(prefix);
+    while (!next.empty() && static_cast<unsigned char>(next.back()) == 0xFF) {
+        next.pop_back();
+    }
+    if (next.empty()) {
+        return {first, static_cast<uint32_t>(termCount)};
+    }
+    next.back() = static_cast<char>(static_cast<unsigned char>(next.back()) + 1);
+    return {first, LowerBound(next)};
+}
+
+std::string FrontCodedDictionary::Term(uint32_t id) const {
+    std::string term;
+    Term(id, term);
+    return term;
+}
+
+void FrontCodedDictionary::Term(uint32_t id, std::string& out) const {
+    uint32_t block = id / BLOCK_SIZE;
+    uint32_t length;
+    const uint8_t* at = getVByte(data.data() + blockOffsets[block], length);
+    out.assign(reinterpret_cast<const char*>(at), length);
+    at += length;
+    for (uint32_t i = block * BLOCK_SIZE; i < id; ++i) {
+        uint32_t shared;
+        at = getVByte(at, shared);
+        at = getVByte(at, length);
+        out.resize(shared);
+        out.append(reinterpret_cast<const char*>(at), length);
+        at += length;
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include "FrozenArray.h"
+
+// Неизменяемый словарь сегмента: слова по возрастанию (побайтово), term id -
+// номер слова в этом порядке. Слова идут блоками по BLOCK_SIZE: первое слово
+// блока записано целиком, остальные - длиной общего с предыдущим словом
+// префикса и своим окончанием (front coding), длины - variable-byte.
+// Разреженный индекс - смещение начала каждого блока и ключ блока (первые
+// 8 байт первого слова как число big-endian): поиск слова - двоичный поиск
+// по ключам (сами слова читаются только при равных ключах) и просмотр одного
+// блока, а слова с общим префиксом образуют сплошной диапазон term id.
+class FrontCodedDictionary {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+    static constexpr uint32_t BLOCK_SIZE = 16;
+
+    // Построение из слов, поданных строго по возрастанию
+    class Builder {
+    public:
+        void Add(std::string_view term);
+        size_t Size() const { return count; }
+        size_t UsedBytes() const {
+            return blockOffsets.size() * (sizeof(uint32_t) + sizeof(uint64_t)) + data.size() + previous.size();
+        }
+        FrontCodedDictionary Finish();
+
+    private:
+        std::vector<uint32_t> blockOffsets;
+        std::vector<uint64_t> blockKeys;
+        std::vector<uint8_t> data;
+        std::string previous;
+        uint32_t count = 0;
+    };
+
+    // Последовательный обход слов начиная с term id; слово действительно до Next
+    class Iterator {
+    public:
+        Iterator(const FrontCodedDictionary& dictionary, uint32_t id);
+
+        bool Valid() const { return id < dictionary->Size(); }
+        uint32_t Id() const { return id; }
+        std::string_view Term() const { return term; }
+        void Next();
+
+    private:
+        const FrontCodedDictionary* dictionary;
+        uint32_t id;
+        const uint8_t* at = nullptr;
+        std::string term;
+
+        void decode();
+    };
+
+    FrontCodedDictionary() = default;
+    FrontCodedDictionary(FrozenArray<uint32_t> blockOffsets, FrozenArray<uint64_t> blockKeys,
+                         FrozenArray<uint8_t> data, size_t termCount)
+        : blockOffsets(std::move(blockOffsets)), blockKeys(std::move(blockKeys)), data(std::move(data)),
+          termCount(termCount) { };
+
+    // term id слова или npos
+    uint32_t Find(std::string_view term) const;
+    // Первый term id, слово которого не меньше term (Size(), если таких нет)
+    uint32_t LowerBound(std::string_view term) const;
+    // Диапазон [first, last) term id слов, начинающихся с prefix
+    std::pair<uint32_t, uint32_t> PrefixRange(std::string_view prefix) const;
+
+    std::string Term(uint32_t id) const;
+    // Слово в буфер вызывающего: без выделения памяти, если емкости хватает
+    void Term(uint32_t id, std::string& out) const;
+    size_t Size() const { return termCount; }
+
+    // Сырые массивы для записи на диск
+    const FrozenArray<uint32_t>& BlockOffsets() const { return blockOffsets; }
+    const FrozenArray<uint64_t>& BlockKeys() const { return blockKeys; }
+    const FrozenArray<uint8_t>& Data() const { return data; }
+
+    // Ключ блока: первые 8 байт слова big-endian, недостающие - нули.
+    // Меньший ключ - меньшее слово; при равных ключах слова нужно сравнить
+    static uint64_t BlockKey(std::string_view term);
+
+    size_t UsedBytes() const { return blockOffsets.UsedBytes() + blockKeys.UsedBytes() + data.UsedBytes(); }
+    size_t OwnedBytes() const { return blockOffsets.OwnedBytes() + blockKeys.OwnedBytes() + data.OwnedBytes(); }
+    bool IsView() const { return data.IsView(); }
+
+private:
+    FrozenArray<uint32_t> blockOffsets;
+    FrozenArray<uint64_t> blockKeys;
+    FrozenArray<uint8_t> data;
+    size_t termCount = 0;
+
+    // Первое слово блока лежит в data целиком
+    std::string_view blockHead(uint32_t block) const;
+    // Последний блок, первое слово которого не больше term (npos, если такого нет)
+    uint32_t findBlock(std::string_view term) const;
+    // Первый term id со словом не меньше term; found - слово совпало с term
+    uint32_t seek(std::string_view term, bool& found) const;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// Неизменяемый массив: либо владеет своим std::vector, либо смотрит
+// в чужую память (например, в отображенный в память файл индекса).
+// Во втором случае владелец памяти должен пережить массив.
+template<class T>
+class FrozenArray {
+public:
+    FrozenArray() = default;
+    FrozenArray(std::vector<T> values) : owned(std::move(values)), ptr(owned.data()), count(owned.size()) { };
+
+    static FrozenArray View(const T* data, size_t size) {
+        FrozenArray result;
+        result.ptr = data;
+        result.count = size;
+        return result;
+    }
+
+    // Перемещение std::vector сохраняет буфер, поэтому указатель остается верным
+    FrozenArray(FrozenArray&& other) noexcept = default;
+    FrozenArray& operator=(FrozenArray&& other) noexcept = default;
+    FrozenArray(const FrozenArray&) = delete;
+    FrozenArray& operator=(const FrozenArray&) = delete;
+
+    const T* data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+    const T& front() const { return ptr[0]; }
+    const T& back() const { return ptr[count - 1]; }
+
+    // Байты, занятые собственным буфером (0 для представления чужой памяти)
+    size_t OwnedBytes() const { return owned.capacity() * sizeof(T); }
+    // Байты самих элементов, где бы они ни лежали
+    size_t UsedBytes() const { return count * sizeof(T); }
+    bool IsView() const { return count > 0 && owned.empty(); }
+
+private:
+    std::vector<T> owned;
+    const T* ptr = nullptr;
+    size_t count = 0;
+};
@@ -0,0 +1,187 @@
+#include "FuzzyIndex.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+bool isCharStart(char byte) {
+    return (static_cast<unsigned char>(byte) & 0xC0) != 0x80;
+}
+
+// Символы слова как числа: байты символа UTF-8 подряд в одном uint32_t.
+// Равные символы дают равные числа. false - слово длиннее limit символов
+bool splitChars(std::string_view word, uint32_t* chars, size_t limit, size_t& count) {
+    count = 0;
+    for (size_t i = 0; i < word.size(); ++i) {
+        if (isCharStart(word[i])) {
+            if (count == limit) {
+                return false;
+            }
+            chars[count++] = 0;
+        }
+        chars[count - 1] = (chars[count - 1] << 8) | static_cast<unsigned char>(word[i]);
+    }
+    return true;
+}
+
+}
+
+FuzzyIndex FuzzyIndex::Build(const FrontCodedDictionary& dictionary, uint32_t maxDistance) {
+    if (maxDistance > MAX_DISTANCE) {
+        throw std::invalid_argument("FuzzyIndex: edit distance above " + std::to_string(MAX_DISTANCE) +
+                                    " is not supported");
+    }
+    if (maxDistance == 0 || dictionary.Size() == 0) {
+        return FuzzyIndex();
+    }
+
+    // Хэш варианта в старших 32 битах, term id - в младших: сортировка
+    // упорядочивает пары по хэшу, а внутри хэша - по term id
+    std::vector<uint64_t> entries;
+    std::vector<uint32_t> variants;
+    for (FrontCodedDictionary::Iterator term(dictionary, 0); term.Valid(); term.Next()) {
+        Variants(term.Term(), maxDistance, variants);
+        for (uint32_t key : variants) {
+            entries.push_back(static_cast<uint64_t>(key) << 32 | term.Id());
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+    if (entries.size() >= UINT32_MAX) {
+        throw std::length_error("fuzzy index exceeds 32-bit offsets");
+    }
+
+    // Корзин - степень двойки, примерно по две пары на корзину
+    size_t bucketCount = 1;
+    while (bucketCount * 2 < entries.size()) {
+        bucketCount *= 2;
+    }
+    std::vector<uint32_t> keys(entries.size());
+    std::vector<uint32_t> terms(entries.size());
+    std::vector<uint32_t> buckets(bucketCount + 1);
+    size_t bucket = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        keys[i] = static_cast<uint32_t>(entries[i] >> 32);
+        terms[i] = static_cast<uint32_t>(entries[i]);
+        for (uint32_t target = bucketOf(keys[i], bucketCount); bucket <= target; ++bucket) {
+            buckets[bucket] = static_cast<uint32_t>(i);
+        }
+    }
+    for (; bucket <= bucketCount; ++bucket) {
+        buckets[bucket] = static_cast<uint32_t>(entries.size());
+    }
+    return FuzzyIndex(maxDistance, std::move(buckets), std::move(keys), std::move(terms));
+}
+
+void FuzzyIndex::Variants(std::string_view word, uint32_t distance, std::vector<uint32_t>& variants) {
+    variants.clear();
+
+    // Границы символов префикса: символ k - байты [starts[k], starts[k + 1])
+    size_t starts[PREFIX_LENGTH + 1];
+    size_t count = 0;
+    size_t end = word.size();
+    for (size_t i = 0; i < word.size(); ++i) {
+        if (isCharStart(word[i])) {
+            if (count == PREFIX_LENGTH) {
+                end = i;
+                break;
+            }
+            starts[count++] = i;
+        }
+    }
+    starts[count] = end;
+
+    // FNV-1a по байтам префикса без символов skip1 и skip2 и перемешивание
+    // (murmur3 fmix32), чтобы старшие биты, которые адресуют корзину,
+    // зависели от всех байтов. Одинаковые варианты дают одинаковый хэш
+    auto hash = [&](size_t skip1, size_t skip2) {
+        uint32_t h = 2166136261u;
+        for (size_t k = 0; k < count; ++k) {
+            if (k == skip1 || k == skip2) {
+                continue;
+            }
+            for (size_t i = starts[k]; i < starts[k + 1]; ++i) {
+                h = (h ^ static_cast<unsigned char>(word[i])) * 16777619u;
+            }
+        }
+        h ^= h >> 16;
+        h *= 0x85EBCA6Bu;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35u;
+        h ^= h >> 16;
+        return h;
+    };
+
+    variants.push_back(hash(count, count));
+    if (distance >= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            variants.push_back(hash(i, count));
+        }
+    }
+    if (distance >= 2) {
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t j = i + 1; j < count; ++j) {
+                variants.push_back(hash(i, j));
+            }
+        }
+    }
+    std::sort(variants.begin(), variants.end());
+    variants.erase(std::unique(variants.begin(), variants.end()), variants.end());
+}
+
+void FuzzyIndex::Lookup(const std::vector<uint32_t>& variants, std::vector<uint32_t>& out) const {
+    if (keys.empty()) {
+        return;
+    }
+    for (uint32_t key : variants) {
+        uint32_t bucket = bucketOf(key, buckets.size() - 1);
+        for (uint32_t i = buckets[bucket]; i < buckets[bucket + 1] && keys[i] <= key; ++i) {
+            if (keys[i] == key) {
+                out.push_back(terms[i]);
+            }
+        }
+    }
+}
+
+uint32_t FuzzyIndex::Distance(std::string_view a, std::string_view b, uint32_t limit) {
+    uint32_t left[MAX_WORD_LENGTH];
+    uint32_t right[MAX_WORD_LENGTH];
+    size_t n = 0;
+    size_t m = 0;
+    if (!splitChars(a, left, MAX_WORD_LENGTH, n) || !splitChars(b, right, MAX_WORD_LENGTH, m)) {
+        return limit + 1;
+    }
+    if ((n > m ? n - m : m - n) > limit) {
+        return limit + 1;
+    }
+
+    // Три строки таблицы: перестановка смотрит на две строки назад
+    uint32_t rows[3][MAX_WORD_LENGTH + 1];
+    uint32_t* before = rows[0];
+    uint32_t* previous = rows[1];
+    uint32_t* current = rows[2];
+    for (size_t j = 0; j <= m; ++j) {
+        previous[j] = static_cast<uint32_t>(j);
+    }
+    for (size_t i = 1; i <= n; ++i) {
+        current[0] = static_cast<uint32_t>(i);
+        uint32_t rowMin = current[0];
+        for (size_t j = 1; j <= m; ++j) {
+            uint32_t cost = left[i - 1] == right[j - 1] ? 0 : 1;
+            uint32_t value = std::min({previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost});
+            if (i > 1 && j > 1 && left[i - 1] == right[j - 2] && left[i - 2] == right[j - 1]) {
+                value = std::min(value, before[j - 2] + 1);
+            }
+            current[j] = value;
+            rowMin = std::min(rowMin, value);
+        }
+        // Значения в следующих строках не меньше минимума текущей
+        if (rowMin > limit) {
+            return limit + 1;
+        }
+        uint32_t* spare = before;
+        before = previous;
+        previous = current;
+        current = spare;
+    }
+    return std::min(previous[m], limit + 1);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "FrontCodedDictionary.h"
+#include "FrozenArray.h"
+
+// Индекс удалений (symmetric delete) для нечеткого поиска слов сегмента.
+// Для каждого слова словаря строятся варианты его префикса из PREFIX_LENGTH
+// символов без 0..maxDistance символов, и индекс отображает хэш варианта
+// в term id. Если слова отличаются не больше чем на d правок, у их префиксов
+// найдется общий вариант не больше чем с d удалениями с каждой стороны,
+// поэтому кандидаты для слова запроса - слова с общими вариантами. Их немного,
+// и точное расстояние проверяется только для них, а не для всего словаря.
+//
+// Пары (хэш, term id) отсортированы по хэшу; старшие биты хэша адресуют
+// корзину в каталоге buckets, так что поиск варианта - одно обращение
+// к каталогу и просмотр нескольких соседних пар
+class FuzzyIndex {
+public:
+    static constexpr uint32_t MAX_DISTANCE = 2;
+    // Варианты строятся только по началу слова: число вариантов слова
+    // ограничено, а окончание проверяет точное расстояние
+    static constexpr size_t PREFIX_LENGTH = 7;
+    // Слова длиннее (в символах) Distance не сравнивает
+    static constexpr size_t MAX_WORD_LENGTH = 64;
+
+    FuzzyIndex() = default;
+    FuzzyIndex(uint32_t maxDistance, FrozenArray<uint32_t> buckets, FrozenArray<uint32_t> keys,
+               FrozenArray<uint32_t> terms)
+        : maxDistance(maxDistance), buckets(std::move(buckets)), keys(std::move(keys)), terms(std::move(terms)) { };
+
+    // Индекс по словам словаря; maxDistance == 0 - пустой индекс
+    static FuzzyIndex Build(const FrontCodedDictionary& dictionary, uint32_t maxDistance);
+
+    // Хэши вариантов слова не больше чем с distance удалениями, по возрастанию без повторов
+    static void Variants(std::string_view word, uint32_t distance, std::vector<uint32_t>& variants);
+    // Добавляет в out term id слов, у которых есть один из вариантов variants.
+    // Слово может попасть несколько раз, среди кандидатов бывают и далекие слова
+    void Lookup(const std::vector<uint32_t>& variants, std::vector<uint32_t>& out) const;
+
+    // Расстояние правки по символам UTF-8: вставка, удаление, замена символа
+    // и перестановка соседних символов. Больше limit - limit + 1
+    static uint32_t Distance(std::string_view a, std::string_view b, uint32_t limit);
+
+    // Наибольшее расстояние, для которого построен индекс (0 - индекса нет)
+    uint32_t MaxDistance() const { return maxDistance; }
+    size_t Size() const { return keys.size(); }
+
+    // Сырые массивы для записи на диск
+    const FrozenArray<uint32_t>& Buckets() const { return buckets; }
+    const FrozenArray<uint32_t>& Keys() const { return keys; }
+    const FrozenArray<uint32_t>& Terms() const { return terms; }
+
+    size_t UsedBytes() const { return buckets.UsedBytes() + keys.UsedBytes() + terms.UsedBytes(); }
+    size_t OwnedBytes() const { return buckets.OwnedBytes() + keys.OwnedBytes() + terms.OwnedBytes(); }
+    bool IsView() const { return keys.IsView(); }
+
+private:
+    uint32_t maxDistance = 0;
+    FrozenArray<uint32_t> buckets;      // 2^k + 1 начал корзин в keys
+    FrozenArray<uint32_t> keys;         // хэши вариантов по возрастанию
+    FrozenArray<uint32_t> terms;        // term id для каждого хэша
+
+    // Номер корзины хэша: его старшие биты
+    static uint32_t bucketOf(uint32_t key, size_t bucketCount) {
+        return static_cast<uint32_t>((static_cast<uint64_t>(key) * bucketCount) >> 32);
+    }
+};
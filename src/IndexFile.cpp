@@ -0,0 +1,367 @@
+#include "IndexFile.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+const char MAGIC[8] = {'S', 'E', 'I', 'N', 'D', 'E', 'X', '\0'};
+
+enum Section {
+    SECTION_DICTIONARY_BLOCKS,
+    SECTION_DICTIONARY_KEYS,
+    SECTION_DICTIONARY,
+    SECTION_TERM_BLOCKS,
+    SECTION_SKIPS,
+    SECTION_DATA,
+    SECTION_DOC_IDS,
+    SECTION_DOC_LENGTHS,
+    SECTION_POSITION_OFFSETS,
+    SECTION_POSITIONS,
+    SECTION_FUZZY_BUCKETS,
+    SECTION_FUZZY_KEYS,
+    SECTION_FUZZY_TERMS,
+    SECTION_COUNT
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fingerprint;
+    uint64_t payloadChecksum;
+    uint64_t fileSize;
+    uint32_t documentCount;
+    uint32_t termCount;
+    uint32_t fuzzyDistance;     // 0 - индекса удалений нет
+    uint32_t fuzzyBuckets;
+    uint64_t fuzzyEntries;
+    uint64_t dictionaryBlocks;
+    uint64_t dictionarySize;
+    uint64_t postingCount;
+    uint64_t blockCount;
+    uint64_t dataSize;
+    uint64_t segmentDocCount;
+    uint64_t sectionOffset[SECTION_COUNT];
+    uint64_t sectionSize[SECTION_COUNT];
+    uint64_t headerChecksum;   // по всем предыдущим байтам заголовка
+};
+
+static_assert(std::is_trivially_copyable<Header>::value, "header is written as raw bytes");
+static_assert(sizeof(Header) % 8 == 0, "header must keep sections aligned");
+static_assert(sizeof(SkipEntry) == 20, "skip entry layout is part of the file format");
+
+size_t alignUp(size_t value) {
+    return (value + 7) & ~size_t(7);
+}
+
+uint64_t headerChecksum(const Header& header) {
+    return IndexFile::Checksum(&header, offsetof(Header, headerChecksum));
+}
+
+void fail(const std::string& path, const std::string& reason) {
+    throw std::runtime_error("index file " + path + " is corrupted: " + reason);
+}
+
+}
+
+uint64_t IndexFile::Checksum(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * 0x100000001B3ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+void IndexFile::Write(const std::string& path, const IndexSegment& segment,
+                      uint32_t documentCount, uint64_t fingerprint) {
+    Contents contents;
+    contents.terms = &segment.Terms();
+    contents.termBlocks = segment.TermBlocks().data();
+    contents.skips = segment.Skips().data();
+    contents.blockCount = segment.Skips().size();
+    contents.data = segment.Data().data();
+    contents.dataSize = segment.Data().size();
+    contents.postingCount = segment.PostingCount();
+    contents.docIds = segment.DocIds().data();
+    contents.docLengths = segment.DocLengths().data();
+    contents.segmentDocCount = segment.DocumentCount();
+    if (segment.HasPositions()) {
+        contents.positionOffsets = segment.PositionOffsets().data();
+        contents.positionData = segment.PositionData().data();
+        contents.positionDataSize = segment.PositionData().size();
+    }
+    if (segment.Fuzzy().MaxDistance() > 0) {
+        contents.fuzzy = &segment.Fuzzy();
+    }
+    Write(path, contents, documentCount, fingerprint);
+}
+
+void IndexFile::Write(const std::string& path, const Contents& contents,
+                      uint32_t documentCount, uint64_t fingerprint) {
+    const FrontCodedDictionary& terms = *contents.terms;
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.headerSize = sizeof(Header);
+    header.fingerprint = fingerprint;
+    header.documentCount = documentCount;
+    header.termCount = static_cast<uint32_t>(terms.Size());
+    header.dictionaryBlocks = terms.BlockOffsets().size();
+    header.dictionarySize = terms.Data().size();
+    header.postingCount = contents.postingCount;
+    header.blockCount = contents.blockCount;
+    header.dataSize = contents.dataSize;
+    header.segmentDocCount = contents.segmentDocCount;
+    if (contents.fuzzy != nullptr) {
+        header.fuzzyDistance = contents.fuzzy->MaxDistance();
+        header.fuzzyBuckets = static_cast<uint32_t>(contents.fuzzy->Buckets().size() - 1);
+        header.fuzzyEntries = contents.fuzzy->Size();
+    }
+
+    std::ifstream dataFile;
+    if (!contents.dataPath.empty()) {
+        dataFile.open(contents.dataPath, std::ios::binary);
+        if (!dataFile.is_open()) {
+            throw std::runtime_error("cannot open postings data: " + contents.dataPath);
+        }
+    }
+
+    const void* sectionData[SECTION_COUNT] = {
+        terms.BlockOffsets().data(), terms.BlockKeys().data(), terms.Data().data(),
+        contents.termBlocks, contents.skips, contents.data,
+        contents.docIds, contents.docLengths,
+        contents.positionOffsets, contents.positionData,
+        contents.fuzzy ? contents.fuzzy->Buckets().data() : nullptr,
+        contents.fuzzy ? contents.fuzzy->Keys().data() : nullptr,
+        contents.fuzzy ? contents.fuzzy->Terms().data() : nullptr
+    };
+    header.sectionSize[SECTION_DICTIONARY_BLOCKS] = header.dictionaryBlocks * sizeof(uint32_t);
+    header.sectionSize[SECTION_DICTIONARY_KEYS] = header.dictionaryBlocks * sizeof(uint64_t);
+    header.sectionSize[SECTION_DICTIONARY] = header.dictionarySize;
+    header.sectionSize[SECTION_TERM_BLOCKS] = (terms.Size() + 1) * sizeof(uint32_t);
+    header.sectionSize[SECTION_SKIPS] = contents.blockCount * sizeof(SkipEntry);
+    header.sectionSize[SECTION_DATA] = contents.dataSize;
+    header.sectionSize[SECTION_DOC_IDS] = contents.segmentDocCount * sizeof(uint32_t);
+    header.sectionSize[SECTION_DOC_LENGTHS] = contents.segmentDocCount * sizeof(uint32_t);
+    if (contents.positionOffsets != nullptr) {
+        header.sectionSize[SECTION_POSITION_OFFSETS] = contents.blockCount * sizeof(uint32_t);
+        header.sectionSize[SECTION_POSITIONS] = contents.positionDataSize;
+    }
+    if (contents.fuzzy != nullptr) {
+        header.sectionSize[SECTION_FUZZY_BUCKETS] = (uint64_t(header.fuzzyBuckets) + 1) * sizeof(uint32_t);
+        header.sectionSize[SECTION_FUZZY_KEYS] = header.fuzzyEntries * sizeof(uint32_t);
+        header.sectionSize[SECTION_FUZZY_TERMS] = header.fuzzyEntries * sizeof(uint32_t);
+    }
+
+    uint64_t offset = sizeof(Header);
+    for (int s = 0; s < SECTION_COUNT; ++s) {
+        header.sectionOffset[s] = offset;
+        offset += alignUp(header.sectionSize[s]);
+    }
+    header.fileSize = offset;
+
+    std::string tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("cannot create index file: " + tmpPath);
+    }
+
+    // Заголовок пишется дважды: место под него сейчас, итоговые суммы - в конце
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Кусок секции пишется и добавляется в сумму; длина всех кусков,
+    // кроме последнего, кратна 8, последний дополняется нулями
+    const char padding[8] = {};
+    uint64_t checksum = CHECKSUM_SEED;
+    auto emit = [&](const char* bytes, size_t size, bool last) {
+        out.write(bytes, size);
+        size_t whole = size & ~size_t(7);
+        checksum = Checksum(bytes, whole, checksum);
+        if (last && whole != size) {
+            char tail[8] = {};
+            std::memcpy(tail, bytes + whole, size - whole);
+            out.write(padding, 8 - (size - whole));
+            checksum = Checksum(tail, 8, checksum);
+        }
+    };
+
+    for (int s = 0; s < SECTION_COUNT; ++s) {
+        size_t size = header.sectionSize[s];
+        if (s == SECTION_DATA && dataFile.is_open()) {
+            // Сжатые постинги, собранные вне памяти, копируются из файла кусками
+            std::vector<char> chunk(size_t(1) << 20);
+            size_t left = size;
+            while (left > 0) {
+                size_t n = std::min(left, chunk.size());
+                if (!dataFile.read(chunk.data(), static_cast<std::streamsize>(n))) {
+                    throw std::runtime_error("postings data is shorter than expected: " + contents.dataPath);
+                }
+                left -= n;
+                emit(chunk.data(), n, left == 0);
+            }
+        } else if (size > 0) {
+            emit(static_cast<const char*>(sectionData[s]), size, true);
+        }
+    }
+
+    header.payloadChecksum = checksum;
+    header.headerChecksum = headerChecksum(header);
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (!out) {
+        throw std::runtime_error("cannot write index file: " + tmpPath);
+    }
+
+    std::filesystem::rename(tmpPath, path);
+}
+
+std::shared_ptr<const IndexSegment> IndexFile::Read(const std::string& path, uint64_t fingerprint,
+                                                    uint32_t& documentCount, bool verifyChecksum) {
+    if (!std::filesystem::exists(path)) {
+        return nullptr;
+    }
+
+    auto file = std::make_shared<MappedFile>(path);
+    if (file->Size() < sizeof(Header)) {
+        fail(path, "file is too small");
+    }
+
+    Header header;
+    std::memcpy(&header, file->Data(), sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        fail(path, "bad magic");
+    }
+    if (header.version != VERSION) {
+        // Файл старого формата просто перестраивается
+        return nullptr;
+    }
+    if (header.headerSize != sizeof(Header) || header.headerChecksum != headerChecksum(header)) {
+        fail(path, "header checksum mismatch");
+    }
+    if (header.fingerprint != fingerprint) {
+        return nullptr;
+    }
+    if (header.fileSize != file->Size()) {
+        fail(path, "unexpected file size");
+    }
+
+    for (int s = 0; s < SECTION_COUNT; ++s) {
+        if (header.sectionOffset[s] % 8 != 0 ||
+            header.sectionOffset[s] > header.fileSize ||
+            header.sectionSize[s] > header.fileSize - header.sectionOffset[s]) {
+            fail(path, "section out of bounds");
+        }
+    }
+
+    uint64_t termCount = header.termCount;
+    if (header.dictionaryBlocks != (termCount + FrontCodedDictionary::BLOCK_SIZE - 1) / FrontCodedDictionary::BLOCK_SIZE ||
+        header.sectionSize[SECTION_DICTIONARY_BLOCKS] != header.dictionaryBlocks * sizeof(uint32_t) ||
+        header.sectionSize[SECTION_DICTIONARY_KEYS] != header.dictionaryBlocks * sizeof(uint64_t) ||
+        header.sectionSize[SECTION_DICTIONARY] != header.dictionarySize ||
+        header.sectionSize[SECTION_TERM_BLOCKS] != (termCount + 1) * sizeof(uint32_t) ||
+        header.sectionSize[SECTION_SKIPS] != header.blockCount * sizeof(SkipEntry) ||
+        header.sectionSize[SECTION_DATA] != header.dataSize ||
+        header.sectionSize[SECTION_DOC_IDS] != header.segmentDocCount * sizeof(uint32_t) ||
+        header.sectionSize[SECTION_DOC_LENGTHS] != header.segmentDocCount * sizeof(uint32_t) ||
+        (header.sectionSize[SECTION_POSITION_OFFSETS] != 0 &&
+         header.sectionSize[SECTION_POSITION_OFFSETS] != header.blockCount * sizeof(uint32_t))) {
+        fail(path, "inconsistent section sizes");
+    }
+    bool fuzzy = header.fuzzyDistance > 0;
+    if (header.fuzzyDistance > FuzzyIndex::MAX_DISTANCE || (fuzzy && header.fuzzyBuckets == 0) ||
+        header.sectionSize[SECTION_FUZZY_BUCKETS] != (fuzzy ? (uint64_t(header.fuzzyBuckets) + 1) * sizeof(uint32_t) : 0) ||
+        header.sectionSize[SECTION_FUZZY_KEYS] != header.fuzzyEntries * sizeof(uint32_t) ||
+        header.sectionSize[SECTION_FUZZY_TERMS] != header.fuzzyEntries * sizeof(uint32_t) ||
+        (!fuzzy && header.fuzzyEntries != 0)) {
+        fail(path, "inconsistent fuzzy index");
+    }
+
+    if (verifyChecksum) {
+        uint64_t checksum = Checksum(file->Data() + sizeof(Header), file->Size() - sizeof(Header));
+        if (checksum != header.payloadChecksum) {
+            fail(path, "payload checksum mismatch");
+        }
+    }
+
+    auto section = [&](Section s) { return file->Data() + header.sectionOffset[s]; };
+    const uint32_t* dictionaryBlocks = reinterpret_cast<const uint32_t*>(section(SECTION_DICTIONARY_BLOCKS));
+    const uint32_t* termBlocks = reinterpret_cast<const uint32_t*>(section(SECTION_TERM_BLOCKS));
+    if (termBlocks[termCount] != header.blockCount) {
+        fail(path, "inconsistent offsets");
+    }
+    // Проходы по секциям целиком - только вместе с полной проверкой
+    for (uint64_t b = 0; verifyChecksum && b < header.dictionaryBlocks; ++b) {
+        if (dictionaryBlocks[b] >= header.dictionarySize || (b > 0 && dictionaryBlocks[b] <= dictionaryBlocks[b - 1])) {
+            fail(path, "inconsistent dictionary blocks");
+        }
+    }
+
+    const uint32_t* fuzzyBuckets = reinterpret_cast<const uint32_t*>(section(SECTION_FUZZY_BUCKETS));
+    const uint32_t* fuzzyTerms = reinterpret_cast<const uint32_t*>(section(SECTION_FUZZY_TERMS));
+    if (fuzzy) {
+        if (fuzzyBuckets[0] != 0 || fuzzyBuckets[header.fuzzyBuckets] != header.fuzzyEntries) {
+            fail(path, "inconsistent fuzzy index");
+        }
+        for (uint64_t b = 0; verifyChecksum && b < header.fuzzyBuckets; ++b) {
+            if (fuzzyBuckets[b] > fuzzyBuckets[b + 1]) {
+                fail(path, "inconsistent fuzzy index");
+            }
+        }
+        for (uint64_t i = 0; verifyChecksum && i < header.fuzzyEntries; ++i) {
+            if (fuzzyTerms[i] >= termCount) {
+                fail(path, "fuzzy index term out of range");
+            }
+        }
+    }
+
+    const uint32_t* docIds = reinterpret_cast<const uint32_t*>(section(SECTION_DOC_IDS));
+    if (header.segmentDocCount > 0 && docIds[header.segmentDocCount - 1] >= header.documentCount) {
+        fail(path, "doc_id out of range");
+    }
+
+    FrontCodedDictionary terms(
+        FrozenArray<uint32_t>::View(dictionaryBlocks, header.dictionaryBlocks),
+        FrozenArray<uint64_t>::View(reinterpret_cast<const uint64_t*>(section(SECTION_DICTIONARY_KEYS)),
+                                    header.dictionaryBlocks),
+        FrozenArray<uint8_t>::View(reinterpret_cast<const uint8_t*>(section(SECTION_DICTIONARY)), header.dictionarySize),
+        termCount);
+
+    FuzzyIndex fuzzyIndex;
+    if (fuzzy) {
+        fuzzyIndex = FuzzyIndex(
+            header.fuzzyDistance,
+            FrozenArray<uint32_t>::View(fuzzyBuckets, uint64_t(header.fuzzyBuckets) + 1),
+            FrozenArray<uint32_t>::View(reinterpret_cast<const uint32_t*>(section(SECTION_FUZZY_KEYS)),
+                                        header.fuzzyEntries),
+            FrozenArray<uint32_t>::View(fuzzyTerms, header.fuzzyEntries));
+    }
+
+    size_t positionBlocks = header.sectionSize[SECTION_POSITION_OFFSETS] / sizeof(uint32_t);
+    const uint32_t* positionOffsets = reinterpret_cast<const uint32_t*>(section(SECTION_POSITION_OFFSETS));
+
+    documentCount = header.documentCount;
+    return std::make_shared<const IndexSegment>(
+        std::move(terms),
+        FrozenArray<uint32_t>::View(termBlocks, termCount + 1),
+        FrozenArray<SkipEntry>::View(reinterpret_cast<const SkipEntry*>(section(SECTION_SKIPS)), header.blockCount),
+        FrozenArray<uint8_t>::View(reinterpret_cast<const uint8_t*>(section(SECTION_DATA)), header.dataSize),
+        header.postingCount,
+        FrozenArray<uint32_t>::View(docIds, header.segmentDocCount),
+        FrozenArray<uint32_t>::View(reinterpret_cast<const uint32_t*>(section(SECTION_DOC_LENGTHS)), header.segmentDocCount),
+        FrozenArray<uint32_t>::View(positionOffsets, positionBlocks),
+        FrozenArray<uint8_t>::View(reinterpret_cast<const uint8_t*>(section(SECTION_POSITIONS)),
+                                   header.sectionSize[SECTION_POSITIONS]),
+        std::move(fuzzyIndex), std::move(file));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "IndexSegment.h"
+
+// Бинарный файл индекса: заголовок с версией, отпечатком исходных файлов
+// и контрольными суммами, далее секции словаря, сжатых постингов (таблица
+// пропусков и байты блоков), позиций слов (пустые, если индекс не
+// позиционный), таблицы длин документов и индекса удалений для нечеткого
+// поиска (пустые, если он не строился). Секции выровнены на 8 байт и читаются
+// через mmap как есть, без разбора и копирования. Порядок байт - родной для
+// машины (little-endian).
+class IndexFile {
+public:
+    // 3 - слова приведены к нижнему регистру (Tokenizer)
+    // 4 - границы блоков для BM25 в таблице пропусков (maxCount, minLength)
+    // 5 - позиции слов (секции пусты у непозиционного индекса)
+    // 6 - отсортированный словарь с front coding вместо хэш-таблицы
+    // 7 - индекс удалений для нечеткого поиска (секции пусты, если он не строился)
+    static constexpr uint32_t VERSION = 7;
+
+    // Содержимое файла в виде массивов. Сжатые постинги лежат либо в памяти
+    // (data), либо в отдельном файле dataPath - так пишется индекс,
+    // собранный вне памяти (см. SpimiBuilder).
+    struct Contents {
+        const FrontCodedDictionary* terms = nullptr;
+        const uint32_t* termBlocks = nullptr;    // terms->Size() + 1 значений
+        const SkipEntry* skips = nullptr;
+        size_t blockCount = 0;
+        const uint8_t* data = nullptr;
+        std::string dataPath;
+        size_t dataSize = 0;
+        size_t postingCount = 0;
+        const uint32_t* docIds = nullptr;
+        const uint32_t* docLengths = nullptr;
+        size_t segmentDocCount = 0;
+        const uint32_t* positionOffsets = nullptr;  // blockCount значений или nullptr
+        const uint8_t* positionData = nullptr;
+        size_t positionDataSize = 0;
+        const FuzzyIndex* fuzzy = nullptr;          // nullptr - индекса удалений нет
+    };
+
+    // Записывает сегмент в файл атомарно (через временный файл и переименование).
+    // documentCount - граница пространства doc_id индекса.
+    static void Write(const std::string& path, const IndexSegment& segment,
+                      uint32_t documentCount, uint64_t fingerprint);
+    static void Write(const std::string& path, const Contents& contents,
+                      uint32_t documentCount, uint64_t fingerprint);
+
+    // Открывает файл индекса через отображение в память.
+    // Возвращает nullptr, если файла нет или отпечаток не совпал;
+    // бросает std::runtime_error, если файл поврежден.
+    // Без verifyChecksum проверяются только заголовок (его сумма, отпечаток,
+    // размеры секций) и несколько граничных значений - данные не читаются,
+    // и открытие не зависит от размера индекса. verifyChecksum - еще сумма
+    // всех данных и согласованность словаря и индекса удалений (читает файл целиком).
+    static std::shared_ptr<const IndexSegment> Read(const std::string& path, uint64_t fingerprint,
+                                                    uint32_t& documentCount, bool verifyChecksum = false);
+
+    // Потоковая контрольная сумма по 8-байтным словам (size кратен 8).
+    // Результат можно передать как seed следующему куску данных.
+    static constexpr uint64_t CHECKSUM_SEED = 0x9E3779B97F4A7C15ull;
+    static uint64_t Checksum(const void* data, size_t size, uint64_t seed = CHECKSUM_SEED);
+};
@@ -0,0 +1,93 @@
+#include "IndexReloader.h"
+#include <exception>
+
+IndexReloader::IndexReloader(SearchServer& server, Builder builder, Validator validator)
+    : server(server), builder(std::move(builder)), validator(std::move(validator)) {
+    worker = std::thread(&IndexReloader::workerLoop, this);
+}
+
+IndexReloader::~IndexReloader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    worker.join();
+}
+
+void IndexReloader::Request() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requested = true;
+    }
+    cv.notify_all();
+}
+
+void IndexReloader::WaitIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return !requested && !running; });
+}
+
+IndexReloader::Stats IndexReloader::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+bool IndexReloader::ReloadNow() {
+    std::lock_guard<std::mutex> reloadLock(reload_mutex);
+
+    std::string error;
+    std::shared_ptr<InvertedIndex> fresh;
+    try {
+        fresh = builder();
+        if (!fresh) {
+            error = "builder returned no index";
+        } else {
+            // Фоновые слияния завершаются до публикации: читатели получают
+            // уже уплотненный индекс, а сборка не конкурирует с ними позже
+            fresh->WaitForMerges();
+            if (validator && !validator(*fresh, error)) {
+                fresh.reset();
+            }
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+        fresh.reset();
+    }
+
+    if (!fresh) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++stats.failures;
+        stats.lastError = error.empty() ? "index rejected" : error;
+        return false;
+    }
+
+    auto previous = server.SetIndex(std::move(fresh));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++stats.reloads;
+    }
+    // Если читателей старого индекса уже нет, он освобождается здесь,
+    // на потоке перезагрузки, а не на потоке запроса
+    previous.reset();
+    return true;
+}
+
+void IndexReloader::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [this]() { return stopping || requested; });
+        if (stopping) {
+            return;
+        }
+        requested = false;
+        running = true;
+        lock.unlock();
+
+        ReloadNow();
+
+        lock.lock();
+        running = false;
+        cv.notify_all();
+    }
+}
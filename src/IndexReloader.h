@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "InvertedIndex.h"
+#include "SearchServer.h"
+
+// Горячая перезагрузка индекса. Новый индекс строится в фоновом потоке
+// (builder: заново по файлам из config.json или открытием сохраненного),
+// проверяется и атомарно подменяет индекс сервера (SearchServer::SetIndex).
+// Запросы, начатые до подмены, дорабатывают на старом снимке; старый индекс
+// освобождается вместе с последним читателем, а не на потоке запроса.
+// Если сборка или проверка не удалась, сервер продолжает работать на прежнем индексе.
+class IndexReloader {
+public:
+    // Строит новый индекс; исключение - перезагрузка не удалась
+    using Builder = std::function<std::shared_ptr<InvertedIndex>()>;
+    // Проверка перед публикацией: false и error - индекс отклонен
+    using Validator = std::function<bool(const InvertedIndex&, std::string& error)>;
+
+    IndexReloader(SearchServer& server, Builder builder, Validator validator = nullptr);
+    // Дожидается текущей перезагрузки
+    ~IndexReloader();
+
+    IndexReloader(const IndexReloader&) = delete;
+    IndexReloader& operator=(const IndexReloader&) = delete;
+
+    // Запросить перезагрузку в фоне и сразу вернуться. Запросы, пришедшие
+    // во время сборки, склеиваются в одну следующую перезагрузку.
+    void Request();
+
+    // Построить, проверить и опубликовать на вызывающем потоке.
+    // Возвращает true, если новый индекс опубликован.
+    bool ReloadNow();
+
+    // Дождаться, пока не останется запрошенных и выполняющихся перезагрузок
+    void WaitIdle();
+
+    struct Stats {
+        uint64_t reloads = 0;       // опубликовано новых индексов
+        uint64_t failures = 0;      // сборка или проверка не удалась
+        std::string lastError;
+    };
+    Stats GetStats() const;
+
+private:
+    SearchServer& server;
+    Builder builder;
+    Validator validator;
+
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    bool requested = false;
+    bool running = false;
+    bool stopping = false;
+    Stats stats;
+
+    // Сборки не пересекаются: ReloadNow и фоновый поток сериализуются
+    std::mutex reload_mutex;
+
+    void workerLoop();
+};
@@ -0,0 +1,40 @@
+#include "IndexSegment.h"
+#include <algorithm>
+
+PostingsList IndexSegment::Find(std::string_view word) const {
+    uint32_t id = terms.Find(word);
+    if (id == FrontCodedDictionary::npos) {
+        return {};
+    }
+    return Postings(id);
+}
+
+PostingsList IndexSegment::Postings(uint32_t termId) const {
+    // Постинги гарантированно отсортированы по doc_id
+    uint32_t first = termBlocks[termId];
+    if (HasPositions()) {
+        return PostingsList(skips.data() + first, termBlocks[termId + 1] - first, data.data(),
+                            positionOffsets.data() + first, positionData.data());
+    }
+    return PostingsList(skips.data() + first, termBlocks[termId + 1] - first, data.data());
+}
+
+bool IndexSegment::ContainsDocument(uint32_t doc_id) const {
+    return std::binary_search(docIds.begin(), docIds.end(), doc_id);
+}
+
+void IndexSegment::computeLengthStatistics() {
+    denseDocs = !docIds.empty() && docIds[docIds.size() - 1] - docIds[0] + 1 == docIds.size();
+    totalLength = 0;
+    for (uint32_t length : docLengths) {
+        totalLength += length;
+    }
+}
+
+uint32_t IndexSegment::docLengthSlow(uint32_t doc_id) const {
+    auto found = std::lower_bound(docIds.begin(), docIds.end(), doc_id);
+    if (found == docIds.end() || *found != doc_id) {
+        return 0;
+    }
+    return docLengths[static_cast<size_t>(found - docIds.begin())];
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "FrontCodedDictionary.h"
+#include "FuzzyIndex.h"
+#include "FrozenArray.h"
+#include "PostingsCodec.h"
+
+// Неизменяемый сегмент индекса по некоторому набору документов (doc_id глобальные).
+// Отсортированный словарь term -> term id (слова с общим префиксом - сплошной
+// диапазон term id) и сжатые постинг-листы: блоки слова id описаны
+// записями skips[termBlocks[id], termBlocks[id + 1]), данные блоков лежат в data.
+// В позиционном индексе позиции слов лежат отдельным потоком positionData,
+// positionOffsets[b] - начало позиций блока b: запросы без фраз его не читают,
+// а из отображенного файла его страницы подгружаются только при чтении.
+// Индекс удалений fuzzy для нечеткого поиска строится по словарю, если включен.
+// Массивы сегмента либо принадлежат ему, либо смотрят в storage
+// (отображенный в память файл индекса), который живет вместе с сегментом.
+class IndexSegment {
+public:
+    IndexSegment() = default;
+    IndexSegment(FrontCodedDictionary terms, FrozenArray<uint32_t> termBlocks, FrozenArray<SkipEntry> skips,
+                 FrozenArray<uint8_t> data, size_t postingCount,
+                 FrozenArray<uint32_t> docIds, FrozenArray<uint32_t> docLengths,
+                 FrozenArray<uint32_t> positionOffsets, FrozenArray<uint8_t> positionData,
+                 FuzzyIndex fuzzy, std::shared_ptr<const void> storage = nullptr)
+        : storage(std::move(storage)), terms(std::move(terms)), termBlocks(std::move(termBlocks)),
+          skips(std::move(skips)), data(std::move(data)), postingCount(postingCount),
+          docIds(std::move(docIds)), docLengths(std::move(docLengths)),
+          positionOffsets(std::move(positionOffsets)), positionData(std::move(positionData)),
+          fuzzy(std::move(fuzzy)) {
+        computeLengthStatistics();
+    };
+
+    PostingsList Find(std::string_view word) const;
+    PostingsList Postings(uint32_t termId) const;
+
+    const FrontCodedDictionary& Terms() const { return terms; }
+    // Индекс удалений словаря (пустой, если нечеткий поиск не включен)
+    const FuzzyIndex& Fuzzy() const { return fuzzy; }
+    size_t TermCount() const { return terms.Size(); }
+    size_t PostingCount() const { return postingCount; }
+
+    // Документы сегмента по возрастанию doc_id и их длины в словах
+    const FrozenArray<uint32_t>& DocIds() const { return docIds; }
+    const FrozenArray<uint32_t>& DocLengths() const { return docLengths; }
+    size_t DocumentCount() const { return docIds.size(); }
+    bool ContainsDocument(uint32_t doc_id) const;
+
+    // Длина документа сегмента в словах; для сплошного диапазона doc_id -
+    // прямой индекс, иначе двоичный поиск
+    uint32_t DocLength(uint32_t doc_id) const {
+        if (denseDocs) {
+            return docLengths[doc_id - docIds[0]];
+        }
+        return docLengthSlow(doc_id);
+    }
+    // Сумма длин всех документов сегмента
+    uint64_t TotalLength() const { return totalLength; }
+
+    // Хранит ли сегмент позиции слов (у пустого сегмента их нет)
+    bool HasPositions() const { return !positionOffsets.empty(); }
+
+    // Сырые массивы для записи на диск
+    const FrozenArray<uint32_t>& TermBlocks() const { return termBlocks; }
+    const FrozenArray<SkipEntry>& Skips() const { return skips; }
+    const FrozenArray<uint8_t>& Data() const { return data; }
+    const FrozenArray<uint32_t>& PositionOffsets() const { return positionOffsets; }
+    const FrozenArray<uint8_t>& PositionData() const { return positionData; }
+
+private:
+    std::shared_ptr<const void> storage;   // объявлен первым - разрушается последним
+    FrontCodedDictionary terms;
+    FrozenArray<uint32_t> termBlocks = std::vector<uint32_t>{0};
+    FrozenArray<SkipEntry> skips;
+    FrozenArray<uint8_t> data;
+    size_t postingCount = 0;
+    FrozenArray<uint32_t> docIds;
+    FrozenArray<uint32_t> docLengths;
+    FrozenArray<uint32_t> positionOffsets;      // по одному на запись skips или пусто
+    FrozenArray<uint8_t> positionData;
+    FuzzyIndex fuzzy;
+    bool denseDocs = false;
+    uint64_t totalLength = 0;
+
+    void computeLengthStatistics();
+    uint32_t docLengthSlow(uint32_t doc_id) const;
+};
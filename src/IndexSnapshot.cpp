@@ -0,0 +1,271 @@
+#include "IndexSnapshot.h"
+#include "WordPattern.h"
+#include "FuzzyIndex.h"
+#include <algorithm>
+#include <unordered_map>
+
+DeletedDocs::DeletedDocs(const IndexSegment& segment) {
+    const auto& docIds = segment.DocIds();
+    if (!docIds.empty()) {
+        base = docIds.front();
+        bits.assign((docIds.back() - base) / 64 + 1, 0);
+    }
+}
+
+void DeletedDocs::Insert(uint32_t doc_id) {
+    if (Contains(doc_id)) {
+        return;
+    }
+    size_t bit = doc_id - base;
+    bits[bit / 64] |= uint64_t(1) << (bit % 64);
+    ++count;
+}
+
+void IndexSnapshot::computeStatistics() {
+    for (const auto& ref : segments) {
+        liveDocuments += ref.LiveDocumentCount();
+        totalLength += ref.segment->TotalLength();
+        if (!ref.deleted) {
+            continue;
+        }
+        // Длины удаленных документов вычитаются; удалений обычно немного,
+        // а проход нужен только по сегментам, где они есть
+        const auto& ids = ref.segment->DocIds();
+        const auto& lengths = ref.segment->DocLengths();
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (!ref.IsLive(ids[i])) {
+                totalLength -= lengths[i];
+            }
+        }
+    }
+}
+
+std::vector<Posting> IndexSnapshot::CollectPostings(std::string_view word) const {
+    std::vector<Posting> result;
+    bool sorted = true;
+
+    for (const auto& ref : segments) {
+        for (const Posting& posting : ref.segment->Find(word).Decode()) {
+            if (!ref.IsLive(posting.doc_id)) {
+                continue;
+            }
+            if (!result.empty() && result.back().doc_id > posting.doc_id) {
+                sorted = false;
+            }
+            result.push_back(posting);
+        }
+    }
+
+    // Диапазоны doc_id сегментов пересекаются после замены документов
+    if (!sorted) {
+        std::sort(result.begin(), result.end(),
+            [](const Posting& a, const Posting& b) { return a.doc_id < b.doc_id; });
+    }
+    return result;
+}
+
+void IndexSnapshot::ExpandPattern(std::string_view pattern, size_t limit, PatternExpansion& expansion) const {
+    expansion.Clear();
+    std::string_view prefix = WordPattern::LiteralPrefix(pattern);
+    auto& matches = expansion.matches;
+    for (const auto& ref : segments) {
+        const FrontCodedDictionary& terms = ref.segment->Terms();
+        auto [first, last] = terms.PrefixRange(prefix);
+        for (FrontCodedDictionary::Iterator term(terms, first); term.Valid() && term.Id() < last; term.Next()) {
+            if (WordPattern::Matches(pattern, term.Term())) {
+                matches.push_back({expansion.pool.size(), term.Term().size(), ref.segment->Postings(term.Id()).size()});
+                expansion.pool += term.Term();
+            }
+        }
+    }
+    expansion.Select(limit, segments.size() > 1);
+}
+
+void IndexSnapshot::ExpandFuzzy(std::string_view word, uint32_t distance, size_t limit,
+                                PatternExpansion& expansion) const {
+    expansion.Clear();
+    if (distance == 0) {
+        return;
+    }
+    FuzzyIndex::Variants(word, distance, expansion.variants);
+
+    // best - расстояние ближайших найденных слов: более далекие слова
+    // не проверяются до конца, а при находке ближе прежние отбрасываются
+    uint32_t best = distance;
+    auto& matches = expansion.matches;
+    auto& candidates = expansion.candidates;
+    for (const auto& ref : segments) {
+        const IndexSegment& segment = *ref.segment;
+        candidates.clear();
+        segment.Fuzzy().Lookup(expansion.variants, candidates);
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        for (uint32_t id : candidates) {
+            segment.Terms().Term(id, expansion.term);
+            uint32_t found = FuzzyIndex::Distance(word, expansion.term, best);
+            if (found == 0 || found > best) {
+                continue;
+            }
+            if (found < best) {
+                matches.clear();
+                expansion.pool.clear();
+                best = found;
+            }
+            matches.push_back({expansion.pool.size(), expansion.term.size(), segment.Postings(id).size()});
+            expansion.pool += expansion.term;
+        }
+    }
+    expansion.distance = matches.empty() ? 0 : best;
+    expansion.Select(limit, segments.size() > 1);
+}
+
+void PatternExpansion::Select(size_t limit, bool merge) {
+    auto termOf = [&](const Match& m) {
+        return std::string_view(pool).substr(m.offset, m.length);
+    };
+    auto byTerm = [&](const Match& a, const Match& b) {
+        return termOf(a) < termOf(b);
+    };
+    if (merge) {
+        std::sort(matches.begin(), matches.end(), byTerm);
+        size_t unique = 0;
+        for (const auto& match : matches) {
+            if (unique > 0 && termOf(matches[unique - 1]) == termOf(match)) {
+                matches[unique - 1].frequency += match.frequency;
+            } else {
+                matches[unique++] = match;
+            }
+        }
+        matches.resize(unique);
+    }
+    total = matches.size();
+
+    if (limit > 0 && matches.size() > limit) {
+        auto limitEnd = matches.begin() + static_cast<std::ptrdiff_t>(limit);
+        std::nth_element(matches.begin(), limitEnd - 1, matches.end(),
+                         [&](const Match& a, const Match& b) {
+                             return a.frequency != b.frequency ? a.frequency > b.frequency : byTerm(a, b);
+                         });
+        matches.resize(limit);
+        std::sort(matches.begin(), matches.end(), byTerm);
+    }
+}
+
+namespace {
+
+// Массив сегмента: в куче (вместе с запасом емкости) или в отображенном файле
+template<class T>
+void addArray(const FrozenArray<T>& array, size_t& component, IndexMemoryUsage& usage) {
+    component += array.UsedBytes();
+    if (array.IsView()) {
+        usage.mappedBytes += array.UsedBytes();
+    } else {
+        usage.heapBytes += array.OwnedBytes();
+        usage.slackBytes += array.OwnedBytes() - array.UsedBytes();
+    }
+}
+
+// Размер постингов каждого слова сегмента: блоки одного слова лежат в data
+// подряд, конец последнего - начало следующего по смещению блока
+template<class Visit>
+void forEachTermSize(const IndexSegment& segment, Visit visit) {
+    const auto& skips = segment.Skips();
+    const auto& termBlocks = segment.TermBlocks();
+    std::vector<uint32_t> offsets;
+    offsets.reserve(skips.size());
+    for (const SkipEntry& skip : skips) {
+        offsets.push_back(skip.dataOffset);
+    }
+    std::sort(offsets.begin(), offsets.end());
+
+    for (FrontCodedDictionary::Iterator term(segment.Terms(), 0); term.Valid(); term.Next()) {
+        uint32_t id = term.Id();
+        uint32_t first = termBlocks[id];
+        uint32_t last = termBlocks[id + 1];
+        if (first == last) {
+            continue;
+        }
+        uint32_t lastOffset = skips[last - 1].dataOffset;
+        auto next = std::upper_bound(offsets.begin(), offsets.end(), lastOffset);
+        size_t end = next == offsets.end() ? segment.Data().size() : *next;
+        size_t postings = 0;
+        for (uint32_t block = first; block < last; ++block) {
+            postings += skips[block].count;
+        }
+        visit(term.Term(), postings,
+              end - skips[first].dataOffset + (last - first) * sizeof(SkipEntry));
+    }
+}
+
+}
+
+IndexMemoryUsage IndexSnapshot::MemoryUsage(size_t topTerms) const {
+    IndexMemoryUsage usage;
+    usage.segments = segments.size();
+
+    for (const auto& ref : segments) {
+        const IndexSegment& segment = *ref.segment;
+        const FrontCodedDictionary& terms = segment.Terms();
+        usage.dictionaryBytes += terms.UsedBytes();
+        if (terms.IsView()) {
+            usage.mappedBytes += terms.UsedBytes();
+        } else {
+            usage.heapBytes += terms.OwnedBytes();
+            usage.slackBytes += terms.OwnedBytes() - terms.UsedBytes();
+        }
+
+        addArray(segment.TermBlocks(), usage.postingsBytes, usage);
+        addArray(segment.Skips(), usage.postingsBytes, usage);
+        addArray(segment.Data(), usage.postingsBytes, usage);
+        addArray(segment.PositionOffsets(), usage.positionsBytes, usage);
+        addArray(segment.PositionData(), usage.positionsBytes, usage);
+        addArray(segment.Fuzzy().Buckets(), usage.fuzzyBytes, usage);
+        addArray(segment.Fuzzy().Keys(), usage.fuzzyBytes, usage);
+        addArray(segment.Fuzzy().Terms(), usage.fuzzyBytes, usage);
+        addArray(segment.DocIds(), usage.documentBytes, usage);
+        addArray(segment.DocLengths(), usage.documentBytes, usage);
+        if (ref.deleted) {
+            usage.deletedBytes += ref.deleted->MemoryBytes();
+            usage.heapBytes += ref.deleted->MemoryBytes();
+        }
+        usage.heapBytes += sizeof(IndexSegment);
+
+        usage.terms += segment.TermCount();
+        usage.postings += segment.PostingCount();
+    }
+
+    if (topTerms == 0) {
+        return usage;
+    }
+
+    // Слово может быть в нескольких сегментах - размеры складываются.
+    // Слова сегмента восстанавливаются из front coding по одному, поэтому
+    // строки копируются в таблицу
+    struct Footprint {
+        std::string term;
+        size_t postings;
+        size_t bytes;
+    };
+    std::vector<Footprint> footprints;
+    std::unordered_map<std::string, size_t> position;
+    for (const auto& ref : segments) {
+        forEachTermSize(*ref.segment, [&](std::string_view term, size_t postings, size_t bytes) {
+            auto [it, inserted] = position.emplace(std::string(term), footprints.size());
+            if (inserted) {
+                footprints.push_back({it->first, 0, 0});
+            }
+            footprints[it->second].postings += postings;
+            footprints[it->second].bytes += bytes;
+        });
+    }
+
+    size_t keep = std::min(topTerms, footprints.size());
+    std::partial_sort(footprints.begin(), footprints.begin() + static_cast<std::ptrdiff_t>(keep), footprints.end(),
+                      [](const Footprint& a, const Footprint& b) {
+                          return a.bytes != b.bytes ? a.bytes > b.bytes : a.term < b.term;
+                      });
+    for (size_t i = 0; i < keep; ++i) {
+        usage.largestTerms.push_back({std::move(footprints[i].term), footprints[i].postings, footprints[i].bytes});
+    }
+    return usage;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "IndexSegment.h"
+#include "MemoryUsage.h"
+
+// Битовое множество удаленных документов сегмента (tombstones).
+// Бит doc_id хранится по смещению doc_id - base, base - первый документ сегмента.
+class DeletedDocs {
+public:
+    DeletedDocs() = default;
+    explicit DeletedDocs(const IndexSegment& segment);
+
+    bool Contains(uint32_t doc_id) const {
+        if (doc_id < base) {
+            return false;
+        }
+        size_t bit = doc_id - base;
+        return bit / 64 < bits.size() && (bits[bit / 64] >> (bit % 64)) & 1u;
+    }
+
+    void Insert(uint32_t doc_id);
+    size_t Count() const { return count; }
+    size_t MemoryBytes() const { return bits.capacity() * sizeof(uint64_t); }
+
+private:
+    uint32_t base = 0;
+    std::vector<uint64_t> bits;
+    size_t count = 0;
+};
+
+// Сегмент в составе снимка вместе с его удалениями на момент снимка
+struct SegmentRef {
+    std::shared_ptr<const IndexSegment> segment;
+    std::shared_ptr<const DeletedDocs> deleted;   // nullptr - удалений нет
+
+    bool IsLive(uint32_t doc_id) const { return !deleted || !deleted->Contains(doc_id); }
+    size_t LiveDocumentCount() const {
+        return segment->DocumentCount() - (deleted ? deleted->Count() : 0);
+    }
+};
+
+// Слова индекса, подходящие под шаблон или близкие к слову запроса
+// (см. IndexSnapshot::ExpandPattern и ExpandFuzzy). Строки лежат подряд
+// в pool; буфер переиспользуется между запросами
+struct PatternExpansion {
+    struct Match {
+        size_t offset;          // начало слова в pool
+        size_t length;
+        size_t frequency;       // число постингов слова во всех сегментах
+    };
+
+    std::string pool;
+    std::vector<Match> matches;
+    size_t total = 0;           // подходящих слов до ограничения
+    uint32_t distance = 0;      // нечеткое раскрытие: расстояние правки до его слов
+
+    // Рабочие буферы нечеткого раскрытия
+    std::vector<uint32_t> variants;
+    std::vector<uint32_t> candidates;
+    std::string term;
+
+    size_t Size() const { return matches.size(); }
+    // Склеивает повторы слов (merge - слова могли прийти из разных сегментов
+    // или шардов, их частоты складываются) и оставляет limit (0 - без
+    // ограничения) самых частых слов по возрастанию
+    void Select(size_t limit, bool merge = true);
+    std::string_view Term(size_t i) const {
+        return std::string_view(pool).substr(matches[i].offset, matches[i].length);
+    }
+    void Clear() {
+        pool.clear();
+        matches.clear();
+        total = 0;
+        distance = 0;
+    }
+};
+
+// Неизменяемый снимок индекса: набор сегментов с их удалениями.
+// Каждый живой документ находится ровно в одном сегменте.
+// После публикации снимок только читается, поэтому чтение не требует блокировок.
+class IndexSnapshot {
+public:
+    IndexSnapshot() = default;
+    IndexSnapshot(std::vector<SegmentRef> segments, uint32_t documentCount, uint64_t generation = 0)
+        : segments(std::move(segments)), documentCount(documentCount), generation(generation) {
+        computeStatistics();
+    };
+
+    const std::vector<SegmentRef>& Segments() const { return segments; }
+
+    // Граница пространства doc_id (все выданные doc_id меньше нее)
+    uint32_t DocumentCount() const { return documentCount; }
+
+    // Поколение содержимого индекса: меняется при каждом изменении набора
+    // документов и не меняется при слиянии сегментов. Уникально среди всех
+    // индексов процесса (0 - пустой индекс без публикаций)
+    uint64_t Generation() const { return generation; }
+
+    // Статистика коллекции для BM25, считается один раз при публикации:
+    // число живых документов и сумма их длин в словах
+    size_t LiveDocumentCount() const { return liveDocuments; }
+    uint64_t TotalLength() const { return totalLength; }
+    double AverageLength() const {
+        return liveDocuments == 0 ? 0.0 : static_cast<double>(totalLength) / static_cast<double>(liveDocuments);
+    }
+
+    // Постинги слова по всем сегментам без удаленных документов, по возрастанию doc_id
+    std::vector<Posting> CollectPostings(std::string_view word) const;
+
+    // Раскрытие шаблона слова (см. WordPattern): в словаре каждого сегмента
+    // просматривается только диапазон слов с литеральным префиксом шаблона.
+    // Если подходящих слов больше limit (0 - без ограничения), остаются limit
+    // самых частых. Результат - различные слова по возрастанию
+    void ExpandPattern(std::string_view pattern, size_t limit, PatternExpansion& expansion) const;
+
+    // Нечеткое раскрытие: слова индекса на расстоянии правки от 1 до distance
+    // от word (FuzzyIndex::Distance). Кандидаты берутся из индексов удалений
+    // сегментов, поэтому в сегменте без индекса слова не ищутся. Остаются
+    // только ближайшие из найденных слов (их расстояние - expansion.distance),
+    // из них не больше limit самых частых. Результат - различные слова по возрастанию
+    void ExpandFuzzy(std::string_view word, uint32_t distance, size_t limit, PatternExpansion& expansion) const;
+
+    // Память снимка по составляющим; topTerms > 0 - еще и столько самых
+    // больших постинг-листов (требует прохода по всем словам)
+    IndexMemoryUsage MemoryUsage(size_t topTerms = 0) const;
+
+private:
+    std::vector<SegmentRef> segments;
+    uint32_t documentCount = 0;
+    uint64_t generation = 0;
+    size_t liveDocuments = 0;
+    uint64_t totalLength = 0;
+
+    void computeStatistics();
+};
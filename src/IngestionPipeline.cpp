@@ -0,0 +1,122 @@
+#include "IngestionPipeline.h"
+#include "BoundedQueue.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <utility>
+
+namespace {
+
+constexpr size_t READ_CHUNK = size_t(1) << 20;
+
+}
+
+IngestionPipeline::IngestionPipeline(InvertedIndex& index, size_t memoryBudget) : index(index) {
+    if (memoryBudget == 0) {
+        memoryBudget = DEFAULT_MEMORY_BUDGET;
+    }
+    readAheadBytes = std::max<size_t>(1, memoryBudget / 2);
+    batchBytes = std::max<size_t>(1, memoryBudget - readAheadBytes);
+}
+
+std::string IngestionPipeline::readFile(const std::string& path) {
+    SE_METRICS_TIMER(ReadDocuments);
+    std::string content;
+    std::ifstream file;
+    if (!path.empty()) {
+        file.open(path, std::ios::binary);
+    }
+    if (!file.is_open()) {
+        std::cerr << "⚠️  Warning: Cannot open file " << (path.empty() ? "(not found)" : path) << std::endl;
+        return content;
+    }
+
+    // Чтение кусками: размер файла может измениться между stat и чтением
+    while (file) {
+        size_t at = content.size();
+        content.resize(at + READ_CHUNK);
+        file.read(content.data() + at, static_cast<std::streamsize>(READ_CHUNK));
+        content.resize(at + static_cast<size_t>(file.gcount()));
+    }
+    content.shrink_to_fit();
+    SE_METRICS_ADD(BytesRead, content.size());
+    return content;
+}
+
+void IngestionPipeline::ReadFiles(const std::vector<std::string>& paths, size_t readAheadBytes,
+                                  const std::function<void(std::string&&)>& consume) {
+    BoundedQueue<std::string> queue(readAheadBytes);
+    std::exception_ptr readError;
+
+    // Стадия чтения: файлы читаются по порядку, порядок задает doc_id
+    std::thread reader([&]() {
+        try {
+            for (const auto& path : paths) {
+                std::string text = readFile(path);
+                size_t cost = text.size();
+                if (!queue.Push(std::move(text), cost)) {
+                    break;
+                }
+            }
+        } catch (...) {
+            readError = std::current_exception();
+        }
+        queue.Close();
+    });
+
+    try {
+        std::string text;
+        while (queue.Pop(text)) {
+            consume(std::move(text));
+        }
+    } catch (...) {
+        queue.Close();
+        reader.join();
+        throw;
+    }
+
+    reader.join();
+    if (readError) {
+        std::rethrow_exception(readError);
+    }
+}
+
+size_t IngestionPipeline::Run(const std::vector<std::string>& paths) {
+    size_t indexed = 0;
+    bool first = true;
+    std::vector<std::string> batch;
+    size_t bytes = 0;
+
+    auto flush = [&]() {
+        // Первый пакет заменяет прежнюю базу, следующие дописываются новыми сегментами
+        indexed += batch.size();
+        if (first) {
+            index.UpdateDocumentBase(std::move(batch));
+            first = false;
+        } else {
+            index.AddDocuments(std::move(batch));
+        }
+        batch = std::vector<std::string>();
+        bytes = 0;
+    };
+
+    ReadFiles(paths, readAheadBytes, [&](std::string&& text) {
+        if (sink) {
+            sink(text);
+        }
+        bytes += text.size();
+        batch.push_back(std::move(text));
+        if (bytes >= batchBytes) {
+            flush();
+        }
+    });
+    if (!batch.empty() || first) {
+        flush();
+    }
+
+    index.WaitForMerges();
+    return indexed;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include "InvertedIndex.h"
+
+// Потоковая загрузка документов в индекс с ограниченной памятью.
+// Стадии работают одновременно и связаны очередями с ограничением по байтам:
+//   чтение файлов (отдельный поток, читает вперед, пока есть место в очереди)
+//   -> сборка пакета документов -> разбор на слова и построение сегмента
+//      на пуле потоков индекса (InvertedIndex::AddDocuments).
+// Текст пакета освобождается сразу после построения его сегмента, поэтому
+// кроме самого индекса в памяти находится не больше memoryBudget байт текста.
+class IngestionPipeline {
+public:
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t(64) << 20;
+
+    // memoryBudget == 0 - DEFAULT_MEMORY_BUDGET. Половина бюджета отводится
+    // очереди чтения, половина - пакету, который сейчас индексируется.
+    explicit IngestionPipeline(InvertedIndex& index, size_t memoryBudget = 0);
+
+    // Заменяет базу документов индекса содержимым файлов: файл paths[i]
+    // получает doc_id i. Пустой путь или нечитаемый файл - пустой документ.
+    // Возвращает число документов.
+    size_t Run(const std::vector<std::string>& paths);
+
+    // Что еще сделать с текстом каждого документа до его индексации, по
+    // порядку doc_id (например, записать в DocumentStore). Вызывается на потоке Run
+    void SetDocumentSink(std::function<void(const std::string&)> sink) { this->sink = std::move(sink); }
+
+    // Стадия чтения отдельно: файлы читаются в фоновом потоке не дальше чем
+    // на readAheadBytes вперед, consume получает тексты по порядку на
+    // вызывающем потоке. Используется и для построения вне памяти (SpimiBuilder).
+    static void ReadFiles(const std::vector<std::string>& paths, size_t readAheadBytes,
+                          const std::function<void(std::string&&)>& consume);
+
+private:
+    InvertedIndex& index;
+    size_t readAheadBytes;
+    size_t batchBytes;
+    std::function<void(const std::string&)> sink;
+
+    static std::string readFile(const std::string& path);
+};
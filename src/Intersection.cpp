@@ -0,0 +1,133 @@
+#include "Intersection.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define INTERSECTION_SSE2 1
+#endif
+
+size_t Intersection::Linear(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                            uint32_t* matchA, uint32_t* matchB) {
+    size_t i = 0, j = 0, found = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            ++i;
+        } else if (a[i] > b[j]) {
+            ++j;
+        } else {
+            matchA[found] = static_cast<uint32_t>(i++);
+            matchB[found] = static_cast<uint32_t>(j++);
+            ++found;
+        }
+    }
+    return found;
+}
+
+size_t Intersection::Galloping(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                               uint32_t* matchA, uint32_t* matchB) {
+    size_t j = 0, found = 0;
+    for (size_t i = 0; i < na && j < nb; ++i) {
+        uint32_t target = a[i];
+        if (b[j] < target) {
+            // Разгон: шаг удваивается, пока не перепрыгнем target
+            size_t step = 1;
+            size_t low = j;
+            size_t high = j + 1;
+            while (high < nb && b[high] < target) {
+                low = high;
+                step *= 2;
+                high = j + step;
+            }
+            high = std::min(high, nb);
+            j = static_cast<size_t>(std::lower_bound(b + low + 1, b + high, target) - b);
+            if (j == nb) {
+                break;
+            }
+        }
+        if (b[j] == target) {
+            matchA[found] = static_cast<uint32_t>(i);
+            matchB[found] = static_cast<uint32_t>(j);
+            ++found;
+            ++j;
+        }
+    }
+    return found;
+}
+
+size_t Intersection::Simd(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                          uint32_t* matchA, uint32_t* matchB) {
+    size_t i = 0, j = 0, found = 0;
+#ifdef INTERSECTION_SSE2
+    // Блок из 4 элементов a сравнивается со всеми 4 циклическими сдвигами блока b
+    while (i + 4 <= na && j + 4 <= nb) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+        __m128i equal = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(equal));
+
+        while (mask != 0) {
+            int lane = 0;
+            while (((mask >> lane) & 1) == 0) {
+                ++lane;
+            }
+            mask &= mask - 1;
+            uint32_t value = a[i + lane];
+            size_t k = 0;
+            while (b[j + k] != value) {
+                ++k;
+            }
+            matchA[found] = static_cast<uint32_t>(i + lane);
+            matchB[found] = static_cast<uint32_t>(j + k);
+            ++found;
+        }
+
+        uint32_t lastA = a[i + 3];
+        uint32_t lastB = b[j + 3];
+        if (lastA <= lastB) {
+            i += 4;
+        }
+        if (lastB <= lastA) {
+            j += 4;
+        }
+    }
+#endif
+    // Хвосты досчитываются слиянием
+    size_t rest = Linear(a + i, na - i, b + j, nb - j, matchA + found, matchB + found);
+    for (size_t k = found; k < found + rest; ++k) {
+        matchA[k] += static_cast<uint32_t>(i);
+        matchB[k] += static_cast<uint32_t>(j);
+    }
+    return found + rest;
+}
+
+Intersection::Kernel Intersection::Choose(size_t na, size_t nb) {
+    size_t shorter = std::min(na, nb);
+    size_t longer = std::max(na, nb);
+    if (shorter * GALLOPING_RATIO <= longer) {
+        return Kernel::Galloping;
+    }
+#ifdef INTERSECTION_SSE2
+    if (shorter >= 8) {
+        return Kernel::Simd;
+    }
+#endif
+    return Kernel::Linear;
+}
+
+size_t Intersection::Intersect(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                               uint32_t* matchA, uint32_t* matchB) {
+    switch (Choose(na, nb)) {
+        case Kernel::Galloping:
+            // Галоп всегда ищет элементы короткого списка в длинном
+            return na <= nb ? Galloping(a, na, b, nb, matchA, matchB)
+                            : Galloping(b, nb, a, na, matchB, matchA);
+        case Kernel::Simd:
+            return Simd(a, na, b, nb, matchA, matchB);
+        default:
+            return Linear(a, na, b, nb, matchA, matchB);
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Ядра пересечения отсортированных массивов doc_id без повторов.
+// Каждое ядро записывает позиции совпавших элементов в обоих массивах
+// (matchA[k], matchB[k]) и возвращает число совпадений. Буферы позиций
+// должны вмещать min(na, nb) элементов. Ядра не выделяют память.
+class Intersection {
+public:
+    enum class Kernel {
+        Linear,      // слияние двумя указателями - списки сравнимой длины
+        Galloping,   // экспоненциальный поиск элементов короткого списка в длинном
+        Simd         // сравнение блоков 4x4 в SSE-регистрах
+    };
+
+    static size_t Linear(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                         uint32_t* matchA, uint32_t* matchB);
+    // a - короткий список, b - длинный
+    static size_t Galloping(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                            uint32_t* matchA, uint32_t* matchB);
+    static size_t Simd(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                       uint32_t* matchA, uint32_t* matchB);
+
+    // Выбор ядра по соотношению длин списков
+    static Kernel Choose(size_t na, size_t nb);
+    static size_t Intersect(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                            uint32_t* matchA, uint32_t* matchB);
+
+    // Во сколько раз длинный список должен превосходить короткий для галопа
+    static constexpr size_t GALLOPING_RATIO = 16;
+};
@@ -1,62 +1,764 @@
 #include "InvertedIndex.h"
-#include <sstream>
+#include "IndexFile.h"
+#include "Metrics.h"
+#include <atomic>
 #include <algorithm>
-#include <thread>
+#include <functional>
+#include <map>
+#include <stdexcept>
 #include <vector>
 
+InvertedIndex::~InvertedIndex() {
+    {
+        std::lock_guard<std::mutex> lock(merge_mutex);
+        stopMerging = true;
+    }
+    merge_cv.notify_all();
+    if (mergeThread.joinable()) {
+        mergeThread.join();
+    }
+}
+
 void InvertedIndex::UpdateDocumentBase(std::vector<std::string> input_docs) {
-    docs = std::move(input_docs);
-    freq_dictionary.clear();
-    
-    std::vector<std::thread> threads;
-    for (size_t i = 0; i < docs.size(); ++i) {
-        threads.emplace_back(&InvertedIndex::indexDocument, this, i, std::ref(docs[i]));
+    if (input_docs.size() >= UINT32_MAX) {
+        throw std::length_error("too many documents for 32-bit doc_id");
+    }
+
+    SE_METRICS_TIMER(UpdateDocumentBase);
+    std::lock_guard<std::mutex> lock(update_mutex);
+
+    std::vector<uint32_t> docIds(input_docs.size());
+    for (size_t i = 0; i < docIds.size(); ++i) {
+        docIds[i] = static_cast<uint32_t>(i);
+    }
+
+    std::vector<SegmentRef> segments;
+    auto segment = buildSegment(std::move(docIds), input_docs);
+    if (segment->DocumentCount() > 0) {
+        segments.push_back({std::move(segment), nullptr});
+    }
+    enforceMemoryBudget(segments);
+
+    documentCount = input_docs.size();
+    publish(std::move(segments));
+}
+
+std::vector<size_t> InvertedIndex::AddDocuments(std::vector<std::string> input_docs) {
+    std::vector<size_t> assigned;
+    if (input_docs.empty()) {
+        return assigned;
+    }
+
+    std::lock_guard<std::mutex> lock(update_mutex);
+    if (documentCount + input_docs.size() >= UINT32_MAX) {
+        throw std::length_error("too many documents for 32-bit doc_id");
+    }
+
+    std::vector<uint32_t> docIds;
+    for (size_t i = 0; i < input_docs.size(); ++i) {
+        docIds.push_back(static_cast<uint32_t>(documentCount + i));
+        assigned.push_back(documentCount + i);
+    }
+
+    std::vector<SegmentRef> segments = GetSnapshot()->Segments();
+    segments.push_back({buildSegment(std::move(docIds), input_docs), nullptr});
+    enforceMemoryBudget(segments);
+
+    documentCount += input_docs.size();
+    publish(std::move(segments));
+    requestMerge();
+    return assigned;
+}
+
+void InvertedIndex::RemoveDocuments(const std::vector<size_t>& doc_ids) {
+    std::lock_guard<std::mutex> lock(update_mutex);
+    std::vector<SegmentRef> segments = GetSnapshot()->Segments();
+    for (size_t doc_id : doc_ids) {
+        if (doc_id >= documentCount) {
+            continue;
+        }
+        removeDocument(static_cast<uint32_t>(doc_id), segments);
+    }
+    publish(std::move(segments));
+    requestMerge();
+}
+
+void InvertedIndex::ReplaceDocument(size_t doc_id, std::string text) {
+    std::lock_guard<std::mutex> lock(update_mutex);
+    if (doc_id >= documentCount) {
+        throw std::out_of_range("ReplaceDocument: unknown doc_id " + std::to_string(doc_id));
+    }
+
+    // Новая версия получает тот же doc_id и живет в новом сегменте
+    std::vector<SegmentRef> segments = GetSnapshot()->Segments();
+    removeDocument(static_cast<uint32_t>(doc_id), segments);
+    segments.push_back({buildSegment({static_cast<uint32_t>(doc_id)}, {std::move(text)}), nullptr});
+    enforceMemoryBudget(segments);
+    publish(std::move(segments));
+    requestMerge();
+}
+
+void InvertedIndex::SetPositional(bool enabled) {
+    std::lock_guard<std::mutex> lock(update_mutex);
+    positional = enabled;
+}
+
+void InvertedIndex::SetFuzzyDistance(uint32_t distance) {
+    if (distance > FuzzyIndex::MAX_DISTANCE) {
+        throw std::invalid_argument("fuzzy distance must not exceed " + std::to_string(FuzzyIndex::MAX_DISTANCE));
+    }
+    std::lock_guard<std::mutex> lock(update_mutex);
+    fuzzyDistance = distance;
+}
+
+void InvertedIndex::SetMergeFactor(size_t factor) {
+    std::lock_guard<std::mutex> lock(merge_mutex);
+    mergeFactor = std::max<size_t>(2, factor);
+}
+
+void InvertedIndex::WaitForMerges() {
+    std::unique_lock<std::mutex> lock(merge_mutex);
+    merge_cv.wait(lock, [this]() { return !mergeRequested && !merging; });
+}
+
+void InvertedIndex::SaveIndex(const std::string& path, uint64_t fingerprint) {
+    auto current = GetSnapshot();
+    const auto& segments = current->Segments();
+
+    // В файл пишется один сегмент без удаленных документов
+    if (segments.size() == 1 && !segments[0].deleted) {
+        IndexFile::Write(path, *segments[0].segment, current->DocumentCount(), fingerprint);
+    } else {
+        auto merged = mergeSegments(segments);
+        IndexFile::Write(path, *merged, current->DocumentCount(), fingerprint);
+    }
+}
+
+bool InvertedIndex::LoadIndex(const std::string& path, uint64_t fingerprint, bool verify) {
+    uint32_t fileDocumentCount = 0;
+    auto segment = IndexFile::Read(path, fingerprint, fileDocumentCount, verify);
+    if (!segment) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(update_mutex);
+    if (positional && segment->PostingCount() > 0 && !segment->HasPositions()) {
+        // Файл построен без позиций - фразы по нему не проверить
+        return false;
+    }
+    if (segment->Fuzzy().MaxDistance() < fuzzyDistance && segment->TermCount() > 0) {
+        // Индекс удалений файла не найдет слова на нужном расстоянии
+        return false;
+    }
+    // Тексты документов в файле не хранятся, известна только граница doc_id
+    documentCount = fileDocumentCount;
+
+    std::vector<SegmentRef> segments;
+    if (segment->DocumentCount() > 0) {
+        segments.push_back({std::move(segment), nullptr});
+    }
+    publish(std::move(segments));
+    return true;
+}
+
+size_t InvertedIndex::GetDocumentCount() const {
+    return GetSnapshot()->DocumentCount();
+}
+
+IndexMemoryUsage InvertedIndex::GetMemoryUsage(size_t topTerms) const {
+    IndexMemoryUsage usage = GetSnapshot()->MemoryUsage(topTerms);
+    if (auto store = GetDocumentStore()) {
+        size_t cached = store->GetCacheStats().bytes;
+        usage.storedTextBytes += cached;
+        usage.heapBytes += cached;
+    }
+    return usage;
+}
+
+void InvertedIndex::SetDocumentStore(std::shared_ptr<const DocumentStore> store) {
+    std::atomic_store(&documentStore, std::move(store));
+}
+
+std::shared_ptr<const DocumentStore> InvertedIndex::GetDocumentStore() const {
+    return std::atomic_load(&documentStore);
+}
+
+void InvertedIndex::SetMemoryBudget(size_t bytes, MemoryPolicy policy) {
+    std::lock_guard<std::mutex> lock(update_mutex);
+    memoryBudget = bytes;
+    memoryPolicy = policy;
+}
+
+void InvertedIndex::enforceMemoryBudget(std::vector<SegmentRef>& segments) const {
+    if (memoryBudget == 0) {
+        return;
     }
-    
-    for (auto& thread : threads) {
-        thread.join();
+    size_t used = IndexSnapshot(segments, 0).MemoryUsage().heapBytes;
+    if (used <= memoryBudget) {
+        return;
     }
-    
-    // ДОБАВИТЬ: сортировка всех векторов в freq_dictionary по doc_id
-    for (auto& [word, entries] : freq_dictionary) {
-        std::sort(entries.begin(), entries.end(), 
-            [](const Entry& a, const Entry& b) {
-                return a.doc_id < b.doc_id;
-            });
+
+    if (memoryPolicy == MemoryPolicy::Compact) {
+        // Сегменты в куче сливаются в один: уходят повторы слов в словарях
+        // разных сегментов, постинги удаленных документов и запас емкости.
+        // Сегменты из отображенного файла не трогаем - слияние перенесло бы их в кучу
+        std::vector<SegmentRef> heap;
+        std::vector<SegmentRef> kept;
+        for (auto& ref : segments) {
+            (ref.segment->Data().IsView() ? kept : heap).push_back(std::move(ref));
+        }
+        if (heap.size() > 1 || (heap.size() == 1 && heap[0].deleted)) {
+            auto merged = mergeSegments(heap);
+            heap.clear();
+            if (merged->DocumentCount() > 0) {
+                heap.push_back({std::move(merged), nullptr});
+            }
+        }
+        segments = std::move(kept);
+        segments.insert(segments.end(), heap.begin(), heap.end());
+
+        used = IndexSnapshot(segments, 0).MemoryUsage().heapBytes;
+        if (used <= memoryBudget) {
+            return;
+        }
     }
+
+    throw MemoryBudgetError("index needs " + std::to_string(used / 1024) + " KiB, memory budget is " +
+                            std::to_string(memoryBudget / 1024) + " KiB");
+}
+
+std::shared_ptr<const IndexSnapshot> InvertedIndex::GetSnapshot() const {
+    return std::atomic_load(&snapshot);
 }
 
 std::vector<Entry> InvertedIndex::GetWordCount(const std::string& word) {
-    std::lock_guard<std::mutex> lock(dict_mutex);
-    auto it = freq_dictionary.find(word);
-    if (it != freq_dictionary.end()) {
-        // Теперь вектор гарантированно отсортирован по doc_id
-        return it->second;
-    }
-    return {};
-}
-
-void InvertedIndex::indexDocument(size_t doc_id, const std::string& text) {
-    std::stringstream ss(text);
-    std::string word;
-    std::map<std::string, size_t> wordCount;
-    
-    while (ss >> word) {
-        if (word.length() > 100) continue;
-        ++wordCount[word];
-    }
-    
-    std::lock_guard<std::mutex> lock(dict_mutex);
-    for (const auto& [word, count] : wordCount) {
-        auto& entries = freq_dictionary[word];
-        auto it = std::find_if(entries.begin(), entries.end(),
-            [doc_id](const Entry& entry) { return entry.doc_id == doc_id; });
-        
-        if (it != entries.end()) {
-            it->count = count;
+    SE_METRICS_TIMER(GetWordCount);
+    std::vector<Entry> result;
+    auto current = GetSnapshot();
+    for (const Posting& posting : current->CollectPostings(Tokenizer::Normalize(word))) {
+        result.push_back({posting.doc_id, posting.count});
+    }
+    return result;
+}
+
+void InvertedIndex::publish(std::vector<SegmentRef> segments, bool contentChanged) {
+    if (contentChanged) {
+        // Счетчик общий для всех индексов процесса: после подмены индекса
+        // в SearchServer (горячая перезагрузка) поколения не повторяются,
+        // и кэш запросов не выдаст результат старого индекса
+        static std::atomic<uint64_t> nextGeneration{1};
+        generation = nextGeneration.fetch_add(1);
+    }
+    auto fresh = std::make_shared<const IndexSnapshot>(std::move(segments), static_cast<uint32_t>(documentCount),
+                                                       generation);
+    std::atomic_store(&snapshot, std::move(fresh));
+}
+
+void InvertedIndex::removeDocument(uint32_t doc_id, std::vector<SegmentRef>& segments) {
+    for (auto& ref : segments) {
+        if (!ref.IsLive(doc_id) || !ref.segment->ContainsDocument(doc_id)) {
+            continue;
+        }
+        // Копирование при записи: читатели старого снимка видят прежние удаления
+        auto deleted = ref.deleted ? std::make_shared<DeletedDocs>(*ref.deleted)
+                                   : std::make_shared<DeletedDocs>(*ref.segment);
+        deleted->Insert(doc_id);
+        ref.deleted = std::move(deleted);
+        return;
+    }
+}
+
+std::shared_ptr<const IndexSegment> InvertedIndex::buildSegment(std::vector<uint32_t> docIds,
+                                                                const std::vector<std::string>& texts) {
+    if (!pool) {
+        pool = std::make_unique<ThreadPool>(indexingThreads);
+    }
+
+    // Каждый поток получает непрерывный диапазон doc_id, поэтому
+    // склейка частичных списков в порядке потоков сразу дает сортировку по doc_id
+    size_t workers = std::max<size_t>(1, std::min(pool->Size(), docIds.size()));
+    size_t chunk = (docIds.size() + workers - 1) / workers;
+
+    // Каждый поток копит постинги в своей арене и сразу раскладывает
+    // свои слова по секциям слияния
+    std::vector<PostingsAccumulator> parts(workers);
+    for (auto& part : parts) {
+        part.SetPositional(positional);
+    }
+    std::vector<std::vector<std::vector<uint32_t>>> partitions(workers);
+    std::vector<uint32_t> docLengths(docIds.size());
+    pool->ParallelFor(workers, [&](size_t w) {
+        size_t begin = std::min(docIds.size(), w * chunk);
+        size_t end = std::min(docIds.size(), begin + chunk);
+        partitions[w].resize(workers);
+        indexRange(docIds, texts, docLengths, begin, end, parts[w], partitions[w]);
+    });
+
+    // Параллельное слияние: секция p собирает ссылки на свои слова из всех
+    // потоков. Ссылки раскладываются по словам подсчетом, порядок потоков
+    // внутри слова сохраняется - это и есть порядок doc_id
+    std::vector<Section> sections(workers);
+    pool->ParallelFor(workers, [&](size_t p) {
+        Section& section = sections[p];
+        TermDictionary terms;
+        std::vector<std::pair<uint32_t, SectionRef>> found;
+        for (uint32_t w = 0; w < workers; ++w) {
+            for (uint32_t id : partitions[w][p]) {
+                found.push_back({terms.Insert(parts[w].Term(id)), {w, id}});
+            }
+        }
+        section.start.assign(terms.Size() + 1, 0);
+        for (const auto& [term, ref] : found) {
+            ++section.start[term + 1];
+        }
+        for (size_t term = 0; term < terms.Size(); ++term) {
+            section.start[term + 1] += section.start[term];
+        }
+        std::vector<size_t> next(section.start.begin(), section.start.end() - 1);
+        section.refs.resize(found.size());
+        for (const auto& [term, ref] : found) {
+            section.refs[next[term]++] = ref;
+        }
+    });
+    partitions.clear();
+
+    return freezeSections(parts, sections, std::move(docIds), std::move(docLengths), fuzzyDistance, pool.get());
+}
+
+std::shared_ptr<const IndexSegment> InvertedIndex::freezeSections(const std::vector<PostingsAccumulator>& parts,
+                                                                  const std::vector<Section>& sections,
+                                                                  std::vector<uint32_t> docIds,
+                                                                  std::vector<uint32_t> docLengths,
+                                                                  uint32_t fuzzyDistance, ThreadPool* pool) {
+    // Слова каждой секции сортируются параллельно, заодно считаются
+    // размеры их списков и первый блок слова внутри секции
+    struct SectionOrder {
+        std::vector<uint32_t> terms;        // локальные номера слов по возрастанию
+        std::vector<size_t> sizes;          // число постингов слова
+        std::vector<uint32_t> firstBlock;   // первый блок слова в блоках секции
+    };
+    std::vector<SectionOrder> orders(sections.size());
+    auto termOf = [&](size_t p, uint32_t term) {
+        const SectionRef& head = sections[p].refs[sections[p].start[term]];
+        return parts[head.part].Term(head.term);
+    };
+    auto orderSection = [&](size_t p) {
+        const Section& section = sections[p];
+        SectionOrder& order = orders[p];
+        size_t count = section.start.size() - 1;
+        order.terms.resize(count);
+        order.sizes.resize(count);
+        order.firstBlock.resize(count + 1);
+        size_t blocks = 0;
+        for (uint32_t term = 0; term < count; ++term) {
+            order.terms[term] = term;
+            size_t size = 0;
+            for (size_t r = section.start[term]; r < section.start[term + 1]; ++r) {
+                size += parts[section.refs[r].part].PostingCount(section.refs[r].term);
+            }
+            order.sizes[term] = size;
+            order.firstBlock[term] = static_cast<uint32_t>(blocks);
+            blocks += (size + PostingsCodec::BLOCK_SIZE - 1) / PostingsCodec::BLOCK_SIZE;
+        }
+        order.firstBlock[count] = static_cast<uint32_t>(blocks);
+        std::sort(order.terms.begin(), order.terms.end(),
+                  [&](uint32_t a, uint32_t b) { return termOf(p, a) < termOf(p, b); });
+    };
+    if (pool) {
+        pool->ParallelFor(sections.size(), orderSection);
+    } else {
+        for (size_t p = 0; p < sections.size(); ++p) {
+            orderSection(p);
+        }
+    }
+
+    // Слияние отсортированных секций дает term id - ранг слова; каждое слово
+    // лежит ровно в одной секции. Число блоков каждого слова известно
+    // заранее, поэтому таблица termBlocks строится до сжатия
+    size_t termCount = 0;
+    for (const auto& section : sections) {
+        termCount += section.start.size() - 1;
+    }
+
+    struct Placement {
+        uint32_t section;
+        uint32_t term;      // локальный номер слова в секции
+    };
+    FrontCodedDictionary::Builder dictionary;
+    std::vector<Placement> global;
+    global.reserve(termCount);
+    std::vector<uint32_t> termBlocks;
+    termBlocks.reserve(termCount + 1);
+    termBlocks.push_back(0);
+
+    size_t totalBlocks = 0;
+    size_t postingCount = 0;
+    std::vector<size_t> cursor(sections.size(), 0);
+    while (global.size() < termCount) {
+        size_t best = sections.size();
+        for (size_t p = 0; p < sections.size(); ++p) {
+            if (cursor[p] < orders[p].terms.size() &&
+                (best == sections.size() ||
+                 termOf(p, orders[p].terms[cursor[p]]) < termOf(best, orders[best].terms[cursor[best]]))) {
+                best = p;
+            }
+        }
+        uint32_t term = orders[best].terms[cursor[best]++];
+        dictionary.Add(termOf(best, term));
+        global.push_back({static_cast<uint32_t>(best), term});
+        size_t size = orders[best].sizes[term];
+        postingCount += size;
+        totalBlocks += (size + PostingsCodec::BLOCK_SIZE - 1) / PostingsCodec::BLOCK_SIZE;
+        if (totalBlocks >= UINT32_MAX) {
+            throw std::length_error("too many postings blocks for 32-bit offsets");
+        }
+        termBlocks.push_back(static_cast<uint32_t>(totalBlocks));
+    }
+
+    // Длины документов по doc_id для границ блоков. Сегмент после слияния
+    // может иметь пропуски в doc_id - тогда таблица разворачивается на весь диапазон
+    DocLengthTable lengths;
+    std::vector<uint32_t> spread;
+    if (!docIds.empty()) {
+        lengths.base = docIds.front();
+        if (docIds.back() - docIds.front() + 1 == docIds.size()) {
+            lengths.lengths = docLengths.data();
         } else {
-            entries.push_back({doc_id, count});
+            spread.assign(docIds.back() - docIds.front() + 1, 0);
+            for (size_t i = 0; i < docIds.size(); ++i) {
+                spread[docIds[i] - lengths.base] = docLengths[i];
+            }
+            lengths.lengths = spread.data();
+        }
+    }
+
+    // Сжатие идет по секциям параллельно, каждая секция пишет свои байты
+    bool positional = !parts.empty() && parts[0].Positional();
+    std::vector<SkipEntry> skips;
+    skips.reserve(totalBlocks);
+    std::vector<std::vector<SkipEntry>> sectionSkips(sections.size());
+    std::vector<std::vector<uint8_t>> sectionData(sections.size());
+    std::vector<std::vector<uint32_t>> sectionPositionOffsets(sections.size());
+    std::vector<std::vector<uint8_t>> sectionPositions(sections.size());
+    auto encodeSection = [&](size_t p) {
+        const Section& section = sections[p];
+        auto& blocks = sectionSkips[p];
+        blocks.reserve(orders[p].firstBlock.back());
+        // Список из одной части кодируется на месте, из нескольких - склеивается
+        // в буфер, который переиспользуется для всех слов секции
+        std::vector<Posting> joined;
+        std::vector<uint32_t> joinedPositions;
+        for (size_t term = 0; term + 1 < section.start.size(); ++term) {
+            size_t first = section.start[term];
+            size_t last = section.start[term + 1];
+            if (last - first == 1) {
+                const PostingsAccumulator& part = parts[section.refs[first].part];
+                uint32_t id = section.refs[first].term;
+                PostingsCodec::Encode(part.Postings(id), part.PostingCount(id), blocks, sectionData[p], 0, lengths);
+                if (positional) {
+                    PostingsCodec::EncodePositions(part.Postings(id), part.PostingCount(id), part.Positions(id),
+                                                   sectionPositionOffsets[p], sectionPositions[p]);
+                }
+                continue;
+            }
+            joined.clear();
+            joinedPositions.clear();
+            for (size_t r = first; r < last; ++r) {
+                const PostingsAccumulator& part = parts[section.refs[r].part];
+                uint32_t id = section.refs[r].term;
+                joined.insert(joined.end(), part.Postings(id), part.Postings(id) + part.PostingCount(id));
+                if (positional) {
+                    joinedPositions.insert(joinedPositions.end(), part.Positions(id),
+                                           part.Positions(id) + part.PositionCount(id));
+                }
+            }
+            PostingsCodec::Encode(joined.data(), joined.size(), blocks, sectionData[p], 0, lengths);
+            if (positional) {
+                PostingsCodec::EncodePositions(joined.data(), joined.size(), joinedPositions.data(),
+                                               sectionPositionOffsets[p], sectionPositions[p]);
+            }
+        }
+    };
+    if (pool) {
+        pool->ParallelFor(sections.size(), encodeSection);
+    } else {
+        for (size_t p = 0; p < sections.size(); ++p) {
+            encodeSection(p);
+        }
+    }
+
+    // Склейка секций со сдвигом смещений данных
+    size_t dataSize = 0;
+    for (const auto& bytes : sectionData) {
+        dataSize += bytes.size();
+    }
+    if (dataSize > UINT32_MAX) {
+        throw std::length_error("compressed postings exceed 4 GiB per segment");
+    }
+
+    std::vector<uint8_t> data;
+    data.reserve(dataSize);
+    std::vector<uint32_t> dataBase(sections.size());
+    for (size_t p = 0; p < sections.size(); ++p) {
+        dataBase[p] = static_cast<uint32_t>(data.size());
+        data.insert(data.end(), sectionData[p].begin(), sectionData[p].end());
+        std::vector<uint8_t>().swap(sectionData[p]);
+    }
+
+    // Позиции склеиваются так же
+    std::vector<uint32_t> positionOffsets;
+    std::vector<uint8_t> positions;
+    std::vector<uint32_t> positionBase(sections.size());
+    if (positional) {
+        size_t positionsSize = 0;
+        for (const auto& bytes : sectionPositions) {
+            positionsSize += bytes.size();
+        }
+        if (positionsSize > UINT32_MAX) {
+            throw std::length_error("positions exceed 4 GiB per segment");
         }
+        positions.reserve(positionsSize);
+        for (size_t p = 0; p < sections.size(); ++p) {
+            positionBase[p] = static_cast<uint32_t>(positions.size());
+            positions.insert(positions.end(), sectionPositions[p].begin(), sectionPositions[p].end());
+            std::vector<uint8_t>().swap(sectionPositions[p]);
+        }
+        positionOffsets.reserve(totalBlocks);
     }
+
+    // Блоки слов переставляются в порядке term id, смещения сдвигаются
+    // на начало данных своей секции
+    for (const Placement& place : global) {
+        uint32_t first = orders[place.section].firstBlock[place.term];
+        uint32_t last = orders[place.section].firstBlock[place.term + 1];
+        for (uint32_t block = first; block < last; ++block) {
+            SkipEntry entry = sectionSkips[place.section][block];
+            entry.dataOffset += dataBase[place.section];
+            skips.push_back(entry);
+            if (positional) {
+                positionOffsets.push_back(sectionPositionOffsets[place.section][block] + positionBase[place.section]);
+            }
+        }
+    }
+
+    FrontCodedDictionary terms = dictionary.Finish();
+    FuzzyIndex fuzzy = FuzzyIndex::Build(terms, fuzzyDistance);
+    return std::make_shared<const IndexSegment>(std::move(terms), std::move(termBlocks), std::move(skips),
+                                                std::move(data), postingCount,
+                                                std::move(docIds), std::move(docLengths),
+                                                std::move(positionOffsets), std::move(positions),
+                                                std::move(fuzzy));
 }
 
+std::shared_ptr<const IndexSegment> InvertedIndex::mergeSegments(const std::vector<SegmentRef>& sources) {
+    std::vector<std::pair<uint32_t, uint32_t>> liveDocs;
+    for (const auto& ref : sources) {
+        const auto& ids = ref.segment->DocIds();
+        const auto& lengths = ref.segment->DocLengths();
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (ref.IsLive(ids[i])) {
+                liveDocs.emplace_back(ids[i], lengths[i]);
+            }
+        }
+    }
+    std::sort(liveDocs.begin(), liveDocs.end());
+
+    std::vector<uint32_t> docIds(liveDocs.size());
+    std::vector<uint32_t> docLengths(liveDocs.size());
+    for (size_t i = 0; i < liveDocs.size(); ++i) {
+        docIds[i] = liveDocs[i].first;
+        docLengths[i] = liveDocs[i].second;
+    }
+
+    // Позиции переносятся, только если они есть во всех сегментах с постингами
+    // Индекс удалений - для наименьшего расстояния среди сегментов со словами
+    bool positional = true;
+    uint32_t fuzzyDistance = FuzzyIndex::MAX_DISTANCE;
+    for (const auto& ref : sources) {
+        positional = positional && (ref.segment->HasPositions() || ref.segment->PostingCount() == 0);
+        if (ref.segment->TermCount() > 0) {
+            fuzzyDistance = std::min(fuzzyDistance, ref.segment->Fuzzy().MaxDistance());
+        }
+    }
+
+    std::vector<PostingsAccumulator> parts(1);
+    PostingsAccumulator& merged = parts[0];
+    merged.SetPositional(positional);
+    std::vector<uint32_t> positions;
+    for (const auto& ref : sources) {
+        for (FrontCodedDictionary::Iterator term(ref.segment->Terms(), 0); term.Valid(); term.Next()) {
+            uint32_t target = PostingsAccumulator::npos;
+            for (PostingsCursor cursor(ref.segment->Postings(term.Id())); cursor.Valid(); cursor.Next()) {
+                if (!ref.IsLive(cursor.DocId())) {
+                    continue;
+                }
+                if (target == PostingsAccumulator::npos) {
+                    target = merged.Intern(term.Term());
+                }
+                if (positional) {
+                    cursor.Positions(positions);
+                }
+                merged.Append(target, {cursor.DocId(), cursor.Count()}, positions.data());
+            }
+        }
+    }
+    // Диапазоны doc_id сегментов могут пересекаться после замены документов
+    merged.Finish(true);
+
+    // Одна часть - одна секция со ссылкой на каждое слово
+    std::vector<Section> sections(1);
+    Section& section = sections[0];
+    section.start.resize(merged.TermCount() + 1);
+    section.refs.resize(merged.TermCount());
+    for (uint32_t id = 0; id < merged.TermCount(); ++id) {
+        section.start[id] = id;
+        section.refs[id] = {0, id};
+    }
+    section.start[merged.TermCount()] = merged.TermCount();
+
+    return freezeSections(parts, sections, std::move(docIds), std::move(docLengths), fuzzyDistance, nullptr);
+}
+
+void InvertedIndex::requestMerge() {
+    {
+        std::lock_guard<std::mutex> lock(merge_mutex);
+        mergeRequested = true;
+        if (!mergeThread.joinable()) {
+            mergeThread = std::thread(&InvertedIndex::mergeLoop, this);
+        }
+    }
+    merge_cv.notify_all();
+}
+
+void InvertedIndex::mergeLoop() {
+    std::unique_lock<std::mutex> lock(merge_mutex);
+    while (true) {
+        merge_cv.wait(lock, [this]() { return stopMerging || mergeRequested; });
+        if (stopMerging) {
+            return;
+        }
+        mergeRequested = false;
+        merging = true;
+        lock.unlock();
+
+        while (mergeOnce()) {
+            std::lock_guard<std::mutex> stopLock(merge_mutex);
+            if (stopMerging) {
+                break;
+            }
+        }
+
+        lock.lock();
+        merging = false;
+        merge_cv.notify_all();
+    }
+}
+
+bool InvertedIndex::mergeOnce() {
+    size_t factor;
+    {
+        std::lock_guard<std::mutex> lock(merge_mutex);
+        factor = mergeFactor;
+    }
+
+    // Многоуровневая политика: уровень сегмента - floor(log_factor(живых документов)).
+    // Сливаются factor сегментов самого нижнего переполненного уровня,
+    // а также сегменты, в которых не осталось живых документов.
+    auto base = GetSnapshot();
+    const auto& segments = base->Segments();
+    std::map<size_t, std::vector<size_t>> tiers;
+    std::vector<size_t> picked;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        size_t live = segments[i].LiveDocumentCount();
+        if (live == 0) {
+            picked.push_back(i);
+            continue;
+        }
+        size_t tier = 0;
+        for (; live >= factor; live /= factor) {
+            ++tier;
+        }
+        tiers[tier].push_back(i);
+    }
+    for (const auto& [tier, members] : tiers) {
+        if (members.size() >= factor) {
+            picked.insert(picked.end(), members.begin(), members.begin() + factor);
+            break;
+        }
+    }
+    if (picked.empty()) {
+        return false;
+    }
+
+    std::vector<SegmentRef> sources;
+    for (size_t i : picked) {
+        sources.push_back(segments[i]);
+    }
+    auto merged = mergeSegments(sources);
+
+    std::lock_guard<std::mutex> lock(update_mutex);
+    std::vector<SegmentRef> current = GetSnapshot()->Segments();
+    std::shared_ptr<DeletedDocs> lateDeletes;
+
+    for (const auto& source : sources) {
+        auto it = std::find_if(current.begin(), current.end(),
+            [&](const SegmentRef& ref) { return ref.segment == source.segment; });
+        if (it == current.end()) {
+            // Индекс перестроен во время слияния - результат устарел
+            return true;
+        }
+
+        // Удаления, пришедшие во время слияния, переносим в новый сегмент
+        if (it->deleted != source.deleted) {
+            for (uint32_t doc_id : source.segment->DocIds()) {
+                if (source.IsLive(doc_id) && !it->IsLive(doc_id)) {
+                    if (!lateDeletes) {
+                        lateDeletes = std::make_shared<DeletedDocs>(*merged);
+                    }
+                    lateDeletes->Insert(doc_id);
+                }
+            }
+        }
+        current.erase(it);
+    }
+
+    if (merged->DocumentCount() > 0) {
+        current.push_back({merged, lateDeletes});
+    }
+    publish(std::move(current), false);
+    return true;
+}
+
+void InvertedIndex::indexRange(const std::vector<uint32_t>& docIds, const std::vector<std::string>& texts,
+                               std::vector<uint32_t>& docLengths, size_t begin, size_t end,
+                               PostingsAccumulator& postings,
+                               std::vector<std::vector<uint32_t>>& partitions) const {
+    Tokenizer tokenizer;
+    for (size_t i = begin; i < end; ++i) {
+        docLengths[i] = indexDocument(docIds[i], texts[i], postings, tokenizer);
+    }
+    postings.Finish();
+
+    // Раскладываем слова по секциям слияния заранее, чтобы секции не сканировали чужие слова
+    for (uint32_t id = 0; id < postings.TermCount(); ++id) {
+        partitions[TermDictionary::Hash(postings.Term(id)) % partitions.size()].push_back(id);
+    }
+}
+
+uint32_t InvertedIndex::indexDocument(uint32_t doc_id, const std::string& text, PostingsAccumulator& postings,
+                                      Tokenizer& tokenizer) const {
+    SE_METRICS_TIMER(IndexDocument);
+    std::string_view word;
+    uint32_t length = 0;
+
+    // Слово интернируется в арене потока при первой встрече, дальше
+    // вхождение стоит одного поиска в хэш-таблице без выделения памяти
+    tokenizer.Reset(text);
+    while (tokenizer.Next(word)) {
+        postings.Add(postings.Intern(word), doc_id, length);
+        ++length;
+    }
+    SE_METRICS_ADD(DocumentsIndexed, 1);
+    SE_METRICS_ADD(TokensIndexed, length);
+    return length;
+}
@@ -2,8 +2,16 @@
 
 #include <string>
 #include <vector>
-#include <map>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <cstdint>
+#include "ThreadPool.h"
+#include "IndexSnapshot.h"
+#include "Tokenizer.h"
+#include "PostingsAccumulator.h"
+#include "DocumentStore.h"
 
 struct Entry {
     size_t doc_id, count;
@@ -15,15 +23,135 @@ struct Entry {
 
 class InvertedIndex {
 public:
-    InvertedIndex() = default;
+    // threadCount == 0 - число потоков индексации по числу ядер
+    explicit InvertedIndex(size_t threadCount = 0) : indexingThreads(threadCount) { };
+    ~InvertedIndex();
     
+    // Полная перестройка индекса: документы получают doc_id 0..n-1.
+    // Тексты нужны только на время индексации и после нее освобождаются.
     void UpdateDocumentBase(std::vector<std::string> input_docs);
+
+    // Инкрементальные изменения без полной перестройки.
+    // Новые документы попадают в новый небольшой сегмент, удаления отмечаются
+    // в tombstones сегментов, фоновое слияние уплотняет сегменты.
+    std::vector<size_t> AddDocuments(std::vector<std::string> input_docs);
+    void RemoveDocuments(const std::vector<size_t>& doc_ids);
+    void ReplaceDocument(size_t doc_id, std::string text);
+
+    // Позиционный индекс: хранить позиции слов для фразовых запросов
+    // (по умолчанию выключен). Действует на сегменты, построенные после вызова;
+    // LoadIndex не примет файл без позиций, если они включены
+    void SetPositional(bool enabled);
+
+    // Индекс удалений для нечеткого поиска слов на расстоянии правки до
+    // distance (0 - не строить, по умолчанию; не больше FuzzyIndex::MAX_DISTANCE).
+    // Как и позиции, действует на сегменты, построенные после вызова;
+    // LoadIndex не примет файл, индекс удалений которого построен для меньшего расстояния
+    void SetFuzzyDistance(uint32_t distance);
+
+    // Сколько сегментов одного уровня сливаются в один (не меньше 2)
+    void SetMergeFactor(size_t factor);
+    // Дождаться завершения всех запланированных слияний
+    void WaitForMerges();
+
+    // Сохранение индекса в файл и быстрое открытие через отображение в память.
+    // fingerprint - отпечаток набора исходных файлов (ConverterJSON::GetFilesFingerprint).
+    // LoadIndex возвращает false, если файла нет или он построен по другим файлам.
+    // Данные файла при открытии не читаются; verify - сначала проверить их
+    // контрольную сумму целиком (см. IndexFile::Read)
+    void SaveIndex(const std::string& path, uint64_t fingerprint);
+    bool LoadIndex(const std::string& path, uint64_t fingerprint, bool verify = false);
+
     std::vector<Entry> GetWordCount(const std::string& word);
 
+    // Граница пространства doc_id (число выданных doc_id, включая удаленные)
+    size_t GetDocumentCount() const;
+
+    // Память текущего снимка по составляющим; topTerms - сколько самых
+    // больших постинг-листов перечислить
+    IndexMemoryUsage GetMemoryUsage(size_t topTerms = 0) const;
+
+    // Бюджет памяти кучи под индекс (0 - без ограничения, по умолчанию).
+    // Проверяется до публикации нового содержимого (UpdateDocumentBase,
+    // AddDocuments, ReplaceDocument): если индекс не укладывается, изменение
+    // отклоняется исключением MemoryBudgetError, опубликованный индекс не
+    // меняется. Отображенный в память файл индекса в бюджет не входит.
+    void SetMemoryBudget(size_t bytes, MemoryPolicy policy = MemoryPolicy::Fail);
+
+    // Хранилище текстов документов для сниппетов (по умолчанию нет). Самому
+    // индексу тексты не нужны; хранилище держится при индексе, чтобы при
+    // горячей перезагрузке тексты сменились вместе с ним. Его кэш блоков
+    // входит в GetMemoryUsage (storedTextBytes), но не в бюджет памяти
+    void SetDocumentStore(std::shared_ptr<const DocumentStore> store);
+    std::shared_ptr<const DocumentStore> GetDocumentStore() const;
+
+    // Текущий опубликованный снимок. Держатель снимка может читать его
+    // без блокировок, пока не отпустит указатель.
+    std::shared_ptr<const IndexSnapshot> GetSnapshot() const;
+
 private:
-    std::vector<std::string> docs;
-    std::map<std::string, std::vector<Entry>> freq_dictionary;
-    std::mutex dict_mutex;
+    // Секция слияния: слова одной хэш-секции из частичных индексов всех
+    // потоков. Постинги не копируются - секция ссылается на списки потоков
+    struct SectionRef {
+        uint32_t part;      // номер частичного индекса
+        uint32_t term;      // term id в нем
+    };
+    struct Section {
+        std::vector<size_t> start;          // начало ссылок слова в refs, размер - число слов + 1
+        std::vector<SectionRef> refs;       // по словам, внутри слова - по номеру части
+    };
+
+    // Число выданных doc_id; сами тексты индекс не хранит
+    size_t documentCount = 0;
+
+    // Публикуется атомарно (RCU): читатели берут копию shared_ptr,
+    // старый снимок освобождается вместе с последним читателем
+    std::shared_ptr<const IndexSnapshot> snapshot = std::make_shared<IndexSnapshot>();
+    std::shared_ptr<const DocumentStore> documentStore;
+
+    // Сериализует писателей
+    std::mutex update_mutex;
+    uint64_t generation = 0;
+    bool positional = false;
+    uint32_t fuzzyDistance = 0;
+    size_t memoryBudget = 0;
+    MemoryPolicy memoryPolicy = MemoryPolicy::Fail;
+    size_t indexingThreads;
+    std::unique_ptr<ThreadPool> pool;
+
+    // Фоновое слияние сегментов
+    std::thread mergeThread;
+    std::mutex merge_mutex;
+    std::condition_variable merge_cv;
+    bool mergeRequested = false;
+    bool merging = false;
+    bool stopMerging = false;
+    size_t mergeFactor = 10;
     
-    void indexDocument(size_t doc_id, const std::string& text);
-};
\ No newline at end of file
+    uint32_t indexDocument(uint32_t doc_id, const std::string& text, PostingsAccumulator& postings,
+                           Tokenizer& tokenizer) const;
+    // Частичный индекс диапазона документов; partitions[p] - term id слов секции p
+    void indexRange(const std::vector<uint32_t>& docIds, const std::vector<std::string>& texts,
+                    std::vector<uint32_t>& docLengths, size_t begin, size_t end,
+                    PostingsAccumulator& postings, std::vector<std::vector<uint32_t>>& partitions) const;
+
+    // texts[i] - текст документа docIds[i]
+    std::shared_ptr<const IndexSegment> buildSegment(std::vector<uint32_t> docIds,
+                                                     const std::vector<std::string>& texts);
+    static std::shared_ptr<const IndexSegment> freezeSections(const std::vector<PostingsAccumulator>& parts,
+                                                              const std::vector<Section>& sections,
+                                                              std::vector<uint32_t> docIds,
+                                                              std::vector<uint32_t> docLengths,
+                                                              uint32_t fuzzyDistance, ThreadPool* pool);
+    static std::shared_ptr<const IndexSegment> mergeSegments(const std::vector<SegmentRef>& sources);
+
+    // contentChanged == false - тот же набор документов в другой раскладке (слияние)
+    void publish(std::vector<SegmentRef> segments, bool contentChanged = true);
+    void removeDocument(uint32_t doc_id, std::vector<SegmentRef>& segments);
+    // Вызывается под update_mutex перед публикацией; при политике Compact может
+    // заменить сегменты кучи одним слитым
+    void enforceMemoryBudget(std::vector<SegmentRef>& segments) const;
+    void requestMerge();
+    void mergeLoop();
+    bool mergeOnce();
+};
@@ -0,0 +1,161 @@
+#include "LzCodec.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr size_t HASH_BITS = 14;
+constexpr size_t WILD_COPY = 16;
+
+uint32_t read32(const char* at) {
+    uint32_t value;
+    std::memcpy(&value, at, sizeof(value));
+    return value;
+}
+
+uint32_t hashOf(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Продолжение длины: байты по 255 и остаток
+char* putLength(char* out, size_t length) {
+    while (length >= 255) {
+        *out++ = static_cast<char>(255);
+        length -= 255;
+    }
+    *out++ = static_cast<char>(length);
+    return out;
+}
+
+bool getLength(const uint8_t*& in, const uint8_t* end, size_t& length) {
+    uint8_t byte;
+    do {
+        if (in == end) {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// Последовательность: литералы и повтор длиной matchLength (0 - без повтора, последняя)
+char* putSequence(char* out, const char* literals, size_t literalLength, size_t offset, size_t matchLength) {
+    size_t matchCode = matchLength == 0 ? 0 : matchLength - LzCodec::MIN_MATCH;
+    *out++ = static_cast<char>((literalLength < 15 ? literalLength : 15) << 4 | (matchCode < 15 ? matchCode : 15));
+    if (literalLength >= 15) {
+        out = putLength(out, literalLength - 15);
+    }
+    std::memcpy(out, literals, literalLength);
+    out += literalLength;
+    if (matchLength == 0) {
+        return out;
+    }
+    *out++ = static_cast<char>(offset & 0xFF);
+    *out++ = static_cast<char>(offset >> 8);
+    if (matchCode >= 15) {
+        out = putLength(out, matchCode - 15);
+    }
+    return out;
+}
+
+}
+
+void LzCodec::Compress(const char* src, size_t size, std::string& out) {
+    // Последняя позиция, с которой видно слово из 4 байт
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+    // Вывод пишется прямо в буфер, размер которого рассчитан на худший случай -
+    // одни литералы: байт токена и продолжение длины на каждые 255 байт
+    size_t start = out.size();
+    out.resize(start + size + size / 255 + 16);
+    char* at = out.data() + start;
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (pos + MIN_MATCH <= size) {
+        uint32_t sequence = read32(src + pos);
+        uint32_t& slot = table[hashOf(sequence)];
+        size_t candidate = slot;
+        slot = static_cast<uint32_t>(pos);
+        if (candidate >= pos || pos - candidate > MAX_OFFSET || read32(src + candidate) != sequence) {
+            // На несжимаемых данных шаг растет, чтобы не искать повторы в каждом байте
+            pos += 1 + ((pos - anchor) >> 6);
+            continue;
+        }
+
+        size_t length = MIN_MATCH;
+        while (pos + length < size && src[candidate + length] == src[pos + length]) {
+            ++length;
+        }
+        at = putSequence(at, src + anchor, pos - anchor, pos - candidate, length);
+        pos += length;
+        anchor = pos;
+        // Позиция внутри повтора: следующее совпадение часто начинается рядом с его концом
+        if (pos >= 2 && pos + MIN_MATCH <= size + 2) {
+            table[hashOf(read32(src + pos - 2))] = static_cast<uint32_t>(pos - 2);
+        }
+    }
+    at = putSequence(at, src + anchor, size - anchor, 0, 0);
+    out.resize(static_cast<size_t>(at - out.data()));
+}
+
+bool LzCodec::Decompress(const char* src, size_t size, char* dst, size_t dstSize) {
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+    const uint8_t* end = in + size;
+    size_t at = 0;
+    while (in < end) {
+        uint8_t token = *in++;
+
+        size_t literals = token >> 4;
+        if (literals == 15 && !getLength(in, end, literals)) {
+            return false;
+        }
+        if (literals > static_cast<size_t>(end - in) || literals > dstSize - at) {
+            return false;
+        }
+        // Короткие куски копируются блоками фиксированной длины с запасом
+        // (wild copy): так копирование не вызывает memcpy с переменной длиной.
+        // Лишние байты затираются следующими последовательностями
+        if (literals <= WILD_COPY && static_cast<size_t>(end - in) >= WILD_COPY && dstSize - at >= WILD_COPY) {
+            std::memcpy(dst + at, in, WILD_COPY);
+        } else {
+            std::memcpy(dst + at, in, literals);
+        }
+        in += literals;
+        at += literals;
+        if (in == end) {
+            break;
+        }
+
+        if (end - in < 2) {
+            return false;
+        }
+        size_t offset = static_cast<size_t>(in[0]) | static_cast<size_t>(in[1]) << 8;
+        in += 2;
+        size_t length = token & 0x0F;
+        if (length == 15 && !getLength(in, end, length)) {
+            return false;
+        }
+        length += MIN_MATCH;
+        if (offset == 0 || offset > at || length > dstSize - at) {
+            return false;
+        }
+
+        // Повтор может перекрывать сам себя (offset < length) - тогда побайтово
+        char* out = dst + at;
+        const char* from = out - offset;
+        if (length <= WILD_COPY && offset >= WILD_COPY / 2 && dstSize - at >= WILD_COPY) {
+            // Куски по 8 байт: при offset >= 8 каждый читает уже записанные байты
+            std::memcpy(out, from, WILD_COPY / 2);
+            std::memcpy(out + WILD_COPY / 2, from + WILD_COPY / 2, WILD_COPY / 2);
+        } else if (offset >= length) {
+            std::memcpy(out, from, length);
+        } else {
+            for (size_t i = 0; i < length; ++i) {
+                out[i] = from[i];
+            }
+        }
+        at += length;
+    }
+    return at == dstSize;
+}
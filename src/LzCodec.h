@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+// Простой кодек семейства LZ77 для блоков текста (формат как у LZ4 block):
+// последовательности "токен, литералы, смещение, длина повтора". Токен -
+// длина литералов в старших 4 битах и длина повтора минус MIN_MATCH в
+// младших; 15 означает продолжение длины байтами (255 - еще байт).
+// Смещение - 2 байта little-endian, поэтому повтор ищется не дальше
+// MAX_OFFSET байт назад. Последняя последовательность - только литералы.
+// Сжатие однопроходное с хэш-таблицей по 4 байтам: быстро, без энтропийного
+// кодирования, распаковка - копирование байтов.
+class LzCodec {
+public:
+    static constexpr size_t MIN_MATCH = 4;
+    static constexpr size_t MAX_OFFSET = 65535;
+
+    // Дописывает сжатые size байт из src в конец out
+    static void Compress(const char* src, size_t size, std::string& out);
+
+    // Распаковывает ровно dstSize байт в dst; false - данные повреждены
+    // (выход за границы входа или выхода, смещение до начала, другой размер)
+    static bool Decompress(const char* src, size_t size, char* dst, size_t dstSize);
+};
@@ -0,0 +1,94 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("cannot open file: " + path);
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        throw std::runtime_error("cannot get file size: " + path);
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+    fileHandle = file;
+    if (size == 0) {
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        throw std::runtime_error("cannot map file: " + path);
+    }
+    mappingHandle = mapping;
+
+    data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("cannot map file: " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open file: " + path);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot get file size: " + path);
+    }
+    size = static_cast<size_t>(info.st_size);
+    if (size == 0) {
+        close(fd);
+        return;
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // Отображение держит файл открытым само, дескриптор больше не нужен
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("cannot map file: " + path);
+    }
+    data = static_cast<const char*>(mapped);
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+#endif
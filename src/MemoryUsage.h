@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Разбивка памяти индекса по составляющим, в байтах. Каждая составляющая
+// считается целиком, где бы ни лежали данные; mappedBytes - часть из них,
+// которая лежит в отображенном файле индекса (страничный кэш ОС, а не куча).
+struct IndexMemoryUsage {
+    size_t dictionaryBytes = 0;     // словари терминов: хэш-таблицы, смещения, строки слов
+    size_t postingsBytes = 0;       // сжатые постинги, таблицы пропусков, границы блоков слов
+    size_t positionsBytes = 0;      // позиции слов позиционного индекса
+    size_t fuzzyBytes = 0;          // индексы удалений для нечеткого поиска
+    size_t documentBytes = 0;       // списки doc_id и длины документов сегментов
+    size_t deletedBytes = 0;        // битовые множества удаленных документов
+    size_t storedTextBytes = 0;     // распакованные блоки хранилища документов в его кэше
+    size_t slackBytes = 0;          // выделено в куче сверх нужного (запас емкости)
+
+    size_t mappedBytes = 0;
+    size_t heapBytes = 0;           // все, что не в отображенном файле, вместе со slack
+
+    size_t segments = 0;
+    size_t terms = 0;               // слова по всем сегментам (слово в двух сегментах - дважды)
+    size_t postings = 0;
+
+    // Самые большие постинг-листы (по всем сегментам), по убыванию размера
+    struct TermFootprint {
+        std::string term;
+        size_t postings = 0;
+        size_t bytes = 0;           // сжатые данные и записи таблицы пропусков
+    };
+    std::vector<TermFootprint> largestTerms;
+
+    size_t TotalBytes() const { return heapBytes + mappedBytes; }
+};
+
+// Что делать, когда индекс не укладывается в бюджет памяти
+enum class MemoryPolicy {
+    Fail,       // отказать в изменении: исключение, опубликованный индекс не меняется
+    Compact     // сначала слить все сегменты в один, и только если не помогло - отказать
+};
+
+// Изменение индекса не уложилось в бюджет памяти (InvertedIndex::SetMemoryBudget)
+class MemoryBudgetError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
@@ -0,0 +1,254 @@
+#include "Metrics.h"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+std::atomic<bool> Metrics::enabledFlag{false};
+
+namespace {
+
+// Набор счетчиков одного потока. Пишет только владелец, поэтому хватает
+// relaxed load + store без атомарного сложения; Collect читает параллельно.
+struct alignas(64) Shard {
+    std::array<std::atomic<uint64_t>, Metrics::COUNTER_COUNT> counters{};
+
+    struct StageData {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> totalNanos{0};
+        std::atomic<uint64_t> maxNanos{0};
+        std::array<std::atomic<uint64_t>, Metrics::BUCKET_COUNT> buckets{};
+    };
+    std::array<StageData, Metrics::STAGE_COUNT> stages;
+};
+
+void bump(std::atomic<uint64_t>& value, uint64_t delta) {
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+// Наборы не удаляются: данные завершившегося потока остаются в отчете,
+// а сам набор достается следующему новому потоку
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<Shard*> free;
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry();     // живет до конца процесса
+    return *instance;
+}
+
+struct ShardHolder {
+    Shard* shard = nullptr;
+
+    ~ShardHolder() {
+        if (shard != nullptr) {
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.free.push_back(shard);
+        }
+    }
+};
+
+Shard& localShard() {
+    thread_local ShardHolder holder;
+    if (holder.shard == nullptr) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (!r.free.empty()) {
+            holder.shard = r.free.back();
+            r.free.pop_back();
+        } else {
+            r.shards.push_back(std::make_unique<Shard>());
+            holder.shard = r.shards.back().get();
+        }
+    }
+    return *holder.shard;
+}
+
+uint64_t percentile(const std::array<uint64_t, Metrics::BUCKET_COUNT>& buckets, uint64_t count, double p) {
+    if (count == 0) {
+        return 0;
+    }
+    // Ближайший ранг: наименьшее значение, не меньше которого доля p замеров
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p * static_cast<double>(count))));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            return Metrics::BucketValue(bucket);
+        }
+    }
+    return Metrics::BucketValue(buckets.size() - 1);
+}
+
+}
+
+size_t Metrics::BucketIndex(uint64_t value) {
+    if (value < 16) {
+        return static_cast<size_t>(value);
+    }
+    size_t exponent = 63;
+    while ((value >> exponent) == 0) {
+        --exponent;
+    }
+    // Старший бит и четыре следующих за ним: степень двойки и 1/16 внутри нее
+    size_t sub = static_cast<size_t>((value >> (exponent - 4)) & 15);
+    return 16 + (exponent - 4) * 16 + sub;
+}
+
+uint64_t Metrics::BucketValue(size_t bucket) {
+    if (bucket < 16) {
+        return bucket;
+    }
+    size_t exponent = (bucket - 16) / 16 + 4;
+    uint64_t sub = (bucket - 16) % 16;
+    uint64_t low = (16 + sub) << (exponent - 4);
+    uint64_t width = uint64_t(1) << (exponent - 4);
+    return low + width / 2;
+}
+
+void Metrics::Add(Counter counter, uint64_t value) {
+    bump(localShard().counters[static_cast<size_t>(counter)], value);
+}
+
+void Metrics::Record(Stage stage, uint64_t nanoseconds) {
+    auto& data = localShard().stages[static_cast<size_t>(stage)];
+    bump(data.count, 1);
+    bump(data.totalNanos, nanoseconds);
+    if (nanoseconds > data.maxNanos.load(std::memory_order_relaxed)) {
+        data.maxNanos.store(nanoseconds, std::memory_order_relaxed);
+    }
+    bump(data.buckets[BucketIndex(nanoseconds)], 1);
+}
+
+Metrics::Report Metrics::Collect() {
+    Report report;
+    std::array<std::array<uint64_t, BUCKET_COUNT>, STAGE_COUNT> buckets{};
+
+    Registry& r = registry();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (const auto& shard : r.shards) {
+            for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+                report.counters[c] += shard->counters[c].load(std::memory_order_relaxed);
+            }
+            for (size_t s = 0; s < STAGE_COUNT; ++s) {
+                const auto& data = shard->stages[s];
+                StageStats& stats = report.stages[s];
+                stats.count += data.count.load(std::memory_order_relaxed);
+                stats.totalNanos += data.totalNanos.load(std::memory_order_relaxed);
+                stats.maxNanos = std::max(stats.maxNanos, data.maxNanos.load(std::memory_order_relaxed));
+                for (size_t b = 0; b < BUCKET_COUNT; ++b) {
+                    buckets[s][b] += data.buckets[b].load(std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    for (size_t s = 0; s < STAGE_COUNT; ++s) {
+        // Количество берется по корзинам: во время сбора потоки продолжают писать
+        uint64_t count = 0;
+        for (uint64_t value : buckets[s]) {
+            count += value;
+        }
+        StageStats& stats = report.stages[s];
+        stats.p50Nanos = std::min(percentile(buckets[s], count, 0.50), stats.maxNanos);
+        stats.p90Nanos = std::min(percentile(buckets[s], count, 0.90), stats.maxNanos);
+        stats.p99Nanos = std::min(percentile(buckets[s], count, 0.99), stats.maxNanos);
+    }
+    return report;
+}
+
+void Metrics::Reset() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& shard : r.shards) {
+        for (auto& counter : shard->counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto& data : shard->stages) {
+            data.count.store(0, std::memory_order_relaxed);
+            data.totalNanos.store(0, std::memory_order_relaxed);
+            data.maxNanos.store(0, std::memory_order_relaxed);
+            for (auto& bucket : data.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+const char* Metrics::StageName(Stage stage) {
+    switch (stage) {
+        case Stage::ReadDocuments: return "read_documents";
+        case Stage::IndexDocument: return "index_document";
+        case Stage::UpdateDocumentBase: return "update_document_base";
+        case Stage::GetWordCount: return "get_word_count";
+        case Stage::ProcessQuery: return "process_query";
+        case Stage::Intersect: return "intersect";
+        case Stage::PutAnswers: return "put_answers";
+        default: return "unknown";
+    }
+}
+
+const char* Metrics::CounterName(Counter counter) {
+    switch (counter) {
+        case Counter::BytesRead: return "bytes_read";
+        case Counter::DocumentsIndexed: return "documents_indexed";
+        case Counter::TokensIndexed: return "tokens_indexed";
+        case Counter::Queries: return "queries";
+        case Counter::PostingsScanned: return "postings_scanned";
+        case Counter::DocumentsScored: return "documents_scored";
+        case Counter::PatternTerms: return "pattern_terms";
+        case Counter::FuzzyTerms: return "fuzzy_terms";
+        case Counter::StoreBlocksRead: return "store_blocks_read";
+        default: return "unknown";
+    }
+}
+
+std::string Metrics::ToJson(const Report& report) {
+    auto micros = [](uint64_t nanos) { return static_cast<double>(nanos) / 1000.0; };
+
+    nlohmann::json counters = nlohmann::json::object();
+    for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+        counters[CounterName(static_cast<Counter>(c))] = report.counters[c];
+    }
+
+    nlohmann::json stages = nlohmann::json::object();
+    for (size_t s = 0; s < STAGE_COUNT; ++s) {
+        const StageStats& stats = report.stages[s];
+        if (stats.count == 0) {
+            continue;
+        }
+        stages[StageName(static_cast<Stage>(s))] = {
+                {"count", stats.count},
+                {"total_ms", static_cast<double>(stats.totalNanos) / 1e6},
+                {"mean_us", micros(stats.totalNanos) / static_cast<double>(stats.count)},
+                {"p50_us", micros(stats.p50Nanos)},
+                {"p90_us", micros(stats.p90Nanos)},
+                {"p99_us", micros(stats.p99Nanos)},
+                {"max_us", micros(stats.maxNanos)}
+        };
+    }
+
+    nlohmann::json root = {
+            {"compiled_in", SEARCH_ENGINE_METRICS != 0},
+            {"enabled", Enabled()},
+            {"counters", std::move(counters)},
+            {"stages", std::move(stages)}
+    };
+    return root.dump(2);
+}
+
+void Metrics::WriteJson(const std::string& path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("cannot write metrics file: " + path);
+    }
+    out << ToJson(Collect()) << "\n";
+}
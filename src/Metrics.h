@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifndef SEARCH_ENGINE_METRICS
+#define SEARCH_ENGINE_METRICS 0
+#endif
+
+// Встроенная телеметрия: счетчики и гистограммы задержек по стадиям.
+//
+// Включается дважды: при сборке (SEARCH_ENGINE_METRICS, опция CMake) и во
+// время работы (Metrics::SetEnabled, поле metrics_path в config.json).
+// Без опции сборки макросы ниже не генерируют кода; при выключенной
+// телеметрии таймер стоит одну атомарную загрузку флага.
+//
+// Каждый поток пишет в свой набор счетчиков без блокировок и общих строк
+// кэша; Collect складывает наборы всех потоков. Гистограммы лог-линейные
+// (как HDR Histogram): 16 корзин на каждую степень двойки, погрешность
+// перцентилей не больше 1/16 (~6%).
+class Metrics {
+public:
+    enum class Stage {
+        ReadDocuments,          // чтение файлов документов
+        IndexDocument,          // разбор одного документа в словарь
+        UpdateDocumentBase,     // полная перестройка индекса
+        GetWordCount,
+        ProcessQuery,           // запрос целиком: разбор, кэш, ранжирование
+        Intersect,              // пересечение постингов в одном сегменте
+        PutAnswers,             // запись answers.json
+        Count
+    };
+
+    enum class Counter {
+        BytesRead,
+        DocumentsIndexed,
+        TokensIndexed,
+        Queries,
+        PostingsScanned,        // распакованные постинги при пересечении
+        DocumentsScored,        // документы, получившие релевантность
+        PatternTerms,           // слова, в которые раскрылись шаблоны запросов
+        FuzzyTerms,             // слова индекса, которыми исправлены слова запросов
+        StoreBlocksRead,        // распакованные блоки хранилища документов (промахи его кэша)
+        Count
+    };
+
+    static constexpr size_t STAGE_COUNT = static_cast<size_t>(Stage::Count);
+    static constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::Count);
+    // 16 точных корзин для 0..15 нс и по 16 на каждую степень двойки до 2^63
+    static constexpr size_t BUCKET_COUNT = 16 + 60 * 16;
+
+    static void SetEnabled(bool enabled) { enabledFlag.store(enabled, std::memory_order_relaxed); }
+    static bool Enabled() { return enabledFlag.load(std::memory_order_relaxed); }
+
+    static void Add(Counter counter, uint64_t value);
+    static void Record(Stage stage, uint64_t nanoseconds);
+
+    struct StageStats {
+        uint64_t count = 0;
+        uint64_t totalNanos = 0;
+        uint64_t maxNanos = 0;
+        uint64_t p50Nanos = 0;
+        uint64_t p90Nanos = 0;
+        uint64_t p99Nanos = 0;
+    };
+
+    struct Report {
+        std::array<uint64_t, COUNTER_COUNT> counters{};
+        std::array<StageStats, STAGE_COUNT> stages{};
+    };
+
+    // Сумма по всем потокам на текущий момент
+    static Report Collect();
+    // Обнулить накопленное (потоки продолжают писать в свои наборы)
+    static void Reset();
+
+    // Отчет в JSON: счетчики и по каждой стадии count, total_ms, mean/p50/p90/p99/max в микросекундах
+    static std::string ToJson(const Report& report);
+    static void WriteJson(const std::string& path);
+
+    static const char* StageName(Stage stage);
+    static const char* CounterName(Counter counter);
+
+    static size_t BucketIndex(uint64_t value);
+    // Значение, которым представлена корзина (середина ее диапазона)
+    static uint64_t BucketValue(size_t bucket);
+
+private:
+    static std::atomic<bool> enabledFlag;
+};
+
+// Замер времени области видимости; при выключенной телеметрии часы не читаются
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Metrics::Stage stage) : stage(stage), active(Metrics::Enabled()) {
+        if (active) {
+            started = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedTimer() {
+        if (active) {
+            auto elapsed = std::chrono::steady_clock::now() - started;
+            Metrics::Record(stage, static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Metrics::Stage stage;
+    bool active;
+    std::chrono::steady_clock::time_point started;
+};
+
+#define SE_METRICS_CONCAT_INNER(a, b) a##b
+#define SE_METRICS_CONCAT(a, b) SE_METRICS_CONCAT_INNER(a, b)
+
+#if SEARCH_ENGINE_METRICS
+#define SE_METRICS_TIMER(stage) ScopedTimer SE_METRICS_CONCAT(metricsTimer, __LINE__)(Metrics::Stage::stage)
+#define SE_METRICS_ADD(counter, value) \
+    do { if (Metrics::Enabled()) Metrics::Add(Metrics::Counter::counter, static_cast<uint64_t>(value)); } while (0)
+#else
+#define SE_METRICS_TIMER(stage) do { } while (0)
+#define SE_METRICS_ADD(counter, value) do { } while (0)
+#endif
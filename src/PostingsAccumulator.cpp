@@ -0,0 +1,147 @@
+#include "PostingsAccumulator.h"
+#include <algorithm>
+
+namespace {
+
+constexpr size_t NO_ENTRY = SIZE_MAX;
+
+}
+
+uint32_t PostingsAccumulator::Intern(std::string_view term) {
+    uint32_t id = terms.Insert(term);
+    if (id == lastEntry.size()) {
+        lastEntry.push_back(NO_ENTRY);
+    }
+    return id;
+}
+
+void PostingsAccumulator::Add(uint32_t term, uint32_t doc_id, uint32_t position) {
+    if (positional) {
+        positionLog.push_back({term, position});
+    }
+    size_t& last = lastEntry[term];
+    if (last != NO_ENTRY && log[last].posting.doc_id == doc_id) {
+        ++log[last].posting.count;
+        return;
+    }
+    last = log.size();
+    log.push_back({term, {doc_id, 1}});
+}
+
+void PostingsAccumulator::Append(uint32_t term, Posting posting, const uint32_t* positions) {
+    log.push_back({term, posting});
+    if (positional) {
+        for (uint32_t i = 0; i < posting.count; ++i) {
+            positionLog.push_back({term, positions[i]});
+        }
+    }
+}
+
+void PostingsAccumulator::Finish(bool sortDocs) {
+    // Сортировка подсчетом по term id: порядок постингов внутри слова
+    // сохраняется, поэтому doc_id остаются возрастающими
+    start.assign(terms.Size() + 1, 0);
+    for (const LogEntry& entry : log) {
+        ++start[entry.term + 1];
+    }
+    for (size_t id = 0; id < terms.Size(); ++id) {
+        start[id + 1] += start[id];
+    }
+
+    postings.resize(log.size());
+    std::vector<size_t>& next = lastEntry;     // больше не нужен - служит курсором записи
+    next.assign(start.begin(), start.end() - 1);
+    for (const LogEntry& entry : log) {
+        postings[next[entry.term]++] = entry.posting;
+    }
+    // Журнал больше не нужен: отдаем память сразу, чтобы в пике не держать
+    // постинги дважды
+    std::vector<LogEntry>().swap(log);
+
+    if (positional) {
+        // Позиции раскладываются тем же подсчетом; next снова служит курсором
+        positionStart.assign(terms.Size() + 1, 0);
+        for (const PositionEntry& entry : positionLog) {
+            ++positionStart[entry.term + 1];
+        }
+        for (size_t id = 0; id < terms.Size(); ++id) {
+            positionStart[id + 1] += positionStart[id];
+        }
+        positions.resize(positionLog.size());
+        next.assign(positionStart.begin(), positionStart.end() - 1);
+        for (const PositionEntry& entry : positionLog) {
+            positions[next[entry.term]++] = entry.position;
+        }
+        std::vector<PositionEntry>().swap(positionLog);
+    }
+    finished = true;
+
+    if (sortDocs) {
+        for (uint32_t id = 0; id < terms.Size(); ++id) {
+            sortPostings(id);
+        }
+    }
+}
+
+void PostingsAccumulator::sortPostings(uint32_t id) {
+    auto byDoc = [](const Posting& a, const Posting& b) { return a.doc_id < b.doc_id; };
+    Posting* first = postings.data() + start[id];
+    Posting* last = postings.data() + start[id + 1];
+    if (std::is_sorted(first, last, byDoc)) {
+        return;
+    }
+    if (!positional) {
+        std::sort(first, last, byDoc);
+        return;
+    }
+
+    // Позиции постинга идут за позициями предыдущих, поэтому переставляются
+    // вместе с постингами через порядок индексов
+    size_t count = static_cast<size_t>(last - first);
+    std::vector<size_t> offset(count + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        offset[i + 1] = offset[i] + first[i].count;
+    }
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [first](size_t a, size_t b) { return first[a].doc_id < first[b].doc_id; });
+
+    std::vector<Posting> sortedPostings(count);
+    std::vector<uint32_t> sortedPositions;
+    sortedPositions.reserve(offset[count]);
+    uint32_t* termPositions = positions.data() + positionStart[id];
+    for (size_t i = 0; i < count; ++i) {
+        sortedPostings[i] = first[order[i]];
+        sortedPositions.insert(sortedPositions.end(), termPositions + offset[order[i]],
+                               termPositions + offset[order[i] + 1]);
+    }
+    std::copy(sortedPostings.begin(), sortedPostings.end(), first);
+    std::copy(sortedPositions.begin(), sortedPositions.end(), termPositions);
+}
+
+void PostingsAccumulator::Clear() {
+    terms.Clear();
+    log.clear();
+    lastEntry.clear();
+    start.clear();
+    postings.clear();
+    positionLog.clear();
+    positionStart.clear();
+    positions.clear();
+    finished = false;
+}
+
+void PostingsAccumulator::Release() {
+    bool keepPositional = positional;
+    *this = PostingsAccumulator();
+    positional = keepPositional;
+}
+
+size_t PostingsAccumulator::UsedBytes() const {
+    return terms.UsedBytes() + log.size() * sizeof(LogEntry) + lastEntry.size() * sizeof(size_t) +
+           start.size() * sizeof(size_t) + postings.size() * sizeof(Posting) +
+           positionLog.size() * sizeof(PositionEntry) + positionStart.size() * sizeof(size_t) +
+           positions.size() * sizeof(uint32_t);
+}
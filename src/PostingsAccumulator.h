@@ -0,0 +1,92 @@
+#pragma once
+
+#include "PostingsCodec.h"
+#include "TermDictionary.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Накопитель постингов при построении сегмента: монотонная арена одного потока.
+//
+// Каждое слово интернируется один раз в TermDictionary (строки лежат подряд
+// в одном буфере) и получает term id. Постинги всех слов пишутся в общий
+// журнал, а Finish раскладывает журнал подсчетом по словам в один плоский
+// массив. Так на слово не заводится ни узел хэш-таблицы, ни свой вектор,
+// и память растет несколькими большими массивами. Clear сохраняет емкость
+// словаря и массивов: накопитель переиспользуется без лишних выделений.
+//
+// В позиционном режиме накопитель хранит еще и номера слов в документе:
+// отдельный журнал позиций раскладывается по словам так же, как постинги,
+// и позиции каждого слова идут подряд в порядке его постингов.
+class PostingsAccumulator {
+public:
+    static constexpr uint32_t npos = TermDictionary::npos;
+
+    // Хранить ли позиции; задается до первого добавления
+    void SetPositional(bool enabled) { positional = enabled; }
+    bool Positional() const { return positional; }
+
+    // Term id слова, добавляет его при первой встрече
+    uint32_t Intern(std::string_view term);
+
+    // Одно вхождение слова term в документ doc_id на позиции position.
+    // Документы должны поступать по возрастанию doc_id, позиции внутри
+    // документа - по возрастанию: повтор в том же документе увеличивает
+    // счетчик последнего постинга слова
+    void Add(uint32_t term, uint32_t doc_id, uint32_t position = 0);
+
+    // Готовый постинг в конец списка слова; в позиционном режиме
+    // positions - его posting.count позиций
+    void Append(uint32_t term, Posting posting, const uint32_t* positions = nullptr);
+
+    // Раскладывает журнал по словам и освобождает его; после Finish
+    // накопитель только читается до Clear. sortDocs - упорядочить постинги слова
+    // по doc_id, если они добавлялись не по порядку (слияние сегментов)
+    void Finish(bool sortDocs = false);
+
+    size_t TermCount() const { return terms.Size(); }
+    std::string_view Term(uint32_t id) const { return terms.Term(id); }
+    uint32_t Find(std::string_view term) const { return terms.Find(term); }
+
+    // Постинги слова; доступны после Finish
+    const Posting* Postings(uint32_t id) const { return postings.data() + start[id]; }
+    size_t PostingCount(uint32_t id) const { return start[id + 1] - start[id]; }
+    size_t TotalPostings() const { return finished ? postings.size() : log.size(); }
+
+    // Позиции всех постингов слова подряд (в позиционном режиме, после Finish):
+    // у постинга - posting.count позиций
+    const uint32_t* Positions(uint32_t id) const { return positions.data() + positionStart[id]; }
+    size_t PositionCount(uint32_t id) const { return positionStart[id + 1] - positionStart[id]; }
+
+    // Очистка без освобождения памяти
+    void Clear();
+    // Полное освобождение памяти
+    void Release();
+
+    // Байты занятых элементов (без запаса емкости)
+    size_t UsedBytes() const;
+
+private:
+    struct LogEntry {
+        uint32_t term;
+        Posting posting;
+    };
+    struct PositionEntry {
+        uint32_t term;
+        uint32_t position;
+    };
+
+    TermDictionary terms;
+    std::vector<LogEntry> log;
+    std::vector<size_t> lastEntry;      // позиция последнего постинга слова в log
+    std::vector<size_t> start;          // начало списков слов в postings, размер TermCount() + 1
+    std::vector<Posting> postings;
+    std::vector<PositionEntry> positionLog;
+    std::vector<size_t> positionStart;
+    std::vector<uint32_t> positions;
+    bool positional = false;
+    bool finished = false;
+
+    void sortPostings(uint32_t id);
+};
@@ -0,0 +1,387 @@
+#include "PostingsCodec.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define POSTINGS_CODEC_SSE2 1
+#endif
+
+namespace {
+
+uint32_t bitsFor(uint32_t value) {
+    uint32_t bits = 0;
+    while (value != 0) {
+        ++bits;
+        value >>= 1;
+    }
+    return bits;
+}
+
+void putVByte(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+const uint8_t* getVByte(const uint8_t* in, uint32_t& value) {
+    value = 0;
+    for (uint32_t shift = 0; ; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return in;
+        }
+    }
+}
+
+// Восстановление doc_id из разностей: префиксная сумма плюс база блока
+void prefixSum(uint32_t* values, size_t count, uint32_t base) {
+#ifdef POSTINGS_CODEC_SSE2
+    if (count == PostingsCodec::BLOCK_SIZE) {
+        __m128i carry = _mm_set1_epi32(static_cast<int>(base));
+        for (size_t i = 0; i < count; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi32(v, carry);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), v);
+            carry = _mm_shuffle_epi32(v, 0xFF);
+        }
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        base += values[i];
+        values[i] = base;
+    }
+}
+
+}
+
+bool PostingsCodec::HasSimd() {
+#ifdef POSTINGS_CODEC_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PostingsCodec::Pack(const uint32_t* values, uint32_t bits, uint8_t* out) {
+    if (bits == 0) {
+        return;
+    }
+
+    // Полоса lane хранит значения lane, lane + 4, lane + 8, ... подряд в своих
+    // 32-битных словах; слово w полосы lane лежит по индексу w * 4 + lane
+    for (size_t lane = 0; lane < 4; ++lane) {
+        uint64_t accumulator = 0;
+        uint32_t filled = 0;
+        size_t word = 0;
+        for (size_t k = 0; k < BLOCK_SIZE / 4; ++k) {
+            accumulator |= static_cast<uint64_t>(values[k * 4 + lane]) << filled;
+            filled += bits;
+            if (filled >= 32) {
+                uint32_t packed = static_cast<uint32_t>(accumulator);
+                std::memcpy(out + (word * 4 + lane) * 4, &packed, 4);
+                accumulator >>= 32;
+                filled -= 32;
+                ++word;
+            }
+        }
+    }
+}
+
+void PostingsCodec::UnpackScalar(const uint8_t* in, uint32_t bits, uint32_t* values) {
+    if (bits == 0) {
+        std::fill(values, values + BLOCK_SIZE, 0u);
+        return;
+    }
+
+    uint64_t mask = (uint64_t(1) << bits) - 1;
+    for (size_t lane = 0; lane < 4; ++lane) {
+        uint64_t accumulator = 0;
+        uint32_t available = 0;
+        size_t word = 0;
+        for (size_t k = 0; k < BLOCK_SIZE / 4; ++k) {
+            if (available < bits) {
+                uint32_t packed;
+                std::memcpy(&packed, in + (word * 4 + lane) * 4, 4);
+                accumulator |= static_cast<uint64_t>(packed) << available;
+                available += 32;
+                ++word;
+            }
+            values[k * 4 + lane] = static_cast<uint32_t>(accumulator & mask);
+            accumulator >>= bits;
+            available -= bits;
+        }
+    }
+}
+
+void PostingsCodec::Unpack(const uint8_t* in, uint32_t bits, uint32_t* values) {
+#ifdef POSTINGS_CODEC_SSE2
+    if (bits == 0 || bits == 32) {
+        // При ширине 32 вертикальная раскладка совпадает с обычной
+        if (bits == 32) {
+            std::memcpy(values, in, BLOCK_SIZE * 4);
+        } else {
+            std::fill(values, values + BLOCK_SIZE, 0u);
+        }
+        return;
+    }
+
+    const __m128i* input = reinterpret_cast<const __m128i*>(in);
+    const __m128i mask = _mm_set1_epi32(static_cast<int>((1u << bits) - 1));
+    __m128i current = _mm_loadu_si128(input);
+    uint32_t shift = 0;
+
+    for (size_t k = 0; k < BLOCK_SIZE / 4; ++k) {
+        __m128i value = _mm_srl_epi32(current, _mm_cvtsi32_si128(static_cast<int>(shift)));
+        if (shift + bits > 32) {
+            // Значение разрезано между двумя словами полосы
+            current = _mm_loadu_si128(++input);
+            value = _mm_or_si128(value, _mm_sll_epi32(current, _mm_cvtsi32_si128(static_cast<int>(32 - shift))));
+            shift = shift + bits - 32;
+        } else {
+            shift += bits;
+            if (shift == 32 && k + 1 < BLOCK_SIZE / 4) {
+                current = _mm_loadu_si128(++input);
+                shift = 0;
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + k * 4), _mm_and_si128(value, mask));
+    }
+#else
+    UnpackScalar(in, bits, values);
+#endif
+}
+
+void PostingsCodec::Encode(const Posting* postings, size_t count,
+                           std::vector<SkipEntry>& skips, std::vector<uint8_t>& data,
+                           uint32_t baseDoc, DocLengthTable lengths) {
+    uint32_t gaps[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    uint32_t previous = baseDoc;
+
+    for (size_t start = 0; start < count; start += BLOCK_SIZE) {
+        size_t n = std::min(BLOCK_SIZE, count - start);
+        if (data.size() > UINT32_MAX) {
+            throw std::length_error("compressed postings exceed 4 GiB per segment");
+        }
+
+        SkipEntry entry{};
+        entry.lastDocId = postings[start + n - 1].doc_id;
+        entry.dataOffset = static_cast<uint32_t>(data.size());
+        entry.count = static_cast<uint16_t>(n);
+
+        uint32_t maxGap = 0;
+        uint32_t maxCount = 0;
+        uint32_t minLength = UINT32_MAX;
+        for (size_t i = 0; i < n; ++i) {
+            gaps[i] = postings[start + i].doc_id - previous;
+            counts[i] = postings[start + i].count - 1;
+            previous = postings[start + i].doc_id;
+            maxGap = std::max(maxGap, gaps[i]);
+            maxCount = std::max(maxCount, counts[i]);
+            minLength = std::min(minLength, lengths.Length(previous));
+        }
+        entry.maxCount = maxCount + 1;
+        entry.minLength = minLength;
+
+        if (n == BLOCK_SIZE) {
+            entry.docBits = static_cast<uint8_t>(bitsFor(maxGap));
+            entry.countBits = static_cast<uint8_t>(bitsFor(maxCount));
+            size_t at = data.size();
+            data.resize(at + 16 * (entry.docBits + entry.countBits));
+            Pack(gaps, entry.docBits, data.data() + at);
+            Pack(counts, entry.countBits, data.data() + at + 16 * entry.docBits);
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                putVByte(data, gaps[i]);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                putVByte(data, counts[i]);
+            }
+        }
+        skips.push_back(entry);
+    }
+}
+
+void PostingsCodec::EncodePositions(const Posting* postings, size_t count, const uint32_t* positions,
+                                    std::vector<uint32_t>& blockOffsets, std::vector<uint8_t>& data) {
+    for (size_t i = 0; i < count; ++i) {
+        if (i % BLOCK_SIZE == 0) {
+            if (data.size() > UINT32_MAX) {
+                throw std::length_error("positions exceed 4 GiB per segment");
+            }
+            blockOffsets.push_back(static_cast<uint32_t>(data.size()));
+        }
+        uint32_t previous = 0;
+        for (uint32_t k = 0; k < postings[i].count; ++k) {
+            putVByte(data, positions[k] - previous);
+            previous = positions[k];
+        }
+        positions += postings[i].count;
+    }
+}
+
+const uint8_t* PostingsCodec::DecodePositions(const uint8_t* in, uint32_t count, uint32_t* positions) {
+    uint32_t previous = 0;
+    for (uint32_t k = 0; k < count; ++k) {
+        uint32_t delta;
+        in = getVByte(in, delta);
+        previous += delta;
+        positions[k] = previous;
+    }
+    return in;
+}
+
+const uint8_t* PostingsCodec::SkipPositions(const uint8_t* in, uint32_t count) {
+    // Конец числа - байт без старшего бита
+    while (count > 0) {
+        count -= (*in++ & 0x80) == 0;
+    }
+    return in;
+}
+
+void PostingsCodec::DecodeBlock(const SkipEntry& block, uint32_t baseDoc, const uint8_t* data,
+                                uint32_t* docs, uint32_t* counts) {
+    size_t n = block.count;
+    if (n == BLOCK_SIZE) {
+        Unpack(data, block.docBits, docs);
+        Unpack(data + 16 * block.docBits, block.countBits, counts);
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            data = getVByte(data, docs[i]);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            data = getVByte(data, counts[i]);
+        }
+    }
+
+    prefixSum(docs, n, baseDoc);
+#ifdef POSTINGS_CODEC_SSE2
+    if (n == BLOCK_SIZE) {
+        const __m128i one = _mm_set1_epi32(1);
+        for (size_t i = 0; i < n; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counts + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(counts + i), _mm_add_epi32(v, one));
+        }
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; ++i) {
+        ++counts[i];
+    }
+}
+
+std::vector<Posting> PostingsList::Decode() const {
+    std::vector<Posting> result;
+    result.reserve(size());
+    for (PostingsCursor cursor(*this); cursor.Valid(); cursor.NextBlock()) {
+        for (size_t i = 0; i < cursor.BlockSize(); ++i) {
+            result.push_back({cursor.Docs()[i], cursor.Counts()[i]});
+        }
+    }
+    return result;
+}
+
+PostingsCursor::PostingsCursor(const PostingsList& list) : list(list) {
+    if (Valid()) {
+        decode();
+    }
+}
+
+void PostingsCursor::decode() {
+    const SkipEntry& entry = list.Skips()[block];
+    uint32_t base = block == 0 ? 0 : list.Skips()[block - 1].lastDocId;
+    PostingsCodec::DecodeBlock(entry, base, list.Data() + entry.dataOffset, docs, counts);
+    size = entry.count;
+    pos = 0;
+    if (list.HasPositions()) {
+        positionCursor = list.PositionData() + list.PositionOffsets()[block];
+        positionIndex = 0;
+    }
+}
+
+bool PostingsCursor::NextBlock() {
+    ++block;
+    if (Valid()) {
+        decode();
+    }
+    return Valid();
+}
+
+bool PostingsCursor::SeekBlock(uint32_t target) {
+    if (!Valid()) {
+        return false;
+    }
+    if (BlockLastDoc() >= target) {
+        return true;
+    }
+
+    // Экспоненциальный поиск по таблице пропусков, затем двоичный
+    const SkipEntry* skips = list.Skips();
+    uint32_t count = list.BlockCount();
+    uint32_t low = block;
+    uint32_t step = 1;
+    uint32_t high = block + 1;
+    while (high < count && skips[high].lastDocId < target) {
+        low = high;
+        step *= 2;
+        high = block + step;
+    }
+    high = std::min(high, count);
+
+    // Инвариант: skips[low].lastDocId < target, ответ в (low, high]
+    while (low + 1 < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (skips[middle].lastDocId < target) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    block = high;
+    if (Valid()) {
+        decode();
+    }
+    return Valid();
+}
+
+bool PostingsCursor::Next() {
+    if (++pos == size) {
+        return NextBlock();
+    }
+    return true;
+}
+
+bool PostingsCursor::Advance(uint32_t target) {
+    if (!Valid()) {
+        return false;
+    }
+    if (docs[pos] >= target) {
+        return true;
+    }
+    if (BlockLastDoc() < target && !SeekBlock(target)) {
+        return false;
+    }
+    pos = static_cast<size_t>(std::lower_bound(docs + pos, docs + size, target) - docs);
+    return true;
+}
+
+void PostingsCursor::Positions(std::vector<uint32_t>& out) {
+    if (positionIndex > pos) {
+        positionCursor = list.PositionData() + list.PositionOffsets()[block];
+        positionIndex = 0;
+    }
+    for (; positionIndex < pos; ++positionIndex) {
+        positionCursor = PostingsCodec::SkipPositions(positionCursor, counts[positionIndex]);
+    }
+    out.resize(counts[pos]);
+    PostingsCodec::DecodePositions(positionCursor, counts[pos], out.data());
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Компактная запись постинг-листа во внутреннем представлении индекса
+struct Posting {
+    uint32_t doc_id, count;
+
+    bool operator ==(const Posting& other) const {
+        return (doc_id == other.doc_id && count == other.count);
+    }
+};
+
+// Запись таблицы пропусков: один блок сжатого постинг-листа.
+// maxCount и minLength - верхняя граница вклада блока в релевантность
+// (BM25 растет с count и убывает с длиной документа): блоки, которые не
+// могут поднять документ в ответ, пропускаются без распаковки
+struct SkipEntry {
+    uint32_t lastDocId;    // последний doc_id блока
+    uint32_t dataOffset;   // начало данных блока в массиве байтов сегмента
+    uint32_t maxCount;     // наибольший count в блоке
+    uint32_t minLength;    // наименьшая длина документа блока в словах
+    uint16_t count;        // число постингов в блоке
+    uint8_t docBits;       // ширина разностей doc_id (для полного блока)
+    uint8_t countBits;     // ширина count - 1 (для полного блока)
+};
+
+// Длины документов при кодировании: длина doc_id - lengths[doc_id - base].
+// Без таблицы minLength блоков равен 0 - граница остается верной, но грубее
+struct DocLengthTable {
+    const uint32_t* lengths = nullptr;
+    uint32_t base = 0;
+
+    uint32_t Length(uint32_t doc_id) const { return lengths ? lengths[doc_id - base] : 0; }
+};
+
+// Кодек постинг-листов.
+// Список режется на блоки по BLOCK_SIZE постингов. В полном блоке разности
+// doc_id и значения count - 1 упакованы битами фиксированной ширины в
+// 4-полосной вертикальной раскладке: значение i лежит в полосе i % 4, поэтому
+// распаковка идет сразу по 4 значения в SSE-регистре. Неполный хвостовой
+// блок кодируется variable-byte. База разностей блока - последний doc_id
+// предыдущего блока (0 для первого).
+class PostingsCodec {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    // Кодирует отсортированный по doc_id список: дописывает записи в skips, байты в data.
+    // Смещения данных в skips отсчитываются от начала data.
+    // baseDoc - последний doc_id уже закодированных блоков этого же списка, когда
+    // список дописывается по частям (каждая часть, кроме последней, - целые блоки).
+    // lengths - длины документов для границ блоков (minLength).
+    static void Encode(const Posting* postings, size_t count,
+                       std::vector<SkipEntry>& skips, std::vector<uint8_t>& data,
+                       uint32_t baseDoc = 0, DocLengthTable lengths = {});
+
+    // Позиции слов для тех же постингов: у каждого постинга posting.count
+    // возрастающих позиций, первая записана как есть, остальные - разностями,
+    // все variable-byte. В blockOffsets дописывается начало позиций каждого
+    // блока постингов (от начала data), чтобы курсор не листал чужие блоки.
+    // positions - позиции всех постингов подряд
+    static void EncodePositions(const Posting* postings, size_t count, const uint32_t* positions,
+                                std::vector<uint32_t>& blockOffsets, std::vector<uint8_t>& data);
+    // Позиции одного постинга; возвращают указатель на позиции следующего
+    static const uint8_t* DecodePositions(const uint8_t* in, uint32_t count, uint32_t* positions);
+    static const uint8_t* SkipPositions(const uint8_t* in, uint32_t count);
+
+    // Декодирует один блок; docs и counts вмещают BLOCK_SIZE значений
+    static void DecodeBlock(const SkipEntry& block, uint32_t baseDoc, const uint8_t* data,
+                            uint32_t* docs, uint32_t* counts);
+
+    // Упаковка BLOCK_SIZE чисел шириной bits бит: занимает 16 * bits байт
+    static void Pack(const uint32_t* values, uint32_t bits, uint8_t* out);
+    static void Unpack(const uint8_t* in, uint32_t bits, uint32_t* values);
+    static void UnpackScalar(const uint8_t* in, uint32_t bits, uint32_t* values);
+
+    // Используется ли векторная распаковка на этой сборке
+    static bool HasSimd();
+};
+
+// Невладеющая ссылка на сжатый постинг-лист слова внутри сегмента.
+// Действительна, пока жив сегмент, из которого она получена.
+class PostingsList {
+public:
+    PostingsList() = default;
+    PostingsList(const SkipEntry* skips, uint32_t blockCount, const uint8_t* data,
+                 const uint32_t* positionOffsets = nullptr, const uint8_t* positionData = nullptr)
+        : skips(skips), blockCount(blockCount), data(data),
+          positionOffsets(positionOffsets), positionData(positionData) { };
+
+    // Число постингов (документов со словом)
+    size_t size() const {
+        return blockCount == 0 ? 0 : (blockCount - 1) * PostingsCodec::BLOCK_SIZE + skips[blockCount - 1].count;
+    }
+    bool empty() const { return blockCount == 0; }
+
+    const SkipEntry* Skips() const { return skips; }
+    uint32_t BlockCount() const { return blockCount; }
+    const uint8_t* Data() const { return data; }
+
+    // Позиции есть только у сегментов позиционного индекса;
+    // positionOffsets - начало позиций каждого блока в positionData
+    bool HasPositions() const { return positionData != nullptr; }
+    const uint32_t* PositionOffsets() const { return positionOffsets; }
+    const uint8_t* PositionData() const { return positionData; }
+
+    // Полная распаковка (для отладки, тестов и слияния сегментов)
+    std::vector<Posting> Decode() const;
+
+private:
+    const SkipEntry* skips = nullptr;
+    uint32_t blockCount = 0;
+    const uint8_t* data = nullptr;
+    const uint32_t* positionOffsets = nullptr;
+    const uint8_t* positionData = nullptr;
+};
+
+// Курсор по сжатому списку: распаковывает по одному блоку за раз.
+// Сразу после создания распакован первый блок (если список не пуст).
+class PostingsCursor {
+public:
+    PostingsCursor() = default;
+    explicit PostingsCursor(const PostingsList& list);
+
+    bool Valid() const { return block < list.BlockCount(); }
+
+    // Блочный доступ
+    const uint32_t* Docs() const { return docs; }
+    const uint32_t* Counts() const { return counts; }
+    size_t BlockSize() const { return size; }
+    uint32_t BlockLastDoc() const { return list.Skips()[block].lastDocId; }
+    uint32_t BlockIndex() const { return block; }
+    bool NextBlock();
+    // Перейти к первому блоку, где может встретиться doc_id >= target,
+    // пропуская остальные блоки по таблице пропусков без распаковки
+    bool SeekBlock(uint32_t target);
+
+    // Поштучный доступ
+    uint32_t DocId() const { return docs[pos]; }
+    uint32_t Count() const { return counts[pos]; }
+    bool Next();
+    bool Advance(uint32_t target);
+
+    // Позиции слова в текущем документе по возрастанию (только если
+    // list.HasPositions()). Распаковываются лениво: курсор помнит, докуда
+    // дочитал позиции блока, и при движении вперед продолжает с того места
+    void Positions(std::vector<uint32_t>& out);
+
+private:
+    PostingsList list;
+    uint32_t block = 0;
+    size_t size = 0;
+    size_t pos = 0;
+    const uint8_t* positionCursor = nullptr;    // позиции постинга positionIndex блока
+    size_t positionIndex = 0;
+    alignas(16) uint32_t docs[PostingsCodec::BLOCK_SIZE];
+    alignas(16) uint32_t counts[PostingsCodec::BLOCK_SIZE];
+
+    void decode();
+};
@@ -0,0 +1,104 @@
+#include "QueryCache.h"
+#include <functional>
+#include <iterator>
+
+namespace {
+
+// Служебные расходы записи: узел списка, узел хэш-таблицы, управляющий блок
+constexpr size_t ENTRY_OVERHEAD = 128;
+
+}
+
+QueryCache::QueryCache(size_t capacityBytes)
+    : capacity(capacityBytes), shardCapacity(capacityBytes / SHARDS), shards(new Shard[SHARDS]) {
+}
+
+QueryCache::Shard& QueryCache::shardFor(const std::string& key) {
+    // Старшие биты хэша: младшие использует сама хэш-таблица шарда
+    size_t hash = std::hash<std::string>()(key);
+    return shards[(hash >> 24) % SHARDS];
+}
+
+void QueryCache::erase(Shard& shard, std::list<Entry>::iterator it) {
+    shard.bytes -= it->bytes;
+    shard.lookup.erase(it->key);
+    shard.lru.erase(it);
+}
+
+QueryCache::Result QueryCache::Find(const std::string& key, uint64_t generation) {
+    if (!Enabled()) {
+        return nullptr;
+    }
+
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.lookup.find(key);
+    if (found == shard.lookup.end()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    if (found->second->generation != generation) {
+        // Индекс обновился после того, как запись была посчитана
+        erase(shard, found->second);
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return found->second->result;
+}
+
+void QueryCache::Insert(const std::string& key, uint64_t generation, Result result, size_t bytes) {
+    if (!Enabled()) {
+        return;
+    }
+
+    bytes += key.size() * 2 + ENTRY_OVERHEAD;
+    if (bytes > shardCapacity) {
+        return;
+    }
+
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.lookup.find(key);
+    if (found != shard.lookup.end()) {
+        // Другой поток успел посчитать тот же запрос - оставляем более свежий
+        if (found->second->generation > generation) {
+            return;
+        }
+        erase(shard, found->second);
+    }
+
+    while (shard.bytes + bytes > shardCapacity && !shard.lru.empty()) {
+        erase(shard, std::prev(shard.lru.end()));
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    shard.lru.push_front({key, generation, std::move(result), bytes});
+    shard.lookup.emplace(key, shard.lru.begin());
+    shard.bytes += bytes;
+}
+
+void QueryCache::Clear() {
+    for (size_t i = 0; i < SHARDS; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        shards[i].lru.clear();
+        shards[i].lookup.clear();
+        shards[i].bytes = 0;
+    }
+}
+
+QueryCache::Stats QueryCache::GetStats() const {
+    Stats stats;
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    stats.evictions = evictions.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < SHARDS; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        stats.entries += shards[i].lru.size();
+        stats.bytes += shards[i].bytes;
+    }
+    return stats;
+}
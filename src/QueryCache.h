@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct RelativeIndex;
+
+// Кэш результатов запросов перед SearchServer::processQuery.
+// Ключ - нормализованный запрос (отсортированный набор слов и лимит ответов),
+// значение - готовый отсортированный ответ. Кэш разбит на независимые шарды
+// со своими блокировками и LRU-списками; бюджет памяти делится поровну.
+// Запись помнит поколение индекса, на котором посчитана: после обновления
+// индекса поколение меняется, и старые записи считаются промахом.
+class QueryCache {
+public:
+    using Result = std::shared_ptr<const std::vector<RelativeIndex>>;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    static constexpr size_t SHARDS = 16;
+
+    // capacityBytes == 0 - кэш выключен
+    explicit QueryCache(size_t capacityBytes = 0);
+
+    QueryCache(const QueryCache&) = delete;
+    QueryCache& operator=(const QueryCache&) = delete;
+
+    bool Enabled() const { return capacity > 0; }
+    size_t Capacity() const { return capacity; }
+
+    // nullptr при промахе или если запись посчитана на другом поколении индекса
+    Result Find(const std::string& key, uint64_t generation);
+
+    // bytes - оценка памяти под результат (без ключа и служебных структур)
+    void Insert(const std::string& key, uint64_t generation, Result result, size_t bytes);
+
+    void Clear();
+    Stats GetStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        Result result;
+        size_t bytes;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> lru;     // в начале - самые недавно использованные
+        std::unordered_map<std::string, std::list<Entry>::iterator> lookup;
+        size_t bytes = 0;
+    };
+
+    size_t capacity;
+    size_t shardCapacity;
+    std::unique_ptr<Shard[]> shards;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+
+    Shard& shardFor(const std::string& key);
+    void erase(Shard& shard, std::list<Entry>::iterator it);
+};
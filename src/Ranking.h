@@ -0,0 +1,12 @@
+#pragma once
+
+// Способ ранжирования результатов поиска
+enum class Ranking {
+    // Сумма вхождений всех слов запроса в документ, нормированная на максимум.
+    // В ответ попадают документы со всеми словами запроса (AND). По умолчанию
+    Absolute,
+    // Okapi BM25 (k1 = 1.2, b = 0.75) по документам хотя бы с одним словом
+    // запроса (OR). Лучшие max_responses документов отбираются block-max WAND
+    // без оценки документов, которые заведомо не войдут в ответ
+    BM25
+};
@@ -0,0 +1,519 @@
+#include "SearchDaemon.h"
+#include "ShardProtocol.h"
+#include "nlohmann/json.hpp"
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+// Ответ на один запрос соединения; заполняется в порядке готовности,
+// а отправляется в порядке запросов
+struct SearchDaemon::Slot {
+    bool ready = false;
+    std::string response;
+};
+
+struct SearchDaemon::Connection {
+    int readFd = -1;
+    int writeFd = -1;
+    bool isSocket = false;
+    bool readClosed = false;
+    bool broken = false;
+    std::string input;
+    std::deque<std::shared_ptr<Slot>> slots;
+    std::string output;
+    size_t written = 0;
+
+    bool Finished() const { return broken || (readClosed && slots.empty() && written == output.size()); }
+};
+
+namespace {
+
+std::string errorResponse(const std::string& id, const std::string& message) {
+    return "{\"id\":" + id + ",\"error\":" + json(message).dump() + "}\n";
+}
+
+// rank уже округлен до 0.001 (SearchServer), но float в json печатается как
+// double - 0.699999988079071 вместо 0.7. Тот же десятичный rank, что в answers.json
+double decimalRank(float rank) {
+    return std::round(static_cast<double>(rank) * 1000.0) / 1000.0;
+}
+
+}
+
+std::string SearchDaemon::formatResult(const InvertedIndex& index, const std::string& id, const std::string& query,
+                                      const std::vector<RelativeIndex>& result) const {
+    // Поля как в answers.json: result, relevance[{docid, rank}], и сниппет
+    // документа, если у индекса есть хранилище текстов
+    json relevance = json::array();
+    for (const auto& entry : result) {
+        json item = {{"docid", entry.doc_id}, {"rank", decimalRank(entry.rank)}};
+        std::string snippet = server.GetSnippet(index, entry.doc_id, query);
+        if (!snippet.empty()) {
+            item["snippet"] = std::move(snippet);
+        }
+        relevance.push_back(std::move(item));
+    }
+    json body = {{"result", !result.empty()}, {"relevance", std::move(relevance)}};
+    std::string text = body.dump();
+    return "{\"id\":" + id + "," + text.substr(1) + "\n";
+}
+
+std::string SearchDaemon::handleShard(const InvertedIndex& index, const Job& job) {
+    try {
+        std::string text = ShardProtocol::Handle(server, index, json::parse(job.shard)).dump();
+        return "{\"id\":" + job.id + "," + text.substr(1) + "\n";
+    } catch (const std::exception& e) {
+        return errorResponse(job.id, e.what());
+    }
+}
+
+SearchDaemon::Stats SearchDaemon::GetStats() const {
+    Stats stats;
+    stats.requests = requests.load();
+    stats.rejected = rejected.load();
+    stats.batches = batches.load();
+    return stats;
+}
+
+void SearchDaemon::workerLoop() {
+    std::vector<Job> batch;
+    std::vector<std::string> queries;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this]() { return workerStop || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+
+            // Микропакет: короткое ожидание, пока соберется больше запросов.
+            // Запрос шарда не ждет: координатор ждет его ответа, чтобы
+            // продолжить свой запрос, и задержка копилась бы на каждой фазе
+            auto urgent = [this]() { return !queue.back().shard.empty(); };
+            if (queue.size() < options.maxBatch && options.batchDelayMicros > 0 && !workerStop && !urgent()) {
+                queue_cv.wait_for(lock, std::chrono::microseconds(options.batchDelayMicros), [&]() {
+                    return workerStop || queue.size() >= options.maxBatch || urgent();
+                });
+            }
+
+            size_t n = std::min(queue.size(), options.maxBatch);
+            batch.clear();
+            for (size_t i = 0; i < n; ++i) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+
+        // Запросы шардов выполняются параллельно на потоках поиска сервера,
+        // обычные - одним пакетом. Весь пакет, вместе со сниппетами, - на
+        // одном индексе: подмена индекса (IndexReloader) между поиском и
+        // сниппетами не дала бы документу ответа текст другого документа
+        auto index = server.GetIndex();
+        std::vector<std::pair<std::shared_ptr<Slot>, std::string>> responses;
+        std::vector<Job> shardJobs;
+        queries.clear();
+        size_t searches = 0;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (!batch[i].shard.empty()) {
+                shardJobs.push_back(std::move(batch[i]));
+                continue;
+            }
+            queries.push_back(batch[i].query);
+            if (searches != i) {
+                batch[searches] = std::move(batch[i]);
+            }
+            ++searches;
+        }
+        std::vector<std::string> shardResponses(shardJobs.size());
+        server.RunParallel(shardJobs.size(), [&](size_t i) {
+            shardResponses[i] = handleShard(*index, shardJobs[i]);
+        });
+        for (size_t i = 0; i < shardJobs.size(); ++i) {
+            responses.emplace_back(shardJobs[i].slot, std::move(shardResponses[i]));
+        }
+        try {
+            auto results = server.search(*index, queries);
+            for (size_t i = 0; i < searches; ++i) {
+                responses.emplace_back(batch[i].slot, formatResult(*index, batch[i].id, batch[i].query, results[i]));
+            }
+        } catch (const std::exception& e) {
+            for (size_t i = 0; i < searches; ++i) {
+                responses.emplace_back(batch[i].slot, errorResponse(batch[i].id, e.what()));
+            }
+        }
+        batches.fetch_add(1);
+
+        {
+            std::lock_guard<std::mutex> lock(done_mutex);
+            for (auto& response : responses) {
+                done.push_back(std::move(response));
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            inFlight -= responses.size();
+        }
+        wake();
+    }
+}
+
+#ifndef _WIN32
+
+SearchDaemon::SearchDaemon(SearchServer& server, Options options) : server(server), options(options) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::runtime_error(std::string("cannot create wake pipe: ") + std::strerror(errno));
+    }
+    wakeRead = fds[0];
+    wakeWrite = fds[1];
+    fcntl(wakeRead, F_SETFL, fcntl(wakeRead, F_GETFL) | O_NONBLOCK);
+    fcntl(wakeWrite, F_SETFL, fcntl(wakeWrite, F_GETFL) | O_NONBLOCK);
+}
+
+SearchDaemon::~SearchDaemon() {
+    close(wakeRead);
+    close(wakeWrite);
+}
+
+void SearchDaemon::wake() {
+    // Только write: допустимо из обработчика сигнала
+    char byte = 1;
+    ssize_t ignored = write(wakeWrite, &byte, 1);
+    (void)ignored;
+}
+
+void SearchDaemon::Stop() {
+    stopping = true;
+    wake();
+}
+
+void SearchDaemon::RequestReload() {
+    reloadRequested = true;
+    wake();
+}
+
+void SearchDaemon::handleLine(Connection& connection, const std::string& line) {
+    auto slot = std::make_shared<Slot>();
+    connection.slots.push_back(slot);
+    requests.fetch_add(1);
+
+    std::string id = "null";
+    std::string query;
+    std::string shard;
+    try {
+        json request = json::parse(line);
+        if (request.is_object() && request.contains("id")) {
+            id = request["id"].dump();
+        }
+        if (request.is_object() && request.contains("shard")) {
+            // Разбирается на рабочем потоке целиком (ShardProtocol::Handle)
+            shard = line;
+        } else if (!request.is_object() || !request.contains("query") || !request["query"].is_string()) {
+            throw std::invalid_argument("expected {\"id\": ..., \"query\": \"...\"}");
+        } else {
+            query = request["query"].get<std::string>();
+        }
+    } catch (const std::exception& e) {
+        slot->ready = true;
+        slot->response = errorResponse(id, std::string("bad request: ") + e.what());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    if (inFlight >= options.maxQueue) {
+        // Контроль допуска: перегруженный сервер отвечает сразу, а не копит очередь
+        rejected.fetch_add(1);
+        slot->ready = true;
+        slot->response = errorResponse(id, "busy");
+        return;
+    }
+    ++inFlight;
+    queue.push_back({slot, std::move(id), std::move(query), std::move(shard)});
+    queue_cv.notify_one();
+}
+
+void SearchDaemon::collectDone() {
+    std::vector<std::pair<std::shared_ptr<Slot>, std::string>> ready;
+    {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        ready.swap(done);
+    }
+    for (auto& [slot, response] : ready) {
+        slot->response = std::move(response);
+        slot->ready = true;
+    }
+}
+
+bool SearchDaemon::flush(Connection& connection) {
+    while (!connection.slots.empty() && connection.slots.front()->ready) {
+        connection.output += connection.slots.front()->response;
+        connection.slots.pop_front();
+    }
+
+    while (connection.written < connection.output.size()) {
+        const char* data = connection.output.data() + connection.written;
+        size_t size = connection.output.size() - connection.written;
+        ssize_t n = connection.isSocket ? send(connection.writeFd, data, size, MSG_NOSIGNAL)
+                                        : write(connection.writeFd, data, size);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        connection.written += static_cast<size_t>(n);
+    }
+
+    if (connection.written == connection.output.size()) {
+        connection.output.clear();
+        connection.written = 0;
+    }
+    return true;
+}
+
+void SearchDaemon::run(int listenFd, std::vector<std::unique_ptr<Connection>> connections) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        workerStop = false;
+    }
+    std::thread worker(&SearchDaemon::workerLoop, this);
+
+    std::vector<pollfd> fds;
+    std::vector<std::pair<Connection*, short>> owners;
+    char buffer[1 << 16];
+
+    while (true) {
+        bool stopNow = stopping.load();
+        if (stopNow) {
+            // Новые запросы не читаем, принятые доделываем
+            for (auto& connection : connections) {
+                connection->readClosed = true;
+            }
+        }
+
+        for (size_t i = 0; i < connections.size();) {
+            if (connections[i]->Finished()) {
+                if (connections[i]->isSocket) {
+                    close(connections[i]->readFd);
+                }
+                connections.erase(connections.begin() + static_cast<std::ptrdiff_t>(i));
+            } else {
+                ++i;
+            }
+        }
+        if (connections.empty() && (listenFd < 0 || stopNow)) {
+            break;
+        }
+
+        fds.clear();
+        owners.clear();
+        fds.push_back({wakeRead, POLLIN, 0});
+        owners.emplace_back(nullptr, 0);
+        if (listenFd >= 0 && !stopNow) {
+            fds.push_back({listenFd, POLLIN, 0});
+            owners.emplace_back(nullptr, 0);
+        }
+        for (auto& connection : connections) {
+            bool wantRead = !connection->readClosed;
+            bool wantWrite = !connection->output.empty();
+            if (connection->readFd == connection->writeFd) {
+                short events = static_cast<short>((wantRead ? POLLIN : 0) | (wantWrite ? POLLOUT : 0));
+                fds.push_back({connection->readFd, events, 0});
+                owners.emplace_back(connection.get(), events);
+            } else {
+                if (wantRead) {
+                    fds.push_back({connection->readFd, POLLIN, 0});
+                    owners.emplace_back(connection.get(), POLLIN);
+                }
+                if (wantWrite) {
+                    fds.push_back({connection->writeFd, POLLOUT, 0});
+                    owners.emplace_back(connection.get(), POLLOUT);
+                }
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            while (read(wakeRead, buffer, sizeof(buffer)) > 0) {
+            }
+        }
+        if (reloadRequested.exchange(false) && reloadHandler) {
+            reloadHandler();
+        }
+
+        for (size_t i = 1; i < fds.size(); ++i) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+
+            Connection* connection = owners[i].first;
+            if (connection == nullptr) {
+                // Новые клиенты
+                while (true) {
+                    int client = accept(listenFd, nullptr, nullptr);
+                    if (client < 0) {
+                        break;
+                    }
+                    fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+                    auto accepted = std::make_unique<Connection>();
+                    accepted->readFd = accepted->writeFd = client;
+                    accepted->isSocket = true;
+                    connections.push_back(std::move(accepted));
+                }
+                continue;
+            }
+
+            if ((owners[i].second & POLLIN) && (fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                ssize_t n = read(connection->readFd, buffer, sizeof(buffer));
+                if (n > 0) {
+                    connection->input.append(buffer, static_cast<size_t>(n));
+                } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    connection->readClosed = true;
+                }
+
+                // Разбор полных строк; запросы одного соединения идут по порядку
+                auto handle = [this, connection](std::string line) {
+                    if (!line.empty() && line.back() == '\r') {
+                        line.pop_back();
+                    }
+                    if (line.find_first_not_of(" \t") != std::string::npos) {
+                        handleLine(*connection, line);
+                    }
+                };
+                size_t start = 0;
+                for (size_t end; (end = connection->input.find('\n', start)) != std::string::npos; start = end + 1) {
+                    handle(connection->input.substr(start, end - start));
+                }
+                connection->input.erase(0, start);
+                // Последний запрос перед закрытием входа может быть без перевода строки
+                if (connection->readClosed && !connection->input.empty() &&
+                    connection->input.size() <= options.maxLineBytes) {
+                    handle(std::move(connection->input));
+                    connection->input.clear();
+                }
+
+                if (connection->input.size() > options.maxLineBytes) {
+                    auto slot = std::make_shared<Slot>();
+                    slot->ready = true;
+                    slot->response = errorResponse("null", "bad request: line is too long");
+                    connection->slots.push_back(slot);
+                    connection->input.clear();
+                    connection->readClosed = true;
+                }
+            }
+
+            if ((owners[i].second & POLLOUT) && (fds[i].revents & (POLLERR | POLLHUP)) &&
+                !(fds[i].revents & POLLOUT)) {
+                connection->broken = true;
+            }
+        }
+
+        collectDone();
+        for (auto& connection : connections) {
+            if (!connection->broken && !flush(*connection)) {
+                connection->broken = true;
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        workerStop = true;
+    }
+    queue_cv.notify_all();
+    worker.join();
+    collectDone();
+
+    for (auto& connection : connections) {
+        if (connection->isSocket) {
+            close(connection->readFd);
+        }
+    }
+}
+
+void SearchDaemon::ServeSocket(const std::string& socketPath) {
+    sockaddr_un address{};
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("socket path is too long: " + socketPath);
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error(std::string("cannot create socket: ") + std::strerror(errno));
+    }
+    unlink(socketPath.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listenFd, 128) != 0) {
+        std::string reason = std::strerror(errno);
+        close(listenFd);
+        throw std::runtime_error("cannot listen on " + socketPath + ": " + reason);
+    }
+    fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+
+    run(listenFd, {});
+
+    close(listenFd);
+    unlink(socketPath.c_str());
+}
+
+void SearchDaemon::ServeStream(int inputFd, int outputFd) {
+    auto connection = std::make_unique<Connection>();
+    connection->readFd = inputFd;
+    connection->writeFd = outputFd;
+    std::vector<std::unique_ptr<Connection>> connections;
+    connections.push_back(std::move(connection));
+    run(-1, std::move(connections));
+}
+
+#else
+
+SearchDaemon::SearchDaemon(SearchServer& server, Options options) : server(server), options(options) {
+}
+
+SearchDaemon::~SearchDaemon() {
+}
+
+void SearchDaemon::wake() {
+}
+
+void SearchDaemon::Stop() {
+    stopping = true;
+}
+
+void SearchDaemon::RequestReload() {
+    reloadRequested = true;
+}
+
+void SearchDaemon::ServeSocket(const std::string&) {
+    throw std::runtime_error("daemon mode is not supported on this platform");
+}
+
+void SearchDaemon::ServeStream(int, int) {
+    throw std::runtime_error("daemon mode is not supported on this platform");
+}
+
+#endif
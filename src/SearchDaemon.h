@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SearchServer.h"
+
+// Резидентный режим: индекс и SearchServer остаются в памяти, запросы
+// приходят по Unix-сокету (или через stdin/stdout) построчно в JSON:
+//   запрос:  {"id": 1, "query": "milk water"}
+//   ответ:   {"id": 1, "result": true, "relevance": [{"docid": 0, "rank": 1.0}, ...]}
+//            (если у индекса есть хранилище документов, у каждого документа
+//            еще "snippet" - фрагмент текста с подсвеченными словами запроса)
+//   ошибка:  {"id": 1, "error": "busy" | "bad request: ..."}
+// Клиент может слать запросы, не дожидаясь ответов: ответы на одном
+// соединении приходят в порядке запросов. Строки с полем "shard" - запросы
+// координатора распределенного поиска к серверу как к шарду (ShardProtocol):
+// они не ждут добора пачки и выполняются параллельно на потоках поиска.
+//
+// Сетевой цикл однопоточный (poll). Запросы всех соединений складываются в
+// общую очередь, рабочий поток забирает их пачками и выполняет одним вызовом
+// SearchServer::search. Если очередь полна, запрос сразу получает "busy".
+class SearchDaemon {
+public:
+    struct Options {
+        size_t maxQueue = 4096;         // запросов в очереди, сверх - "busy"
+        size_t maxBatch = 256;          // запросов в одном вызове search
+        int batchDelayMicros = 200;     // сколько ждать добора пачки
+        size_t maxLineBytes = 1 << 20;  // длиннее - соединение закрывается
+    };
+
+    SearchDaemon(SearchServer& server, Options options);
+    explicit SearchDaemon(SearchServer& server) : SearchDaemon(server, Options()) { };
+    ~SearchDaemon();
+
+    SearchDaemon(const SearchDaemon&) = delete;
+    SearchDaemon& operator=(const SearchDaemon&) = delete;
+
+    // Слушать Unix-сокет socketPath до вызова Stop
+    void ServeSocket(const std::string& socketPath);
+
+    // Одно соединение поверх готовых дескрипторов (stdin/stdout). Завершается,
+    // когда вход закрыт и все ответы записаны, или по Stop.
+    void ServeStream(int inputFd, int outputFd);
+
+    // Плавная остановка: новые соединения не принимаются, принятые запросы
+    // выполняются, ответы дописываются. Можно вызывать из обработчика сигнала.
+    void Stop();
+
+    // Что делать по запросу перезагрузки индекса (например, IndexReloader::Request).
+    // Вызывается на сетевом потоке, поэтому не должен блокироваться.
+    void SetReloadHandler(std::function<void()> handler) { reloadHandler = std::move(handler); }
+
+    // Запросить перезагрузку индекса. Можно вызывать из обработчика сигнала (SIGHUP).
+    void RequestReload();
+
+    struct Stats {
+        uint64_t requests = 0;
+        uint64_t rejected = 0;
+        uint64_t batches = 0;
+    };
+    Stats GetStats() const;
+
+private:
+    struct Connection;
+    struct Slot;
+
+    struct Job {
+        std::shared_ptr<Slot> slot;
+        std::string id;       // JSON-значение id из запроса
+        std::string query;
+        std::string shard;    // строка запроса шарда; пустая - обычный запрос
+    };
+
+    SearchServer& server;
+    Options options;
+
+    int wakeRead = -1;
+    int wakeWrite = -1;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> reloadRequested{false};
+    std::function<void()> reloadHandler;
+
+    // Очередь запросов к рабочему потоку
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<Job> queue;
+    bool workerStop = false;
+    size_t inFlight = 0;          // принятые, но еще не выполненные запросы
+
+    // Готовые ответы от рабочего потока к сетевому циклу
+    std::mutex done_mutex;
+    std::vector<std::pair<std::shared_ptr<Slot>, std::string>> done;
+
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint64_t> batches{0};
+
+    void run(int listenFd, std::vector<std::unique_ptr<Connection>> connections);
+    void workerLoop();
+    void wake();
+    void handleLine(Connection& connection, const std::string& line);
+    void collectDone();
+    static bool flush(Connection& connection);
+    std::string handleShard(const InvertedIndex& index, const Job& job);
+    std::string formatResult(const InvertedIndex& index, const std::string& id, const std::string& query,
+                             const std::vector<RelativeIndex>& result) const;
+};
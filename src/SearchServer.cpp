@@ -1,113 +1,1062 @@
 #include "SearchServer.h"
-#include <sstream>
+#include "Intersection.h"
+#include "Metrics.h"
+#include "ShardCoordinator.h"
+#include "WordPattern.h"
 #include <algorithm>
-#include <map>
 #include <cmath>
-#include <set>
-#include <unordered_map>
+#include <atomic>
+#include <stdexcept>
+
+namespace {
+
+constexpr float BM25_K1 = 1.2f;
+constexpr float BM25_B = 0.75f;
+constexpr uint32_t END_OF_LIST = UINT32_MAX;
+
+// Насыщающая часть BM25: count вхождений в документе длины length,
+// lengthScale = b / средняя длина. Записана только монотонными операциями,
+// поэтому и в плавающей точке граница по (maxCount, minLength) блока
+// не меньше оценки любого документа блока
+float saturation(uint32_t count, uint32_t length, float lengthScale) {
+    float norm = BM25_K1 * (1.0f - BM25_B + static_cast<float>(length) * lengthScale);
+    return (BM25_K1 + 1.0f) / (1.0f + norm / static_cast<float>(count));
+}
+
+// Первый блок начиная с from, где может быть doc_id >= target (count - таких нет)
+uint32_t findBlock(const SkipEntry* skips, uint32_t from, uint32_t count, uint32_t target) {
+    uint32_t step = 1;
+    uint32_t low = from;
+    while (low < count && skips[low].lastDocId < target) {
+        from = low + 1;
+        low += step;
+        step *= 2;
+    }
+    // Ответ в [from, min(low, count)]
+    uint32_t high = std::min(low, count);
+    while (from < high) {
+        uint32_t middle = from + (high - from) / 2;
+        if (skips[middle].lastDocId < target) {
+            from = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return from;
+}
+
+}
+
+std::shared_ptr<InvertedIndex> SearchServer::SetIndex(std::shared_ptr<InvertedIndex> idx) {
+    // Кэш сбрасывать не нужно: поколения снимков уникальны в пределах процесса,
+    // записи старого индекса просто перестают совпадать
+    return std::atomic_exchange(&_index, std::move(idx));
+}
 
 std::vector<std::vector<RelativeIndex>> SearchServer::search(const std::vector<std::string>& queries_input) {
-    std::vector<std::vector<RelativeIndex>> result;
+    return search(*GetIndex(), queries_input);
+}
+
+std::vector<std::vector<RelativeIndex>> SearchServer::search(const InvertedIndex& index,
+                                                             const std::vector<std::string>& queries_input) {
+    // Результат каждого запроса пишется в свою заранее созданную ячейку,
+    // поэтому порядок ответов совпадает с порядком запросов
+    std::vector<std::vector<RelativeIndex>> result(queries_input.size());
+
+    // Весь пакет запросов выполняется на одном снимке индекса. Снимок держит
+    // свои сегменты сам, поэтому подмена индекса (SetIndex) пакету не мешает
+    auto snapshot = index.GetSnapshot();
 
-    for (const auto& query : queries_input) {
-        result.push_back(processQuery(query));
+    if (!_pool || queries_input.size() < 2) {
+        auto scratch = acquireScratch();
+        for (size_t i = 0; i < queries_input.size(); ++i) {
+            processQuery(*snapshot, queries_input[i], *scratch, result[i]);
+        }
+        releaseScratch(std::move(scratch));
+        return result;
     }
 
+    // Каждый поток забирает из общего счетчика небольшие порции запросов:
+    // освободившийся поток сразу берет следующую порцию, и длинные запросы
+    // не задерживают тех, кто уже закончил свою часть
+    size_t workers = std::min(_pool->Size(), queries_input.size());
+    size_t chunk = std::max<size_t>(1, std::min<size_t>(64, queries_input.size() / (workers * 8)));
+    std::atomic<size_t> nextQuery{0};
+
+    _pool->ParallelFor(workers, [&](size_t) {
+        auto scratch = acquireScratch();
+        while (true) {
+            size_t begin = nextQuery.fetch_add(chunk);
+            if (begin >= queries_input.size()) {
+                break;
+            }
+            size_t end = std::min(begin + chunk, queries_input.size());
+            for (size_t i = begin; i < end; ++i) {
+                processQuery(*snapshot, queries_input[i], *scratch, result[i]);
+            }
+        }
+        releaseScratch(std::move(scratch));
+    });
+
     return result;
 }
 
-std::vector<RelativeIndex> SearchServer::processQuery(const std::string& query) {
-    std::stringstream ss(query);
-    std::string word;
-    std::vector<std::string> words;
+void SearchServer::Search(const std::string& query, std::vector<RelativeIndex>& result) {
+    auto snapshot = GetIndex()->GetSnapshot();
+    auto scratch = acquireScratch();
+    processQuery(*snapshot, query, *scratch, result);
+    releaseScratch(std::move(scratch));
+}
 
-    // Разбиваем запрос на слова
-    while (ss >> word) {
-        if (word.length() > 100) continue;
-        words.push_back(word);
+std::unique_ptr<SearchServer::QueryScratch> SearchServer::acquireScratch() {
+    {
+        std::lock_guard<std::mutex> lock(_scratchMutex);
+        if (!_scratchPool.empty()) {
+            auto scratch = std::move(_scratchPool.back());
+            _scratchPool.pop_back();
+            return scratch;
+        }
     }
+    return std::make_unique<QueryScratch>();
+}
 
-    if (words.empty()) {
-        return {};
+void SearchServer::releaseScratch(std::unique_ptr<QueryScratch> scratch) {
+    std::lock_guard<std::mutex> lock(_scratchMutex);
+    _scratchPool.push_back(std::move(scratch));
+}
+
+void SearchServer::SetSearchThreads(size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = ThreadPool::DefaultThreadCount();
+    }
+    if (threadCount == 1) {
+        _pool.reset();
+    } else if (!_pool || _pool->Size() != threadCount) {
+        _pool = std::make_unique<ThreadPool>(threadCount);
     }
+}
+
+void SearchServer::RunParallel(size_t count, const std::function<void(size_t)>& body) {
+    if (!_pool || count < 2) {
+        for (size_t i = 0; i < count; ++i) {
+            body(i);
+        }
+        return;
+    }
+    _pool->ParallelFor(count, body);
+}
+
+bool SearchServer::scoredBefore(const RelativeIndex& a, const RelativeIndex& b) {
+    return a.rank > b.rank || (a.rank == b.rank && a.doc_id < b.doc_id);
+}
+
+float SearchServer::normalizedRank(float score, float best) {
+    float rank = best > 0 ? score / best : 0;
+    // Округляем для избежания проблем с точностью float
+    return std::round(rank * 1000.0f) / 1000.0f;
+}
+
+bool SearchServer::rankedBefore(const RelativeIndex& a, const RelativeIndex& b) {
+    // Сначала сравниваем по rank (убывание)
+    if (std::abs(a.rank - b.rank) > 0.0001f) {
+        return a.rank > b.rank;
+    }
+    // При равной релевантности - по возрастанию doc_id
+    return a.doc_id < b.doc_id;
+}
+
+void SearchServer::intersectSegment(const SegmentRef& segment, QueryScratch& scratch) {
+    SE_METRICS_TIMER(Intersect);
+    std::vector<PostingsList>& lists = scratch.lists;
+    std::vector<float>& weights = scratch.listWeights;
+    std::vector<uint32_t>& order = scratch.listOrder;
+    std::vector<uint32_t>& candidates = scratch.candidates;
+    std::vector<float>& relevance = scratch.relevance;
+    std::vector<uint32_t>& matchCandidate = scratch.matchCandidate;
+    std::vector<uint32_t>& matchPosting = scratch.matchPosting;
+
+    // Самый короткий список задает кандидатов, остальные пересекаются по возрастанию длины
+    order.resize(lists.size());
+    for (uint32_t l = 0; l < order.size(); ++l) {
+        order[l] = l;
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return lists[a].size() < lists[b].size(); });
+
+    candidates.clear();
+    relevance.clear();
+    float weight = weights[order[0]];
+    for (PostingsCursor cursor(lists[order[0]]); cursor.Valid(); cursor.NextBlock()) {
+        for (size_t i = 0; i < cursor.BlockSize(); ++i) {
+            if (segment.IsLive(cursor.Docs()[i])) {
+                candidates.push_back(cursor.Docs()[i]);
+                relevance.push_back(static_cast<float>(cursor.Counts()[i]) * weight);
+            }
+        }
+    }
+
+    matchCandidate.resize(PostingsCodec::BLOCK_SIZE);
+    matchPosting.resize(PostingsCodec::BLOCK_SIZE);
+    size_t scanned = lists[order[0]].size();
+
+    for (size_t l = 1; l < lists.size() && !candidates.empty(); ++l) {
+        PostingsCursor cursor(lists[order[l]]);
+        weight = weights[order[l]];
+        size_t next = 0;       // первый непроверенный кандидат
+        size_t kept = 0;       // выжившие кандидаты сдвигаются в начало массивов
+
+        // Кандидаты пересекаются с блоком, в диапазон которого попадают;
+        // блоки без кандидатов пропускаются по таблице пропусков без распаковки
+        while (next < candidates.size() && cursor.SeekBlock(candidates[next])) {
+            size_t end = static_cast<size_t>(std::upper_bound(candidates.begin() + next, candidates.end(),
+                                                              cursor.BlockLastDoc()) - candidates.begin());
+            size_t found = Intersection::Intersect(candidates.data() + next, end - next,
+                                                   cursor.Docs(), cursor.BlockSize(),
+                                                   matchCandidate.data(), matchPosting.data());
+            for (size_t k = 0; k < found; ++k) {
+                size_t from = next + matchCandidate[k];
+                candidates[kept] = candidates[from];
+                relevance[kept] = relevance[from] + static_cast<float>(cursor.Counts()[matchPosting[k]]) * weight;
+                ++kept;
+            }
+            scanned += cursor.BlockSize();
+            next = end;
+            cursor.NextBlock();
+        }
+
+        candidates.resize(kept);
+        relevance.resize(kept);
+    }
+
+    // Фразы проверяются только у документов, прошедших пересечение
+    bool phrases = !scratch.phrases.empty();
+    bool positional = segment.segment->HasPositions();
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (!phrases || matchPhrases(scratch, candidates[i], positional)) {
+            scratch.docRelevance.emplace_back(candidates[i], relevance[i]);
+        }
+    }
+    SE_METRICS_ADD(PostingsScanned, scanned);
+}
+
+bool SearchServer::preparePhrases(const IndexSegment& segment, QueryScratch& scratch) {
+    scratch.phraseCursors.resize(scratch.phraseWords.size());
+    for (size_t k = 0; k < scratch.phraseWords.size(); ++k) {
+        PostingsList list = segment.Find(scratch.phraseWords[k]);
+        if (list.empty()) {
+            return false;
+        }
+        scratch.phraseCursors[k] = PostingsCursor(list);
+    }
+    return true;
+}
+
+bool SearchServer::matchPhrases(QueryScratch& scratch, uint32_t doc_id, bool positional) {
+    std::vector<uint32_t>& starts = scratch.phraseStarts;
+    std::vector<uint32_t>& positions = scratch.phrasePositions;
+    for (const auto& [begin, end] : scratch.phrases) {
+        for (size_t k = begin; k < end; ++k) {
+            PostingsCursor& cursor = scratch.phraseCursors[k];
+            if (!cursor.Advance(doc_id) || cursor.DocId() != doc_id) {
+                return false;
+            }
+        }
+        if (!positional) {
+            continue;
+        }
+
+        // Начала фразы - позиции первого слова, у которых k-е слово стоит на позиции + k.
+        // Позиции по возрастанию, поэтому каждое слово сверяется одним слиянием
+        scratch.phraseCursors[begin].Positions(starts);
+        for (size_t k = begin + 1; k < end && !starts.empty(); ++k) {
+            scratch.phraseCursors[k].Positions(positions);
+            uint32_t shift = static_cast<uint32_t>(k - begin);
+            size_t kept = 0;
+            size_t j = 0;
+            for (uint32_t start : starts) {
+                while (j < positions.size() && positions[j] < start + shift) {
+                    ++j;
+                }
+                if (j < positions.size() && positions[j] == start + shift) {
+                    starts[kept++] = start;
+                }
+            }
+            starts.resize(kept);
+        }
+        if (starts.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SearchServer::SetCacheCapacity(size_t bytes) {
+    if (bytes != _cache->Capacity()) {
+        _cache = std::make_unique<QueryCache>(bytes);
+    }
+}
+
+void SearchServer::SetShards(std::vector<std::shared_ptr<SearchShard>> shards) {
+    _shards = shards.empty() ? nullptr : std::make_shared<ShardCoordinator>(std::move(shards));
+}
+
+void SearchServer::CollectShardStats(const InvertedIndex& index, const ShardQuery& query, ShardStats& stats) {
+    auto snapshot = index.GetSnapshot();
+    auto scratch = acquireScratch();
+    parseQuery(query.query, *scratch);
+    stats.documents = snapshot->LiveDocumentCount();
+    stats.totalLength = snapshot->TotalLength();
+    stats.terms.clear();
+    stats.expansions.clear();
+
+    // Различные слова запроса. До решений координатора у шаблонов и у слов,
+    // которых нет в шарде, собираются все кандидаты раскрытия; после - частота
+    // раскрытого слова считается по объединению списков выбранных слов
+    std::vector<std::string_view>& words = scratch->words;
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    if (query.planned && expandWords(*snapshot, *scratch, &query) && scratch->unions.empty()) {
+        scratch->unions.resize(1);
+    }
+    PatternExpansion candidates;
+    auto addCandidates = [&](std::string_view word) {
+        ShardExpansion expansion;
+        expansion.word = std::string(word);
+        expansion.distance = candidates.distance;
+        for (size_t i = 0; i < candidates.Size(); ++i) {
+            expansion.terms.emplace_back(std::string(candidates.Term(i)), candidates.matches[i].frequency);
+        }
+        stats.expansions.push_back(std::move(expansion));
+    };
 
-    // Шаг 1: Получаем документы, содержащие каждое слово
-    std::vector<std::vector<Entry>> wordEntriesList;
-    
     for (const auto& word : words) {
-        auto wordEntries = _index->GetWordCount(word);
-        if (wordEntries.empty()) {
-            // Если хотя бы одно слово не найдено ни в одном документе - возвращаем пустой результат
-            return {};
+        const PatternExpansion* expansion = query.planned ? expansionOf(*scratch, word) : nullptr;
+        if (!query.planned && WordPattern::IsPattern(word)) {
+            snapshot->ExpandPattern(word, 0, candidates);
+            addCandidates(word);
+            continue;
+        }
+
+        ShardTerm term;
+        term.word = std::string(word);
+        for (const auto& ref : snapshot->Segments()) {
+            PostingsList list = expansion ? unionPattern(*ref.segment, *expansion, *scratch, scratch->unions[0])
+                                          : ref.segment->Find(word);
+            term.frequency += list.size();
+            term.known = term.known || ref.segment->Terms().Find(word) != FrontCodedDictionary::npos;
+        }
+        stats.terms.push_back(term);
+
+        uint32_t distance = fuzzyDistanceFor(word, query.fuzzyDistance);
+        if (!query.planned && !term.known && distance > 0) {
+            snapshot->ExpandFuzzy(word, distance, 0, candidates);
+            addCandidates(word);
         }
-        wordEntriesList.push_back(wordEntries);
     }
+    releaseScratch(std::move(scratch));
+}
 
-    // Шаг 2: Находим документы, содержащие ВСЕ слова (AND логика)
-    // Начинаем с первого множества документов
-    std::map<size_t, float> docRelevance;
-    
-    if (!wordEntriesList.empty()) {
-        // Используем первый список слов как базовый
-        for (const auto& entry : wordEntriesList[0]) {
-            docRelevance[entry.doc_id] = static_cast<float>(entry.count);
-        }
-        
-        // Пересекаем с остальными списками
-        for (size_t i = 1; i < wordEntriesList.size(); ++i) {
-            std::map<size_t, float> tempRelevance;
-            
-            for (const auto& entry : wordEntriesList[i]) {
-                // Если документ есть в текущем результате, добавляем его
-                if (docRelevance.find(entry.doc_id) != docRelevance.end()) {
-                    tempRelevance[entry.doc_id] = docRelevance[entry.doc_id] + static_cast<float>(entry.count);
+void SearchServer::ShardSearch(const InvertedIndex& index, const ShardQuery& query, ShardHits& hits) {
+    auto snapshot = index.GetSnapshot();
+    auto scratch = acquireScratch();
+    parseQuery(query.query, *scratch);
+    hits.tail = 0;
+    if (query.ranking == Ranking::BM25) {
+        rankBm25(*snapshot, *scratch, &query, hits.hits);
+    } else {
+        hits.tail = rankQuery(*snapshot, *scratch, &query, hits.hits);
+    }
+    releaseScratch(std::move(scratch));
+}
+
+void SearchServer::parseQuery(const std::string& query, QueryScratch& scratch) {
+    // Слова запроса нормализуются тем же токенизатором, что и документы.
+    // Кавычки остаются частью слов (разделители - только пробелы), поэтому
+    // начало и конец фразы - кавычка в начале и в конце слова
+    scratch.words.clear();
+    scratch.phraseWords.clear();
+    scratch.phrases.clear();
+    scratch.tokenizer.Reset(query);
+    std::string_view word;
+    bool inPhrase = false;
+    size_t phraseBegin = 0;
+    auto closePhrase = [&]() {
+        // Фраза из одного слова - обычное слово
+        if (scratch.phraseWords.size() - phraseBegin >= 2) {
+            scratch.phrases.emplace_back(phraseBegin, scratch.phraseWords.size());
+        } else {
+            scratch.phraseWords.resize(phraseBegin);
+        }
+        inPhrase = false;
+    };
+    while (scratch.tokenizer.Next(word)) {
+        if (!inPhrase && word.front() == '"') {
+            word.remove_prefix(1);
+            inPhrase = true;
+            phraseBegin = scratch.phraseWords.size();
+        }
+        bool closes = inPhrase && !word.empty() && word.back() == '"';
+        if (closes) {
+            word.remove_suffix(1);
+        }
+        if (!word.empty()) {
+            scratch.words.push_back(word);
+            if (inPhrase) {
+                scratch.phraseWords.push_back(word);
+            }
+        }
+        if (closes) {
+            closePhrase();
+        }
+    }
+    // Незакрытая кавычка продолжает фразу до конца запроса
+    if (inPhrase) {
+        closePhrase();
+    }
+}
+
+std::string SearchServer::GetSnippet(size_t doc_id, const std::string& query) const {
+    return GetSnippet(*GetIndex(), doc_id, query);
+}
+
+std::string SearchServer::GetSnippet(const InvertedIndex& index, size_t doc_id, const std::string& query) const {
+    if (_shards) {
+        return _snippetLength == 0 ? std::string() : _shards->GetSnippet(doc_id, query);
+    }
+    auto store = index.GetDocumentStore();
+    std::string text;
+    if (!store || _snippetLength == 0 || !store->Get(doc_id, text)) {
+        return std::string();
+    }
+
+    // Слова запроса нормализуются как в parseQuery, кавычки фраз отбрасываются
+    std::vector<std::string> words;
+    Tokenizer tokenizer;
+    tokenizer.Reset(query);
+    std::string_view word;
+    while (tokenizer.Next(word)) {
+        if (word.front() == '"') {
+            word.remove_prefix(1);
+        }
+        if (!word.empty() && word.back() == '"') {
+            word.remove_suffix(1);
+        }
+        if (!word.empty()) {
+            words.emplace_back(word);
+        }
+    }
+    return Snippet::Make(text, words, _snippetLength);
+}
+
+void SearchServer::SetFuzzyDistance(uint32_t distance) {
+    if (distance > FuzzyIndex::MAX_DISTANCE) {
+        throw std::invalid_argument("fuzzy distance must not exceed " + std::to_string(FuzzyIndex::MAX_DISTANCE));
+    }
+    _fuzzyDistance = distance;
+}
+
+void SearchServer::SetFuzzyPenalty(float penalty) {
+    if (!(penalty > 0.0f && penalty <= 1.0f)) {
+        throw std::invalid_argument("fuzzy penalty must be in (0, 1]");
+    }
+    _fuzzyPenalty = penalty;
+}
+
+uint32_t SearchServer::fuzzyDistanceFor(std::string_view word, uint32_t distance) {
+    size_t chars = 0;
+    for (char byte : word) {
+        chars += (static_cast<unsigned char>(byte) & 0xC0) != 0x80;
+    }
+    uint32_t allowed = chars < 3 ? 0 : chars < 6 ? 1 : 2;
+    return std::min(allowed, distance);
+}
+
+bool SearchServer::expandWords(const IndexSnapshot& snapshot, QueryScratch& scratch, const ShardQuery* shard) const {
+    std::vector<std::string_view>& expanded = scratch.expanded;
+    expanded.clear();
+    if (shard != nullptr && shard->planned) {
+        // Слова раскрытий выбраны координатором по всем шардам
+        for (const auto& planned : shard->expansions) {
+            size_t i = expanded.size();
+            expanded.push_back(planned.word);
+            if (scratch.expansions.size() < expanded.size()) {
+                scratch.expansions.resize(expanded.size());
+            }
+            PatternExpansion& expansion = scratch.expansions[i];
+            expansion.Clear();
+            for (const auto& [term, frequency] : planned.terms) {
+                expansion.matches.push_back({expansion.pool.size(), term.size(), static_cast<size_t>(frequency)});
+                expansion.pool += term;
+            }
+            expansion.total = expansion.matches.size();
+            expansion.distance = planned.distance;
+        }
+        return !expanded.empty();
+    }
+    for (const auto& word : scratch.words) {
+        if (std::find(expanded.begin(), expanded.end(), word) != expanded.end()) {
+            continue;
+        }
+        bool pattern = WordPattern::IsPattern(word);
+        uint32_t distance = pattern ? 0 : fuzzyDistanceFor(word, _fuzzyDistance);
+        if (!pattern && distance == 0) {
+            continue;
+        }
+        // Исправляется только слово, которого нет ни в одном сегменте
+        if (!pattern && std::any_of(snapshot.Segments().begin(), snapshot.Segments().end(), [&](const SegmentRef& ref) {
+                return ref.segment->Terms().Find(word) != FrontCodedDictionary::npos;
+            })) {
+            continue;
+        }
+
+        size_t i = expanded.size();
+        expanded.push_back(word);
+        if (scratch.expansions.size() < expanded.size()) {
+            scratch.expansions.resize(expanded.size());
+        }
+        if (pattern) {
+            snapshot.ExpandPattern(word, _maxExpansions, scratch.expansions[i]);
+            SE_METRICS_ADD(PatternTerms, scratch.expansions[i].Size());
+        } else {
+            snapshot.ExpandFuzzy(word, distance, _maxFuzzyTerms, scratch.expansions[i]);
+            SE_METRICS_ADD(FuzzyTerms, scratch.expansions[i].Size());
+        }
+    }
+    return !expanded.empty();
+}
+
+const PatternExpansion* SearchServer::expansionOf(const QueryScratch& scratch, std::string_view word) {
+    auto it = std::find(scratch.expanded.begin(), scratch.expanded.end(), word);
+    if (it == scratch.expanded.end()) {
+        return nullptr;
+    }
+    return &scratch.expansions[static_cast<size_t>(it - scratch.expanded.begin())];
+}
+
+float SearchServer::expansionWeight(const PatternExpansion* expansion, float penalty) {
+    if (expansion == nullptr || expansion->distance == 0) {
+        return 1.0f;
+    }
+    return std::pow(penalty, static_cast<float>(expansion->distance));
+}
+
+PostingsList SearchServer::unionPattern(const IndexSegment& segment, const PatternExpansion& expansion,
+                                        QueryScratch& scratch, PatternUnion& out) {
+    std::vector<PostingsCursor>& cursors = scratch.unionCursors;
+    cursors.clear();
+    PostingsList single;
+    size_t total = 0;
+    uint32_t firstDoc = UINT32_MAX;
+    uint32_t lastDoc = 0;
+    for (size_t t = 0; t < expansion.Size(); ++t) {
+        PostingsList list = segment.Find(expansion.Term(t));
+        if (!list.empty()) {
+            single = list;
+            cursors.emplace_back(list);
+            total += list.size();
+            firstDoc = std::min(firstDoc, cursors.back().DocId());
+            lastDoc = std::max(lastDoc, list.Skips()[list.BlockCount() - 1].lastDocId);
+        }
+    }
+    // Одно слово из раскрытия - его список как есть
+    if (cursors.size() <= 1) {
+        return single;
+    }
+
+    std::vector<Posting>& postings = scratch.unionPostings;
+    postings.clear();
+    size_t range = static_cast<size_t>(lastDoc - firstDoc) + 1;
+    if (range <= total * 32) {
+        // Счетчики по doc_id в массиве: списки распаковываются целыми блоками
+        // без кучи. Обнулить и просмотреть элемент массива намного дешевле,
+        // чем провести постинг через кучу из десятков курсоров, поэтому
+        // массив выгоден и при довольно редких списках
+        std::vector<uint32_t>& counts = scratch.unionCounts;
+        counts.assign(range, 0);
+        for (PostingsCursor& cursor : cursors) {
+            for (; cursor.Valid(); cursor.NextBlock()) {
+                for (size_t i = 0; i < cursor.BlockSize(); ++i) {
+                    counts[cursor.Docs()[i] - firstDoc] += cursor.Counts()[i];
                 }
             }
-            
-            docRelevance = std::move(tempRelevance);
-            
-            // Если после пересечения не осталось документов, возвращаем пустой результат
-            if (docRelevance.empty()) {
-                return {};
+        }
+        for (size_t i = 0; i < range; ++i) {
+            if (counts[i] != 0) {
+                postings.push_back({static_cast<uint32_t>(firstDoc + i), counts[i]});
+            }
+        }
+    } else {
+        mergeCursors(cursors, scratch.unionHeap, postings);
+    }
+
+    // Границы блоков для BM25; без сплошного диапазона doc_id таблицы длин
+    // нет, и minLength блоков остается нулевым (граница грубее, но верна)
+    DocLengthTable lengths;
+    const auto& ids = segment.DocIds();
+    if (!ids.empty() && ids.back() - ids.front() + 1 == ids.size()) {
+        lengths = {segment.DocLengths().data(), ids.front()};
+    }
+    out.skips.clear();
+    out.data.clear();
+    PostingsCodec::Encode(postings.data(), postings.size(), out.skips, out.data, 0, lengths);
+    return PostingsList(out.skips.data(), static_cast<uint32_t>(out.skips.size()), out.data.data());
+}
+
+void SearchServer::mergeCursors(std::vector<PostingsCursor>& cursors, std::vector<size_t>& heap,
+                                std::vector<Posting>& postings) {
+    // Слияние k списков кучей по текущему doc_id
+    auto later = [&cursors](size_t a, size_t b) { return cursors[a].DocId() > cursors[b].DocId(); };
+    heap.clear();
+    for (size_t c = 0; c < cursors.size(); ++c) {
+        heap.push_back(c);
+    }
+    std::make_heap(heap.begin(), heap.end(), later);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        PostingsCursor& cursor = cursors[heap.back()];
+        if (!postings.empty() && postings.back().doc_id == cursor.DocId()) {
+            postings.back().count += cursor.Count();
+        } else {
+            postings.push_back({cursor.DocId(), cursor.Count()});
+        }
+        if (cursor.Next()) {
+            std::push_heap(heap.begin(), heap.end(), later);
+        } else {
+            heap.pop_back();
+        }
+    }
+}
+
+void SearchServer::processQuery(const IndexSnapshot& snapshot, const std::string& query, QueryScratch& scratch,
+                                std::vector<RelativeIndex>& result) const {
+    SE_METRICS_TIMER(ProcessQuery);
+    SE_METRICS_ADD(Queries, 1);
+    if (_shards) {
+        _shards->Search(*this, query, result);
+        return;
+    }
+    parseQuery(query, scratch);
+    auto rank = [&]() {
+        if (_ranking == Ranking::BM25) {
+            rankBm25(snapshot, scratch, nullptr, result);
+        } else {
+            rankQuery(snapshot, scratch, nullptr, result);
+        }
+    };
+    if (!_cache->Enabled()) {
+        rank();
+        return;
+    }
+
+    // Нормализованный ключ: слова по алфавиту (повторы сохраняются - они
+    // влияют на релевантность), фразы, лимит ответов и способ ранжирования.
+    // Порядок слов вне фраз на ранжирование не влияет.
+    std::vector<std::string_view>& words = scratch.words;
+    std::sort(words.begin(), words.end());
+
+    std::string& key = scratch.cacheKey;
+    key.clear();
+    for (const auto& w : words) {
+        key += w;
+        key += ' ';
+    }
+    for (const auto& [begin, end] : scratch.phrases) {
+        key += '"';
+        for (size_t k = begin; k < end; ++k) {
+            key += scratch.phraseWords[k];
+            key += k + 1 < end ? ' ' : '"';
+        }
+    }
+    key += std::to_string(_maxResponses);
+    key += _ranking == Ranking::BM25 ? 'b' : 'a';
+    if (std::any_of(words.begin(), words.end(), WordPattern::IsPattern)) {
+        // Раскрытие шаблона зависит от ограничения на число слов
+        key += 'e';
+        key += std::to_string(_maxExpansions);
+    }
+    if (_fuzzyDistance > 0) {
+        // Любое слово запроса может оказаться исправленным
+        key += 'f';
+        key += std::to_string(_fuzzyDistance);
+        key += '/';
+        key += std::to_string(_fuzzyPenalty);
+        key += '/';
+        key += std::to_string(_maxFuzzyTerms);
+    }
+
+    if (auto cached = _cache->Find(key, snapshot.Generation())) {
+        result.assign(cached->begin(), cached->end());
+        return;
+    }
+
+    rank();
+    auto entry = std::make_shared<const std::vector<RelativeIndex>>(result);
+    _cache->Insert(key, snapshot.Generation(), entry, entry->size() * sizeof(RelativeIndex));
+}
+
+float SearchServer::rankQuery(const IndexSnapshot& snapshot, QueryScratch& scratch, const ShardQuery* shard,
+                              std::vector<RelativeIndex>& result) const {
+    result.clear();
+    const std::vector<std::string_view>& words = scratch.words;
+    if (words.empty()) {
+        return 0;
+    }
+    float penalty = shard ? shard->fuzzyPenalty : _fuzzyPenalty;
+
+    // Документ целиком лежит в одном сегменте, поэтому пересечение
+    // выполняется в каждом сегменте отдельно, а результаты объединяются
+    std::vector<std::pair<size_t, float>>& docRelevance = scratch.docRelevance;
+    std::vector<PostingsList>& wordEntriesList = scratch.lists;
+    docRelevance.clear();
+
+    // Шаблон (и исправляемое слово) раскрывается один раз на запрос;
+    // у каждого вхождения слова свой буфер объединенного списка
+    if (expandWords(snapshot, scratch, shard) && scratch.unions.size() < words.size()) {
+        scratch.unions.resize(words.size());
+    }
+
+    for (const auto& segment : snapshot.Segments()) {
+        // Шаг 1: Получаем сжатые постинг-листы сегмента для каждого слова
+        wordEntriesList.clear();
+        scratch.listWeights.clear();
+        bool allFound = true;
+
+        for (size_t w = 0; w < words.size(); ++w) {
+            const std::string_view& word = words[w];
+            const PatternExpansion* expansion = expansionOf(scratch, word);
+            PostingsList wordEntries = expansion
+                    ? unionPattern(*segment.segment, *expansion, scratch, scratch.unions[w])
+                    : segment.segment->Find(word);
+            if (wordEntries.empty()) {
+                // Слово не встречается в сегменте - в нем нет подходящих документов
+                allFound = false;
+                break;
             }
+            wordEntriesList.push_back(wordEntries);
+            scratch.listWeights.push_back(expansionWeight(expansion, penalty));
+        }
+
+        // Шаг 2: Находим документы, содержащие ВСЕ слова (AND логика)
+        // и все фразы запроса
+        if (allFound && (scratch.phrases.empty() || preparePhrases(*segment.segment, scratch))) {
+            intersectSegment(segment, scratch);
         }
     }
 
     // Шаг 3: Рассчитываем итоговую релевантность для оставшихся документов
     // (уже суммировали вхождения во время пересечения)
     
+    SE_METRICS_ADD(DocumentsScored, docRelevance.size());
+
     // Если не нашли ни одного документа, возвращаем пустой результат
     if (docRelevance.empty()) {
-        return {};
+        return 0;
     }
 
-    // Шаг 4: Находим максимальную релевантность для нормализации
-    float maxRelevance = 0.0f;
-    for (const auto& [doc_id, relevance] : docRelevance) {
-        if (relevance > maxRelevance) {
-            maxRelevance = relevance;
+    // Шаг 4: Находим максимальную релевантность для нормализации. Шарду
+    // общий максимум сообщает координатор; пока он неизвестен, шард отбирает
+    // документы по сырой релевантности
+    bool raw = shard && shard->maxRelevance == 0;
+    float maxRelevance = shard ? shard->maxRelevance : 0.0f;
+    if (!shard) {
+        for (const auto& [doc_id, relevance] : docRelevance) {
+            if (relevance > maxRelevance) {
+                maxRelevance = relevance;
+            }
         }
     }
 
-    // Шаг 5: Формируем результат с нормализованной релевантностью
-    std::vector<RelativeIndex> result;
+    // Шаг 5: Формируем результат с нормализованной релевантностью.
+    // При ограничении числа ответов держим кучу из K лучших (на вершине худший
+    // из них), так что сортируются только попавшие в ответ документы
+    auto before = raw ? scoredBefore : rankedBefore;
+    size_t maxResponses = shard ? shard->maxResponses : _maxResponses;
+    size_t limit = maxResponses == 0 ? docRelevance.size() : std::min(maxResponses, docRelevance.size());
+    float tail = 0;     // лучшая сырая релевантность среди не попавших в ответ
+    result.reserve(limit);
     for (auto& [doc_id, relevance] : docRelevance) {
-        float normalizedRank = (maxRelevance > 0) ? (relevance / maxRelevance) : 0;
-        // Округляем для избежания проблем с точностью float
-        normalizedRank = std::round(normalizedRank * 1000.0f) / 1000.0f;
-        result.push_back({doc_id, normalizedRank});
+        RelativeIndex entry{doc_id, raw ? relevance : normalizedRank(relevance, maxRelevance)};
+
+        if (result.size() < limit) {
+            result.push_back(entry);
+            if (limit < docRelevance.size()) {
+                std::push_heap(result.begin(), result.end(), before);
+            }
+        } else if (before(entry, result.front())) {
+            std::pop_heap(result.begin(), result.end(), before);
+            tail = std::max(tail, result.back().rank);
+            result.back() = entry;
+            std::push_heap(result.begin(), result.end(), before);
+        } else {
+            tail = std::max(tail, entry.rank);
+        }
     }
 
     // Шаг 6: Сортируем по убыванию релевантности (как требует ТЗ)
-    std::sort(result.begin(), result.end(),
-              [](const RelativeIndex& a, const RelativeIndex& b) {
-                  // Сначала сравниваем по rank (убывание)
-                  if (std::abs(a.rank - b.rank) > 0.0001f) {
-                      return a.rank > b.rank;
-                  }
-                  // При равной релевантности - по возрастанию doc_id
-                  return a.doc_id < b.doc_id;
-              });
+    if (limit < docRelevance.size()) {
+        std::sort_heap(result.begin(), result.end(), before);
+    } else {
+        std::sort(result.begin(), result.end(), before);
+    }
+    return raw ? tail : 0;
+}
 
-    return result;
-}
\ No newline at end of file
+void SearchServer::rankBm25(const IndexSnapshot& snapshot, QueryScratch& scratch, const ShardQuery* shard,
+                            std::vector<RelativeIndex>& result) const {
+    result.clear();
+
+    // Повторы слова в запросе не дают отдельных курсоров, а умножают вес слова
+    std::vector<std::string_view>& words = scratch.words;
+    std::vector<float>& weights = scratch.weights;
+    std::sort(words.begin(), words.end());
+    weights.clear();
+    size_t unique = 0;
+    for (const auto& word : words) {
+        if (unique > 0 && words[unique - 1] == word) {
+            weights[unique - 1] += 1.0f;
+            continue;
+        }
+        words[unique++] = word;
+        weights.push_back(1.0f);
+    }
+    words.resize(unique);
+    // Шард считает idf и длины по статистике всей коллекции от координатора
+    double documents = static_cast<double>(shard ? shard->documents : snapshot.LiveDocumentCount());
+    if (words.empty() || documents == 0) {
+        return;
+    }
+
+    // Постинг-листы слов во всех сегментах (lists[w * сегментов + s]) и idf.
+    // Частота слова считается по спискам целиком, вместе с еще не слитыми
+    // удаленными документами - как в Lucene; ограничение сверху числом
+    // документов держит idf положительным. Шаблон - одно слово запроса
+    // с объединенным списком своего раскрытия: вхождения в документ
+    // складываются, частота - число документов хотя бы с одним из слов.
+    // Исправленное слово - так же, его вес еще умножается на штраф за правки
+    const auto& segments = snapshot.Segments();
+    if (expandWords(snapshot, scratch, shard) && scratch.unions.size() < words.size() * segments.size()) {
+        scratch.unions.resize(words.size() * segments.size());
+    }
+    std::vector<PostingsList>& lists = scratch.lists;
+    lists.clear();
+    float penalty = shard ? shard->fuzzyPenalty : _fuzzyPenalty;
+    for (size_t w = 0; w < words.size(); ++w) {
+        size_t frequency = 0;
+        const PatternExpansion* expansion = expansionOf(scratch, words[w]);
+        for (const auto& segment : segments) {
+            lists.push_back(expansion
+                    ? unionPattern(*segment.segment, *expansion, scratch, scratch.unions[lists.size()])
+                    : segment.segment->Find(words[w]));
+            frequency += lists.back().size();
+        }
+        if (shard) {
+            auto term = std::find_if(shard->terms.begin(), shard->terms.end(),
+                                     [&](const ShardTerm& t) { return t.word == words[w]; });
+            frequency = term == shard->terms.end() ? 0 : static_cast<size_t>(term->frequency);
+        }
+        double df = std::min(static_cast<double>(frequency), documents);
+        weights[w] *= static_cast<float>(std::log(1.0 + (documents - df + 0.5) / (df + 0.5))) *
+                      expansionWeight(expansion, penalty);
+    }
+    double averageLength = shard ? shard->averageLength : snapshot.AverageLength();
+    float lengthScale = averageLength > 0 ? static_cast<float>(BM25_B / averageLength) : 0.0f;
+
+    // rank округляется до 0.001 лучшей оценки, поэтому документ чуть ниже
+    // K-го по сырой оценке может сравняться с ним и обойти его по doc_id.
+    // Лучшая оценка заранее неизвестна; сверху ее ограничивает сумма весов
+    // слов при насыщении k1 + 1 - одна и та же во всех сегментах и шардах
+    float slack = 0;
+    for (float weight : weights) {
+        slack += weight * (BM25_K1 + 1.0f);
+    }
+    slack *= 0.0011f;
+    scratch.ties.clear();
+
+    // Порог отбора общий для всех сегментов: документы первых сегментов
+    // поднимают его, и в следующих пропускается больше
+    size_t limit = shard ? shard->maxResponses : _maxResponses;
+    size_t scored = 0;
+    for (size_t s = 0; s < segments.size(); ++s) {
+        // Фразы обязательны: сегмент без какого-то их слова пропускается
+        if (!scratch.phrases.empty() && !preparePhrases(*segments[s].segment, scratch)) {
+            continue;
+        }
+        std::vector<TermCursor>& cursors = scratch.cursors;
+        cursors.clear();
+        for (size_t w = 0; w < words.size(); ++w) {
+            const PostingsList& list = lists[w * segments.size() + s];
+            if (list.empty()) {
+                continue;
+            }
+            float maxScore = 0;
+            for (uint32_t b = 0; b < list.BlockCount(); ++b) {
+                const SkipEntry& block = list.Skips()[b];
+                maxScore = std::max(maxScore, weights[w] * saturation(block.maxCount, block.minLength, lengthScale));
+            }
+            cursors.push_back({list, PostingsCursor(list), weights[w], maxScore, 0});
+            cursors.back().doc = cursors.back().cursor.DocId();
+        }
+        if (!cursors.empty()) {
+            scored += scoreSegmentBm25(segments[s], scratch, lengthScale, limit, slack, result);
+        }
+    }
+    SE_METRICS_ADD(DocumentsScored, scored);
+    if (result.empty()) {
+        return;
+    }
+    // Куча полна, если есть вытесненные: к ней добавляются все, кто может
+    // сравняться с ее худшим документом, а отрезает лишних уже rankedBefore
+    if (!scratch.ties.empty()) {
+        float floor = result.front().rank - slack;
+        for (const auto& entry : scratch.ties) {
+            if (entry.rank >= floor) {
+                result.push_back(entry);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end(), scoredBefore);
+    if (shard) {
+        // Нормирует и отрезает координатор - по лучшей оценке всех шардов
+        return;
+    }
+
+    // Нормализация на лучший документ, как и в режиме Absolute: rank в (0, 1]
+    float best = result.front().rank;
+    for (auto& entry : result) {
+        entry.rank = normalizedRank(entry.rank, best);
+    }
+    std::sort(result.begin(), result.end(), rankedBefore);
+    if (limit > 0 && result.size() > limit) {
+        result.resize(limit);
+    }
+}
+
+size_t SearchServer::scoreSegmentBm25(const SegmentRef& segment, QueryScratch& scratch, float lengthScale,
+                                      size_t limit, float slack, std::vector<RelativeIndex>& result) {
+    std::vector<TermCursor*>& order = scratch.order;
+    order.clear();
+    for (auto& term : scratch.cursors) {
+        order.push_back(&term);
+    }
+
+    // Документ стоит оценивать, если граница его оценки достигает порога -
+    // худшей оценки в заполненной куче за вычетом slack. Небольшой запас
+    // покрывает разный порядок сложения границ и оценок
+    std::vector<RelativeIndex>& ties = scratch.ties;
+    auto threshold = [&]() { return result.front().rank - slack; };
+    auto canEnter = [&](float bound) {
+        return limit == 0 || result.size() < limit || bound >= threshold() * (1.0f - 1e-5f);
+    };
+    // Отставшие от поднявшегося порога документы время от времени выбрасываются
+    size_t compactAt = std::max(2 * ties.size(), 2 * limit + 64);
+    auto advance = [](TermCursor& term, uint32_t target) {
+        term.doc = term.cursor.Advance(target) ? term.cursor.DocId() : END_OF_LIST;
+    };
+
+    bool phrases = !scratch.phrases.empty();
+    bool positional = segment.segment->HasPositions();
+    size_t scored = 0;
+    while (true) {
+        // Курсоры по возрастанию текущего документа (слов в запросе немного)
+        for (size_t i = 1; i < order.size(); ++i) {
+            for (size_t j = i; j > 0 && order[j]->doc < order[j - 1]->doc; --j) {
+                std::swap(order[j], order[j - 1]);
+            }
+        }
+
+        // Опорный курсор - первый, на котором сумма границ слов достигает
+        // порога. Документы до его документа содержат только слова левее,
+        // а их границ на ответ не хватает
+        float bound = 0;
+        size_t pivot = order.size();
+        for (size_t i = 0; i < order.size() && order[i]->doc != END_OF_LIST; ++i) {
+            bound += order[i]->maxScore;
+            if (canEnter(bound)) {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot == order.size()) {
+            break;
+        }
+        uint32_t pivotDoc = order[pivot]->doc;
+        while (pivot + 1 < order.size() && order[pivot + 1]->doc == pivotDoc) {
+            ++pivot;
+        }
+
+        // Уточнение по блокам, в которые попадает pivotDoc, без их распаковки
+        float blockBound = 0;
+        uint32_t blockEnd = END_OF_LIST;    // первый doc_id за самым коротким из этих блоков
+        for (size_t i = 0; i <= pivot; ++i) {
+            TermCursor& term = *order[i];
+            uint32_t b = findBlock(term.list.Skips(), term.cursor.BlockIndex(), term.list.BlockCount(), pivotDoc);
+            if (b == term.list.BlockCount()) {
+                continue;                   // список кончается раньше pivotDoc
+            }
+            const SkipEntry& block = term.list.Skips()[b];
+            blockBound += term.weight * saturation(block.maxCount, block.minLength, lengthScale);
+            blockEnd = std::min(blockEnd, block.lastDocId + 1);
+        }
+
+        if (canEnter(blockBound)) {
+            if (order[0]->doc == pivotDoc) {
+                // Все слова до опорного стоят на pivotDoc - полная оценка
+                if (segment.IsLive(pivotDoc) && (!phrases || matchPhrases(scratch, pivotDoc, positional))) {
+                    // Слагаемые - в порядке слов запроса, а не курсоров: тогда
+                    // оценка документа до бита одна и та же при любом разбиении
+                    // индекса на сегменты и шарды
+                    uint32_t length = segment.segment->DocLength(pivotDoc);
+                    float score = 0;
+                    for (const TermCursor& term : scratch.cursors) {
+                        if (term.doc == pivotDoc) {
+                            score += term.weight * saturation(term.cursor.Count(), length, lengthScale);
+                        }
+                    }
+                    ++scored;
+
+                    RelativeIndex entry{pivotDoc, score};
+                    if (limit == 0) {
+                        result.push_back(entry);
+                    } else if (result.size() < limit) {
+                        result.push_back(entry);
+                        std::push_heap(result.begin(), result.end(), scoredBefore);
+                    } else if (scoredBefore(entry, result.front())) {
+                        std::pop_heap(result.begin(), result.end(), scoredBefore);
+                        ties.push_back(result.back());
+                        result.back() = entry;
+                        std::push_heap(result.begin(), result.end(), scoredBefore);
+                    } else if (score >= threshold()) {
+                        ties.push_back(entry);
+                    }
+                    if (ties.size() >= compactAt) {
+                        float floor = threshold();
+                        ties.erase(std::remove_if(ties.begin(), ties.end(),
+                                                  [floor](const RelativeIndex& e) { return e.rank < floor; }),
+                                   ties.end());
+                        compactAt = std::max(2 * ties.size(), 2 * limit + 64);
+                    }
+                }
+                for (size_t i = 0; i <= pivot; ++i) {
+                    order[i]->doc = order[i]->cursor.Next() ? order[i]->cursor.DocId() : END_OF_LIST;
+                }
+            } else {
+                // Отстающие курсоры подтягиваются к pivotDoc
+                for (size_t i = 0; i < pivot && order[i]->doc < pivotDoc; ++i) {
+                    advance(*order[i], pivotDoc);
+                }
+            }
+        } else {
+            // До конца текущих блоков (и до документа следующего слова)
+            // ни один документ не наберет порога - все курсоры прыгают дальше
+            uint32_t target = blockEnd;
+            if (pivot + 1 < order.size()) {
+                target = std::min(target, order[pivot + 1]->doc);
+            }
+            for (size_t i = 0; i <= pivot; ++i) {
+                if (order[i]->doc < target) {
+                    advance(*order[i], target);
+                }
+            }
+        }
+    }
+    return scored;
+}
@@ -1,10 +1,23 @@
 #pragma once
 
 #include "InvertedIndex.h"
+#include "ThreadPool.h"
+#include "QueryCache.h"
+#include "Tokenizer.h"
+#include "Ranking.h"
+#include "Snippet.h"
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <memory>
+#include <functional>
+#include <mutex>
+
+struct ShardQuery;
+struct ShardStats;
+struct ShardHits;
+class SearchShard;
+class ShardCoordinator;
 
 struct RelativeIndex {
     size_t doc_id;
@@ -17,12 +30,240 @@ struct RelativeIndex {
 
 class SearchServer {
 public:
-    SearchServer(std::shared_ptr<InvertedIndex> idx) : _index(idx) { };
+    // maxResponses == 0 - возвращать все найденные документы
+    SearchServer(std::shared_ptr<InvertedIndex> idx, size_t maxResponses = 0)
+        : _index(idx), _maxResponses(maxResponses) { };
 
+    // Слова в двойных кавычках - фраза: документ подходит, только если
+    // слова фразы идут в нем подряд в том же порядке ("london is the capital").
+    // Фраза проверяется после отбора документов по словам, по позициям слов;
+    // в сегментах без позиций (индекс не позиционный) - только наличие всех слов.
+    // Слово с '*' или '?' - шаблон (см. WordPattern): "lond*", "c?t".
+    // Он раскрывается в подходящие слова индекса, и их постинги объединяются:
+    // документ должен содержать хотя бы одно из них, вхождения всех слов
+    // раскрытия складываются, как будто это одно слово (в BM25 его частота -
+    // число документов хотя бы с одним из слов). Слова фраз сравниваются буквально.
+    // При нечетком поиске (SetFuzzyDistance) так же объединяются слова индекса,
+    // близкие к слову запроса, которого в индексе нет
     std::vector<std::vector<RelativeIndex>> search(const std::vector<std::string>& queries_input);
+    // Пакет на заданном индексе: вызывающий держит его, чтобы и сниппеты
+    // ответов взять из него же (GetSnippet), даже если индекс уже подменен
+    std::vector<std::vector<RelativeIndex>> search(const InvertedIndex& index,
+                                                   const std::vector<std::string>& queries_input);
+
+    // Один запрос с ответом в буфер вызывающего. Рабочие буферы берутся из
+    // пула сервера, а result переиспользует свою емкость, поэтому после
+    // прогрева запрос не обращается к куче (при включенном кэше память
+    // выделяется только под новую запись кэша). Можно вызывать из разных потоков.
+    void Search(const std::string& query, std::vector<RelativeIndex>& result);
+
+    // Атомарная подмена индекса во время работы (горячая перезагрузка).
+    // Пакеты запросов, начатые до подмены, дорабатывают на старом снимке.
+    // Возвращает прежний индекс: вызывающий может освободить его у себя.
+    std::shared_ptr<InvertedIndex> SetIndex(std::shared_ptr<InvertedIndex> idx);
+    std::shared_ptr<InvertedIndex> GetIndex() const { return std::atomic_load(&_index); }
+
+    // Сколько лучших документов возвращать на запрос (0 - без ограничения)
+    void SetMaxResponses(size_t maxResponses) { _maxResponses = maxResponses; }
+    size_t GetMaxResponses() const { return _maxResponses; }
+
+    // Наибольшее число слов, в которое раскрывается один шаблон (0 - без
+    // ограничения): при большем числе подходящих слов берутся самые частые
+    static constexpr size_t DEFAULT_MAX_EXPANSIONS = 64;
+    void SetMaxExpansions(size_t maxExpansions) { _maxExpansions = maxExpansions; }
+    size_t GetMaxExpansions() const { return _maxExpansions; }
+
+    // Нечеткий поиск (по умолчанию выключен): слово запроса, которого нет
+    // в индексе, заменяется ближайшими словами индекса на расстоянии правки
+    // до distance (не больше FuzzyIndex::MAX_DISTANCE, а для коротких слов
+    // меньше - см. fuzzyDistanceFor). Кандидатов дают индексы удалений
+    // сегментов (InvertedIndex::SetFuzzyDistance), без них слова не исправляются.
+    // Найденные слова объединяются, как раскрытие шаблона, но вклад такого
+    // слова в оценку умножается на penalty за каждую правку. Слов берется
+    // не больше maxTerms (0 - без ограничения), самые частые из ближайших
+    static constexpr float DEFAULT_FUZZY_PENALTY = 0.5f;
+    static constexpr size_t DEFAULT_MAX_FUZZY_TERMS = 8;
+    void SetFuzzyDistance(uint32_t distance);
+    uint32_t GetFuzzyDistance() const { return _fuzzyDistance; }
+    // Штраф за правку в (0, 1]
+    void SetFuzzyPenalty(float penalty);
+    float GetFuzzyPenalty() const { return _fuzzyPenalty; }
+    void SetMaxFuzzyTerms(size_t maxTerms) { _maxFuzzyTerms = maxTerms; }
+    size_t GetMaxFuzzyTerms() const { return _maxFuzzyTerms; }
+
+    // Сниппет документа для выдачи: окно его текста вокруг слов запроса
+    // с подсветкой (см. Snippet). Текст читается из хранилища документов
+    // индекса (InvertedIndex::SetDocumentStore). Пустая строка - хранилища
+    // нет, документа в нем нет или длина сниппета 0. Слова, исправленные
+    // нечетким поиском, не подсвечиваются. Можно вызывать из разных потоков
+    std::string GetSnippet(size_t doc_id, const std::string& query) const;
+    // Сниппет из хранилища index - того индекса, на котором искали
+    std::string GetSnippet(const InvertedIndex& index, size_t doc_id, const std::string& query) const;
+    // Длина сниппета в байтах (по умолчанию Snippet::DEFAULT_LENGTH)
+    void SetSnippetLength(size_t length) { _snippetLength = length; }
+    size_t GetSnippetLength() const { return _snippetLength; }
+
+    // Способ ранжирования (по умолчанию Ranking::Absolute). В режиме BM25
+    // при ненулевом maxResponses документы, которые не могут войти в ответ,
+    // пропускаются по верхним границам блоков постингов
+    void SetRanking(Ranking ranking) { _ranking = ranking; }
+    Ranking GetRanking() const { return _ranking; }
+
+    // Число потоков пакетного поиска: 1 - последовательно на вызывающем
+    // потоке (по умолчанию), 0 - по числу ядер
+    void SetSearchThreads(size_t threadCount);
+    size_t GetSearchThreads() const { return _pool ? _pool->Size() : 1; }
+    // body(i) для i из [0, count) на тех же потоках, что и пакетный поиск
+    // (например, пакет запросов шарда); исключение пробрасывается вызывающему
+    void RunParallel(size_t count, const std::function<void(size_t)>& body);
+
+    // Кэш результатов повторяющихся запросов с бюджетом памяти в байтах
+    // (0 - кэш выключен, по умолчанию). Записи сбрасываются сами, когда
+    // меняется поколение индекса.
+    void SetCacheCapacity(size_t bytes);
+    QueryCache::Stats GetCacheStats() const { return _cache->GetStats(); }
+
+    // Распределенный поиск: запросы выполняют шарды (см. ShardCoordinator)
+    // с настройками ранжирования этого сервера, собственный индекс сервера
+    // не используется. Ответ совпадает с ответом одного индекса по всем
+    // документам шардов. Кэш запросов при этом не работает: шарды
+    // перестраиваются независимо, общего поколения у них нет.
+    // Пустой список - снова искать в своем индексе
+    void SetShards(std::vector<std::shared_ptr<SearchShard>> shards);
+    std::shared_ptr<ShardCoordinator> GetShards() const { return _shards; }
+
+    // Сервер как шард распределенного поиска (две фазы запроса, см. ShardProtocol).
+    // Все настройки ранжирования берутся из запроса, а не из сервера;
+    // поиск идет по index (обычно GetIndex())
+    void CollectShardStats(const InvertedIndex& index, const ShardQuery& query, ShardStats& stats);
+    void ShardSearch(const InvertedIndex& index, const ShardQuery& query, ShardHits& hits);
 
 private:
+    // Слияние ответов шардов повторяет порядок и нормировку ответа сервера
+    friend class ShardCoordinator;
+
+    // Курсор слова запроса при ранжировании BM25
+    struct TermCursor {
+        PostingsList list;
+        PostingsCursor cursor;
+        float weight;           // idf слова, умноженный на число его повторов в запросе
+        float maxScore;         // граница вклада слова по всем блокам списка
+        uint32_t doc;           // текущий doc_id или UINT32_MAX, если список кончился
+    };
+
+    // Объединенный список раскрытого шаблона в одном сегменте
+    struct PatternUnion {
+        std::vector<SkipEntry> skips;
+        std::vector<uint8_t> data;
+    };
+
+    // Рабочие буферы одного потока поиска. Переиспользуются между запросами,
+    // поэтому после прогрева запрос не выделяет память под промежуточные данные
+    struct QueryScratch {
+        Tokenizer tokenizer;
+        std::vector<std::string_view> words;    // смотрят в буфер tokenizer
+        std::vector<PostingsList> lists;
+        std::vector<float> listWeights;         // множитель вхождений слова lists[i] (Absolute)
+        std::vector<uint32_t> listOrder;
+        std::vector<std::pair<size_t, float>> docRelevance;
+        std::vector<uint32_t> candidates;
+        std::vector<float> relevance;
+        std::vector<uint32_t> matchCandidate;
+        std::vector<uint32_t> matchPosting;
+        std::string cacheKey;
+        // BM25: вес каждого различного слова и курсоры слов в текущем сегменте
+        std::vector<float> weights;
+        std::vector<TermCursor> cursors;
+        std::vector<TermCursor*> order;
+        // BM25 с ограничением ответов: вытесненные из кучи и не вошедшие в нее
+        // документы, которые после нормировки еще могут сравняться с худшим в ней
+        std::vector<RelativeIndex> ties;
+        // Фразы: их слова подряд в порядке запроса (они же есть и в words),
+        // границы каждой фразы в phraseWords и курсоры этих слов в текущем сегменте
+        std::vector<std::string_view> phraseWords;
+        std::vector<std::pair<size_t, size_t>> phrases;
+        std::vector<PostingsCursor> phraseCursors;
+        std::vector<uint32_t> phraseStarts;
+        std::vector<uint32_t> phrasePositions;
+        // Раскрываемые слова: различные шаблоны и исправляемые слова запроса
+        // и их раскрытия (expansions[i] - для expanded[i]), объединенные списки
+        // по сегментам и буферы слияния
+        std::vector<std::string_view> expanded;
+        std::vector<PatternExpansion> expansions;
+        std::vector<PatternUnion> unions;
+        std::vector<PostingsCursor> unionCursors;
+        std::vector<size_t> unionHeap;
+        std::vector<Posting> unionPostings;
+        std::vector<uint32_t> unionCounts;
+    };
+
+    // Публикуется атомарно, как снимок внутри InvertedIndex
     std::shared_ptr<InvertedIndex> _index;
+    size_t _maxResponses;
+    Ranking _ranking = Ranking::Absolute;
+    size_t _maxExpansions = DEFAULT_MAX_EXPANSIONS;
+    uint32_t _fuzzyDistance = 0;
+    float _fuzzyPenalty = DEFAULT_FUZZY_PENALTY;
+    size_t _maxFuzzyTerms = DEFAULT_MAX_FUZZY_TERMS;
+    size_t _snippetLength = Snippet::DEFAULT_LENGTH;
+    std::unique_ptr<ThreadPool> _pool;
+    std::unique_ptr<QueryCache> _cache = std::make_unique<QueryCache>();
+    std::shared_ptr<ShardCoordinator> _shards;
+
+    // Свободные рабочие буферы. Поток берет буфер на время запроса или
+    // пакета и возвращает его, так что буферов не больше, чем одновременно
+    // работающих потоков, и их емкость переживает отдельные вызовы
+    std::mutex _scratchMutex;
+    std::vector<std::unique_ptr<QueryScratch>> _scratchPool;
+
+    std::unique_ptr<QueryScratch> acquireScratch();
+    void releaseScratch(std::unique_ptr<QueryScratch> scratch);
 
-    std::vector<RelativeIndex> processQuery(const std::string& query);
+    void processQuery(const IndexSnapshot& snapshot, const std::string& query, QueryScratch& scratch,
+                      std::vector<RelativeIndex>& result) const;
+    // shard != nullptr - запрос шарда: раскрытия, статистика и число ответов
+    // из него. Absolute без shard->maxRelevance отбирает документы по сырой
+    // релевантности и возвращает лучшую из не попавших в ответ (иначе 0)
+    float rankQuery(const IndexSnapshot& snapshot, QueryScratch& scratch, const ShardQuery* shard,
+                    std::vector<RelativeIndex>& result) const;
+    // Запрос шарда получает сырые оценки BM25 по убыванию - K лучших и все,
+    // кто после нормировки может сравняться с K-м
+    void rankBm25(const IndexSnapshot& snapshot, QueryScratch& scratch, const ShardQuery* shard,
+                  std::vector<RelativeIndex>& result) const;
+    // Block-max WAND по одному сегменту: пополняет result (куча из limit лучших
+    // по scoredBefore, при limit == 0 - все документы) сырыми оценками BM25,
+    // а scratch.ties - документами не дальше slack от худшего в куче
+    static size_t scoreSegmentBm25(const SegmentRef& segment, QueryScratch& scratch, float lengthScale,
+                                   size_t limit, float slack, std::vector<RelativeIndex>& result);
+    static void parseQuery(const std::string& query, QueryScratch& scratch);
+    // Раскрывает различные шаблоны среди слов запроса, а при нечетком поиске -
+    // и слова, которых нет в индексе (у запроса шарда - готовые раскрытия
+    // координатора); false - раскрывать нечего
+    bool expandWords(const IndexSnapshot& snapshot, QueryScratch& scratch, const ShardQuery* shard) const;
+    // Раскрытие слова запроса; nullptr - слово ищется как есть
+    static const PatternExpansion* expansionOf(const QueryScratch& scratch, std::string_view word);
+    // Множитель вклада слова в оценку: штраф penalty за каждую правку нечеткого раскрытия
+    static float expansionWeight(const PatternExpansion* expansion, float penalty);
+    // Сколько правок (не больше distance) допустимо в слове: зависит от его
+    // длины, как fuzziness AUTO в Elasticsearch - в коротком слове уже
+    // одна-две правки дают слишком много посторонних слов
+    static uint32_t fuzzyDistanceFor(std::string_view word, uint32_t distance);
+    // Объединение списков всех слов раскрытия в сегменте: count документа -
+    // сумма по словам. Пустой список - ни одного из слов в сегменте нет
+    static PostingsList unionPattern(const IndexSegment& segment, const PatternExpansion& expansion,
+                                     QueryScratch& scratch, PatternUnion& out);
+    // Слияние курсоров кучей в список по возрастанию doc_id (count повторов складываются)
+    static void mergeCursors(std::vector<PostingsCursor>& cursors, std::vector<size_t>& heap,
+                             std::vector<Posting>& postings);
+    static bool rankedBefore(const RelativeIndex& a, const RelativeIndex& b);
+    // rank ответа: оценка, деленная на лучшую и округленная до 0.001
+    static float normalizedRank(float score, float best);
+    // Точный порядок по сырой оценке: больше rank, при равенстве - меньше doc_id
+    static bool scoredBefore(const RelativeIndex& a, const RelativeIndex& b);
+    static void intersectSegment(const SegmentRef& segment, QueryScratch& scratch);
+    // Курсоры слов фраз в сегменте; false - какого-то слова в сегменте нет
+    static bool preparePhrases(const IndexSegment& segment, QueryScratch& scratch);
+    // Есть ли в документе все фразы запроса. Документы сегмента проверяются
+    // по возрастанию doc_id; positional == false - только наличие слов
+    static bool matchPhrases(QueryScratch& scratch, uint32_t doc_id, bool positional);
 };
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "SearchShard.h"
+#include <chrono>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+void LocalShard::CollectStats(const ShardQuery& query, ShardStats& stats) {
+    server->CollectShardStats(*server->GetIndex(), query, stats);
+}
+
+void LocalShard::Search(const ShardQuery& query, ShardHits& hits) {
+    server->ShardSearch(*server->GetIndex(), query, hits);
+}
+
+std::string LocalShard::GetSnippet(size_t doc_id, const std::string& query) {
+    return server->GetSnippet(doc_id, query);
+}
+
+void RemoteShard::CollectStats(const ShardQuery& query, ShardStats& stats) {
+    json response = call({{"id", 0}, {"shard", "stats"}, {"request", ShardProtocol::ToJson(query)}});
+    ShardProtocol::FromJson(response.at("stats"), stats);
+}
+
+void RemoteShard::Search(const ShardQuery& query, ShardHits& hits) {
+    json response = call({{"id", 0}, {"shard", "search"}, {"request", ShardProtocol::ToJson(query)}});
+    ShardProtocol::FromJson(response.at("hits"), hits);
+}
+
+std::string RemoteShard::GetSnippet(size_t doc_id, const std::string& query) {
+    json response = call({{"id", 0}, {"shard", "snippet"}, {"docid", doc_id}, {"query", query}});
+    return response.at("snippet").get<std::string>();
+}
+
+#ifndef _WIN32
+
+RemoteShard::~RemoteShard() {
+    for (int fd : idle) {
+        close(fd);
+    }
+}
+
+int RemoteShard::connect() {
+    sockaddr_un address{};
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("socket path is too long: " + socketPath);
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("cannot create socket: ") + std::strerror(errno));
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::string reason = std::strerror(errno);
+        close(fd);
+        throw std::runtime_error("cannot connect to shard " + socketPath + ": " + reason);
+    }
+    // Отправка в шард, который перестал читать, тоже не блокирует навсегда
+    timeval timeout{};
+    timeout.tv_sec = static_cast<time_t>(timeoutMs / 1000);
+    timeout.tv_usec = static_cast<suseconds_t>(timeoutMs % 1000 * 1000);
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+json RemoteShard::call(const json& request) {
+    int fd = -1;
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        if (!idle.empty()) {
+            fd = idle.back();
+            idle.pop_back();
+        }
+    }
+    if (fd < 0) {
+        fd = connect();
+    }
+
+    // Соединение занято одним запросом, поэтому ответ - ровно следующая строка.
+    // Зависший шард не держит запрос дольше timeoutMs: соединение с ним
+    // закрывается, чтобы опоздавший ответ не достался следующему запросу
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    std::string line = request.dump() + "\n";
+    std::string response;
+    std::string error;
+    for (size_t written = 0; written < line.size() && error.empty(); ) {
+        ssize_t n = send(fd, line.data() + written, line.size() - written, MSG_NOSIGNAL);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            error = "timed out after " + std::to_string(timeoutMs) + " ms";
+        } else if (n < 0 && errno != EINTR) {
+            error = std::strerror(errno);
+        } else if (n > 0) {
+            written += static_cast<size_t>(n);
+        }
+    }
+    char buffer[1 << 14];
+    while (error.empty() && (response.empty() || response.back() != '\n')) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        pollfd ready{fd, POLLIN, 0};
+        int polled = left.count() > 0 ? poll(&ready, 1, static_cast<int>(left.count())) : 0;
+        if (polled == 0) {
+            error = "timed out after " + std::to_string(timeoutMs) + " ms";
+            break;
+        }
+        if (polled < 0) {
+            if (errno != EINTR) {
+                error = std::strerror(errno);
+            }
+            continue;
+        }
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        } else if (n == 0) {
+            error = "connection closed";
+        } else if (errno != EINTR) {
+            error = std::strerror(errno);
+        }
+    }
+    if (!error.empty()) {
+        close(fd);
+        throw std::runtime_error("shard " + socketPath + ": " + error);
+    }
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        idle.push_back(fd);
+    }
+
+    json body = json::parse(response, nullptr, false);
+    if (body.is_discarded() || !body.is_object()) {
+        throw std::runtime_error("shard " + socketPath + ": malformed response");
+    }
+    if (body.contains("error")) {
+        const json& message = body["error"];
+        throw std::runtime_error("shard " + socketPath + ": " +
+                                 (message.is_string() ? message.get<std::string>() : message.dump()));
+    }
+    return body;
+}
+
+#else
+
+RemoteShard::~RemoteShard() {
+}
+
+int RemoteShard::connect() {
+    throw std::runtime_error("remote shards are not supported on this platform");
+}
+
+json RemoteShard::call(const json&) {
+    connect();
+    return json();
+}
+
+#endif
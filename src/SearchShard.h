@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ShardProtocol.h"
+#include "SearchServer.h"
+
+// Шард распределенного поиска для ShardCoordinator: своя часть документов
+// со своими doc_id. Методы вызываются из разных потоков одновременно
+class SearchShard {
+public:
+    virtual ~SearchShard() = default;
+
+    // Первая фаза запроса: статистика слов (SearchServer::CollectShardStats)
+    virtual void CollectStats(const ShardQuery& query, ShardStats& stats) = 0;
+    // Вторая фаза: лучшие документы по решениям координатора (SearchServer::ShardSearch)
+    virtual void Search(const ShardQuery& query, ShardHits& hits) = 0;
+    // Сниппет документа шарда (doc_id шарда)
+    virtual std::string GetSnippet(size_t doc_id, const std::string& query) = 0;
+};
+
+// Шард в том же процессе: свой SearchServer над своим индексом
+class LocalShard : public SearchShard {
+public:
+    explicit LocalShard(std::shared_ptr<SearchServer> server) : server(std::move(server)) { };
+
+    void CollectStats(const ShardQuery& query, ShardStats& stats) override;
+    void Search(const ShardQuery& query, ShardHits& hits) override;
+    std::string GetSnippet(size_t doc_id, const std::string& query) override;
+
+    SearchServer& Server() { return *server; }
+
+private:
+    std::shared_ptr<SearchServer> server;
+};
+
+// Шард в отдельном процессе (search_engine --serve <socket> --shard i/N):
+// запросы ShardProtocol построчно по Unix-сокету. На каждый одновременный
+// запрос - свое соединение; свободные соединения переиспользуются.
+// Ошибка связи, ответ с ошибкой или ответ не за timeoutMs - std::runtime_error
+class RemoteShard : public SearchShard {
+public:
+    static constexpr size_t DEFAULT_TIMEOUT_MS = 30000;
+
+    explicit RemoteShard(std::string socketPath, size_t timeoutMs = DEFAULT_TIMEOUT_MS)
+        : socketPath(std::move(socketPath)), timeoutMs(timeoutMs) { };
+    ~RemoteShard() override;
+
+    RemoteShard(const RemoteShard&) = delete;
+    RemoteShard& operator=(const RemoteShard&) = delete;
+
+    void CollectStats(const ShardQuery& query, ShardStats& stats) override;
+    void Search(const ShardQuery& query, ShardHits& hits) override;
+    std::string GetSnippet(size_t doc_id, const std::string& query) override;
+
+    const std::string& SocketPath() const { return socketPath; }
+
+private:
+    std::string socketPath;
+    size_t timeoutMs;
+    std::mutex idle_mutex;
+    std::vector<int> idle;
+
+    // Запрос по свободному соединению; ответ - поля ответа без id
+    nlohmann::json call(const nlohmann::json& request);
+    int connect();
+};
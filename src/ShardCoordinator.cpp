@@ -0,0 +1,245 @@
+#include "ShardCoordinator.h"
+#include "WordPattern.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+// Складывает частоты слов шардов (у всех шардов одни и те же слова запроса)
+void addTerms(const std::vector<ShardTerm>& terms, std::vector<ShardTerm>& total) {
+    for (const auto& term : terms) {
+        auto it = std::find_if(total.begin(), total.end(), [&](const ShardTerm& t) { return t.word == term.word; });
+        if (it == total.end()) {
+            total.push_back(term);
+        } else {
+            it->frequency += term.frequency;
+            it->known = it->known || term.known;
+        }
+    }
+}
+
+}
+
+ShardCoordinator::ShardCoordinator(std::vector<std::shared_ptr<SearchShard>> shards) : shards(std::move(shards)) {
+    if (this->shards.empty()) {
+        throw std::invalid_argument("at least one shard is required");
+    }
+    if (this->shards.size() > 1) {
+        pool = std::make_unique<ThreadPool>(this->shards.size());
+    }
+}
+
+ShardCoordinator::Stats ShardCoordinator::GetStats() const {
+    Stats stats;
+    stats.queries = queries.load();
+    stats.requests = requests.load();
+    stats.refetches = refetches.load();
+    return stats;
+}
+
+void ShardCoordinator::forShards(const std::vector<size_t>& which, const std::function<void(size_t)>& body) {
+    requests.fetch_add(which.size());
+    if (!pool) {
+        for (size_t s : which) {
+            body(s);
+        }
+        return;
+    }
+    pool->ParallelFor(which.size(), [&](size_t i) { body(which[i]); });
+}
+
+std::string ShardCoordinator::GetSnippet(size_t doc_id, const std::string& query) {
+    size_t count = shards.size();
+    return shards[ShardOf(doc_id, count)]->GetSnippet(LocalId(doc_id, count), query);
+}
+
+void ShardCoordinator::plan(const SearchServer& server, const std::vector<ShardStats>& stats, ShardQuery& request) {
+    request.planned = true;
+    request.documents = 0;
+    request.terms.clear();
+    request.expansions.clear();
+    uint64_t totalLength = 0;
+    for (const auto& shard : stats) {
+        request.documents += shard.documents;
+        totalLength += shard.totalLength;
+        addTerms(shard.terms, request.terms);
+    }
+    // Та же формула, что у IndexSnapshot::AverageLength
+    request.averageLength = request.documents == 0
+            ? 0.0 : static_cast<double>(totalLength) / static_cast<double>(request.documents);
+
+    // Кандидаты раскрытия из всех шардов складываются и отбираются так же,
+    // как IndexSnapshot отбирает слова из своих сегментов
+    std::vector<std::string_view> words;
+    for (const auto& shard : stats) {
+        for (const auto& expansion : shard.expansions) {
+            if (std::find(words.begin(), words.end(), expansion.word) == words.end()) {
+                words.push_back(expansion.word);
+            }
+        }
+    }
+    PatternExpansion merged;
+    for (std::string_view word : words) {
+        bool pattern = WordPattern::IsPattern(word);
+        uint32_t distance = 0;
+        if (!pattern) {
+            // Исправляется только слово, которого нет ни в одном шарде,
+            // и только ближайшими словами из всех шардов
+            auto term = std::find_if(request.terms.begin(), request.terms.end(),
+                                     [&](const ShardTerm& t) { return t.word == word; });
+            if (term != request.terms.end() && term->known) {
+                continue;
+            }
+            distance = UINT32_MAX;
+            for (const auto& shard : stats) {
+                for (const auto& expansion : shard.expansions) {
+                    if (expansion.word == word && !expansion.terms.empty()) {
+                        distance = std::min(distance, expansion.distance);
+                    }
+                }
+            }
+        }
+
+        merged.Clear();
+        for (const auto& shard : stats) {
+            for (const auto& expansion : shard.expansions) {
+                if (expansion.word != word || (!pattern && expansion.distance != distance)) {
+                    continue;
+                }
+                for (const auto& [term, frequency] : expansion.terms) {
+                    merged.matches.push_back({merged.pool.size(), term.size(), static_cast<size_t>(frequency)});
+                    merged.pool += term;
+                }
+            }
+        }
+        merged.Select(pattern ? server.GetMaxExpansions() : server.GetMaxFuzzyTerms());
+
+        ShardExpansion chosen;
+        chosen.word = std::string(word);
+        chosen.distance = pattern || merged.Size() == 0 ? 0 : distance;
+        for (size_t i = 0; i < merged.Size(); ++i) {
+            chosen.terms.emplace_back(std::string(merged.Term(i)), merged.matches[i].frequency);
+        }
+        request.expansions.push_back(std::move(chosen));
+    }
+}
+
+void ShardCoordinator::Search(const SearchServer& server, const std::string& query,
+                              std::vector<RelativeIndex>& result) {
+    result.clear();
+    queries.fetch_add(1);
+    size_t count = shards.size();
+    std::vector<size_t> all(count);
+    std::iota(all.begin(), all.end(), 0);
+
+    ShardQuery request;
+    request.query = query;
+    request.ranking = server.GetRanking();
+    request.maxResponses = server.GetMaxResponses();
+    request.fuzzyDistance = server.GetFuzzyDistance();
+    request.fuzzyPenalty = server.GetFuzzyPenalty();
+
+    // Фаза 1: статистика слов запроса по всем шардам и общие решения
+    std::vector<ShardStats> stats(count);
+    forShards(all, [&](size_t s) { shards[s]->CollectStats(request, stats[s]); });
+    plan(server, stats, request);
+
+    bool bm25 = request.ranking == Ranking::BM25;
+    if (bm25 && !request.expansions.empty()) {
+        // Частота раскрытого слова - число документов хотя бы с одним из
+        // выбранных слов: ее считает каждый шард по своим спискам
+        forShards(all, [&](size_t s) { shards[s]->CollectStats(request, stats[s]); });
+        request.terms.clear();
+        for (const auto& shard : stats) {
+            addTerms(shard.terms, request.terms);
+        }
+    }
+    if (bm25 && request.documents == 0) {
+        return;
+    }
+
+    // Фаза 2: лучшие документы каждого шарда
+    std::vector<ShardHits> hits(count);
+    std::vector<bool> normalized(count, false);
+    auto search = [&](size_t s) {
+        shards[s]->Search(request, hits[s]);
+        for (auto& hit : hits[s].hits) {
+            hit.doc_id = GlobalId(hit.doc_id, s, count);
+        }
+    };
+    forShards(all, search);
+
+    size_t limit = request.maxResponses;
+    auto select = [&](bool (*before)(const RelativeIndex&, const RelativeIndex&)) {
+        if (limit > 0 && result.size() > limit) {
+            std::partial_sort(result.begin(), result.begin() + static_cast<std::ptrdiff_t>(limit), result.end(), before);
+            result.resize(limit);
+        } else {
+            std::sort(result.begin(), result.end(), before);
+        }
+    };
+
+    if (bm25) {
+        // Оценки шардов посчитаны по общей статистике и сравнимы между собой.
+        // Кроме своих K лучших шард отдает и те, что после нормировки могут
+        // сравняться с K-м, поэтому отрезать можно только по rankedBefore
+        float best = 0;
+        for (const auto& shard : hits) {
+            result.insert(result.end(), shard.hits.begin(), shard.hits.end());
+            if (!shard.hits.empty()) {
+                best = std::max(best, shard.hits.front().rank);
+            }
+        }
+        if (result.empty()) {
+            return;
+        }
+        for (auto& entry : result) {
+            entry.rank = SearchServer::normalizedRank(entry.rank, best);
+        }
+        select(SearchServer::rankedBefore);
+        return;
+    }
+
+    float maxRelevance = 0;
+    for (const auto& shard : hits) {
+        for (const auto& hit : shard.hits) {
+            maxRelevance = std::max(maxRelevance, hit.rank);
+        }
+    }
+    if (maxRelevance == 0) {
+        return;
+    }
+    auto merge = [&]() {
+        result.clear();
+        for (size_t s = 0; s < count; ++s) {
+            for (const auto& hit : hits[s].hits) {
+                result.push_back({hit.doc_id, normalized[s] ? hit.rank : SearchServer::normalizedRank(hit.rank, maxRelevance)});
+            }
+        }
+        select(SearchServer::rankedBefore);
+    };
+    merge();
+    if (limit == 0 || result.size() < limit) {
+        return;
+    }
+
+    // Не отданные документы шарда не выше его tail. Если tail после
+    // нормировки заметно ниже последнего документа ответа, они в ответ
+    // не войдут; иначе шард отбирает лучшие заново по общему максимуму
+    std::vector<size_t> again;
+    float last = result.back().rank;
+    for (size_t s = 0; s < count; ++s) {
+        if (hits[s].tail > 0 && !(last - SearchServer::normalizedRank(hits[s].tail, maxRelevance) > 0.0001f)) {
+            again.push_back(s);
+            normalized[s] = true;
+        }
+    }
+    if (again.empty()) {
+        return;
+    }
+    refetches.fetch_add(again.size());
+    request.maxRelevance = maxRelevance;
+    forShards(again, search);
+    merge();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SearchShard.h"
+#include "ThreadPool.h"
+
+// Координатор распределенного поиска (SearchServer::SetShards).
+// Документы разбиты на N шардов по очереди: документ i лежит в шарде
+// i % N под doc_id шарда i / N. Запрос уходит во все шарды параллельно,
+// их лучшие документы сливаются в общий ответ.
+//
+// Ответ совпадает с ответом одного индекса по всем документам:
+//  - раскрытия шаблонов и исправления выбираются по частотам слов во всех
+//    шардах, а слово исправляется, только если его нет ни в одном шарде;
+//  - BM25 считает idf и среднюю длину по всей коллекции (для раскрытых
+//    слов частота - документы хотя бы с одним из слов, это еще один
+//    короткий проход по шардам);
+//  - в режиме Absolute релевантность нормируется на максимум по всем
+//    шардам. Шарды отдают сырые релевантности, координатор нормирует их
+//    сам. Но после округления rank до 0.001 документы с разной сырой
+//    релевантностью могут сравняться и упорядочиться по doc_id, и тогда
+//    лучшие по сырой релевантности документы шарда - не обязательно его
+//    лучшие в ответе. Поэтому шард сообщает лучшую релевантность из
+//    не отданных документов; если после нормировки она может сравняться
+//    с последним документом ответа, шард отбирает документы заново уже
+//    по общему максимуму.
+class ShardCoordinator {
+public:
+    explicit ShardCoordinator(std::vector<std::shared_ptr<SearchShard>> shards);
+
+    size_t Size() const { return shards.size(); }
+
+    // Разбиение документов между count шардами
+    static size_t ShardOf(size_t doc_id, size_t count) { return doc_id % count; }
+    static size_t LocalId(size_t doc_id, size_t count) { return doc_id / count; }
+    static size_t GlobalId(size_t local_id, size_t shard, size_t count) { return local_id * count + shard; }
+
+    // Запрос с настройками ранжирования server (ответы, способ, раскрытия,
+    // нечеткий поиск); doc_id ответа - общие. Можно вызывать из разных потоков
+    void Search(const SearchServer& server, const std::string& query, std::vector<RelativeIndex>& result);
+    std::string GetSnippet(size_t doc_id, const std::string& query);
+
+    struct Stats {
+        uint64_t queries = 0;
+        uint64_t requests = 0;          // запросы к шардам во всех фазах
+        uint64_t refetches = 0;         // повторные отборы Absolute по общему максимуму
+    };
+    Stats GetStats() const;
+
+private:
+    std::vector<std::shared_ptr<SearchShard>> shards;
+    std::unique_ptr<ThreadPool> pool;
+    std::atomic<uint64_t> queries{0};
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> refetches{0};
+
+    // body(s) для шардов which параллельно, по одному на поток пула
+    void forShards(const std::vector<size_t>& which, const std::function<void(size_t)>& body);
+    // Общие решения по статистике шардов: раскрытия и частоты слов
+    static void plan(const SearchServer& server, const std::vector<ShardStats>& stats, ShardQuery& request);
+};
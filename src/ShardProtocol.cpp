@@ -0,0 +1,155 @@
+#include "ShardProtocol.h"
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+namespace {
+
+json termsToJson(const std::vector<ShardTerm>& terms) {
+    json result = json::array();
+    for (const auto& term : terms) {
+        result.push_back({{"word", term.word}, {"frequency", term.frequency}, {"known", term.known}});
+    }
+    return result;
+}
+
+json expansionsToJson(const std::vector<ShardExpansion>& expansions) {
+    json result = json::array();
+    for (const auto& expansion : expansions) {
+        json terms = json::array();
+        for (const auto& [term, frequency] : expansion.terms) {
+            terms.push_back({term, frequency});
+        }
+        result.push_back({{"word", expansion.word}, {"distance", expansion.distance}, {"terms", std::move(terms)}});
+    }
+    return result;
+}
+
+void termsFromJson(const json& value, std::vector<ShardTerm>& terms) {
+    terms.clear();
+    for (const auto& item : value) {
+        terms.push_back({item.at("word").get<std::string>(), item.at("frequency").get<uint64_t>(),
+                         item.at("known").get<bool>()});
+    }
+}
+
+void expansionsFromJson(const json& value, std::vector<ShardExpansion>& expansions) {
+    expansions.clear();
+    for (const auto& item : value) {
+        ShardExpansion expansion;
+        expansion.word = item.at("word").get<std::string>();
+        expansion.distance = item.at("distance").get<uint32_t>();
+        for (const auto& term : item.at("terms")) {
+            expansion.terms.emplace_back(term.at(0).get<std::string>(), term.at(1).get<uint64_t>());
+        }
+        expansions.push_back(std::move(expansion));
+    }
+}
+
+// Ошибки разбора nlohmann (нет поля, не тот тип) - как неверный запрос
+template<class Parse>
+void parse(const char* what, Parse body) {
+    try {
+        body();
+    } catch (const json::exception& e) {
+        throw std::invalid_argument(std::string("bad shard ") + what + ": " + e.what());
+    }
+}
+
+}
+
+json ShardProtocol::ToJson(const ShardQuery& query) {
+    json value = {
+        {"query", query.query},
+        {"ranking", query.ranking == Ranking::BM25 ? "bm25" : "absolute"},
+        {"max_responses", query.maxResponses},
+        {"fuzzy_distance", query.fuzzyDistance},
+        {"fuzzy_penalty", query.fuzzyPenalty},
+        {"planned", query.planned},
+    };
+    if (query.planned) {
+        value["expansions"] = expansionsToJson(query.expansions);
+        value["documents"] = query.documents;
+        value["average_length"] = query.averageLength;
+        value["terms"] = termsToJson(query.terms);
+        value["max_relevance"] = query.maxRelevance;
+    }
+    return value;
+}
+
+json ShardProtocol::ToJson(const ShardStats& stats) {
+    return {
+        {"documents", stats.documents},
+        {"total_length", stats.totalLength},
+        {"terms", termsToJson(stats.terms)},
+        {"expansions", expansionsToJson(stats.expansions)},
+    };
+}
+
+json ShardProtocol::ToJson(const ShardHits& hits) {
+    json items = json::array();
+    for (const auto& hit : hits.hits) {
+        items.push_back({hit.doc_id, hit.rank});
+    }
+    return {{"hits", std::move(items)}, {"tail", hits.tail}};
+}
+
+void ShardProtocol::FromJson(const json& value, ShardQuery& query) {
+    parse("query", [&]() {
+        query = ShardQuery();
+        query.query = value.at("query").get<std::string>();
+        query.ranking = value.at("ranking").get<std::string>() == "bm25" ? Ranking::BM25 : Ranking::Absolute;
+        query.maxResponses = value.at("max_responses").get<size_t>();
+        query.fuzzyDistance = value.at("fuzzy_distance").get<uint32_t>();
+        query.fuzzyPenalty = value.at("fuzzy_penalty").get<float>();
+        query.planned = value.at("planned").get<bool>();
+        if (query.planned) {
+            expansionsFromJson(value.at("expansions"), query.expansions);
+            query.documents = value.at("documents").get<uint64_t>();
+            query.averageLength = value.at("average_length").get<double>();
+            termsFromJson(value.at("terms"), query.terms);
+            query.maxRelevance = value.at("max_relevance").get<float>();
+        }
+    });
+}
+
+void ShardProtocol::FromJson(const json& value, ShardStats& stats) {
+    parse("stats", [&]() {
+        stats.documents = value.at("documents").get<uint64_t>();
+        stats.totalLength = value.at("total_length").get<uint64_t>();
+        termsFromJson(value.at("terms"), stats.terms);
+        expansionsFromJson(value.at("expansions"), stats.expansions);
+    });
+}
+
+void ShardProtocol::FromJson(const json& value, ShardHits& hits) {
+    parse("hits", [&]() {
+        hits.hits.clear();
+        for (const auto& item : value.at("hits")) {
+            hits.hits.push_back({item.at(0).get<size_t>(), item.at(1).get<float>()});
+        }
+        hits.tail = value.at("tail").get<float>();
+    });
+}
+
+json ShardProtocol::Handle(SearchServer& server, const InvertedIndex& index, const json& request) {
+    std::string op = request.at("shard").get<std::string>();
+    if (op == "snippet") {
+        return {{"snippet", server.GetSnippet(index, request.at("docid").get<size_t>(),
+                                              request.at("query").get<std::string>())}};
+    }
+
+    ShardQuery query;
+    FromJson(request.at("request"), query);
+    if (op == "stats") {
+        ShardStats stats;
+        server.CollectShardStats(index, query, stats);
+        return {{"stats", ToJson(stats)}};
+    }
+    if (op == "search") {
+        ShardHits hits;
+        server.ShardSearch(index, query, hits);
+        return {{"hits", ToJson(hits)}};
+    }
+    throw std::invalid_argument("unknown shard request '" + op + "'");
+}
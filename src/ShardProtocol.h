@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "nlohmann/json.hpp"
+#include "Ranking.h"
+#include "SearchServer.h"
+
+// Запросы и ответы шарда распределенного поиска (см. ShardCoordinator).
+// Шард - SearchServer над своей частью документов со своими doc_id.
+// Ранжирование зависит от статистики всей коллекции, поэтому запрос идет
+// в две фазы: сначала шарды отдают статистику слов запроса, координатор
+// складывает ее и принимает общие решения (раскрытия шаблонов, исправления,
+// idf), затем шарды оценивают документы по этим решениям
+
+// Слово запроса в статистике шарда
+struct ShardTerm {
+    std::string word;
+    uint64_t frequency = 0;     // число постингов (у раскрытого слова - документов хотя бы с одним из слов)
+    bool known = false;         // слово есть в словаре шарда
+};
+
+// Раскрытие слова запроса: у шарда - все подходящие слова его индекса
+// (без ограничения числа), у координатора - выбранные для всех шардов
+struct ShardExpansion {
+    std::string word;
+    uint32_t distance = 0;      // нечеткое раскрытие: расстояние правки до его слов
+    std::vector<std::pair<std::string, uint64_t>> terms;   // слово индекса и его частота
+};
+
+struct ShardQuery {
+    std::string query;
+    Ranking ranking = Ranking::Absolute;
+    size_t maxResponses = 0;
+    uint32_t fuzzyDistance = 0;
+    float fuzzyPenalty = 1.0f;
+
+    // Решения координатора. planned == false - первая фаза: шард ищет
+    // кандидатов раскрытия сам. Иначе раскрываются ровно слова expansions
+    bool planned = false;
+    std::vector<ShardExpansion> expansions;
+    // BM25: статистика всей коллекции - живые документы, средняя длина
+    // и частоты различных слов запроса
+    uint64_t documents = 0;
+    double averageLength = 0;
+    std::vector<ShardTerm> terms;
+    // Absolute: наибольшая релевантность по всем шардам. 0 - еще неизвестна,
+    // тогда шард отдает сырые релевантности (см. ShardHits)
+    float maxRelevance = 0;
+};
+
+struct ShardStats {
+    uint64_t documents = 0;     // живые документы шарда
+    uint64_t totalLength = 0;   // их суммарная длина в словах
+    std::vector<ShardTerm> terms;
+    std::vector<ShardExpansion> expansions;
+};
+
+// Лучшие документы шарда (doc_id шарда). В режиме BM25 и в режиме Absolute
+// без maxRelevance rank - сырая оценка, порядок - по убыванию оценки;
+// с maxRelevance - нормализованный rank, как в ответе SearchServer.
+// BM25 отдает и документы за K лучшими, которые могут сравняться с K-м
+struct ShardHits {
+    std::vector<RelativeIndex> hits;
+    // Сырые релевантности Absolute: лучшая из не попавших в hits (0 - в hits все найденные)
+    float tail = 0;
+};
+
+// JSON-представление для шардов в отдельных процессах. Строка протокола:
+//   запрос:  {"id": 1, "shard": "stats" | "search", "request": {...}}
+//            {"id": 1, "shard": "snippet", "docid": 3, "query": "..."}
+//   ответ:   {"id": 1, "stats": {...}} | {"id": 1, "hits": {...}} | {"id": 1, "snippet": "..."}
+class ShardProtocol {
+public:
+    static nlohmann::json ToJson(const ShardQuery& query);
+    static nlohmann::json ToJson(const ShardStats& stats);
+    static nlohmann::json ToJson(const ShardHits& hits);
+    // Бросают std::invalid_argument на неверном JSON
+    static void FromJson(const nlohmann::json& value, ShardQuery& query);
+    static void FromJson(const nlohmann::json& value, ShardStats& stats);
+    static void FromJson(const nlohmann::json& value, ShardHits& hits);
+
+    // Выполняет строку запроса шарда на сервере по индексу index (пакет
+    // запросов держит один индекс); ответ - поля ответа без id
+    static nlohmann::json Handle(SearchServer& server, const InvertedIndex& index, const nlohmann::json& request);
+};
@@ -0,0 +1,131 @@
+#include "Snippet.h"
+#include "Tokenizer.h"
+#include "WordPattern.h"
+#include <algorithm>
+
+namespace {
+
+// Вхождение слова запроса words[word] в байтах [begin, end) текста
+struct Hit {
+    size_t begin;
+    size_t end;
+    size_t word;
+};
+
+// Те же разделители, что у Tokenizer
+bool isSeparator(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+}
+
+std::string Snippet::Make(std::string_view text, const std::vector<std::string>& words, size_t maxLength,
+                          std::string_view open, std::string_view close) {
+    const char* data = text.data();
+    size_t size = text.size();
+
+    std::vector<Hit> hits;
+    std::string token;
+    for (size_t begin = Tokenizer::FindNonSeparator(data, size, 0); begin < size; ) {
+        size_t end = Tokenizer::FindSeparator(data, size, begin);
+        // Слишком длинные слова индекс пропускает - их и не подсвечиваем
+        if (end - begin <= Tokenizer::MAX_TOKEN_LENGTH) {
+            token.resize(end - begin);
+            Tokenizer::Lowercase(data + begin, end - begin, token.data());
+            for (size_t w = 0; w < words.size(); ++w) {
+                if (words[w] == token || (WordPattern::IsPattern(words[w]) && WordPattern::Matches(words[w], token))) {
+                    hits.push_back({begin, end, w});
+                    break;
+                }
+            }
+        }
+        begin = Tokenizer::FindNonSeparator(data, size, end);
+    }
+
+    // Окно из вхождений [first, last) с наибольшим числом различных слов
+    // (при равенстве - с большим числом вхождений), скользящим окном
+    size_t first = 0;
+    size_t last = 0;
+    if (!hits.empty()) {
+        std::vector<size_t> counts(words.size());
+        size_t distinct = 0;
+        size_t bestDistinct = 0;
+        size_t j = 0;
+        for (size_t i = 0; i < hits.size(); ++i) {
+            while (j < hits.size() && (j == i || hits[j].end - hits[i].begin <= maxLength)) {
+                distinct += counts[hits[j].word]++ == 0;
+                ++j;
+            }
+            if (distinct > bestDistinct || (distinct == bestDistinct && j - i > last - first)) {
+                bestDistinct = distinct;
+                first = i;
+                last = j;
+            }
+            distinct -= --counts[hits[i].word] == 0;
+        }
+    }
+
+    // Ядро окна - найденные вхождения (без них - первое слово текста),
+    // остаток длины делится между контекстом до и после
+    size_t coreBegin = Tokenizer::FindNonSeparator(data, size, 0);
+    size_t coreEnd = Tokenizer::FindSeparator(data, size, coreBegin);
+    if (!hits.empty()) {
+        coreBegin = hits[first].begin;
+        coreEnd = hits[last - 1].end;
+    }
+    size_t begin = coreBegin;
+    size_t end = coreEnd;
+    if (end - begin < maxLength) {
+        size_t slack = maxLength - (end - begin);
+        size_t before = hits.empty() ? 0 : std::min(begin, slack / 2);
+        begin -= before;
+        end = std::min(size, end + slack - before);
+        // Текст кончился раньше - оставшееся место отдается контексту до
+        begin -= std::min(begin, maxLength - (end - begin));
+    }
+
+    // Края окна - по границам слов: обрезанное слово не показывается
+    if (begin > 0 && !isSeparator(data[begin - 1])) {
+        begin = std::min(coreBegin, Tokenizer::FindSeparator(data, size, begin));
+    }
+    begin = std::min(coreBegin, Tokenizer::FindNonSeparator(data, size, begin));
+    if (end < size && !isSeparator(data[end])) {
+        while (end > coreEnd && !isSeparator(data[end - 1])) {
+            --end;
+        }
+    }
+    while (end > coreEnd && isSeparator(data[end - 1])) {
+        --end;
+    }
+
+    std::string snippet;
+    snippet.reserve(end - begin + 8 + (last - first) * (open.size() + close.size()));
+    auto append = [&](size_t from, size_t to) {
+        for (size_t i = from; i < to; ++i) {
+            if (!isSeparator(data[i])) {
+                snippet.push_back(data[i]);
+            } else if (snippet.empty() || snippet.back() != ' ') {
+                snippet.push_back(' ');
+            }
+        }
+    };
+
+    if (begin > Tokenizer::FindNonSeparator(data, size, 0)) {
+        snippet += "... ";
+    }
+    size_t at = begin;
+    for (const auto& hit : hits) {
+        if (hit.begin >= begin && hit.end <= end) {
+            append(at, hit.begin);
+            snippet.append(open);
+            snippet.append(data + hit.begin, hit.end - hit.begin);
+            snippet.append(close);
+            at = hit.end;
+        }
+    }
+    append(at, end);
+    if (Tokenizer::FindNonSeparator(data, size, end) < size) {
+        snippet += " ...";
+    }
+    return snippet;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+// Фрагмент текста документа для выдачи: окно вокруг слов запроса,
+// в котором они подсвечены. Слова текста выделяются и нормализуются как
+// при индексации (Tokenizer), поэтому подсвечиваются ровно те вхождения,
+// которые нашел бы поиск.
+class Snippet {
+public:
+    static constexpr size_t DEFAULT_LENGTH = 160;
+
+    // words - нормализованные слова запроса, среди них могут быть шаблоны
+    // (WordPattern). Выбирается окно не длиннее maxLength байт по границам
+    // слов, в котором больше всего различных слов запроса (без них - начало
+    // текста); вхождения обрамляются open и close, пробельные символы
+    // сжимаются в один пробел, обрезанные края отмечаются "...".
+    // Слово длиннее maxLength выдается целиком
+    static std::string Make(std::string_view text, const std::vector<std::string>& words, size_t maxLength,
+                            std::string_view open = "<b>", std::string_view close = "</b>");
+};
@@ -0,0 +1,303 @@
+#include "SpimiBuilder.h"
+#include "IndexFile.h"
+#include "FrontCodedDictionary.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+
+namespace {
+
+// Столько постингов одного слова копится перед кодированием при слиянии
+constexpr size_t ENCODE_BATCH = PostingsCodec::BLOCK_SIZE * 64;
+constexpr size_t IO_BUFFER = size_t(1) << 20;
+
+// Прогон: записи [длина слова u32][слово][число постингов u32][постинги],
+// слова по возрастанию. Внутри прогона doc_id возрастают, прогоны идут по
+// возрастанию doc_id, поэтому постинги слова из прогонов склеиваются по порядку.
+class RunReader {
+public:
+    explicit RunReader(const std::string& path) : buffer(IO_BUFFER) {
+        in.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        in.open(path, std::ios::binary);
+        if (!in.is_open()) {
+            throw std::runtime_error("cannot open index run: " + path);
+        }
+        this->path = path;
+    }
+
+    // Переход к следующему слову; false - прогон закончился
+    bool NextTerm() {
+        uint32_t length;
+        if (!in.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+            return false;
+        }
+        term.resize(length);
+        uint32_t count;
+        if (!in.read(term.data(), length) || !in.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+            throw std::runtime_error("truncated index run: " + path);
+        }
+        remaining = count;
+        return true;
+    }
+
+    // Чтение очередной части постингов текущего слова
+    size_t ReadPostings(Posting* out, size_t max) {
+        size_t n = std::min<size_t>(max, remaining);
+        if (n > 0 && !in.read(reinterpret_cast<char*>(out), static_cast<std::streamsize>(n * sizeof(Posting)))) {
+            throw std::runtime_error("truncated index run: " + path);
+        }
+        remaining -= n;
+        return n;
+    }
+
+    const std::string& Term() const { return term; }
+    size_t Remaining() const { return remaining; }
+
+private:
+    std::vector<char> buffer;
+    std::ifstream in;
+    std::string path;
+    std::string term;
+    size_t remaining = 0;
+};
+
+}
+
+SpimiBuilder::SpimiBuilder(std::string tempDirectory, size_t memoryBudget)
+    : tempDirectory(std::move(tempDirectory)), memoryBudget(std::max<size_t>(1, memoryBudget)) {
+    std::filesystem::create_directories(this->tempDirectory);
+}
+
+SpimiBuilder::~SpimiBuilder() {
+    removeTemporaryFiles();
+}
+
+void SpimiBuilder::removeTemporaryFiles() {
+    std::error_code error;
+    for (const auto& path : runPaths) {
+        std::filesystem::remove(path, error);
+    }
+    runPaths.clear();
+    std::filesystem::remove((std::filesystem::path(tempDirectory) / "postings.data").string(), error);
+}
+
+void SpimiBuilder::track(size_t memory) {
+    progress.memory = memory;
+    // В пике учитывается и таблица длин документов, которая живет до конца построения
+    progress.peakMemory = std::max(progress.peakMemory,
+                                   progress.memory + docLengths.capacity() * sizeof(uint32_t));
+}
+
+void SpimiBuilder::report() {
+    if (progressCallback) {
+        progressCallback(progress);
+    }
+}
+
+uint32_t SpimiBuilder::AddDocument(std::string_view text) {
+    if (docLengths.size() >= UINT32_MAX - 1) {
+        throw std::length_error("too many documents for 32-bit doc_id");
+    }
+    uint32_t doc_id = static_cast<uint32_t>(docLengths.size());
+    uint32_t length = 0;
+
+    std::string_view word;
+    tokenizer.Reset(text);
+    while (tokenizer.Next(word)) {
+        ++length;
+        postings.Add(postings.Intern(word), doc_id);
+    }
+
+    docLengths.push_back(length);
+    track(postings.UsedBytes());
+    ++progress.documents;
+    progress.bytes += text.size();
+
+    if (progress.memory >= memoryBudget) {
+        spill();
+    }
+    return doc_id;
+}
+
+void SpimiBuilder::spill() {
+    if (postings.TermCount() == 0) {
+        return;
+    }
+
+    postings.Finish();
+    std::vector<uint32_t> sorted(postings.TermCount());
+    for (uint32_t id = 0; id < sorted.size(); ++id) {
+        sorted[id] = id;
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [this](uint32_t a, uint32_t b) { return postings.Term(a) < postings.Term(b); });
+
+    std::string path = (std::filesystem::path(tempDirectory) /
+                        ("run" + std::to_string(runPaths.size()) + ".bin")).string();
+    std::vector<char> buffer(IO_BUFFER);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("cannot create index run: " + path);
+    }
+    runPaths.push_back(path);
+
+    for (uint32_t id : sorted) {
+        std::string_view term = postings.Term(id);
+        uint32_t length = static_cast<uint32_t>(term.size());
+        uint32_t count = static_cast<uint32_t>(postings.PostingCount(id));
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(term.data(), length);
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(postings.Postings(id)), count * sizeof(Posting));
+    }
+    out.close();
+    if (!out) {
+        throw std::runtime_error("cannot write index run: " + path);
+    }
+
+    // Арена очищается с сохранением емкости и служит следующему прогону
+    postings.Clear();
+    progress.memory = 0;
+    ++progress.runs;
+    report();
+}
+
+SpimiBuilder::Progress SpimiBuilder::Finish(const std::string& indexPath, uint64_t fingerprint) {
+    spill();
+    progress.merging = true;
+
+    std::vector<std::unique_ptr<RunReader>> readers;
+    for (const auto& path : runPaths) {
+        readers.push_back(std::make_unique<RunReader>(path));
+    }
+
+    // Куча прогонов по (текущее слово, номер прогона): для одинаковых слов
+    // постинги берутся в порядке прогонов, то есть по возрастанию doc_id
+    auto later = [&](size_t a, size_t b) {
+        int order = readers[a]->Term().compare(readers[b]->Term());
+        return order != 0 ? order > 0 : a > b;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+    for (size_t r = 0; r < readers.size(); ++r) {
+        if (readers[r]->NextTerm()) {
+            heap.push(r);
+        }
+    }
+
+    std::string dataPath = (std::filesystem::path(tempDirectory) / "postings.data").string();
+    std::vector<char> dataBuffer(IO_BUFFER);
+    std::ofstream dataOut;
+    dataOut.rdbuf()->pubsetbuf(dataBuffer.data(), static_cast<std::streamsize>(dataBuffer.size()));
+    dataOut.open(dataPath, std::ios::binary | std::ios::trunc);
+    if (!dataOut.is_open()) {
+        throw std::runtime_error("cannot create postings data: " + dataPath);
+    }
+
+    // Прогоны упорядочены по словам, поэтому словарь собирается сразу отсортированным
+    FrontCodedDictionary::Builder dictionary;
+    std::vector<uint32_t> termBlocks;
+    std::vector<SkipEntry> skips;
+    std::vector<uint8_t> encoded;
+    std::vector<Posting> pending;
+    pending.reserve(ENCODE_BATCH + PostingsCodec::BLOCK_SIZE);
+    uint64_t dataSize = 0;
+    size_t postingCount = 0;
+    uint32_t lastEncoded = 0;
+
+    // Кодирует накопленные постинги слова и дописывает байты в файл данных.
+    // До конца слова кодируются только целые блоки, хвост ждет следующей части.
+    auto encode = [&](bool endOfTerm) {
+        size_t count = endOfTerm ? pending.size()
+                                 : pending.size() / PostingsCodec::BLOCK_SIZE * PostingsCodec::BLOCK_SIZE;
+        if (count == 0) {
+            return;
+        }
+        size_t firstBlock = skips.size();
+        encoded.clear();
+        PostingsCodec::Encode(pending.data(), count, skips, encoded, lastEncoded, {docLengths.data(), 0});
+        if (dataSize + encoded.size() > UINT32_MAX) {
+            throw std::length_error("compressed postings exceed 4 GiB per segment");
+        }
+        for (size_t b = firstBlock; b < skips.size(); ++b) {
+            skips[b].dataOffset += static_cast<uint32_t>(dataSize);
+        }
+        dataOut.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+        dataSize += encoded.size();
+        postingCount += count;
+        lastEncoded = pending[count - 1].doc_id;
+        pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(count));
+    };
+
+    std::string current;
+    while (!heap.empty()) {
+        size_t r = heap.top();
+        heap.pop();
+        RunReader& reader = *readers[r];
+
+        if (termBlocks.empty() || reader.Term() != current) {
+            encode(true);
+            current = reader.Term();
+            dictionary.Add(current);
+            termBlocks.push_back(static_cast<uint32_t>(skips.size()));
+            lastEncoded = 0;
+        }
+
+        while (reader.Remaining() > 0) {
+            size_t at = pending.size();
+            pending.resize(at + std::min(reader.Remaining(), ENCODE_BATCH));
+            pending.resize(at + reader.ReadPostings(pending.data() + at, pending.size() - at));
+            encode(false);
+        }
+
+        if (reader.NextTerm()) {
+            heap.push(r);
+        }
+    }
+    encode(true);
+    termBlocks.push_back(static_cast<uint32_t>(skips.size()));
+    readers.clear();
+
+    dataOut.close();
+    if (!dataOut) {
+        throw std::runtime_error("cannot write postings data: " + dataPath);
+    }
+
+    std::vector<uint32_t> docIds(docLengths.size());
+    for (size_t i = 0; i < docIds.size(); ++i) {
+        docIds[i] = static_cast<uint32_t>(i);
+    }
+
+    // Память слияния: словарь, таблицы блоков и пропусков, буферы
+    FrontCodedDictionary terms = dictionary.Finish();
+    FuzzyIndex fuzzy = FuzzyIndex::Build(terms, fuzzyDistance);
+    track(terms.UsedBytes() + fuzzy.UsedBytes() +
+          termBlocks.size() * sizeof(uint32_t) * 2 + skips.size() * sizeof(SkipEntry) +
+          docIds.size() * sizeof(uint32_t) + pending.capacity() * sizeof(Posting) +
+          IO_BUFFER * (runPaths.size() + 1));
+
+    IndexFile::Contents contents;
+    contents.terms = &terms;
+    contents.termBlocks = termBlocks.data();
+    contents.skips = skips.data();
+    contents.blockCount = skips.size();
+    contents.dataPath = dataPath;
+    contents.dataSize = dataSize;
+    contents.postingCount = postingCount;
+    contents.docIds = docIds.data();
+    contents.docLengths = docLengths.data();
+    contents.segmentDocCount = docIds.size();
+    if (fuzzy.MaxDistance() > 0) {
+        contents.fuzzy = &fuzzy;
+    }
+    IndexFile::Write(indexPath, contents, static_cast<uint32_t>(docLengths.size()), fingerprint);
+
+    removeTemporaryFiles();
+    progress.memory = 0;
+    report();
+    return progress;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "PostingsAccumulator.h"
+#include "PostingsCodec.h"
+#include "Tokenizer.h"
+
+// Построение индекса вне памяти (SPIMI) для корпусов больше оперативной памяти.
+// Документы индексируются за один проход в словарь в памяти; когда словарь
+// превышает бюджет, он сортируется по словам и сбрасывается на диск
+// отдельным прогоном (run). Finish сливает прогоны k-путевым слиянием прямо
+// в файл индекса (формат IndexFile), сжатые постинги при этом тоже пишутся
+// потоком во временный файл. Результат открывается InvertedIndex::LoadIndex.
+class SpimiBuilder {
+public:
+    struct Progress {
+        size_t documents = 0;
+        uint64_t bytes = 0;          // прочитано байт текста
+        size_t runs = 0;             // сброшено прогонов
+        size_t memory = 0;           // оценка памяти словаря в текущем прогоне
+        size_t peakMemory = 0;       // максимум оценки памяти за все время построения
+        bool merging = false;
+    };
+    using ProgressCallback = std::function<void(const Progress&)>;
+
+    // Прогоны пишутся в tempDirectory (создается, если нет).
+    // memoryBudget - предел памяти словаря одного прогона в байтах.
+    SpimiBuilder(std::string tempDirectory, size_t memoryBudget);
+    ~SpimiBuilder();
+
+    SpimiBuilder(const SpimiBuilder&) = delete;
+    SpimiBuilder& operator=(const SpimiBuilder&) = delete;
+
+    // Индекс удалений для нечеткого поиска (см. InvertedIndex::SetFuzzyDistance);
+    // строится в конце слияния по готовому словарю
+    void SetFuzzyDistance(uint32_t distance) { fuzzyDistance = distance; }
+
+    // Вызывается после каждого сброшенного прогона и в конце слияния
+    void SetProgressCallback(ProgressCallback callback) { progressCallback = std::move(callback); }
+
+    // Документы получают doc_id 0, 1, 2, ... в порядке добавления
+    uint32_t AddDocument(std::string_view text);
+
+    // Сливает прогоны в файл индекса и удаляет временные файлы
+    Progress Finish(const std::string& indexPath, uint64_t fingerprint);
+
+    const Progress& GetProgress() const { return progress; }
+
+private:
+    std::string tempDirectory;
+    size_t memoryBudget;
+    uint32_t fuzzyDistance = 0;
+    ProgressCallback progressCallback;
+    Progress progress;
+
+    PostingsAccumulator postings;
+    std::vector<uint32_t> docLengths;
+    std::vector<std::string> runPaths;
+    Tokenizer tokenizer;
+
+    void spill();
+    void track(size_t memory);
+    void report();
+    void removeTemporaryFiles();
+};
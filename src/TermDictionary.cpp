@@ -0,0 +1,96 @@
+#include "TermDictionary.h"
+
+uint32_t TermDictionary::Hash(std::string_view term) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : term) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t TermDictionary::Find(std::string_view term) const {
+    if (slotCount == 0) {
+        return npos;
+    }
+
+    uint32_t hash = Hash(term);
+    size_t mask = slotCount - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        const Slot& slot = slotData[i];
+        if (slot.id == npos) {
+            return npos;
+        }
+        if (slot.hash == hash && Term(slot.id) == term) {
+            return slot.id;
+        }
+    }
+}
+
+uint32_t TermDictionary::Insert(std::string_view term) {
+    // Коэффициент заполнения не выше 1/2
+    if ((Size() + 1) * 2 > slots.size()) {
+        rehash(slots.empty() ? 16 : slots.size() * 2);
+    }
+
+    uint32_t hash = Hash(term);
+    size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+    for (; slots[i].id != npos; i = (i + 1) & mask) {
+        if (slots[i].hash == hash && Term(slots[i].id) == term) {
+            return slots[i].id;
+        }
+    }
+
+    uint32_t id = static_cast<uint32_t>(Size());
+    pool.insert(pool.end(), term.begin(), term.end());
+    termOffsets.push_back(static_cast<uint32_t>(pool.size()));
+    slots[i] = {hash, id};
+    syncViews();
+    return id;
+}
+
+void TermDictionary::Reserve(size_t count) {
+    size_t capacity = 16;
+    while (capacity < count * 2) {
+        capacity *= 2;
+    }
+    if (capacity > slots.size()) {
+        rehash(capacity);
+    }
+    termOffsets.reserve(count + 1);
+    syncViews();
+}
+
+void TermDictionary::Clear() {
+    slots.clear();
+    termOffsets.assign(1, 0);
+    pool.clear();
+    syncViews();
+}
+
+void TermDictionary::rehash(size_t capacity) {
+    std::vector<Slot> fresh(capacity, Slot{0, npos});
+    size_t mask = capacity - 1;
+    for (const Slot& slot : slots) {
+        if (slot.id == npos) {
+            continue;
+        }
+        size_t i = slot.hash & mask;
+        while (fresh[i].id != npos) {
+            i = (i + 1) & mask;
+        }
+        fresh[i] = slot;
+    }
+    slots.swap(fresh);
+    syncViews();
+}
+
+void TermDictionary::syncViews() {
+    slotData = slots.data();
+    slotCount = slots.size();
+    offsetData = termOffsets.data();
+    termCount = termOffsets.size() - 1;
+    poolData = pool.data();
+}
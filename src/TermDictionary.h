@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// Словарь терминов: слово -> плотный term id (0, 1, 2, ...).
+// Хэш-таблица с открытой адресацией (линейное пробирование),
+// сами строки хранятся подряд в одном буфере.
+// Нужен при построении сегмента (интернирование слов в порядке появления);
+// готовый сегмент хранит отсортированный FrontCodedDictionary.
+class TermDictionary {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t id;      // npos - пустой слот
+    };
+
+    TermDictionary() { syncViews(); }
+    TermDictionary(TermDictionary&&) noexcept = default;
+    TermDictionary& operator=(TermDictionary&&) noexcept = default;
+    TermDictionary(const TermDictionary&) = delete;
+    TermDictionary& operator=(const TermDictionary&) = delete;
+
+    // Возвращает term id или npos, если слова нет в словаре
+    uint32_t Find(std::string_view term) const;
+
+    // Добавляет слово (если его еще нет) и возвращает его term id
+    uint32_t Insert(std::string_view term);
+
+    std::string_view Term(uint32_t id) const {
+        return std::string_view(poolData + offsetData[id], offsetData[id + 1] - offsetData[id]);
+    }
+    size_t Size() const { return termCount; }
+
+    void Reserve(size_t termCount);
+    void Clear();
+
+    static uint32_t Hash(std::string_view term);
+
+    size_t PoolSize() const { return offsetData[termCount]; }
+
+    // Байты таблицы, смещений и строк; OwnedBytes - выделено в куче
+    // вместе с запасом емкости
+    size_t UsedBytes() const {
+        return slotCount * sizeof(Slot) + (termCount + 1) * sizeof(uint32_t) + PoolSize();
+    }
+    size_t OwnedBytes() const {
+        return slots.capacity() * sizeof(Slot) + termOffsets.capacity() * sizeof(uint32_t) + pool.capacity();
+    }
+
+private:
+    std::vector<Slot> slots;                  // размер - степень двойки
+    std::vector<uint32_t> termOffsets = {0};  // начало каждого слова в pool
+    std::vector<char> pool;
+
+    // Указатели на массивы, чтобы чтение не проходило через векторы
+    const Slot* slotData = nullptr;
+    size_t slotCount = 0;
+    const uint32_t* offsetData = nullptr;
+    size_t termCount = 0;
+    const char* poolData = nullptr;
+
+    void rehash(size_t capacity);
+    void syncViews();
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <queue>
+
+// Пул потоков фиксированного размера.
+// Используется вместо создания отдельного std::thread на каждый документ.
+class ThreadPool {
+public:
+    // threadCount == 0 - размер пула по числу аппаратных потоков
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t Size() const { return workers.size(); }
+
+    // Поставить задачу в очередь
+    std::future<void> Submit(std::function<void()> task);
+
+    // Выполнить body(i) для всех i из [0, count) и дождаться завершения.
+    // Исключение из любой задачи пробрасывается вызывающему.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    static size_t DefaultThreadCount();
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::packaged_task<void()>> tasks;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    bool stopping = false;
+
+    void workerLoop();
+};
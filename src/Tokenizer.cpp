@@ -0,0 +1,195 @@
+#include "Tokenizer.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TOKENIZER_SSE2 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+inline bool isSeparator(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Один байт результата приведения к нижнему регистру. Векторный проход
+// реализует то же правило, поэтому края буфера обрабатываются этой функцией.
+// Прописная кириллица в UTF-8: D0 80..8F (Ѐ-Џ), D0 90..9F (А-П), D0 A0..AF (Р-Я);
+// строчные: D1 90..9F, D0 B0..BF, D1 80..8F. Байт 0xD0 в UTF-8 всегда ведущий.
+inline unsigned char lowerByte(const unsigned char* src, size_t size, size_t i) {
+    unsigned char c = src[i];
+    if (c >= 'A' && c <= 'Z') {
+        return static_cast<unsigned char>(c + 0x20);
+    }
+    if (c == 0xD0 && i + 1 < size) {
+        unsigned char next = src[i + 1];
+        if ((next >= 0x80 && next <= 0x8F) || (next >= 0xA0 && next <= 0xAF)) {
+            return 0xD1;
+        }
+    }
+    if (i > 0 && src[i - 1] == 0xD0) {
+        if (c >= 0x80 && c <= 0x8F) return static_cast<unsigned char>(c + 0x10);
+        if (c >= 0x90 && c <= 0x9F) return static_cast<unsigned char>(c + 0x20);
+        if (c >= 0xA0 && c <= 0xAF) return static_cast<unsigned char>(c - 0x20);
+    }
+    return c;
+}
+
+#ifdef TOKENIZER_SSE2
+inline unsigned lowestBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// Маска байтов из диапазона [low, high] (беззнаковое сравнение)
+inline __m128i inRange(__m128i v, unsigned char low, unsigned char high) {
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(static_cast<char>(low)));
+    return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(static_cast<char>(high - low))), shifted);
+}
+
+inline unsigned separatorMask(const char* data) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    __m128i mask = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), inRange(v, '\t', '\r'));
+    return static_cast<unsigned>(_mm_movemask_epi8(mask));
+}
+#endif
+
+}
+
+bool Tokenizer::HasSimd() {
+#ifdef TOKENIZER_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Tokenizer::LowercaseScalar(const char* src, size_t size, char* dst) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(src);
+    for (size_t i = 0; i < size; ++i) {
+        dst[i] = static_cast<char>(lowerByte(bytes, size, i));
+    }
+}
+
+void Tokenizer::Lowercase(const char* src, size_t size, char* dst) {
+#ifdef TOKENIZER_SSE2
+    // Векторному блоку [i, i + 16) нужны соседние байты src[i - 1] и src[i + 16]
+    if (size < 18) {
+        LowercaseScalar(src, size, dst);
+        return;
+    }
+
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(src);
+    dst[0] = static_cast<char>(lowerByte(bytes, size, 0));
+
+    const __m128i lead = _mm_set1_epi8(static_cast<char>(0xD0));
+    size_t i = 1;
+    for (; i + 17 <= size; i += 16) {
+        __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i - 1));
+        __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+        // Чистый ASCII без кириллицы - только A-Z
+        __m128i upper = inRange(cur, 'A', 'Z');
+        __m128i result = _mm_add_epi8(cur, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+
+        if (_mm_movemask_epi8(_mm_or_si128(cur, prev)) != 0) {
+            __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 1));
+
+            // Ведущий байт Ѐ-Џ и Р-Я: D0 -> D1
+            __m128i nextShifted = _mm_or_si128(inRange(next, 0x80, 0x8F), inRange(next, 0xA0, 0xAF));
+            __m128i leadFix = _mm_and_si128(_mm_cmpeq_epi8(cur, lead), nextShifted);
+            result = _mm_add_epi8(result, _mm_and_si128(leadFix, _mm_set1_epi8(1)));
+
+            // Второй байт: +0x10, +0x20 или -0x20 в зависимости от диапазона
+            __m128i afterLead = _mm_cmpeq_epi8(prev, lead);
+            __m128i delta = _mm_and_si128(inRange(cur, 0x80, 0x8F), _mm_set1_epi8(0x10));
+            delta = _mm_or_si128(delta, _mm_and_si128(inRange(cur, 0x90, 0x9F), _mm_set1_epi8(0x20)));
+            delta = _mm_or_si128(delta, _mm_and_si128(inRange(cur, 0xA0, 0xAF), _mm_set1_epi8(-0x20)));
+            result = _mm_add_epi8(result, _mm_and_si128(afterLead, delta));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), result);
+    }
+
+    for (; i < size; ++i) {
+        dst[i] = static_cast<char>(lowerByte(bytes, size, i));
+    }
+#else
+    LowercaseScalar(src, size, dst);
+#endif
+}
+
+size_t Tokenizer::FindSeparator(const char* data, size_t size, size_t from) {
+    size_t i = from;
+#ifdef TOKENIZER_SSE2
+    for (; i + 16 <= size; i += 16) {
+        unsigned mask = separatorMask(data + i);
+        if (mask != 0) {
+            return i + lowestBit(mask);
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (isSeparator(static_cast<unsigned char>(data[i]))) {
+            return i;
+        }
+    }
+    return size;
+}
+
+size_t Tokenizer::FindNonSeparator(const char* data, size_t size, size_t from) {
+    size_t i = from;
+#ifdef TOKENIZER_SSE2
+    for (; i + 16 <= size; i += 16) {
+        unsigned mask = ~separatorMask(data + i) & 0xFFFFu;
+        if (mask != 0) {
+            return i + lowestBit(mask);
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (!isSeparator(static_cast<unsigned char>(data[i]))) {
+            return i;
+        }
+    }
+    return size;
+}
+
+void Tokenizer::Reset(std::string_view text) {
+    // Буфер переиспользуется между текстами и растет только при необходимости
+    buffer.resize(text.size());
+    Lowercase(text.data(), text.size(), buffer.data());
+    pos = 0;
+}
+
+bool Tokenizer::Next(std::string_view& token) {
+    const char* data = buffer.data();
+    size_t size = buffer.size();
+    while (true) {
+        size_t begin = FindNonSeparator(data, size, pos);
+        if (begin == size) {
+            pos = size;
+            return false;
+        }
+        size_t end = FindSeparator(data, size, begin);
+        pos = end;
+        if (end - begin <= MAX_TOKEN_LENGTH) {
+            token = std::string_view(data + begin, end - begin);
+            return true;
+        }
+    }
+}
+
+std::string Tokenizer::Normalize(std::string_view word) {
+    std::string result(word.size(), '\0');
+    Lowercase(word.data(), word.size(), result.data());
+    return result;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+// Разбиение текста на слова - общее для индексации и разбора запросов,
+// поэтому слова документа и запроса нормализуются одинаково.
+// Разделители - пробельные символы ASCII (как у std::istream >> word).
+// Текст приводится к нижнему регистру (латиница и кириллица в UTF-8)
+// во внутренний буфер, слова выдаются как string_view на этот буфер
+// и действительны до следующего Reset.
+class Tokenizer {
+public:
+    // Слова длиннее (в байтах) пропускаются
+    static constexpr size_t MAX_TOKEN_LENGTH = 100;
+
+    void Reset(std::string_view text);
+
+    // Следующее слово; false, когда текст закончился
+    bool Next(std::string_view& token);
+
+    // Нормализация отдельного слова (например, для InvertedIndex::GetWordCount)
+    static std::string Normalize(std::string_view word);
+
+    // Приведение к нижнему регистру из src в dst (размер не меняется):
+    // A-Z -> a-z, А-Я и Ѐ-Џ -> а-я и ѐ-џ. Остальные байты копируются как есть.
+    static void Lowercase(const char* src, size_t size, char* dst);
+    static void LowercaseScalar(const char* src, size_t size, char* dst);
+
+    // Позиция первого разделителя (или не-разделителя) начиная с from; size, если нет
+    static size_t FindSeparator(const char* data, size_t size, size_t from);
+    static size_t FindNonSeparator(const char* data, size_t size, size_t from);
+
+    // Используются ли векторные проходы на этой сборке
+    static bool HasSimd();
+
+private:
+    std::string buffer;
+    size_t pos = 0;
+};
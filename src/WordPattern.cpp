@@ -0,0 +1,53 @@
+#include "WordPattern.h"
+
+namespace {
+
+// Начало следующего символа UTF-8: продолжающие байты 10xxxxxx пропускаются
+size_t nextCharacter(std::string_view word, size_t at) {
+    ++at;
+    while (at < word.size() && (static_cast<unsigned char>(word[at]) & 0xC0) == 0x80) {
+        ++at;
+    }
+    return at;
+}
+
+}
+
+bool WordPattern::IsPattern(std::string_view word) {
+    return word.find_first_of("*?") != std::string_view::npos;
+}
+
+std::string_view WordPattern::LiteralPrefix(std::string_view pattern) {
+    return pattern.substr(0, pattern.find_first_of("*?"));
+}
+
+bool WordPattern::Matches(std::string_view pattern, std::string_view word) {
+    // Жадное сопоставление с откатом к последней '*': она забирает
+    // еще один символ слова, и сравнение продолжается после нее
+    size_t p = 0;
+    size_t w = 0;
+    size_t star = std::string_view::npos;
+    size_t starWord = 0;
+    while (w < word.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            starWord = w;
+        } else if (p < pattern.size() && pattern[p] == '?') {
+            ++p;
+            w = nextCharacter(word, w);
+        } else if (p < pattern.size() && pattern[p] == word[w]) {
+            ++p;
+            ++w;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            starWord = nextCharacter(word, starWord);
+            w = starWord;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
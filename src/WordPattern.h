@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string_view>
+
+// Шаблоны слов запроса: '*' - любая (в том числе пустая) последовательность
+// символов, '?' - ровно один символ UTF-8. Остальные байты сравниваются как есть;
+// шаблон нормализуется токенизатором, как и любое слово запроса.
+class WordPattern {
+public:
+    static bool IsPattern(std::string_view word);
+
+    // Часть шаблона до первого '*' или '?': все подходящие слова начинаются с нее
+    static std::string_view LiteralPrefix(std::string_view pattern);
+
+    // Подходит ли слово под шаблон целиком
+    static bool Matches(std::string_view pattern, std::string_view word);
+};
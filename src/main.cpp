@@ -1,9 +1,22 @@
 #include <iostream>
 #include <memory>
 #include <filesystem>
+#include <atomic>
+#include <csignal>
+#include <cctype>
+#include <iomanip>
+#include <sstream>
 #include "ConverterJSON.h"
 #include "InvertedIndex.h"
 #include "SearchServer.h"
+#include "IngestionPipeline.h"
+#include "SpimiBuilder.h"
+#include "SearchDaemon.h"
+#include "IndexReloader.h"
+#include "Metrics.h"
+#include "DocumentStore.h"
+#include "SearchShard.h"
+#include "ShardCoordinator.h"
 
 void printCurrentDirectory() {
     std::cout << "📁 Current working directory: " << std::filesystem::current_path() << std::endl;
@@ -30,7 +43,326 @@ void checkRequiredFiles() {
     }
 }
 
-int main() {
+std::string formatBytes(size_t bytes) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    if (bytes >= (size_t(1) << 20)) {
+        out << static_cast<double>(bytes) / (1 << 20) << " MiB";
+    } else if (bytes >= 1024) {
+        out << static_cast<double>(bytes) / 1024 << " KiB";
+    } else {
+        out << bytes << " B";
+    }
+    return out.str();
+}
+
+void printMemoryReport(const IndexMemoryUsage& usage) {
+    std::cout << "🧮 Index memory report" << std::endl
+              << "   segments: " << usage.segments << ", terms: " << usage.terms
+              << ", postings: " << usage.postings << std::endl
+              << "   term dictionary:    " << formatBytes(usage.dictionaryBytes) << std::endl
+              << "   postings:           " << formatBytes(usage.postingsBytes) << std::endl
+              << "   positions:          " << formatBytes(usage.positionsBytes) << std::endl
+              << "   fuzzy index:        " << formatBytes(usage.fuzzyBytes) << std::endl
+              << "   document lists:     " << formatBytes(usage.documentBytes) << std::endl
+              << "   deleted documents:  " << formatBytes(usage.deletedBytes) << std::endl
+              << "   stored text:        " << formatBytes(usage.storedTextBytes) << std::endl
+              << "   allocator slack:    " << formatBytes(usage.slackBytes) << std::endl
+              << "   heap total:         " << formatBytes(usage.heapBytes) << std::endl
+              << "   mapped from file:   " << formatBytes(usage.mappedBytes) << std::endl;
+    if (!usage.largestTerms.empty()) {
+        std::cout << "   largest postings lists:" << std::endl;
+        for (const auto& term : usage.largestTerms) {
+            std::cout << "     " << term.term << ": " << term.postings << " posting(s), "
+                      << formatBytes(term.bytes) << std::endl;
+        }
+    }
+}
+
+// Индекс по текущему config.json: открытие сохраненного индекса, если он
+// построен по тем же файлам, иначе построение заново (в памяти или вне памяти).
+// shardCount > 1 - только документы шарда shard (см. ShardCoordinator),
+// файлы индекса и хранилища у каждого шарда свои
+std::shared_ptr<InvertedIndex> buildIndex(ConverterJSON& converter, size_t shard = 0, size_t shardCount = 1) {
+    auto index = std::make_shared<InvertedIndex>(converter.GetIndexingThreads());
+    index->SetMemoryBudget(converter.GetIndexMemoryBytes(), converter.GetIndexMemoryPolicy());
+
+    std::vector<std::string> paths = converter.GetDocumentPaths();
+    std::string suffix;
+    if (shardCount > 1) {
+        std::vector<std::string> part;
+        for (size_t i = shard; i < paths.size(); i += shardCount) {
+            part.push_back(paths[i]);
+        }
+        paths = std::move(part);
+        suffix = ".shard" + std::to_string(shard) + "of" + std::to_string(shardCount);
+        std::cout << "🧩 Shard " << shard << " of " << shardCount << ": " << paths.size() << " document(s)" << std::endl;
+    }
+
+    // Открытие сохраненного индекса, если он построен по тем же файлам
+    std::string indexPath = converter.GetIndexPath();
+    uint64_t fingerprint = converter.GetFilesFingerprint();
+    if (!indexPath.empty()) {
+        indexPath += suffix;
+    }
+
+    // Построение вне памяти позиции не пишет
+    bool positional = converter.GetPositionalIndex();
+    if (positional && !indexPath.empty() && converter.GetBuildMemoryBytes() > 0) {
+        std::cerr << "⚠️  Warning: positional_index is not supported with build_memory_mb, "
+                  << "phrases will match by words only" << std::endl;
+        positional = false;
+    }
+    index->SetPositional(positional);
+    index->SetFuzzyDistance(converter.GetFuzzyDistance());
+
+    // Хранилище текстов для сниппетов: открывается, если построено по тем же
+    // файлам, иначе записывается заново по ходу чтения документов
+    std::string storePath = converter.GetDocumentStorePath();
+    if (!storePath.empty()) {
+        storePath += suffix;
+    }
+    std::shared_ptr<DocumentStore> store;
+    if (!storePath.empty()) {
+        try {
+            store = DocumentStore::Open(storePath, fingerprint);
+        } catch (const std::exception& e) {
+            std::cerr << "⚠️  Warning: " << e.what() << ", rebuilding document store" << std::endl;
+        }
+    }
+    std::unique_ptr<DocumentStore::Writer> storeWriter;
+    if (!storePath.empty() && !store) {
+        storeWriter = std::make_unique<DocumentStore::Writer>(storePath);
+    }
+
+    bool indexLoaded = false;
+    if (!indexPath.empty()) {
+        try {
+            indexLoaded = index->LoadIndex(indexPath, fingerprint, converter.GetVerifyIndex());
+        } catch (const std::exception& e) {
+            std::cerr << "⚠️  Warning: " << e.what() << ", rebuilding index" << std::endl;
+        }
+    }
+
+    if (indexLoaded) {
+        std::cout << "✅ Index loaded from " << indexPath << std::endl;
+        if (storeWriter) {
+            // Индекс готов, а хранилища нет: тексты читаются только ради него
+            IngestionPipeline::ReadFiles(paths, converter.GetIngestMemoryBytes() / 2 + 1,
+                                         [&storeWriter](std::string&& text) { storeWriter->Add(text); });
+        }
+    } else if (!indexPath.empty() && converter.GetBuildMemoryBytes() > 0) {
+        // Построение вне памяти: словарь сбрасывается на диск прогонами,
+        // затем прогоны сливаются прямо в файл индекса
+        std::cout << "📚 Building index out of core..." << std::endl;
+        SpimiBuilder builder(indexPath + ".runs", converter.GetBuildMemoryBytes());
+        builder.SetFuzzyDistance(converter.GetFuzzyDistance());
+        builder.SetProgressCallback([](const SpimiBuilder::Progress& progress) {
+            std::cout << (progress.merging ? "   merged " : "   spilled run ") << progress.runs
+                      << (progress.merging ? " run(s), " : ": ") << progress.documents << " documents, "
+                      << progress.bytes / 1024 << " KiB of text, peak memory "
+                      << progress.peakMemory / 1024 << " KiB" << std::endl;
+        });
+        IngestionPipeline::ReadFiles(paths, converter.GetIngestMemoryBytes() / 2 + 1,
+                                     [&builder, &storeWriter](std::string&& text) {
+                                         if (storeWriter) {
+                                             storeWriter->Add(text);
+                                         }
+                                         builder.AddDocument(text);
+                                     });
+        builder.Finish(indexPath, fingerprint);
+        std::filesystem::remove(indexPath + ".runs");
+
+        if (!index->LoadIndex(indexPath, fingerprint)) {
+            throw std::runtime_error("cannot open built index " + indexPath);
+        }
+        std::cout << "✅ Indexed " << builder.GetProgress().documents << " documents into "
+                  << indexPath << std::endl;
+    } else {
+        // Потоковая загрузка и индексация документов: чтение файлов идет
+        // параллельно с индексацией, тексты не копятся в памяти
+        std::cout << "📚 Loading and indexing documents..." << std::endl;
+        IngestionPipeline pipeline(*index, converter.GetIngestMemoryBytes());
+        if (storeWriter) {
+            pipeline.SetDocumentSink([&storeWriter](const std::string& text) { storeWriter->Add(text); });
+        }
+        size_t documentCount = pipeline.Run(paths);
+        std::cout << "✅ Indexed " << documentCount << " documents" << std::endl;
+
+        if (!indexPath.empty()) {
+            index->SaveIndex(indexPath, fingerprint);
+            std::cout << "💾 Index saved to " << indexPath << std::endl;
+        }
+    }
+
+    if (storeWriter) {
+        storeWriter->Finish(fingerprint);
+        store = std::make_shared<DocumentStore>(storePath);
+        std::cout << "🗄️  Document store saved to " << storePath << std::endl;
+    }
+    if (store) {
+        index->SetDocumentStore(store);
+        std::cout << "🗄️  Document store: " << store->Size() << " documents, "
+                  << formatBytes(store->RawBytes()) << " of text in " << formatBytes(store->FileBytes())
+                  << " on disk" << std::endl;
+    }
+
+    auto usage = index->GetMemoryUsage();
+    std::cout << "🧮 Index memory: " << formatBytes(usage.heapBytes) << " in heap, "
+              << formatBytes(usage.mappedBytes) << " mapped from file" << std::endl;
+    return index;
+}
+
+// Отчет телеметрии, если она включена полем metrics_path
+void saveMetrics(const std::string& metricsPath) {
+    if (metricsPath.empty()) {
+        return;
+    }
+    try {
+        Metrics::WriteJson(metricsPath);
+        std::cout << "📊 Metrics saved to " << metricsPath << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "⚠️  Warning: " << e.what() << std::endl;
+    }
+}
+
+// Обработчики сигналов читают сервер через lock-free atomic, а сами
+// Stop/RequestReload только ставят флаг и пишут в pipe пробуждения
+std::atomic<SearchDaemon*> runningDaemon{nullptr};
+static_assert(std::atomic<SearchDaemon*>::is_always_lock_free, "signal handlers need a lock-free pointer");
+
+void stopDaemon(int) {
+    if (SearchDaemon* daemon = runningDaemon.load()) {
+        daemon->Stop();
+    }
+}
+
+void reloadDaemon(int) {
+    if (SearchDaemon* daemon = runningDaemon.load()) {
+        daemon->RequestReload();
+    }
+}
+
+// sigaction: обработчик не сбрасывается после первого сигнала, а прерванные
+// системные вызовы перезапускаются (poll сетевого цикла будит pipe)
+void installSignal(int signal, void (*handler)(int)) {
+#ifndef _WIN32
+    struct sigaction action{};
+    action.sa_handler = handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(signal, &action, nullptr);
+#else
+    std::signal(signal, handler);
+#endif
+}
+
+// Резидентный режим: индекс уже в памяти, запросы идут через сокет или stdin/stdout.
+// SIGHUP - перечитать config.json и перестроить индекс (rebuild) в фоне, не прерывая
+// поиск. Координатор шардов не перезагружается: перезагружаются сами процессы шардов
+void serve(SearchServer& server, const std::string& socketPath, IndexReloader::Builder rebuild) {
+    IndexReloader reloader(server, std::move(rebuild), [&server](const InvertedIndex& fresh, std::string& error) {
+        // Пустой индекс вместо непустого - скорее всего ошибка в config.json
+        if (fresh.GetDocumentCount() == 0 && server.GetIndex()->GetDocumentCount() > 0) {
+            error = "new index has no documents";
+            return false;
+        }
+        return true;
+    });
+
+    SearchDaemon daemon(server);
+    bool reloadable = !server.GetShards();
+    daemon.SetReloadHandler([&reloader, reloadable]() {
+        if (reloadable) {
+            reloader.Request();
+        } else {
+            std::cerr << "⚠️  Warning: sharded search is not reloaded in place, "
+                      << "reload the shard processes or restart" << std::endl;
+        }
+    });
+    runningDaemon.store(&daemon);
+    installSignal(SIGINT, stopDaemon);
+    installSignal(SIGTERM, stopDaemon);
+#ifdef SIGHUP
+    installSignal(SIGHUP, reloadDaemon);
+#endif
+#ifdef SIGPIPE
+    installSignal(SIGPIPE, SIG_IGN);
+#endif
+
+    if (socketPath == "-") {
+        std::cout << "🛰️  Serving queries on stdin/stdout" << std::endl;
+        daemon.ServeStream(0, 1);
+    } else {
+        std::cout << "🛰️  Serving queries on " << socketPath << " (Ctrl+C to stop)" << std::endl;
+        daemon.ServeSocket(socketPath);
+    }
+    runningDaemon.store(nullptr);
+
+    auto stats = daemon.GetStats();
+    std::cout << "🛑 Server stopped: " << stats.requests << " request(s), " << stats.rejected
+              << " rejected, " << stats.batches << " batch(es)" << std::endl;
+
+    reloader.WaitIdle();
+    auto reloads = reloader.GetStats();
+    if (reloads.reloads + reloads.failures > 0) {
+        std::cout << "🔁 Index reloads: " << reloads.reloads << " succeeded, " << reloads.failures << " failed";
+        if (!reloads.lastError.empty()) {
+            std::cout << " (last error: " << reloads.lastError << ")";
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // --serve <socket> - резидентный режим на Unix-сокете, --serve - - на stdin/stdout;
+    // --memory-report [N] - построить индекс, напечатать его память и N самых больших слов;
+    // --shard I/N - процесс шарда I из N: индекс только по его документам (с --serve)
+    std::string socketPath;
+    size_t memoryReportTerms = 0;
+    bool memoryReport = false;
+    bool shardProcess = false;
+    size_t shard = 0;
+    size_t shardCount = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--serve" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (arg == "--shard" && i + 1 < argc) {
+            std::string part = argv[++i];
+            size_t slash = part.find('/');
+            try {
+                shard = std::stoul(part.substr(0, slash));
+                shardCount = slash == std::string::npos ? 0 : std::stoul(part.substr(slash + 1));
+            } catch (const std::exception&) {
+                shardCount = 0;
+            }
+            if (shardCount == 0 || shard >= shardCount) {
+                std::cerr << "--shard expects I/N with I < N, got " << part << std::endl;
+                return 2;
+            }
+            shardProcess = true;
+        } else if (arg == "--memory-report") {
+            memoryReport = true;
+            memoryReportTerms = 10;
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+                memoryReportTerms = std::stoul(argv[++i]);
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--serve <socket path> | --serve -] [--memory-report [N]]"
+                      << " [--shard I/N]" << std::endl;
+            return 2;
+        }
+    }
+    if (shardProcess && socketPath.empty() && !memoryReport) {
+        std::cerr << "--shard requires --serve: a shard answers the coordinator" << std::endl;
+        return 2;
+    }
+    if (socketPath == "-") {
+        // stdout занят протоколом, журнал уходит в stderr
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
     system("chcp 65001");
     try {
         std::cout << "🚀 === SEARCH ENGINE ===" << std::endl;
@@ -41,19 +373,68 @@ int main() {
         // Инициализация компонентов
         std::cout << "🔄 Initializing search engine..." << std::endl;
         ConverterJSON converter;
-        auto index = std::make_shared<InvertedIndex>();
-        SearchServer server(index);
+        const std::string metricsPath = converter.GetMetricsPath();
+        Metrics::SetEnabled(!metricsPath.empty());
+        if (!metricsPath.empty() && !SEARCH_ENGINE_METRICS) {
+            std::cerr << "⚠️  Warning: metrics_path is set, but metrics are disabled at build time" << std::endl;
+        }
 
-        // Получаем лимит ответов из конфигурации
-        int maxResponses = converter.GetResponsesLimit();
+        // Распределенный поиск: шарды в отдельных процессах (shard_sockets)
+        // или в этом процессе (shards); сервер тогда только координирует.
+        // Процесс шарда (--shard) сам ищет только по своим документам
+        std::vector<std::string> shardSockets;
+        size_t localShards = 1;
+        if (!shardProcess) {
+            shardSockets = converter.GetShardSockets();
+            localShards = shardSockets.empty() ? converter.GetShardCount() : 1;
+        }
+        std::vector<std::shared_ptr<InvertedIndex>> indexes;
+        std::vector<std::shared_ptr<SearchShard>> shards;
+        if (!shardSockets.empty()) {
+            for (const auto& shardSocket : shardSockets) {
+                shards.push_back(std::make_shared<RemoteShard>(shardSocket, converter.GetShardTimeoutMs()));
+            }
+            std::cout << "🧩 Coordinating " << shards.size() << " shard process(es)" << std::endl;
+        } else if (localShards > 1) {
+            for (size_t s = 0; s < localShards; ++s) {
+                indexes.push_back(buildIndex(converter, s, localShards));
+                auto shardServer = std::make_shared<SearchServer>(indexes.back());
+                shardServer->SetSnippetLength(converter.GetSnippetLength());
+                shards.push_back(std::make_shared<LocalShard>(shardServer));
+            }
+        } else {
+            indexes.push_back(buildIndex(converter, shard, shardCount));
+        }
+        auto index = shards.empty() ? indexes.front() : std::make_shared<InvertedIndex>();
 
-        // Загрузка и индексация документов
-        std::cout << "📚 Loading and indexing documents..." << std::endl;
-        auto documents = converter.GetTextDocuments();
-        std::cout << "✅ Loaded " << documents.size() << " documents" << std::endl;
+        // Сервер сразу отбирает не более max_responses лучших документов на запрос
+        SearchServer server(index, static_cast<size_t>(converter.GetResponsesLimit()));
+        server.SetSearchThreads(converter.GetSearchThreads());
+        server.SetCacheCapacity(converter.GetQueryCacheBytes());
+        server.SetRanking(converter.GetRanking());
+        server.SetMaxExpansions(converter.GetMaxExpansions());
+        server.SetFuzzyDistance(converter.GetFuzzyDistance());
+        server.SetFuzzyPenalty(converter.GetFuzzyPenalty());
+        server.SetMaxFuzzyTerms(converter.GetMaxFuzzyTerms());
+        server.SetSnippetLength(converter.GetSnippetLength());
+        server.SetShards(shards);
 
-        index->UpdateDocumentBase(documents);
-        std::cout << "✅ Documents indexed successfully" << std::endl;
+        if (memoryReport) {
+            for (const auto& shardIndex : indexes) {
+                printMemoryReport(shardIndex->GetMemoryUsage(memoryReportTerms));
+            }
+            return 0;
+        }
+
+        if (!socketPath.empty()) {
+            serve(server, socketPath, [shard, shardCount]() {
+                std::cout << "🔁 Reloading index..." << std::endl;
+                ConverterJSON converter;
+                return buildIndex(converter, shard, shardCount);
+            });
+            saveMetrics(metricsPath);
+            return 0;
+        }
 
         // Получение запросов
         std::cout << "🔎 Loading search requests..." << std::endl;
@@ -64,16 +445,21 @@ int main() {
         std::cout << "⚡ Processing search queries..." << std::endl;
         auto allSearchResults = server.search(requests);
         std::cout << "✅ Search completed" << std::endl;
+        if (converter.GetQueryCacheBytes() > 0) {
+            auto cacheStats = server.GetCacheStats();
+            std::cout << "🗃️  Query cache: " << cacheStats.hits << " hit(s), " << cacheStats.misses
+                      << " miss(es), " << cacheStats.entries << " entries" << std::endl;
+        }
 
-        // Подготовка результатов с учетом max_responses
+        // Подготовка результатов (лимит max_responses уже применен сервером)
         std::vector<std::vector<std::pair<int, float>>> answers;
         
         for (const auto& result : allSearchResults) {
             std::vector<std::pair<int, float>> queryResult;
             
             // Сохраняем оригинальную сортировку (по убыванию релевантности)
-            for (size_t i = 0; i < result.size() && i < static_cast<size_t>(maxResponses); ++i) {
-                queryResult.emplace_back(static_cast<int>(result[i].doc_id), result[i].rank);
+            for (const auto& entry : result) {
+                queryResult.emplace_back(static_cast<int>(entry.doc_id), entry.rank);
             }
             
             answers.push_back(queryResult);
@@ -101,6 +487,7 @@ int main() {
         // Сохранение результатов
         std::cout << "💾 Saving results to answers.json..." << std::endl;
         converter.putAnswers(answers);
+        saveMetrics(metricsPath);
 
         std::cout << "🎉 === SEARCH COMPLETED SUCCESSFULLY ===" << std::endl;
 
@@ -1,11 +1,76 @@
 #include "gtest/gtest.h"
 #include "../src/InvertedIndex.h"
 #include "../src/SearchServer.h"
+#include "../src/TermDictionary.h"
+#include "../src/FrontCodedDictionary.h"
+#include "../src/FuzzyIndex.h"
+#include "../src/Intersection.h"
+#include "../src/Tokenizer.h"
+#include "../src/IngestionPipeline.h"
+#include "../src/SpimiBuilder.h"
+#include "../src/SearchDaemon.h"
+#include "../src/IndexReloader.h"
+#include "../src/ConverterJSON.h"
+#include "../src/Metrics.h"
+#include "../src/DocumentStore.h"
+#include "../src/LzCodec.h"
+#include "../src/Snippet.h"
+#include "../src/ShardCoordinator.h"
 #include <vector>
+#include <set>
 #include <memory>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "nlohmann/json.hpp"
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
+// Счетчик выделений памяти: замещенный глобальный operator new считает
+// вызовы текущего потока, пока тест держит счет включенным
+namespace {
+thread_local bool countingAllocations = false;
+thread_local size_t allocationCount = 0;
+
+template <typename Function>
+size_t CountAllocations(Function&& function) {
+    allocationCount = 0;
+    countingAllocations = true;
+    function();
+    countingAllocations = false;
+    return allocationCount;
+}
+}
+
+void* operator new(size_t size) {
+    if (countingAllocations) {
+        ++allocationCount;
+    }
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
 void TestInvertedIndexFunctionality(
         const vector<string>& docs,
         const vector<string>& requests,
@@ -71,6 +136,299 @@ TEST(TestCaseInvertedIndex, TestInvertedIndexMissingWord) {
     TestInvertedIndexFunctionality(docs, requests, expected);
 }
 
+TEST(TestCaseInvertedIndex, TestThreadCountDoesNotChangeIndex) {
+    vector<string> docs;
+    for (size_t i = 0; i < 50; ++i) {
+        docs.push_back("common word" + to_string(i % 7) + " common tail" + to_string(i % 3));
+    }
+
+    InvertedIndex single(1);
+    InvertedIndex multi(4);
+    single.UpdateDocumentBase(docs);
+    multi.UpdateDocumentBase(docs);
+
+    for (const string word : {"common", "word0", "word6", "tail2", "missing"}) {
+        vector<Entry> expected = single.GetWordCount(word);
+        vector<Entry> actual = multi.GetWordCount(word);
+        ASSERT_EQ(actual, expected) << word;
+        ASSERT_TRUE(is_sorted(actual.begin(), actual.end(),
+            [](const Entry& a, const Entry& b) { return a.doc_id < b.doc_id; }));
+    }
+    ASSERT_EQ(multi.GetWordCount("common").size(), docs.size());
+    ASSERT_EQ(multi.GetWordCount("common")[0].count, 2u);
+}
+
+TEST(TestCaseInvertedIndex, TestSnapshotSurvivesUpdate) {
+    InvertedIndex idx;
+    idx.UpdateDocumentBase({"milk water", "milk"});
+
+    auto before = idx.GetSnapshot();
+    ASSERT_EQ(before->Segments().size(), 1u);
+    PostingsList milk = before->Segments()[0].segment->Find("milk");
+    ASSERT_EQ(milk.size(), 2u);
+
+    idx.UpdateDocumentBase({"sugar"});
+
+    // Старый снимок и полученная из него ссылка на список остаются корректными
+    ASSERT_EQ(milk.size(), 2u);
+    EXPECT_EQ(milk.Decode(), (vector<Posting>{ {0, 1}, {1, 1} }));
+    EXPECT_TRUE(idx.GetSnapshot()->CollectPostings("milk").empty());
+    EXPECT_EQ(idx.GetWordCount("sugar"), (vector<Entry>{ {0, 1} }));
+}
+
+TEST(TestCasePostingsCodec, TestPackUnpackAllWidths) {
+    uint32_t values[PostingsCodec::BLOCK_SIZE];
+    uint32_t unpacked[PostingsCodec::BLOCK_SIZE];
+    uint32_t unpackedScalar[PostingsCodec::BLOCK_SIZE];
+    uint8_t packed[16 * 32];
+
+    for (uint32_t bits = 0; bits <= 32; ++bits) {
+        uint64_t limit = uint64_t(1) << bits;
+        for (size_t i = 0; i < PostingsCodec::BLOCK_SIZE; ++i) {
+            values[i] = static_cast<uint32_t>((i * 2654435761u + bits) % limit);
+        }
+        PostingsCodec::Pack(values, bits, packed);
+        PostingsCodec::Unpack(packed, bits, unpacked);
+        PostingsCodec::UnpackScalar(packed, bits, unpackedScalar);
+        ASSERT_TRUE(equal(values, values + PostingsCodec::BLOCK_SIZE, unpacked)) << bits;
+        ASSERT_TRUE(equal(values, values + PostingsCodec::BLOCK_SIZE, unpackedScalar)) << bits;
+    }
+}
+
+TEST(TestCasePostingsCodec, TestEncodeDecodeAndSeek) {
+    vector<Posting> postings;
+    uint32_t doc = 0;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        doc += 1 + (i % 17 == 0 ? 5000 : i % 3);
+        postings.push_back({doc, 1 + (i % 11 == 0 ? 70000 : i % 4)});
+    }
+
+    vector<SkipEntry> skips;
+    vector<uint8_t> data;
+    PostingsCodec::Encode(postings.data(), postings.size(), skips, data);
+    ASSERT_EQ(skips.size(), 8u);
+    EXPECT_LT(data.size(), postings.size() * sizeof(Posting) / 2);
+
+    PostingsList list(skips.data(), static_cast<uint32_t>(skips.size()), data.data());
+    ASSERT_EQ(list.size(), postings.size());
+    ASSERT_EQ(list.Decode(), postings);
+
+    PostingsCursor cursor(list);
+    for (size_t i = 0; i < postings.size(); i += 97) {
+        // Цель между соседними документами приводит к следующему из них
+        ASSERT_TRUE(cursor.Advance(i == 0 ? 0 : postings[i - 1].doc_id + 1));
+        ASSERT_EQ(cursor.DocId(), postings[i].doc_id);
+        ASSERT_EQ(cursor.Count(), postings[i].count);
+    }
+    EXPECT_FALSE(cursor.Advance(postings.back().doc_id + 1));
+}
+
+TEST(TestCasePostingsCodec, TestPositionsFollowCursor) {
+    vector<Posting> postings;
+    vector<uint32_t> positions;
+    vector<size_t> firstPosition;
+    for (uint32_t i = 0; i < 300; ++i) {
+        postings.push_back({i * 3, 1 + i % 5});
+        firstPosition.push_back(positions.size());
+        for (uint32_t k = 0; k < postings.back().count; ++k) {
+            positions.push_back(i + k * (200 + i));
+        }
+    }
+
+    vector<SkipEntry> skips;
+    vector<uint8_t> data;
+    vector<uint32_t> offsets;
+    vector<uint8_t> positionData;
+    PostingsCodec::Encode(postings.data(), postings.size(), skips, data);
+    PostingsCodec::EncodePositions(postings.data(), postings.size(), positions.data(), offsets, positionData);
+    ASSERT_EQ(offsets.size(), skips.size());
+
+    // Позиции читаются и подряд, и вразбивку, и после пропуска целого блока
+    PostingsList list(skips.data(), static_cast<uint32_t>(skips.size()), data.data(),
+                      offsets.data(), positionData.data());
+    PostingsCursor cursor(list);
+    vector<uint32_t> read;
+    for (size_t i : {0, 1, 2, 5, 60, 127, 128, 129, 290, 299}) {
+        ASSERT_TRUE(cursor.Advance(postings[i].doc_id));
+        cursor.Positions(read);
+        auto expected = positions.begin() + static_cast<std::ptrdiff_t>(firstPosition[i]);
+        ASSERT_EQ(read, vector<uint32_t>(expected, expected + postings[i].count)) << i;
+    }
+}
+
+TEST(TestCaseTokenizer, TestSplitAndLowercase) {
+    Tokenizer tokenizer;
+    tokenizer.Reset("  Great\tBRITAIN\n\nМосква ЁЖИК  " + string(101, 'x') + " Ёлка\r\nlast");
+    vector<string> tokens;
+    string_view token;
+    while (tokenizer.Next(token)) {
+        tokens.emplace_back(token);
+    }
+    const vector<string> expected = {"great", "britain", "москва", "ёжик", "ёлка", "last"};
+    EXPECT_EQ(tokens, expected);
+    EXPECT_EQ(Tokenizer::Normalize("ПРИВЕТ Мир Ѐ"), "привет мир ѐ");
+}
+
+TEST(TestCaseTokenizer, TestVectorMatchesScalar) {
+    // Все двухбайтовые последовательности с ведущим D0/D1 и ASCII вперемешку
+    string text;
+    for (int second = 0x80; second <= 0xBF; ++second) {
+        for (char lead : {'\xD0', '\xD1'}) {
+            text += lead;
+            text += static_cast<char>(second);
+            text += static_cast<char>('A' + second % 40);
+        }
+    }
+    for (size_t shift = 0; shift < 20; ++shift) {
+        string source = text.substr(shift);
+        string vectorized(source.size(), '\0'), scalar(source.size(), '\0');
+        Tokenizer::Lowercase(source.data(), source.size(), vectorized.data());
+        Tokenizer::LowercaseScalar(source.data(), source.size(), scalar.data());
+        ASSERT_EQ(vectorized, scalar) << shift;
+    }
+}
+
+TEST(TestCaseIntersection, TestKernelsAgree) {
+    for (size_t sizeB : {3u, 40u, 500u, 5000u}) {
+        vector<uint32_t> a, b;
+        for (uint32_t i = 0; i < 300; ++i) {
+            a.push_back(i * 7 + (i % 3));
+        }
+        for (uint32_t i = 0; i < sizeB; ++i) {
+            b.push_back(i * 5 + (i % 2));
+        }
+        vector<uint32_t> expected;
+        set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(expected));
+
+        vector<uint32_t> matchA(min(a.size(), b.size())), matchB(matchA.size());
+        using Kernel = size_t (*)(const uint32_t*, size_t, const uint32_t*, size_t, uint32_t*, uint32_t*);
+        for (Kernel kernel : {&Intersection::Linear, &Intersection::Simd, &Intersection::Intersect}) {
+            size_t found = kernel(a.data(), a.size(), b.data(), b.size(), matchA.data(), matchB.data());
+            ASSERT_EQ(found, expected.size()) << sizeB;
+            for (size_t k = 0; k < found; ++k) {
+                ASSERT_EQ(a[matchA[k]], expected[k]);
+                ASSERT_EQ(b[matchB[k]], expected[k]);
+            }
+        }
+        if (a.size() <= b.size()) {
+            ASSERT_EQ(Intersection::Galloping(a.data(), a.size(), b.data(), b.size(),
+                                              matchA.data(), matchB.data()), expected.size());
+        }
+    }
+    EXPECT_EQ(Intersection::Choose(10, 1000), Intersection::Kernel::Galloping);
+}
+
+TEST(TestCaseTermDictionary, TestInsertAndFind) {
+    TermDictionary dictionary;
+    for (size_t i = 0; i < 1000; ++i) {
+        ASSERT_EQ(dictionary.Insert("term" + to_string(i)), i);
+    }
+    ASSERT_EQ(dictionary.Insert("term42"), 42u);
+    ASSERT_EQ(dictionary.Size(), 1000u);
+
+    for (size_t i = 0; i < 1000; ++i) {
+        ASSERT_EQ(dictionary.Find("term" + to_string(i)), i);
+        ASSERT_EQ(dictionary.Term(static_cast<uint32_t>(i)), "term" + to_string(i));
+    }
+    ASSERT_EQ(dictionary.Find("term1000"), TermDictionary::npos);
+    ASSERT_EQ(dictionary.Find(""), TermDictionary::npos);
+}
+
+TEST(TestCaseFrontCodedDictionary, TestLookupAndPrefixRange) {
+    // Слова с длинными общими префиксами на много блоков, в том числе
+    // слово, которое само является префиксом следующих
+    std::set<string> words = {"a", "ab", "abc", "b", "\xff", "\xff\xff"};
+    for (size_t i = 0; i < 500; ++i) {
+        words.insert("term" + to_string(i));
+        words.insert("te" + to_string(i * 7));
+    }
+    FrontCodedDictionary::Builder builder;
+    for (const auto& word : words) {
+        builder.Add(word);
+    }
+    EXPECT_THROW(builder.Add("a"), std::logic_error);
+    FrontCodedDictionary dictionary = builder.Finish();
+    ASSERT_EQ(dictionary.Size(), words.size());
+
+    uint32_t id = 0;
+    FrontCodedDictionary::Iterator it(dictionary, 0);
+    for (const auto& word : words) {
+        ASSERT_TRUE(it.Valid());
+        ASSERT_EQ(it.Term(), word);
+        ASSERT_EQ(dictionary.Find(word), id);
+        ASSERT_EQ(dictionary.Term(id), word);
+        it.Next();
+        ++id;
+    }
+    EXPECT_FALSE(it.Valid());
+    EXPECT_EQ(dictionary.Find("term"), FrontCodedDictionary::npos);
+    EXPECT_EQ(dictionary.Find("term5000"), FrontCodedDictionary::npos);
+    EXPECT_EQ(dictionary.Find(""), FrontCodedDictionary::npos);
+
+    for (const string probe : {"", "a", "aa", "te", "te35", "term", "term42", "term499x", "u", "\xff", "\xff\xff\xff"}) {
+        auto lower = static_cast<uint32_t>(std::distance(words.begin(), words.lower_bound(probe)));
+        EXPECT_EQ(dictionary.LowerBound(probe), lower) << probe;
+        uint32_t count = 0;
+        for (const auto& word : words) {
+            count += word.compare(0, probe.size(), probe) == 0;
+        }
+        auto [first, last] = dictionary.PrefixRange(probe);
+        EXPECT_EQ(first, lower) << probe;
+        EXPECT_EQ(last - first, count) << probe;
+    }
+}
+
+TEST(TestCaseFuzzyIndex, TestCandidatesMatchBruteForce) {
+    EXPECT_EQ(FuzzyIndex::Distance("capital", "capitol", 2), 1u);
+    EXPECT_EQ(FuzzyIndex::Distance("capital", "cpaital", 2), 1u);
+    EXPECT_EQ(FuzzyIndex::Distance("kitten", "sitting", 3), 3u);
+    EXPECT_EQ(FuzzyIndex::Distance("kitten", "sitting", 2), 3u);
+    EXPECT_EQ(FuzzyIndex::Distance("лондон", "лондн", 2), 1u);
+    EXPECT_EQ(FuzzyIndex::Distance("abc", "", 1), 2u);
+
+    // Длинные слова проверяют поиск по префиксу: правки и в начале, и в конце слова
+    std::set<string> words = {"a", "at", "cat", "cut", "capital", "capitol", "capitals",
+                              "internationalization", "internationalisation", "interpolation",
+                              "лондон", "лондоне"};
+    for (size_t i = 0; i < 300; ++i) {
+        words.insert("term" + to_string(i * 13));
+    }
+    FrontCodedDictionary::Builder builder;
+    for (const auto& word : words) {
+        builder.Add(word);
+    }
+    FrontCodedDictionary dictionary = builder.Finish();
+
+    for (uint32_t distance = 1; distance <= FuzzyIndex::MAX_DISTANCE; ++distance) {
+        FuzzyIndex index = FuzzyIndex::Build(dictionary, distance);
+        EXPECT_EQ(index.MaxDistance(), distance);
+        std::vector<uint32_t> variants;
+        std::vector<uint32_t> candidates;
+        for (const string probe : {"", "a", "ct", "cta", "capitl", "cpaital", "internationalizaton",
+                                   "interantionalization", "lndon", "лнодон", "term1300", "trem130", "xyz"}) {
+            FuzzyIndex::Variants(probe, distance, variants);
+            candidates.clear();
+            index.Lookup(variants, candidates);
+            std::set<string> found;
+            for (uint32_t id : candidates) {
+                string term = dictionary.Term(id);
+                if (FuzzyIndex::Distance(probe, term, distance) <= distance) {
+                    found.insert(term);
+                }
+            }
+            std::set<string> expected;
+            for (const auto& word : words) {
+                if (FuzzyIndex::Distance(probe, word, distance) <= distance) {
+                    expected.insert(word);
+                }
+            }
+            EXPECT_EQ(found, expected) << probe << " " << distance;
+        }
+    }
+    EXPECT_EQ(FuzzyIndex::Build(dictionary, 0).Size(), 0u);
+    EXPECT_THROW(FuzzyIndex::Build(dictionary, FuzzyIndex::MAX_DISTANCE + 1), std::invalid_argument);
+}
+
 TEST(TestCaseSearchServer, TestSimple) {
     const vector<string> docs = {
             "milk milk milk milk water water water",
@@ -217,6 +575,569 @@ TEST(TestCaseSearchServer, TestExactCalculation) {
     }
 }
 
+TEST(TestCaseSearchServer, TestManyBlocksMatchNaiveCount) {
+    // Больше 128 документов на слово - пересечение идет через несколько блоков
+    vector<string> docs;
+    for (size_t i = 0; i < 2000; ++i) {
+        string text;
+        for (size_t k = 0; k < 1 + i % 3; ++k) text += "common ";
+        if (i % 2 == 0) text += "even ";
+        if (i % 3 == 0) text += "three three ";
+        if (i % 250 == 0) text += "rare ";
+        docs.push_back(text);
+    }
+
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->UpdateDocumentBase(docs);
+    SearchServer srv(idx);
+
+    auto result = srv.search({"three even common", "rare three"});
+    ASSERT_EQ(result.size(), 2u);
+
+    // Документы, кратные 6, содержат все три слова: 1..3 раза common, even, 2 раза three
+    size_t expectedDocs = 0;
+    for (size_t i = 0; i < docs.size(); i += 6) ++expectedDocs;
+    ASSERT_EQ(result[0].size(), expectedDocs);
+    EXPECT_EQ(result[0][0].doc_id, 0u);
+    EXPECT_NEAR(result[0][0].rank, 1.0f, 0.001f);
+
+    // rare встречается в документах, кратных 250; из них three - в кратных 750
+    ASSERT_EQ(result[1].size(), 3u);
+    EXPECT_EQ(result[1][0].doc_id, 0u);
+    EXPECT_EQ(result[1][1].doc_id, 750u);
+    EXPECT_EQ(result[1][2].doc_id, 1500u);
+}
+
+TEST(TestCaseSearchServer, TestResponseLimitKeepsOrdering) {
+    vector<string> docs;
+    for (size_t i = 0; i < 600; ++i) {
+        string text = "word ";
+        for (size_t k = 0; k < i % 7; ++k) text += "word ";
+        if (i % 5 == 0) text += "extra ";
+        docs.push_back(text);
+    }
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->UpdateDocumentBase(docs);
+    const vector<string> requests = {"word", "extra word", "missing"};
+
+    SearchServer unlimited(idx);
+    auto full = unlimited.search(requests);
+
+    for (size_t limit : {1u, 5u, 100u, 1000u}) {
+        SearchServer limited(idx, limit);
+        auto top = limited.search(requests);
+        ASSERT_EQ(top.size(), full.size());
+        for (size_t q = 0; q < full.size(); ++q) {
+            vector<RelativeIndex> expected(full[q].begin(),
+                                           full[q].begin() + min(limit, full[q].size()));
+            ASSERT_EQ(top[q], expected) << "limit " << limit << ", request " << q;
+        }
+    }
+}
+
+TEST(TestCaseSearchServer, TestParallelBatchMatchesSequential) {
+    vector<string> docs;
+    for (size_t i = 0; i < 300; ++i) {
+        docs.push_back("alpha " + string(i % 4, 'b') + " gamma " + (i % 3 == 0 ? "delta delta" : "alpha"));
+    }
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->UpdateDocumentBase(docs);
+
+    vector<string> requests;
+    for (size_t i = 0; i < 500; ++i) {
+        static const vector<string> variants = {"alpha", "gamma delta", "bbb alpha", "missing", "", "b gamma"};
+        requests.push_back(variants[i % variants.size()]);
+    }
+
+    SearchServer sequential(idx, 5);
+    ASSERT_EQ(sequential.GetSearchThreads(), 1u);
+    auto expected = sequential.search(requests);
+
+    SearchServer parallel(idx, 5);
+    parallel.SetSearchThreads(4);
+    ASSERT_EQ(parallel.GetSearchThreads(), 4u);
+    EXPECT_EQ(parallel.search(requests), expected);
+}
+
+TEST(TestCaseSearchServer, TestQueryCacheInvalidatedByUpdate) {
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->SetMergeFactor(2);
+    idx->UpdateDocumentBase({"milk water", "milk milk sugar", "water"});
+    SearchServer srv(idx);
+    srv.SetCacheCapacity(1 << 20);
+
+    auto first = srv.search({"milk water", "water milk", "milk"});
+    auto stats = srv.GetCacheStats();
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.hits, 1u);          // "water milk" - тот же набор слов
+    EXPECT_EQ(first[0], first[1]);
+
+    EXPECT_EQ(srv.search({"milk"}), vector<vector<RelativeIndex>>{first[2]});
+    EXPECT_EQ(srv.GetCacheStats().hits, 2u);
+
+    // Новый документ меняет поколение индекса - кэш не отдает старый ответ
+    idx->AddDocuments({"milk milk milk water", "sugar", "salt"});
+    auto updated = srv.search({"milk water"});
+    const vector<RelativeIndex> expected = {{3, 1.0f}, {0, 0.5f}};
+    EXPECT_EQ(updated[0], expected);
+    EXPECT_EQ(srv.GetCacheStats().hits, 2u);
+
+    // Слияние сегментов не меняет результатов и не сбрасывает кэш
+    idx->WaitForMerges();
+    EXPECT_EQ(idx->GetSnapshot()->Segments().size(), 1u);
+    EXPECT_EQ(srv.search({"milk water"})[0], expected);
+    EXPECT_EQ(srv.GetCacheStats().hits, 3u);
+}
+
+TEST(TestCaseSearchServer, TestSearchWithoutAllocations) {
+    vector<string> docs;
+    for (size_t i = 0; i < 1000; ++i) {
+        docs.push_back("alpha " + string(i % 5, 'b') + " gamma " + (i % 3 == 0 ? "delta delta" : "alpha"));
+    }
+    auto idx = std::make_shared<InvertedIndex>(1);
+    idx->UpdateDocumentBase(docs);
+    idx->AddDocuments({"alpha gamma delta", "bb delta"});
+    const vector<string> requests = {"alpha", "gamma delta", "bbb alpha", "missing", "", "delta bb"};
+
+    for (bool cached : {false, true}) {
+        SearchServer srv(idx, 5);
+        if (cached) {
+            srv.SetCacheCapacity(1 << 20);
+        }
+        const auto expected = srv.search(requests);
+
+        // Прогрев: буферы пула и result набирают емкость, кэш - записи
+        vector<RelativeIndex> result;
+        for (const auto& request : requests) {
+            srv.Search(request, result);
+        }
+
+        size_t allocations = CountAllocations([&]() {
+            for (size_t round = 0; round < 10; ++round) {
+                for (const auto& request : requests) {
+                    srv.Search(request, result);
+                }
+            }
+        });
+        EXPECT_EQ(allocations, 0u) << "cache " << cached;
+        // Пакетный search выделяет ответы - заодно проверка, что счетчик работает
+        EXPECT_GT(CountAllocations([&]() { srv.search(requests); }), 0u);
+
+        for (size_t i = 0; i < requests.size(); ++i) {
+            srv.Search(requests[i], result);
+            EXPECT_EQ(result, expected[i]);
+        }
+    }
+}
+
+TEST(TestCaseSearchServer, TestBm25Scores) {
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->UpdateDocumentBase({"a b", "a a b c", "c d"});
+    SearchServer srv(idx);
+    srv.SetRanking(Ranking::BM25);
+
+    // N = 3, df(a) = 2, средняя длина 8/3: оценки 1.1139 и 1.2055
+    const vector<RelativeIndex> expected = {{1, 1.0f}, {0, 0.924f}};
+    EXPECT_EQ(srv.search({"a"})[0], expected);
+
+    // BM25 не требует всех слов запроса, в отличие от режима Absolute
+    EXPECT_EQ(srv.search({"b d"})[0].size(), 3u);
+    srv.SetRanking(Ranking::Absolute);
+    EXPECT_TRUE(srv.search({"b d"})[0].empty());
+}
+
+TEST(TestCaseSearchServer, TestBm25TopKMatchesExhaustive) {
+    // Частоты слов убывают с номером, документы разной длины
+    vector<string> docs;
+    uint64_t state = 7;
+    auto next = [&state]() {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return static_cast<size_t>(state >> 33);
+    };
+    for (size_t i = 0; i < 4000; ++i) {
+        string text;
+        for (size_t n = 3 + next() % 40; n > 0; --n) {
+            size_t word = next() % 40;
+            word = word * word / 40;
+            text += "w" + to_string(word) + " ";
+        }
+        docs.push_back(text);
+    }
+    auto idx = std::make_shared<InvertedIndex>(2);
+    idx->UpdateDocumentBase(docs);
+    idx->AddDocuments({"w30 w30 w31", "w35 w1 w2", "w39"});
+    idx->RemoveDocuments({5, 17, 1000});
+    idx->ReplaceDocument(42, "w37 w37 w38 w0");
+    idx->WaitForMerges();
+
+    const vector<string> requests = {"w0", "w37", "w0 w1", "w3 w39 w0", "w20 w21 w22 w23", "w38 w38 w2", "w99"};
+    SearchServer exhaustive(idx);
+    exhaustive.SetRanking(Ranking::BM25);
+    auto all = exhaustive.search(requests);
+
+    for (size_t limit : {1u, 5u, 50u}) {
+        SearchServer top(idx, limit);
+        top.SetRanking(Ranking::BM25);
+        auto result = top.search(requests);
+        for (size_t q = 0; q < requests.size(); ++q) {
+            // Ответ - ровно начало полного списка, и при равных rank на границе
+            ASSERT_EQ(result[q].size(), std::min(limit, all[q].size())) << requests[q];
+            for (size_t i = 0; i < result[q].size(); ++i) {
+                EXPECT_EQ(result[q][i].doc_id, all[q][i].doc_id) << requests[q] << " #" << i;
+                EXPECT_EQ(result[q][i].rank, all[q][i].rank) << requests[q] << " #" << i;
+            }
+        }
+    }
+
+#if SEARCH_ENGINE_METRICS
+    // Частое слово с редким: отбор 5 лучших оценивает заметно меньше
+    // документов, чем полный перебор
+    auto scored = [&](SearchServer& srv) {
+        Metrics::SetEnabled(true);
+        Metrics::Reset();
+        srv.search({"w0 w38"});
+        uint64_t count = Metrics::Collect().counters[static_cast<size_t>(Metrics::Counter::DocumentsScored)];
+        Metrics::SetEnabled(false);
+        return count;
+    };
+    SearchServer top(idx, 5);
+    top.SetRanking(Ranking::BM25);
+    EXPECT_LT(scored(top) * 2, scored(exhaustive));
+#endif
+}
+
+TEST(TestCaseSearchServer, TestPhraseQueries) {
+    const vector<string> docs = {
+            "london is the capital of great britain",
+            "the capital is london",
+            "london is the capital london is the capital",
+            "is london the capital"
+    };
+    const string phrase = "\"London is the capital\"";
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->SetPositional(true);
+    idx->SetMergeFactor(2);
+    idx->UpdateDocumentBase(docs);
+    SearchServer srv(idx);
+
+    EXPECT_EQ(srv.search({phrase})[0], (vector<RelativeIndex>{ {2, 1.0f}, {0, 0.5f} }));
+    EXPECT_EQ(srv.search({"\"the capital\" of"})[0], (vector<RelativeIndex>{ {0, 1.0f} }));
+    // Незакрытая кавычка - фраза до конца запроса; фраза из одного слова - просто слово
+    EXPECT_EQ(srv.search({"\"capital is"})[0], (vector<RelativeIndex>{ {1, 1.0f} }));
+    EXPECT_EQ(srv.search({"\"britain\""})[0], (vector<RelativeIndex>{ {0, 1.0f} }));
+    srv.SetRanking(Ranking::BM25);
+    EXPECT_EQ(srv.search({phrase})[0].size(), 2u);
+    srv.SetRanking(Ranking::Absolute);
+
+    // Без позиций фраза проверяется только по наличию слов
+    auto plain = std::make_shared<InvertedIndex>();
+    plain->UpdateDocumentBase(docs);
+    EXPECT_EQ(SearchServer(plain).search({phrase})[0].size(), 4u);
+
+    // Позиции переживают изменения, слияние сегментов и файл индекса
+    idx->AddDocuments({"london is the capital"});
+    idx->ReplaceDocument(0, "capital the is london");
+    idx->WaitForMerges();
+    const vector<RelativeIndex> expected = {{2, 1.0f}, {4, 0.5f}};
+    EXPECT_EQ(srv.search({phrase})[0], expected);
+
+    const string path = (std::filesystem::temp_directory_path() / "search_engine_phrase.idx").string();
+    idx->SaveIndex(path, 7);
+    auto loaded = std::make_shared<InvertedIndex>();
+    loaded->SetPositional(true);
+    ASSERT_TRUE(loaded->LoadIndex(path, 7));
+    EXPECT_EQ(SearchServer(loaded).search({phrase})[0], expected);
+
+    // Файл без позиций позиционному индексу не подходит
+    plain->SaveIndex(path, 7);
+    EXPECT_FALSE(loaded->LoadIndex(path, 7));
+    std::filesystem::remove(path);
+}
+
+TEST(TestCaseSearchServer, TestWildcardQueries) {
+    const vector<string> docs = {
+            "london is the capital of great britain",
+            "londoner lives in london",
+            "the cat sat",
+            "a cot and a cut",
+            "Лондон и лондонцы"
+    };
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->SetMergeFactor(10);
+    idx->UpdateDocumentBase(docs);
+    SearchServer srv(idx);
+
+    // Absolute: документ содержит хотя бы одно из слов раскрытия, вхождения складываются
+    EXPECT_EQ(srv.search({"lond*"})[0], (vector<RelativeIndex>{ {1, 1.0f}, {0, 0.5f} }));
+    EXPECT_EQ(srv.search({"c?t"})[0], (vector<RelativeIndex>{ {3, 1.0f}, {2, 0.5f} }));
+    EXPECT_EQ(srv.search({"lond* capital"})[0], (vector<RelativeIndex>{ {0, 1.0f} }));
+    EXPECT_EQ(srv.search({"*ondon"})[0], (vector<RelativeIndex>{ {0, 1.0f}, {1, 1.0f} }));
+    EXPECT_TRUE(srv.search({"zz*"})[0].empty());
+    // '?' - один символ UTF-8, а не байт
+    EXPECT_EQ(srv.search({"лондо?"})[0], (vector<RelativeIndex>{ {4, 1.0f} }));
+    EXPECT_EQ(srv.search({"ЛОНДОН??"})[0], (vector<RelativeIndex>{ {4, 1.0f} }));
+
+    // Раскрытие ограничено самыми частыми словами (при равенстве - по алфавиту)
+    srv.SetMaxExpansions(1);
+    EXPECT_EQ(srv.search({"c?t"})[0], (vector<RelativeIndex>{ {2, 1.0f} }));
+    srv.SetMaxExpansions(SearchServer::DEFAULT_MAX_EXPANSIONS);
+
+    srv.SetRanking(Ranking::BM25);
+    EXPECT_EQ(srv.search({"c?t"})[0].size(), 2u);
+    srv.SetRanking(Ranking::Absolute);
+
+    // Слово из нескольких сегментов и после файла индекса
+    idx->AddDocuments({"londonium"});
+    const vector<RelativeIndex> expected = {{1, 1.0f}, {0, 0.5f}, {5, 0.5f}};
+    EXPECT_EQ(srv.search({"lond*"})[0], expected);
+    srv.SetRanking(Ranking::BM25);
+    EXPECT_EQ(srv.search({"lond*"})[0].size(), 3u);
+    srv.SetRanking(Ranking::Absolute);
+
+    const string path = (std::filesystem::temp_directory_path() / "search_engine_wildcard.idx").string();
+    idx->SaveIndex(path, 9);
+    auto loaded = std::make_shared<InvertedIndex>();
+    ASSERT_TRUE(loaded->LoadIndex(path, 9));
+    EXPECT_EQ(SearchServer(loaded).search({"lond*"})[0], expected);
+    std::filesystem::remove(path);
+}
+
+TEST(TestCaseSearchServer, TestFuzzyQueries) {
+    const vector<string> docs = {
+            "london is the capital of great britain",
+            "capital capital paris",
+            "capital paris paris",
+            "the cat sat",
+            "Лондон и лондонцы",
+            "a bat"
+    };
+    auto plain = std::make_shared<InvertedIndex>();
+    plain->UpdateDocumentBase(docs);
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->SetFuzzyDistance(2);
+    idx->UpdateDocumentBase(docs);
+
+    // Без индекса удалений или без нечеткого поиска опечатка не исправляется
+    SearchServer srv(idx);
+    EXPECT_TRUE(srv.search({"capitl"})[0].empty());
+    SearchServer noIndex(plain);
+    noIndex.SetFuzzyDistance(2);
+    EXPECT_TRUE(noIndex.search({"capitl"})[0].empty());
+
+    srv.SetFuzzyDistance(2);
+    EXPECT_EQ(srv.search({"capitl"})[0], (vector<RelativeIndex>{ {1, 1.0f}, {0, 0.5f}, {2, 0.5f} }));
+    EXPECT_EQ(srv.search({"cpaital"})[0], srv.search({"capital"})[0]);
+    EXPECT_EQ(srv.search({"лондн"})[0], (vector<RelativeIndex>{ {4, 1.0f} }));
+    // Вклад исправленного слова: 0.5 за правку (2 * 0.5 + 1 против 1 * 0.5 + 2)
+    EXPECT_EQ(srv.search({"capitl paris"})[0], (vector<RelativeIndex>{ {2, 1.0f}, {1, 0.8f} }));
+    srv.SetFuzzyPenalty(1.0f);
+    EXPECT_EQ(srv.search({"capitl paris"})[0], (vector<RelativeIndex>{ {1, 1.0f}, {2, 1.0f} }));
+    srv.SetFuzzyPenalty(SearchServer::DEFAULT_FUZZY_PENALTY);
+    EXPECT_THROW(srv.SetFuzzyPenalty(0.0f), std::invalid_argument);
+
+    // Короткие слова: в 3-5 символах одна правка, в 1-2 символах ни одной
+    EXPECT_EQ(srv.search({"xat"})[0], (vector<RelativeIndex>{ {3, 1.0f}, {5, 0.5f} }));
+    EXPECT_TRUE(srv.search({"xt"})[0].empty());
+    EXPECT_TRUE(srv.search({"cxx"})[0].empty());
+    // Ограничение числа слов: самые частые, при равенстве - по алфавиту
+    srv.SetMaxFuzzyTerms(1);
+    EXPECT_EQ(srv.search({"xat"})[0], (vector<RelativeIndex>{ {5, 1.0f} }));
+    srv.SetMaxFuzzyTerms(SearchServer::DEFAULT_MAX_FUZZY_TERMS);
+
+    srv.SetRanking(Ranking::BM25);
+    EXPECT_EQ(srv.search({"capitl"})[0].size(), 3u);
+    EXPECT_EQ(srv.search({"capitl paris"})[0][0].doc_id, 2u);
+    srv.SetRanking(Ranking::Absolute);
+
+    // Индекс удалений переживает слияние сегментов и файл индекса
+    idx->AddDocuments({"capitals of europe"});
+    idx->WaitForMerges();
+    EXPECT_EQ(srv.search({"europa"})[0], (vector<RelativeIndex>{ {6, 1.0f} }));
+    const string path = (std::filesystem::temp_directory_path() / "search_engine_fuzzy.idx").string();
+    idx->SaveIndex(path, 5);
+    auto loaded = std::make_shared<InvertedIndex>();
+    loaded->SetFuzzyDistance(2);
+    ASSERT_TRUE(loaded->LoadIndex(path, 5));
+    SearchServer fromFile(loaded);
+    fromFile.SetFuzzyDistance(2);
+    EXPECT_EQ(fromFile.search({"europa"})[0], (vector<RelativeIndex>{ {6, 1.0f} }));
+    // Файл без индекса удалений не подходит, если нечеткий поиск включен
+    plain->SaveIndex(path, 5);
+    EXPECT_FALSE(loaded->LoadIndex(path, 5));
+    std::filesystem::remove(path);
+}
+
+namespace {
+
+// Корпус для сравнения шардов с одним индексом: мало слов, поэтому много
+// документов с равной релевантностью, есть похожие слова для шаблонов и опечаток
+vector<string> shardedCorpus() {
+    const vector<string> words = {"milk", "mild", "mile", "silk", "water", "waiter", "later", "sugar",
+                                  "bread", "break", "dream", "cream", "green", "grain", "train", "brain"};
+    vector<string> docs;
+    uint64_t state = 11;
+    auto next = [&state]() {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return static_cast<size_t>(state >> 33);
+    };
+    for (size_t i = 0; i < 600; ++i) {
+        string text;
+        for (size_t n = 2 + next() % 12; n > 0; --n) {
+            size_t word = next() % words.size();
+            text += words[word * word / words.size()] + " ";
+        }
+        docs.push_back(text);
+    }
+    return docs;
+}
+
+std::shared_ptr<InvertedIndex> shardedIndex(const vector<string>& docs) {
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->SetPositional(true);
+    idx->SetFuzzyDistance(2);
+    // Несколько сегментов: у шардов и у общего индекса они разные
+    idx->UpdateDocumentBase(vector<string>(docs.begin(), docs.begin() + static_cast<std::ptrdiff_t>(docs.size() / 2)));
+    idx->AddDocuments(vector<string>(docs.begin() + static_cast<std::ptrdiff_t>(docs.size() / 2), docs.end()));
+    idx->WaitForMerges();
+    return idx;
+}
+
+const vector<string> shardedQueries = {
+        "milk", "milk water", "sugar sugar bread", "mil*", "?ream", "gr* brain", "drem", "brian milk",
+        "\"green grain\"", "cream zzzz", "zzzz", "waterr later", ""
+};
+
+}
+
+TEST(TestCaseShardCoordinator, TestMatchesSingleIndex) {
+    auto docs = shardedCorpus();
+    SearchServer single(shardedIndex(docs));
+
+    const size_t count = 3;
+    vector<vector<string>> parts(count);
+    for (size_t i = 0; i < docs.size(); ++i) {
+        parts[ShardCoordinator::ShardOf(i, count)].push_back(docs[i]);
+    }
+    vector<std::shared_ptr<SearchShard>> shards;
+    for (const auto& part : parts) {
+        shards.push_back(std::make_shared<LocalShard>(std::make_shared<SearchServer>(shardedIndex(part))));
+    }
+    SearchServer sharded(std::make_shared<InvertedIndex>());
+    sharded.SetShards(shards);
+    sharded.SetSearchThreads(2);
+
+    // Ранги и порядок - как у одного индекса при любом числе ответов,
+    // включая равенство рангов на границе ответа и ограничение раскрытий
+    for (Ranking ranking : {Ranking::Absolute, Ranking::BM25}) {
+        for (size_t limit : {0u, 1u, 5u, 40u}) {
+            for (SearchServer* srv : {&single, &sharded}) {
+                srv->SetRanking(ranking);
+                srv->SetMaxResponses(limit);
+                srv->SetFuzzyDistance(2);
+                srv->SetMaxExpansions(2);
+            }
+            auto expected = single.search(shardedQueries);
+            auto result = sharded.search(shardedQueries);
+            for (size_t q = 0; q < shardedQueries.size(); ++q) {
+                EXPECT_EQ(result[q], expected[q]) << shardedQueries[q] << ", limit " << limit
+                                                  << (ranking == Ranking::BM25 ? ", bm25" : ", absolute");
+            }
+        }
+    }
+    EXPECT_FALSE(single.search({"milk"})[0].empty());
+    // Равные ранги на границе ответа заставляли шарды отбирать заново
+    auto stats = sharded.GetShards()->GetStats();
+    EXPECT_GT(stats.refetches, 0u);
+    EXPECT_EQ(stats.queries, 2 * 4 * shardedQueries.size());
+
+    // Ошибка шарда - ошибка запроса
+    class FailingShard : public SearchShard {
+    public:
+        void CollectStats(const ShardQuery&, ShardStats&) override { throw std::runtime_error("shard is down"); }
+        void Search(const ShardQuery&, ShardHits&) override { }
+        std::string GetSnippet(size_t, const std::string&) override { return ""; }
+    };
+    shards.push_back(std::make_shared<FailingShard>());
+    sharded.SetShards(shards);
+    EXPECT_THROW(sharded.search({"milk"}), std::runtime_error);
+    sharded.SetShards({});
+    EXPECT_TRUE(sharded.search({"milk"})[0].empty());
+}
+
+TEST(TestCaseIndexReloader, TestSwapWhileSearching) {
+    const vector<string> oldDocs = {"milk water", "milk milk sugar", "water"};
+    const vector<string> newDocs = {"sugar sugar", "milk", "milk water water", "salt"};
+    auto oldIndex = std::make_shared<InvertedIndex>();
+    oldIndex->UpdateDocumentBase(oldDocs);
+    SearchServer srv(oldIndex);
+    srv.SetCacheCapacity(1 << 20);
+
+    const vector<string> requests = {"milk water", "sugar", "milk"};
+    const auto oldExpected = srv.search(requests);
+    std::weak_ptr<InvertedIndex> oldAlive = oldIndex;
+    oldIndex.reset();
+
+    auto reference = std::make_shared<InvertedIndex>();
+    reference->UpdateDocumentBase(newDocs);
+    const auto newExpected = SearchServer(reference).search(requests);
+    ASSERT_NE(oldExpected, newExpected);
+
+    // Каждый пакет видит целиком либо старый, либо новый индекс
+    std::atomic<bool> done{false};
+    std::atomic<size_t> mixed{0};
+    std::thread reader([&]() {
+        while (!done) {
+            auto result = srv.search(requests);
+            if (result != oldExpected && result != newExpected) {
+                ++mixed;
+            }
+        }
+    });
+
+    bool fail = true;
+    IndexReloader reloader(srv, [&]() {
+        if (fail) {
+            throw std::runtime_error("config is broken");
+        }
+        auto fresh = std::make_shared<InvertedIndex>();
+        fresh->UpdateDocumentBase(newDocs);
+        return fresh;
+    });
+
+    // Неудачная сборка оставляет прежний индекс
+    reloader.Request();
+    reloader.WaitIdle();
+    EXPECT_EQ(reloader.GetStats().failures, 1u);
+    EXPECT_EQ(reloader.GetStats().lastError, "config is broken");
+    EXPECT_EQ(srv.search(requests), oldExpected);
+
+    fail = false;
+    reloader.Request();
+    reloader.WaitIdle();
+    done = true;
+    reader.join();
+
+    EXPECT_EQ(reloader.GetStats().reloads, 1u);
+    EXPECT_EQ(mixed.load(), 0u);
+    // Кэш не отдает ответы старого индекса, а сам старый индекс освобожден
+    EXPECT_EQ(srv.search(requests), newExpected);
+    EXPECT_TRUE(oldAlive.expired());
+}
+
+TEST(TestCaseSearchServer, TestCaseInsensitive) {
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->UpdateDocumentBase({"Great Britain", "the great bell", "Молоко и ВОДА"});
+    SearchServer srv(idx);
+
+    auto result = srv.search({"GREAT", "вода молоко"});
+    const vector<vector<RelativeIndex>> expected = {
+            {{0, 1.0f}, {1, 1.0f}},
+            {{2, 1.0f}}
+    };
+    EXPECT_EQ(result, expected);
+    EXPECT_EQ(idx->GetWordCount("Great").size(), 2u);
+}
+
 TEST(TestCaseSearchServer, TestEmptyQuery) {
     const vector<string> docs = {
             "some text here",
@@ -236,6 +1157,599 @@ TEST(TestCaseSearchServer, TestEmptyQuery) {
     ASSERT_EQ(result, expected);
 }
 
+TEST(TestCaseIncrementalIndex, TestAddMatchesFullRebuild) {
+    const vector<string> docs = {
+            "milk milk milk milk water water water",
+            "milk water water",
+            "milk milk milk milk milk water water water water water",
+            "americano cappuccino",
+            "water with sugar",
+            "milk and sugar and water",
+            "cappuccino with milk"
+    };
+    const vector<string> requests = {"milk water", "sugar", "cappuccino", "milk"};
+
+    auto full = std::make_shared<InvertedIndex>();
+    full->UpdateDocumentBase(docs);
+
+    auto incremental = std::make_shared<InvertedIndex>();
+    incremental->SetMergeFactor(2);
+    incremental->UpdateDocumentBase({docs[0], docs[1]});
+    for (size_t i = 2; i < docs.size(); ++i) {
+        vector<size_t> ids = incremental->AddDocuments({docs[i]});
+        ASSERT_EQ(ids, (vector<size_t>{i}));
+    }
+    incremental->WaitForMerges();
+
+    EXPECT_LT(incremental->GetSnapshot()->Segments().size(), docs.size() - 1);
+    for (const auto& word : {"milk", "water", "sugar", "cappuccino", "with"}) {
+        EXPECT_EQ(incremental->GetWordCount(word), full->GetWordCount(word)) << word;
+    }
+    EXPECT_EQ(SearchServer(incremental).search(requests), SearchServer(full).search(requests));
+}
+
+TEST(TestCaseIncrementalIndex, TestRemoveAndReplace) {
+    vector<string> docs = {
+            "milk milk water",
+            "milk water water",
+            "americano cappuccino",
+            "milk sugar"
+    };
+
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->SetMergeFactor(2);
+    idx->UpdateDocumentBase(docs);
+    idx->RemoveDocuments({1});
+    idx->ReplaceDocument(2, "cappuccino with milk milk milk");
+    idx->ReplaceDocument(3, "milk water sugar");
+    idx->WaitForMerges();
+
+    // Эталон - полная перестройка, где удаленный документ пуст
+    docs[1] = "";
+    docs[2] = "cappuccino with milk milk milk";
+    docs[3] = "milk water sugar";
+    auto full = std::make_shared<InvertedIndex>();
+    full->UpdateDocumentBase(docs);
+
+    for (const auto& word : {"milk", "water", "americano", "cappuccino", "sugar"}) {
+        EXPECT_EQ(idx->GetWordCount(word), full->GetWordCount(word)) << word;
+    }
+    const vector<string> requests = {"milk", "milk water", "americano", "cappuccino milk"};
+    EXPECT_EQ(SearchServer(idx).search(requests), SearchServer(full).search(requests));
+    EXPECT_THROW(idx->ReplaceDocument(10, "text"), std::out_of_range);
+}
+
+TEST(TestCaseMemoryUsage, TestBreakdownAndLargestTerms) {
+    InvertedIndex idx;
+    vector<string> docs;
+    for (int i = 0; i < 600; ++i) {
+        docs.push_back("milk w" + to_string(i) + (i % 3 == 0 ? " water" : ""));
+    }
+    idx.UpdateDocumentBase(docs);
+
+    auto usage = idx.GetMemoryUsage(2);
+    EXPECT_EQ(usage.segments, 1u);
+    EXPECT_EQ(usage.terms, 602u);
+    EXPECT_EQ(usage.postings, 600u + 600u + 200u);
+    EXPECT_GT(usage.dictionaryBytes, 0u);
+    EXPECT_GT(usage.postingsBytes, 0u);
+    EXPECT_EQ(usage.documentBytes, 600u * 2 * sizeof(uint32_t));
+    EXPECT_EQ(usage.mappedBytes, 0u);
+    EXPECT_GE(usage.heapBytes, usage.dictionaryBytes + usage.postingsBytes + usage.documentBytes);
+
+    ASSERT_EQ(usage.largestTerms.size(), 2u);
+    EXPECT_EQ(usage.largestTerms[0].term, "milk");
+    EXPECT_EQ(usage.largestTerms[0].postings, 600u);
+    EXPECT_EQ(usage.largestTerms[1].term, "water");
+    EXPECT_EQ(usage.largestTerms[1].postings, 200u);
+    EXPECT_GT(usage.largestTerms[0].bytes, usage.largestTerms[1].bytes);
+}
+
+TEST(TestCaseMemoryUsage, TestBudgetFailsOrCompacts) {
+    vector<string> docs;
+    for (int i = 0; i < 200; ++i) {
+        docs.push_back("milk water w" + to_string(i));
+    }
+
+    InvertedIndex strict;
+    strict.UpdateDocumentBase({"milk"});
+    strict.SetMemoryBudget(1024);
+    EXPECT_THROW(strict.UpdateDocumentBase(docs), MemoryBudgetError);
+    EXPECT_THROW(strict.AddDocuments(docs), MemoryBudgetError);
+    // Отклоненное изменение не публикуется и не расходует doc_id
+    EXPECT_EQ(strict.GetDocumentCount(), 1u);
+    EXPECT_EQ(strict.GetWordCount("milk"), (vector<Entry>{{0, 1}}));
+
+    // Без сжатия десять мелких сегментов не помещаются, слитые в один - помещаются
+    InvertedIndex reference;
+    reference.SetMergeFactor(1000);
+    for (int i = 0; i < 10; ++i) {
+        reference.AddDocuments(vector<string>(docs.begin() + i * 20, docs.begin() + i * 20 + 20));
+    }
+    size_t fragmented = reference.GetMemoryUsage().heapBytes;
+    InvertedIndex merged;
+    merged.UpdateDocumentBase(docs);
+    size_t compact = merged.GetMemoryUsage().heapBytes;
+    ASSERT_LT(compact, fragmented);
+
+    InvertedIndex compacting;
+    compacting.SetMergeFactor(1000);
+    compacting.SetMemoryBudget((compact + fragmented) / 2, MemoryPolicy::Compact);
+    for (int i = 0; i < 10; ++i) {
+        compacting.AddDocuments(vector<string>(docs.begin() + i * 20, docs.begin() + i * 20 + 20));
+    }
+    EXPECT_LT(compacting.GetSnapshot()->Segments().size(), 10u);
+    EXPECT_LE(compacting.GetMemoryUsage().heapBytes, (compact + fragmented) / 2);
+    EXPECT_EQ(compacting.GetWordCount("w150"), (vector<Entry>{{150, 1}}));
+    EXPECT_EQ(compacting.GetWordCount("milk").size(), 200u);
+}
+
+TEST(TestCaseIndexFile, TestSaveAndLoad) {
+    const vector<string> docs = {
+            "milk milk milk milk water water water",
+            "milk water water",
+            "milk milk milk milk milk water water water water water",
+            "americano cappuccino"
+    };
+    const string path = (std::filesystem::temp_directory_path() / "search_engine_test.idx").string();
+
+    auto built = std::make_shared<InvertedIndex>();
+    built->UpdateDocumentBase(docs);
+    built->AddDocuments({"milk sugar"});
+    built->RemoveDocuments({1});
+    built->SaveIndex(path, 42);
+
+    auto loaded = std::make_shared<InvertedIndex>();
+    ASSERT_FALSE(loaded->LoadIndex(path, 43));
+    ASSERT_TRUE(loaded->LoadIndex(path, 42));
+
+    for (const auto& word : {"milk", "water", "cappuccino", "sugar", "tea"}) {
+        EXPECT_EQ(loaded->GetWordCount(word), built->GetWordCount(word)) << word;
+    }
+    const vector<string> requests = {"milk water", "sugar", "cappuccino"};
+    EXPECT_EQ(SearchServer(loaded).search(requests), SearchServer(built).search(requests));
+    EXPECT_EQ(loaded->GetSnapshot()->DocumentCount(), 5u);
+
+    // Загруженный индекс можно дополнять
+    EXPECT_EQ(loaded->AddDocuments({"tea"}), (vector<size_t>{5}));
+    EXPECT_EQ(loaded->GetWordCount("tea"), (vector<Entry>{ {5, 1} }));
+
+    // Открытие не читает данные файла: порча длины документа (последняя
+    // секция) видна только полной проверке контрольной суммы
+    loaded.reset();
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-3, std::ios::end);
+        file.put('x');
+    }
+    InvertedIndex corrupted;
+    EXPECT_TRUE(corrupted.LoadIndex(path, 42));
+    EXPECT_THROW(corrupted.LoadIndex(path, 42, true), std::runtime_error);
+    // Заголовок проверяется всегда
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(20);
+        file.put('x');
+    }
+    EXPECT_THROW(corrupted.LoadIndex(path, 42), std::runtime_error);
+    std::filesystem::remove(path);
+    EXPECT_FALSE(corrupted.LoadIndex(path, 42));
+}
+
+TEST(TestCaseDocumentStore, TestRoundTripAndCorruption) {
+    // Сжимаемые, несжимаемые, пустые и документы больше блока
+    vector<string> docs;
+    unsigned seed = 7;
+    for (int i = 0; i < 300; ++i) {
+        string text;
+        if (i % 7 == 3) {
+            for (int j = 0; j < 200 + i; ++j) {
+                seed = seed * 1103515245u + 12345u;
+                text.push_back(static_cast<char>(seed >> 16));
+            }
+        } else if (i % 11 != 5) {
+            for (int j = 0; j <= i % 40; ++j) {
+                text += "milk water " + std::to_string(j % 5) + " ";
+            }
+        }
+        docs.push_back(text);
+    }
+    docs[100] = string(5000, 'a') + "tail";
+
+    for (const auto& doc : docs) {
+        string compressed;
+        LzCodec::Compress(doc.data(), doc.size(), compressed);
+        string restored(doc.size(), '\0');
+        ASSERT_TRUE(LzCodec::Decompress(compressed.data(), compressed.size(), restored.data(), restored.size()));
+        ASSERT_EQ(restored, doc);
+        if (!doc.empty()) {
+            EXPECT_FALSE(LzCodec::Decompress(compressed.data(), compressed.size() / 2, restored.data(), restored.size()));
+        }
+    }
+
+    const string path = (std::filesystem::temp_directory_path() / "search_engine_test.docs").string();
+    {
+        DocumentStore::Writer writer(path, 1024);
+        for (const auto& doc : docs) {
+            writer.Add(doc);
+        }
+        writer.Finish(42);
+    }
+    EXPECT_EQ(DocumentStore::Open(path, 43), nullptr);
+    auto store = DocumentStore::Open(path, 42, 2);
+    ASSERT_NE(store, nullptr);
+    EXPECT_EQ(store->Size(), docs.size());
+    EXPECT_GT(store->BlockCount(), 10u);
+    EXPECT_LT(store->FileBytes(), store->RawBytes());
+
+    string text;
+    for (size_t i = 0; i < docs.size(); ++i) {
+        size_t doc = (i * 37) % docs.size();
+        ASSERT_TRUE(store->Get(doc, text));
+        EXPECT_EQ(text, docs[doc]) << doc;
+    }
+    EXPECT_FALSE(store->Get(docs.size(), text));
+    EXPECT_THROW(store->Get(docs.size()), std::out_of_range);
+
+    // Соседние документы одного блока читаются из кэша
+    auto before = store->GetCacheStats();
+    store->Get(1);
+    store->Get(2);
+    auto after = store->GetCacheStats();
+    EXPECT_EQ(after.misses - before.misses, 1u);
+    EXPECT_LE(after.blocks, 2u);
+
+    // Порча таблиц обнаруживается при открытии
+    store.reset();
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-4, std::ios::end);
+        uint32_t bad = UINT32_MAX;
+        file.write(reinterpret_cast<const char*>(&bad), sizeof(bad));
+    }
+    EXPECT_THROW(DocumentStore::Open(path, 42), std::runtime_error);
+    std::filesystem::remove(path);
+    EXPECT_EQ(DocumentStore::Open(path, 42), nullptr);
+}
+
+TEST(TestCaseSnippet, TestWindowAndHighlight) {
+    const string text = "Moscow is the capital of Russia. London is the capital of Great Britain,\n"
+                        "and London  is on the Thames river. Paris is the capital of France.";
+    EXPECT_EQ(Snippet::Make(text, {"london", "thames"}, 60),
+              "... Britain, and <b>London</b> is on the <b>Thames</b> river. Paris is ...");
+    EXPECT_EQ(Snippet::Make(text, {"lond*"}, 30, "[", "]"), "... of Russia. [London] is the ...");
+    // Без слов запроса - начало текста
+    EXPECT_EQ(Snippet::Make(text, {"tea"}, 20), "Moscow is the ...");
+    EXPECT_EQ(Snippet::Make("short text", {"text"}, 100), "short <b>text</b>");
+
+    const string path = (std::filesystem::temp_directory_path() / "search_engine_snippet.docs").string();
+    const vector<string> docs = {"milk water", "americano cappuccino with milk, milk, milk, milk and milk"};
+    {
+        DocumentStore::Writer writer(path);
+        for (const auto& doc : docs) {
+            writer.Add(doc);
+        }
+        writer.Finish(1);
+    }
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->UpdateDocumentBase(docs);
+    SearchServer srv(idx);
+    EXPECT_EQ(srv.GetSnippet(1, "Milk"), "");
+    idx->SetDocumentStore(DocumentStore::Open(path, 1));
+    EXPECT_EQ(srv.GetSnippet(1, "\"with Milk\""), "americano cappuccino <b>with</b> milk, milk, milk, <b>milk</b> and <b>milk</b>");
+    EXPECT_EQ(srv.GetSnippet(2, "milk"), "");
+    EXPECT_GT(idx->GetMemoryUsage().storedTextBytes, 0u);
+
+    // Индекс подменили между поиском и сниппетами: сниппет - из индекса,
+    // на котором искали, а не текст другого документа с тем же doc_id
+    auto pinned = srv.GetIndex();
+    auto found = srv.search(*pinned, {"cappuccino"});
+    ASSERT_EQ(found[0].size(), 1u);
+    auto fresh = std::make_shared<InvertedIndex>();
+    fresh->UpdateDocumentBase({"tea", "green tea"});
+    srv.SetIndex(fresh);
+    EXPECT_NE(srv.GetSnippet(*pinned, found[0][0].doc_id, "cappuccino").find("<b>cappuccino</b>"), string::npos);
+    EXPECT_EQ(srv.GetSnippet(found[0][0].doc_id, "cappuccino"), "");
+
+    idx->SetDocumentStore(nullptr);
+    std::filesystem::remove(path);
+}
+
+TEST(TestCaseConverterJSON, TestWriteAnswersFormat) {
+    vector<vector<std::pair<int, float>>> answers(1000);
+    answers[0] = {{2, 1.0f}, {0, 0.5f}};
+    answers[1] = {{3, 1.0f}};
+    answers[999] = {{1, 1.0f}};
+
+    std::ostringstream out;
+    ConverterJSON::WriteAnswers(out, answers);
+    auto parsed = nlohmann::json::parse(out.str())["answers"];
+
+    ASSERT_EQ(parsed.size(), 1000u);
+    EXPECT_EQ(parsed["request001"]["result"], "true");
+    EXPECT_EQ(parsed["request001"]["relevance"][1]["docid"], 0);
+    EXPECT_EQ(parsed["request002"]["docid"], 3);
+    EXPECT_EQ(parsed["request003"]["result"], "false");
+    EXPECT_EQ(parsed["request1000"]["docid"], 1);
+}
+
+TEST(TestCaseMetrics, TestHistogramBucketsBoundError) {
+    for (uint64_t value : {0ull, 7ull, 15ull, 16ull, 100ull, 1000ull, 123456ull, 987654321ull, 1ull << 62}) {
+        uint64_t represented = Metrics::BucketValue(Metrics::BucketIndex(value));
+        EXPECT_LE(represented > value ? represented - value : value - represented, value / 16) << value;
+    }
+    EXPECT_LT(Metrics::BucketIndex(UINT64_MAX), Metrics::BUCKET_COUNT);
+}
+
+TEST(TestCaseMetrics, TestStagesAndCountersCollected) {
+    auto idx = std::make_shared<InvertedIndex>();
+    SearchServer srv(idx);
+
+    Metrics::SetEnabled(false);
+    Metrics::Reset();
+    idx->UpdateDocumentBase({"milk water", "milk sugar", "water"});
+    srv.search({"milk"});
+    EXPECT_EQ(Metrics::Collect().stages[static_cast<size_t>(Metrics::Stage::ProcessQuery)].count, 0u);
+
+    Metrics::SetEnabled(true);
+    idx->UpdateDocumentBase({"milk water", "milk sugar", "water", "milk milk water"});
+    srv.search({"milk water", "sugar", "missing"});
+    idx->GetWordCount("milk");
+    auto report = Metrics::Collect();
+    Metrics::SetEnabled(false);
+
+    auto stage = [&report](Metrics::Stage s) { return report.stages[static_cast<size_t>(s)]; };
+    auto counter = [&report](Metrics::Counter c) { return report.counters[static_cast<size_t>(c)]; };
+    if (!SEARCH_ENGINE_METRICS) {
+        EXPECT_EQ(stage(Metrics::Stage::ProcessQuery).count, 0u);
+        return;
+    }
+    EXPECT_EQ(stage(Metrics::Stage::UpdateDocumentBase).count, 1u);
+    EXPECT_EQ(stage(Metrics::Stage::IndexDocument).count, 4u);
+    EXPECT_EQ(stage(Metrics::Stage::ProcessQuery).count, 3u);
+    EXPECT_EQ(stage(Metrics::Stage::GetWordCount).count, 1u);
+    EXPECT_LE(stage(Metrics::Stage::ProcessQuery).p50Nanos, stage(Metrics::Stage::ProcessQuery).p99Nanos);
+    EXPECT_LE(stage(Metrics::Stage::ProcessQuery).p99Nanos, stage(Metrics::Stage::ProcessQuery).maxNanos);
+    EXPECT_EQ(counter(Metrics::Counter::DocumentsIndexed), 4u);
+    EXPECT_EQ(counter(Metrics::Counter::TokensIndexed), 8u);
+    EXPECT_EQ(counter(Metrics::Counter::Queries), 3u);
+    EXPECT_EQ(counter(Metrics::Counter::DocumentsScored), 3u);    // "milk water": 0, 3; "sugar": 1
+    EXPECT_GE(counter(Metrics::Counter::PostingsScanned), 3u);
+
+    auto json = nlohmann::json::parse(Metrics::ToJson(report));
+    EXPECT_EQ(json["stages"]["process_query"]["count"], 3);
+    EXPECT_EQ(json["counters"]["queries"], 3);
+}
+
 TEST(sample_test_case, sample_test) {
     EXPECT_EQ(1, 1);
 }
+
+TEST(TestCaseIngestionPipeline, TestStreamingMatchesInMemoryBuild) {
+    vector<string> docs;
+    for (size_t i = 0; i < 40; ++i) {
+        docs.push_back("milk " + string(i % 5 + 1, 'w') + " water" + (i % 3 == 0 ? " sugar sugar" : ""));
+    }
+    docs[7] = "";      // нечитаемый файл становится пустым документом
+
+    vector<string> paths;
+    auto directory = std::filesystem::temp_directory_path();
+    for (size_t i = 0; i < docs.size(); ++i) {
+        if (i == 7) {
+            paths.push_back((directory / "search_engine_missing.txt").string());
+            continue;
+        }
+        paths.push_back((directory / ("search_engine_doc" + to_string(i) + ".txt")).string());
+        ofstream(paths.back(), ios::binary) << docs[i];
+    }
+
+    auto expected = std::make_shared<InvertedIndex>();
+    expected->UpdateDocumentBase(docs);
+
+    // Крошечный бюджет: много пакетов и постоянно полная очередь чтения
+    auto streamed = std::make_shared<InvertedIndex>();
+    streamed->UpdateDocumentBase({"old document"});
+    EXPECT_EQ(IngestionPipeline(*streamed, 64).Run(paths), docs.size());
+    EXPECT_GT(streamed->GetSnapshot()->Segments().size(), 0u);
+    EXPECT_EQ(streamed->GetDocumentCount(), docs.size());
+
+    const vector<string> requests = {"milk water", "sugar", "www", "old document"};
+    EXPECT_EQ(SearchServer(streamed).search(requests), SearchServer(expected).search(requests));
+
+    for (const auto& path : paths) {
+        std::filesystem::remove(path);
+    }
+}
+
+TEST(TestCaseSpimiBuilder, TestOutOfCoreMatchesInMemoryBuild) {
+    // Частое слово "milk" дает списки длиннее порции кодирования при слиянии
+    vector<string> docs;
+    for (size_t i = 0; i < 12000; ++i) {
+        string text = "milk";
+        if (i % 2 == 0) text += " water water";
+        if (i % 7 == 0) text += " sugar";
+        if (i % 1000 == 0) text += " Rare";
+        text += " w" + to_string(i % 300);
+        docs.push_back(text);
+    }
+    docs[5] = "";
+
+    auto directory = std::filesystem::temp_directory_path();
+    const string path = (directory / "search_engine_spimi.idx").string();
+    const uint64_t fingerprint = 7;
+
+    vector<size_t> runs;
+    {
+        SpimiBuilder builder((directory / "search_engine_spimi.runs").string(), 16 * 1024);
+        builder.SetProgressCallback([&runs](const SpimiBuilder::Progress& progress) {
+            runs.push_back(progress.runs);
+        });
+        for (const auto& text : docs) {
+            builder.AddDocument(text);
+        }
+        auto progress = builder.Finish(path, fingerprint);
+        EXPECT_EQ(progress.documents, docs.size());
+        EXPECT_GT(progress.runs, 10u);
+        EXPECT_GT(progress.peakMemory, 0u);
+    }
+    EXPECT_EQ(runs.size(), runs.back() + 1);     // по вызову на прогон и на слияние
+
+    auto loaded = std::make_shared<InvertedIndex>();
+    ASSERT_TRUE(loaded->LoadIndex(path, fingerprint));
+    auto built = std::make_shared<InvertedIndex>();
+    built->UpdateDocumentBase(docs);
+
+    const vector<string> requests = {"milk", "water sugar", "rare milk", "w17 water", "missing"};
+    EXPECT_EQ(SearchServer(loaded).search(requests), SearchServer(built).search(requests));
+    EXPECT_EQ(loaded->GetWordCount("milk"), built->GetWordCount("milk"));
+
+    std::filesystem::remove(path);
+    std::filesystem::remove_all(directory / "search_engine_spimi.runs");
+}
+
+#ifndef _WIN32
+TEST(TestCaseSearchDaemon, TestPipelinedResponsesKeepOrder) {
+    const vector<string> docs = {
+            "milk milk milk milk water water water",
+            "milk water water",
+            "milk milk milk milk milk water water water water water",
+            "americano cappuccino"
+    };
+    auto idx = std::make_shared<InvertedIndex>();
+    idx->UpdateDocumentBase(docs);
+    SearchServer srv(idx);
+
+    const vector<string> queries = {"milk water", "sugar", "americano", "Milk"};
+    string input;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        input += nlohmann::json({{"id", i}, {"query", queries[i]}}).dump();
+        // Последний запрос - без перевода строки перед закрытием входа
+        if (i + 1 < queries.size()) {
+            input += "\n";
+        }
+        if (i == 1) {
+            input += "{not json\n";
+            input += R"({"id":"x","query":5})" "\n";
+        }
+    }
+
+    int in[2];
+    int out[2];
+    ASSERT_EQ(pipe(in), 0);
+    ASSERT_EQ(pipe(out), 0);
+    ASSERT_EQ(write(in[1], input.data(), input.size()), static_cast<ssize_t>(input.size()));
+    close(in[1]);
+
+    SearchDaemon daemon(srv);
+    daemon.ServeStream(in[0], out[1]);
+    close(in[0]);
+    close(out[1]);
+
+    string output;
+    char chunk[4096];
+    for (ssize_t n; (n = read(out[0], chunk, sizeof(chunk))) > 0;) {
+        output.append(chunk, static_cast<size_t>(n));
+    }
+    close(out[0]);
+
+    vector<nlohmann::json> responses;
+    std::istringstream lines(output);
+    for (string line; std::getline(lines, line);) {
+        responses.push_back(nlohmann::json::parse(line));
+    }
+    ASSERT_EQ(responses.size(), queries.size() + 2);
+
+    // Ответы идут в порядке запросов, ошибочные строки не ломают соединение
+    EXPECT_TRUE(responses[2].contains("error"));
+    EXPECT_EQ(responses[3]["id"], string("x"));
+    EXPECT_TRUE(responses[3].contains("error"));
+
+    auto expected = srv.search(queries);
+    const size_t positions[] = {0, 1, 4, 5};
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto& response = responses[positions[i]];
+        EXPECT_EQ(response["id"], i);
+        EXPECT_EQ(response["result"], !expected[i].empty());
+        ASSERT_EQ(response["relevance"].size(), expected[i].size());
+        for (size_t j = 0; j < expected[i].size(); ++j) {
+            EXPECT_EQ(response["relevance"][j]["docid"], expected[i][j].doc_id);
+            EXPECT_FLOAT_EQ(response["relevance"][j]["rank"].get<float>(), expected[i][j].rank);
+            // rank печатается так же коротко, как в answers.json (0.7, а не 0.699999988...)
+            EXPECT_LE(response["relevance"][j]["rank"].dump().size(), 5u) << response["relevance"][j]["rank"].dump();
+        }
+    }
+    EXPECT_EQ(daemon.GetStats().requests, queries.size() + 2);
+    EXPECT_EQ(daemon.GetStats().rejected, 0u);
+}
+
+TEST(TestCaseShardCoordinator, TestRemoteShards) {
+    auto docs = shardedCorpus();
+    SearchServer single(shardedIndex(docs));
+
+    const size_t count = 2;
+    vector<std::unique_ptr<SearchServer>> servers;
+    vector<std::unique_ptr<SearchDaemon>> daemons;
+    vector<std::thread> threads;
+    vector<string> paths;
+    vector<std::shared_ptr<SearchShard>> shards;
+    for (size_t s = 0; s < count; ++s) {
+        vector<string> part;
+        for (size_t i = s; i < docs.size(); i += count) {
+            part.push_back(docs[i]);
+        }
+        servers.push_back(std::make_unique<SearchServer>(shardedIndex(part)));
+        // Запросы шардов одного пакета идут на потоки поиска шарда
+        servers.back()->SetSearchThreads(2);
+        daemons.push_back(std::make_unique<SearchDaemon>(*servers.back()));
+        paths.push_back((std::filesystem::temp_directory_path() /
+                         ("search_engine_shard" + std::to_string(s) + ".sock")).string());
+        std::filesystem::remove(paths.back());
+        threads.emplace_back([&daemon = *daemons.back(), path = paths.back()]() { daemon.ServeSocket(path); });
+        shards.push_back(std::make_shared<RemoteShard>(paths.back()));
+    }
+    for (const auto& path : paths) {
+        while (!std::filesystem::exists(path)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    SearchServer sharded(std::make_shared<InvertedIndex>());
+    sharded.SetShards(shards);
+    sharded.SetSearchThreads(4);
+    for (Ranking ranking : {Ranking::Absolute, Ranking::BM25}) {
+        for (SearchServer* srv : {&single, &sharded}) {
+            srv->SetRanking(ranking);
+            srv->SetMaxResponses(5);
+            srv->SetFuzzyDistance(2);
+        }
+        EXPECT_EQ(sharded.search(shardedQueries), single.search(shardedQueries));
+    }
+
+    for (auto& daemon : daemons) {
+        daemon->Stop();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // Шард недоступен - ошибка запроса, а не пустой ответ
+    EXPECT_THROW(sharded.search({"milk"}), std::runtime_error);
+
+    // Шард принимает соединение, но не отвечает - ошибка по таймауту
+    const string hungPath = (std::filesystem::temp_directory_path() / "search_engine_hung.sock").string();
+    std::filesystem::remove(hungPath);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, hungPath.c_str(), hungPath.size() + 1);
+    ASSERT_EQ(bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+    ASSERT_EQ(listen(listener, 4), 0);
+    RemoteShard hung(hungPath, 50);
+    ShardStats stats;
+    auto started = std::chrono::steady_clock::now();
+    EXPECT_THROW(hung.CollectStats(ShardQuery(), stats), std::runtime_error);
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(5));
+    close(listener);
+    std::filesystem::remove(hungPath);
+}
+#endif
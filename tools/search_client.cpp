@@ -0,0 +1,211 @@
+// Клиент резидентного режима search_engine (--serve <socket>).
+//
+//   search_client <socket> [query ...]
+//       отправляет запросы (из аргументов или построчно из stdin), печатает ответы
+//   search_client <socket> --bench <total> [--connections N] [--window W] query ...
+//       нагрузочный тест: total запросов по кругу из списка, N соединений,
+//       до W неотвеченных запросов на соединение; печатает QPS и задержки
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "nlohmann/json.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+class LineSocket {
+public:
+    explicit LineSocket(const std::string& path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("socket path is too long: " + path);
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            throw std::runtime_error("cannot connect to " + path + ": " + std::strerror(errno));
+        }
+    }
+
+    ~LineSocket() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    void Send(const std::string& line) {
+        std::string data = line + "\n";
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                throw std::runtime_error("connection closed while sending");
+            }
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    std::string Receive() {
+        while (true) {
+            size_t end = buffer.find('\n');
+            if (end != std::string::npos) {
+                std::string line = buffer.substr(0, end);
+                buffer.erase(0, end + 1);
+                return line;
+            }
+            char chunk[1 << 16];
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                throw std::runtime_error("connection closed by server");
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+    }
+
+private:
+    int fd = -1;
+    std::string buffer;
+};
+
+std::string makeRequest(size_t id, const std::string& query) {
+    return nlohmann::json({{"id", id}, {"query", query}}).dump();
+}
+
+int runQueries(const std::string& socketPath, std::vector<std::string> queries) {
+    if (queries.empty()) {
+        for (std::string line; std::getline(std::cin, line);) {
+            queries.push_back(line);
+        }
+    }
+
+    LineSocket connection(socketPath);
+    // Запросы уходят, не дожидаясь ответов (не больше окна, чтобы не забить
+    // буферы сокета с обеих сторон); ответы приходят в том же порядке
+    const size_t window = 64;
+    size_t sent = 0;
+    for (size_t received = 0; received < queries.size(); ++received) {
+        while (sent < queries.size() && sent - received < window) {
+            connection.Send(makeRequest(sent, queries[sent]));
+            ++sent;
+        }
+        std::cout << connection.Receive() << std::endl;
+    }
+    return 0;
+}
+
+int runBench(const std::string& socketPath, size_t total, size_t connections, size_t window,
+             const std::vector<std::string>& queries) {
+    std::vector<std::vector<double>> latencies(connections);
+    std::atomic<size_t> busy{0};
+    std::atomic<size_t> next{0};
+
+    std::atomic<size_t> failed{0};
+
+    auto started = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < connections; ++c) {
+        threads.emplace_back([&, c]() {
+            try {
+                LineSocket connection(socketPath);
+                std::deque<Clock::time_point> outstanding;
+                bool exhausted = false;
+                while (!exhausted || !outstanding.empty()) {
+                    while (!exhausted && outstanding.size() < window) {
+                        size_t i = next.fetch_add(1);
+                        if (i >= total) {
+                            exhausted = true;
+                            break;
+                        }
+                        outstanding.push_back(Clock::now());
+                        connection.Send(makeRequest(i, queries[i % queries.size()]));
+                    }
+                    if (outstanding.empty()) {
+                        break;
+                    }
+                    std::string response = connection.Receive();
+                    auto elapsed = std::chrono::duration<double, std::micro>(Clock::now() - outstanding.front());
+                    outstanding.pop_front();
+                    latencies[c].push_back(elapsed.count());
+                    if (response.find("\"error\":\"busy\"") != std::string::npos) {
+                        ++busy;
+                    }
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Connection " << c << ": " << e.what() << std::endl;
+                ++failed;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+
+    std::vector<double> all;
+    for (const auto& part : latencies) {
+        all.insert(all.end(), part.begin(), part.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p) {
+        return all.empty() ? 0.0 : all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))];
+    };
+
+    std::cout << all.size() << " requests in " << seconds << " s: "
+              << static_cast<size_t>(all.size() / std::max(seconds, 1e-9)) << " QPS, "
+              << busy.load() << " busy" << std::endl;
+    std::cout << "latency us: p50 " << percentile(0.5) << ", p90 " << percentile(0.9)
+              << ", p99 " << percentile(0.99) << ", max " << (all.empty() ? 0.0 : all.back()) << std::endl;
+    return failed.load() == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <socket> [query ...]" << std::endl
+                  << "       " << argv[0] << " <socket> --bench <total> [--connections N] [--window W] query ..."
+                  << std::endl;
+        return 2;
+    }
+
+    try {
+        std::string socketPath = argv[1];
+        size_t total = 0;
+        size_t connections = 1;
+        size_t window = 64;
+        std::vector<std::string> queries;
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--bench" && i + 1 < argc) {
+                total = std::stoul(argv[++i]);
+            } else if (arg == "--connections" && i + 1 < argc) {
+                connections = std::max<size_t>(1, std::stoul(argv[++i]));
+            } else if (arg == "--window" && i + 1 < argc) {
+                window = std::max<size_t>(1, std::stoul(argv[++i]));
+            } else {
+                queries.push_back(arg);
+            }
+        }
+
+        if (total > 0) {
+            if (queries.empty()) {
+                throw std::runtime_error("--bench needs at least one query");
+            }
+            return runBench(socketPath, total, connections, window, queries);
+        }
+        return runQueries(socketPath, queries);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}